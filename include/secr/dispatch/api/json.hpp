@@ -1,4 +1,5 @@
 #pragma once
+#include <secr/dispatch/asioex/zero_copy_output.hpp>
 #include <google/protobuf/message.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/util/json_util.h>
@@ -7,6 +8,7 @@
 #include <valuelib/tuple/algorithm.hpp>
 
 #include <sstream>
+#include <type_traits>
 
 namespace secr { namespace dispatch { namespace api {
     
@@ -51,4 +53,54 @@ namespace secr { namespace dispatch { namespace api {
                         google::protobuf::util::JsonOptions opts = json_options(pretty_json,
                                                                                 include_defaults));
     
+    /// Write the json representation of a message to a zero copy stream.
+    /// The output is identical to google::protobuf::util::MessageToJsonString,
+    /// except that:
+    /// - invalid utf-8 in string fields is dropped byte by byte
+    /// - map entries appear in reflection order
+    /// - with always_print_primitive_fields, the members of oneofs which
+    ///   are set, including proto3 optional fields (synthetic oneofs), are
+    ///   written after the other fields. This is the order of protobuf's
+    ///   converter up to 3.21. Later converters may write them in
+    ///   declaration order.
+    /// Messages are written directly by reflection. Messages which use proto2
+    /// or the well-known types are converted by protobuf's own converter,
+    /// through a type resolver which is cached per descriptor pool.
+    /// @throws std::runtime_error if the stream fails or the conversion fails
+    void write_json(google::protobuf::io::ZeroCopyOutputStream& out,
+                    const google::protobuf::Message& msg,
+                    google::protobuf::util::JsonOptions opts = json_options(pretty_json,
+                                                                            include_defaults));
+    
+    /// Append the json representation of a message to a string
+    void append_json(std::string& out,
+                     const google::protobuf::Message& msg,
+                     google::protobuf::util::JsonOptions opts = json_options(pretty_json,
+                                                                             include_defaults));
+    
+    /// Write the json representation of a message to any SyncWriteStream,
+    /// through a fixed-size buffer
+    /// @returns the number of bytes written
+    /// @throws system_error if the stream fails
+    template<class SyncWriteStream,
+             std::enable_if_t<not std::is_base_of<google::protobuf::io::ZeroCopyOutputStream,
+                                                  SyncWriteStream>::value>* = nullptr>
+    std::size_t write_json(SyncWriteStream& stream,
+                           const google::protobuf::Message& msg,
+                           google::protobuf::util::JsonOptions opts = json_options(pretty_json,
+                                                                                   include_defaults))
+    {
+        asioex::zero_copy_output<SyncWriteStream> out(stream);
+        try {
+            write_json(static_cast<google::protobuf::io::ZeroCopyOutputStream&>(out), msg, opts);
+        }
+        catch(...) {
+            // prefer the underlying transport error
+            if (out.error()) throw system_error(out.error());
+            throw;
+        }
+        out.flush();
+        return std::size_t(out.ByteCount());
+    }
+    
 }}}
\ No newline at end of file
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+#include <type_traits>
+
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
+namespace secr { namespace dispatch { namespace asioex {
+
+    /// true if Stream can expose the socket underneath it. Such a stream
+    /// provides:
+    ///     int native_socket() - the socket, in non-blocking mode, or -1 if
+    ///                           the stream transforms the data it writes
+    ///     async_wait_writable(void(const error_code&))
+    template<class Stream, class = void>
+    struct has_native_socket : std::false_type {};
+
+    template<class Stream>
+    struct has_native_socket
+    <
+    Stream,
+    decltype(void(std::declval<Stream&>().native_socket()))
+    > : std::true_type {};
+
+    /// The error reported when a file ends before the region sent from it,
+    /// for instance because it was truncated after its length was committed
+    /// to a Content-Length. It is not an eof, which would read as the end of
+    /// the response, so the connection is closed on the short body.
+    inline error_code short_file_error()
+    {
+        return error_code(EIO, boost::system::system_category());
+    }
+
+#if defined(__linux__)
+    /// Copy a region of a file to a socket with sendfile(2), waiting for the
+    /// socket whenever it is full
+    template<class AsyncWriteStream, class Handler>
+    struct sendfile_op
+    : std::enable_shared_from_this<sendfile_op<AsyncWriteStream, Handler>>
+    {
+        /// the largest amount handed to one sendfile call
+        static constexpr std::size_t max_call = 1 << 30;
+
+        sendfile_op(AsyncWriteStream& stream, int socket, int fd,
+                    std::uint64_t offset, std::size_t size, Handler handler)
+        : _stream(stream)
+        , _socket(socket)
+        , _fd(fd)
+        , _offset(offset)
+        , _remaining(size)
+        , _handler(std::move(handler))
+        {}
+
+        void run()
+        {
+            while (_remaining)
+            {
+                auto offset = off_t(_offset);
+                auto sent = ::sendfile(_socket, _fd, std::addressof(offset), std::min(_remaining, std::size_t(max_call)));
+                if (sent > 0)
+                {
+                    _offset += std::size_t(sent);
+                    _remaining -= std::size_t(sent);
+                    _written += std::size_t(sent);
+                }
+                else if (sent == 0)
+                {
+                    return complete(short_file_error());
+                }
+                else if (errno == EINTR)
+                {
+                    continue;
+                }
+                else if (errno == EAGAIN or errno == EWOULDBLOCK)
+                {
+                    _stream.async_wait_writable([self = this->shared_from_this()](const error_code& ec)
+                                                {
+                                                    if (ec)
+                                                        self->_handler(ec, self->_written);
+                                                    else
+                                                        self->run();
+                                                });
+                    return;
+                }
+                else
+                {
+                    return complete(error_code(errno, boost::system::system_category()));
+                }
+            }
+            complete(error_code());
+        }
+
+    private:
+        void complete(error_code ec)
+        {
+            _stream.get_io_service().post([self = this->shared_from_this(), ec]
+                                          {
+                                              self->_handler(ec, self->_written);
+                                          });
+        }
+
+        AsyncWriteStream& _stream;
+        int _socket;
+        int _fd;
+        std::uint64_t _offset;
+        std::size_t _remaining;
+        std::size_t _written = 0;
+        Handler _handler;
+    };
+#endif
+
+    /// Copy a region of a file to any stream by reading it into memory a
+    /// block at a time
+    template<class AsyncWriteStream, class Handler>
+    struct pread_write_op
+    : std::enable_shared_from_this<pread_write_op<AsyncWriteStream, Handler>>
+    {
+        static constexpr std::size_t block_size = 65536;
+
+        pread_write_op(AsyncWriteStream& stream, int fd,
+                       std::uint64_t offset, std::size_t size, Handler handler)
+        : _stream(stream)
+        , _fd(fd)
+        , _offset(offset)
+        , _remaining(size)
+        , _handler(std::move(handler))
+        , _block(new char[std::min(size, std::size_t(block_size))])
+        {}
+
+        void run()
+        {
+            if (not _remaining)
+                return complete(error_code());
+
+            auto got = ::pread(_fd, _block.get(), std::min(_remaining, std::size_t(block_size)), off_t(_offset));
+            if (got < 0 and errno == EINTR)
+                return run();
+            if (got < 0)
+                return complete(error_code(errno, boost::system::system_category()));
+            if (got == 0)
+                return complete(short_file_error());
+
+            asio::async_write(_stream, asio::buffer(_block.get(), std::size_t(got)),
+                              [self = this->shared_from_this()](const error_code& ec, std::size_t size)
+                              {
+                                  self->_offset += size;
+                                  self->_remaining -= size;
+                                  self->_written += size;
+                                  if (ec)
+                                      self->_handler(ec, self->_written);
+                                  else
+                                      self->run();
+                              });
+        }
+
+    private:
+        void complete(error_code ec)
+        {
+            _stream.get_io_service().post([self = this->shared_from_this(), ec]
+                                          {
+                                              self->_handler(ec, self->_written);
+                                          });
+        }
+
+        AsyncWriteStream& _stream;
+        int _fd;
+        std::uint64_t _offset;
+        std::size_t _remaining;
+        std::size_t _written = 0;
+        Handler _handler;
+        std::unique_ptr<char[]> _block;
+    };
+
+    namespace detail {
+
+        template<class AsyncWriteStream, class Handler>
+        void send_file(AsyncWriteStream& stream, int fd,
+                       std::uint64_t offset, std::size_t size,
+                       Handler&& handler, std::false_type)
+        {
+            using handler_type = std::decay_t<Handler>;
+            std::make_shared<pread_write_op<AsyncWriteStream, handler_type>>
+            (stream, fd, offset, size, std::forward<Handler>(handler))->run();
+        }
+
+        template<class AsyncWriteStream, class Handler>
+        void send_file(AsyncWriteStream& stream, int fd,
+                       std::uint64_t offset, std::size_t size,
+                       Handler&& handler, std::true_type)
+        {
+#if defined(__linux__)
+            using handler_type = std::decay_t<Handler>;
+            auto socket = stream.native_socket();
+            if (socket < 0)
+                return send_file(stream, fd, offset, size, std::forward<Handler>(handler), std::false_type());
+            std::make_shared<sendfile_op<AsyncWriteStream, handler_type>>
+            (stream, socket, fd, offset, size, std::forward<Handler>(handler))->run();
+#else
+            // sendfile(2) differs from one platform to another; elsewhere
+            // the file is copied through user space
+            send_file(stream, fd, offset, size, std::forward<Handler>(handler), std::false_type());
+#endif
+        }
+    }
+
+    /// Write size bytes of the file fd, starting at offset, to a stream.
+    /// If the stream writes straight to a socket the data is sent with
+    /// sendfile(2) and never enters user space (Linux only). Otherwise (TLS,
+    /// for example) it is read with pread and written a block at a time.
+    /// Handler is a model of void(const error_code&, std::size_t bytes_written)
+    /// @note the file must stay open until the handler is called
+    template<class AsyncWriteStream, class Handler>
+    void async_send_file(AsyncWriteStream& stream, int fd,
+                         std::uint64_t offset, std::size_t size,
+                         Handler&& handler)
+    {
+        detail::send_file(stream, fd, offset, size, std::forward<Handler>(handler),
+                          has_native_socket<AsyncWriteStream>());
+    }
+
+}}}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace secr { namespace dispatch { namespace asioex {
+
+    /// A hierarchical timing wheel shared by all wheel_timers on one io_service.
+    /// The service owns a single asio timer which is only armed while there are
+    /// entries on the wheel, so the cost of a wheel_timer is one intrusive list
+    /// node rather than one heap timer per object.
+    /// Expiry is accurate to one tick (100ms by default).
+    /// @note all methods are thread-safe
+    class timer_wheel_service
+    : public asio::io_service::service
+    {
+    public:
+        static asio::io_service::id id;
+
+        using clock_type = std::chrono::steady_clock;
+        using duration = clock_type::duration;
+        using time_point = clock_type::time_point;
+        using handler_type = std::function<void()>;
+
+        static constexpr std::size_t slot_bits = 6;
+        static constexpr std::size_t slots_per_level = std::size_t(1) << slot_bits;
+        static constexpr std::size_t levels = 4;
+
+        /// An entry on the wheel. Owned by a wheel_timer.
+        struct entry
+        {
+            entry() = default;
+            entry(const entry&) = delete;
+            entry& operator=(const entry&) = delete;
+
+            bool linked() const { return _prev != nullptr; }
+
+        private:
+            friend class timer_wheel_service;
+            entry* _prev = nullptr;
+            entry* _next = nullptr;
+            std::uint64_t _expiry_tick = 0;
+            handler_type _handler;
+        };
+
+        explicit timer_wheel_service(asio::io_service& owner);
+
+        /// Set the resolution of the wheel
+        /// @pre there are no entries on the wheel
+        void set_tick_duration(duration tick);
+        duration tick_duration() const;
+
+        /// Place an entry on the wheel. The handler will be posted to the
+        /// io_service once the duration has elapsed.
+        /// @returns true if the entry was already on the wheel, in which case its
+        ///          previous handler will never be called
+        bool schedule(entry& e, duration after, handler_type handler);
+
+        /// Remove an entry from the wheel
+        /// @returns true if the entry was on the wheel, in which case its handler
+        ///          will never be called. false if the handler has already been
+        ///          posted or the entry was never scheduled
+        bool cancel(entry& e);
+
+        /// Move the wheel forward by a number of ticks, posting the handlers of
+        /// all entries which expire. The wheel is normally driven by the
+        /// service's own timer - this is exposed for testing.
+        /// @returns the number of handlers posted
+        std::size_t advance(std::size_t ticks);
+
+        /// The number of entries currently on the wheel
+        std::size_t size() const;
+
+    private:
+        using mutex_type = std::mutex;
+        using lock_type = std::unique_lock<mutex_type>;
+
+        void shutdown_service() override;
+
+        std::uint64_t now_tick() const;
+        void insert(const lock_type& lock, entry& e);
+        void unlink(const lock_type& lock, entry& e);
+        void cascade(const lock_type& lock, std::size_t level);
+        std::size_t tick(const lock_type& lock);
+        void arm(const lock_type& lock);
+        void handle_timer(const error_code& ec);
+
+        /// a circular list head for each slot
+        struct slot
+        {
+            slot() { head._prev = head._next = std::addressof(head); }
+            bool empty() const { return head._next == std::addressof(head); }
+            entry head;
+        };
+
+        mutable mutex_type _mutex;
+        asio::steady_timer _timer;
+        bool _timer_armed = false;
+        duration _tick = std::chrono::milliseconds(100);
+        time_point _origin = clock_type::now();
+        std::uint64_t _current_tick = 0;
+        std::size_t _size = 0;
+        std::array<std::array<slot, slots_per_level>, levels> _slots;
+    };
+
+    /// A timer whose expiry is managed by the io_service's timer_wheel_service.
+    /// Unlike an asio timer, the handler takes no arguments and is never called
+    /// for a cancellation.
+    class wheel_timer
+    {
+    public:
+        using duration = timer_wheel_service::duration;
+
+        explicit wheel_timer(asio::io_service& io_service)
+        : _service(asio::use_service<timer_wheel_service>(io_service))
+        {}
+
+        wheel_timer(const wheel_timer&) = delete;
+        wheel_timer& operator=(const wheel_timer&) = delete;
+
+        ~wheel_timer() noexcept {
+            _service.cancel(_entry);
+        }
+
+        /// Call the handler on the io_service after a duration
+        /// @returns true if a previous expiry was cancelled
+        template<class Handler>
+        bool expires_after(duration after, Handler&& handler)
+        {
+            return _service.schedule(_entry, after,
+                                     timer_wheel_service::handler_type(std::forward<Handler>(handler)));
+        }
+
+        /// @returns true if the timer was pending, in which case its handler
+        ///          will never be called
+        bool cancel() {
+            return _service.cancel(_entry);
+        }
+
+        timer_wheel_service& service() { return _service; }
+
+    private:
+        timer_wheel_service& _service;
+        timer_wheel_service::entry _entry;
+    };
+
+}}}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <secr/dispatch/config.hpp>
+#include <secr/dispatch/asioex/send_file.hpp>
 #include <array>
 #include <memory>
+#include <type_traits>
 
 #include <valuelib/stdext/string_algorithm.hpp>
 #include <boost/log/trivial.hpp>
@@ -96,6 +98,165 @@ namespace secr { namespace dispatch { namespace asioex {
         std::array<char, BufferSize> _buffer;
     };
     
+    /// A transfer from a source which can hand over blocks of data without
+    /// copying them (see fake_stream::async_read_some_or_take).
+    /// Small writes which are ready together are gathered into the buffer, and
+    /// the buffer is written as soon as the source has nothing more ready. An
+    /// attachment is written straight from the caller's memory, together with
+    /// whatever precedes it in the buffer. A file attachment follows the buffer
+    /// with async_send_file.
+    template<class AsyncReadStream, class AsyncWriteStream, class Handler, std::size_t BufferSize>
+    struct zero_copy_transfer_op
+    :std::enable_shared_from_this
+    < zero_copy_transfer_op< AsyncReadStream, AsyncWriteStream, Handler, BufferSize > >
+    {
+        using source_stream_type = AsyncReadStream;
+        using dest_stream_type = AsyncWriteStream;
+        using handler_type = Handler;
+        using attachment_ptr = std::shared_ptr<typename source_stream_type::attachment>;
+        
+        zero_copy_transfer_op(source_stream_type& source, dest_stream_type& dest,
+                              handler_type handler)
+        : _source(source)
+        , _destination(dest)
+        , _handler(std::move(handler))
+        {
+        }
+        
+        void run()
+        {
+            start_read();
+        }
+        
+    private:
+        
+        void start_read()
+        {
+            _source.async_read_some_or_take(asio::buffer(_buffer.data() + _filled,
+                                                         BufferSize - _filled),
+                                            [self = this->shared_from_this()]
+                                            (auto& ec, auto bytes, attachment_ptr a)
+            {
+                self->handle_read(ec, bytes, std::move(a));
+            });
+        }
+        
+        void handle_read(const error_code& ec, std::size_t bytes, attachment_ptr a)
+        {
+            _read_error = ec;
+            _filled += bytes;
+            _bytes_read += bytes;
+            if (a)
+            {
+                _bytes_read += a->remaining();
+                _attachment = std::move(a);
+                if (_attachment->is_file() and not _filled)
+                    start_send_file();
+                else
+                    start_write();
+            }
+            else if (_read_error or _filled == BufferSize or not _source.available())
+            {
+                // nothing more is ready, so hold nothing back from the reader
+                if (_filled)
+                    start_write();
+                else if (_read_error)
+                    complete();
+                else
+                    start_read();
+            }
+            else
+            {
+                start_read();
+            }
+        }
+        
+        void start_write()
+        {
+            std::array<asio::const_buffer, 2> buffers {{
+                asio::buffer(_buffer.data(), _filled),
+                _attachment and not _attachment->is_file() ? _attachment->data() : asio::const_buffer()
+            }};
+            asio::async_write(_destination, buffers,
+                              [self = this->shared_from_this()]
+                              (auto& ec, auto size)
+                              {
+                                  self->handle_write(ec, size);
+                              });
+        }
+        
+        void handle_write(const error_code& ec, std::size_t bytes)
+        {
+            _write_error = ec;
+            _bytes_written += bytes;
+            BOOST_LOG_TRIVIAL(trace) << "transferred: " << bytes << " bytes, total="
+            << _bytes_written << ", write_error: " << ec.message()
+            << (_attachment ? " (attachment)" : "");
+            
+            _filled = 0;
+            if (_attachment and _attachment->is_file() and not ec)
+                return start_send_file();
+            attachment_done();
+        }
+        
+        void start_send_file()
+        {
+            auto region = _attachment->file();
+            async_send_file(_destination, region.fd, region.offset, region.size,
+                            [self = this->shared_from_this()]
+                            (const error_code& ec, std::size_t size)
+                            {
+                                self->_write_error = ec;
+                                self->_bytes_written += size;
+                                self->attachment_done();
+                            });
+        }
+        
+        void attachment_done()
+        {
+            if (_attachment)
+            {
+                _attachment->complete(_write_error);
+                _attachment.reset();
+            }
+            
+            if (_read_error or _write_error) {
+                complete();
+            }
+            else {
+                start_read();
+            }
+        }
+        
+        void complete()
+        {
+            _handler(_read_error, _write_error, _bytes_read, _bytes_written);
+        }
+        
+        source_stream_type& _source;
+        dest_stream_type& _destination;
+        handler_type _handler;
+        
+        error_code _read_error = {};
+        error_code _write_error = {};
+        std::size_t _bytes_read = 0;
+        std::size_t _bytes_written = 0;
+        std::size_t _filled = 0;
+        attachment_ptr _attachment;
+        std::array<char, BufferSize> _buffer;
+    };
+    
+    /// true if Stream can hand over data without copying it
+    template<class Stream, class = void>
+    struct supports_attachments : std::false_type {};
+    
+    template<class Stream>
+    struct supports_attachments
+    <
+    Stream,
+    decltype(void(std::declval<typename Stream::attachment&>().complete(error_code())))
+    > : std::true_type {};
+    
     /// Transfer bytes from one stream to another
     /// @param from is the AsyncReadStream to transfer from
     /// @param to is the AsyncWriteStream to transfer to
@@ -103,6 +264,8 @@ namespace secr { namespace dispatch { namespace asioex {
     ///         be called when the transfer is complete
     /// @note the handler will be called on the io_service of *either*
     ///         stream
+    /// @note if the source supports attachments, they are written to the
+    ///         destination without being copied
     /// Handler is a model of function( const error_code& source_error,
     ///                                 const error_code& dest_error,
     ///                                 std::size_t bytes_read,
@@ -120,7 +283,12 @@ namespace secr { namespace dispatch { namespace asioex {
         using dest_stream_type = std::decay_t<AsyncWriteStream>;
         using handler_type = std::decay_t<Handler>;
         
-        using op_type = transfer_op<source_stream_type, dest_stream_type, handler_type, BufferSize>;
+        using op_type = std::conditional_t
+        <
+        supports_attachments<source_stream_type>::value,
+        zero_copy_transfer_op<source_stream_type, dest_stream_type, handler_type, BufferSize>,
+        transfer_op<source_stream_type, dest_stream_type, handler_type, BufferSize>
+        >;
         
         auto op_ptr = std::make_shared<op_type>(from, to, std::forward<Handler>(handler));
         op_ptr->run();
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include <array>
+#include <cstdint>
+
+namespace secr { namespace dispatch { namespace asioex {
+
+    /// A protobuf ZeroCopyOutputStream which writes through a fixed buffer to
+    /// any asio SyncWriteStream, so that protobuf and json output can be sent
+    /// without first being built as one string.
+    /// If a write fails, Next() returns false and the error is available
+    /// from error(). Call flush() once output is complete.
+    template<class SyncWriteStream, std::size_t BufferSize = 4096>
+    class zero_copy_output
+    : public google::protobuf::io::ZeroCopyOutputStream
+    {
+    public:
+        explicit zero_copy_output(SyncWriteStream& stream)
+        : _stream(stream)
+        {}
+
+        bool Next(void** data, int* size) override
+        {
+            if (_used == _buffer.size() and not flush_buffer())
+                return false;
+            *data = _buffer.data() + _used;
+            *size = static_cast<int>(_buffer.size() - _used);
+            _byte_count += _buffer.size() - _used;
+            _used = _buffer.size();
+            return true;
+        }
+
+        void BackUp(int count) override
+        {
+            assert(count >= 0 and std::size_t(count) <= _used);
+            _used -= count;
+            _byte_count -= count;
+        }
+
+        std::int64_t ByteCount() const override
+        {
+            return _byte_count;
+        }
+
+        /// Write any buffered data to the stream
+        void flush(error_code& ec)
+        {
+            flush_buffer();
+            ec = _error;
+        }
+
+        void flush()
+        {
+            error_code ec;
+            flush(ec);
+            if (ec) throw system_error(ec);
+        }
+
+        const error_code& error() const { return _error; }
+
+    private:
+        bool flush_buffer()
+        {
+            if (_error)
+                return false;
+            if (_used)
+            {
+                asio::write(_stream, asio::buffer(_buffer.data(), _used), _error);
+                _used = 0;
+            }
+            return not _error;
+        }
+
+        SyncWriteStream& _stream;
+        std::array<char, BufferSize> _buffer;
+        std::size_t _used = 0;
+        std::int64_t _byte_count = 0;
+        error_code _error;
+    };
+
+}}}
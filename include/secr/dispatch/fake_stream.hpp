@@ -4,9 +4,14 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <numeric>
 #include <typeinfo>
 
+#include <unistd.h>
+
 namespace secr { namespace dispatch {
     
     /// This is a pseudo stream. 
@@ -24,6 +29,97 @@ namespace secr { namespace dispatch {
         using mutex_type = std::mutex;
         using lock_type = std::unique_lock<mutex_type>;
 
+    public:
+        /// A part of an open file
+        struct file_region
+        {
+            int fd;
+            std::uint64_t offset;
+            std::size_t size;
+        };
+
+        /// A block of data handed to the stream by reference rather than
+        /// copied into it: either memory or a region of a file. The owner keeps
+        /// the data alive until it has been consumed, after which the handler
+        /// is posted to the stream's write io_service.
+        struct attachment
+        {
+            using handler_type = std::function<void(const error_code&, std::size_t)>;
+
+            attachment(asio::io_service& io_service,
+                       asio::const_buffer data,
+                       std::shared_ptr<const void> owner,
+                       handler_type handler)
+            : _io_service(io_service)
+            , _data(data)
+            , _file { -1, 0, asio::buffer_size(data) }
+            , _owner(std::move(owner))
+            , _handler(std::move(handler))
+            {}
+
+            attachment(asio::io_service& io_service,
+                       file_region file,
+                       std::shared_ptr<const void> owner,
+                       handler_type handler)
+            : _io_service(io_service)
+            , _file(file)
+            , _owner(std::move(owner))
+            , _handler(std::move(handler))
+            {}
+
+            ~attachment() noexcept
+            {
+                if (_handler)
+                    complete(asio::error::basic_errors::operation_aborted);
+            }
+
+            bool is_file() const { return _file.fd >= 0; }
+
+            /// The memory which has not yet been consumed
+            /// @pre not is_file()
+            asio::const_buffer data() const { return _data + _consumed; }
+
+            /// The part of the file which has not yet been consumed
+            /// @pre is_file()
+            file_region file() const { return { _file.fd, _file.offset + _consumed, remaining() }; }
+
+            std::size_t remaining() const { return _file.size - _consumed; }
+
+            /// Record that some of the data has been copied out
+            void consume(std::size_t bytes) { _consumed += bytes; }
+
+            /// The object which keeps the data alive
+            const std::shared_ptr<const void>& owner() const { return _owner; }
+
+            /// Release the data and notify the owner
+            void complete(const error_code& ec)
+            {
+                if (not _handler)
+                    return;
+                auto size = ec ? _consumed : _file.size;
+                _io_service.post([handler = std::move(_handler), ec, size, owner = std::move(_owner)]
+                                 {
+                                     handler(ec, size);
+                                 });
+                _handler = nullptr;
+            }
+
+            /// the number of bytes written to the stream's buffer before
+            /// this attachment
+            std::uint64_t position = 0;
+
+        private:
+            asio::io_service& _io_service;
+            asio::const_buffer _data;
+            file_region _file;
+            std::size_t _consumed = 0;
+            std::shared_ptr<const void> _owner;
+            handler_type _handler;
+        };
+        using attachment_ptr = std::unique_ptr<attachment>;
+
+    private:
+
         struct consume_op
         {
             /// Write data from the source buffer to the correct place,
@@ -32,6 +128,11 @@ namespace secr { namespace dispatch {
             ///         to transfer any remaining bytes
             virtual std::size_t consume(const lock_type& lock, asio::const_buffer data) = 0;
 
+            /// Offer the op the attachment at the front of the stream.
+            /// @returns true if the op took ownership of it, false if its
+            ///          data should be copied with consume() instead
+            virtual bool take(const lock_type& lock, attachment_ptr& a) { return false; }
+
             /// Inform the commit op that the stream is in error. Possibly complete
             /// any outstanding call
             virtual void set_error(const lock_type& lock, error_code ec) = 0;
@@ -60,6 +161,45 @@ namespace secr { namespace dispatch {
         
         ~fake_stream() noexcept {
             cancel();
+            clear_watermarks();
+        }
+
+        /// A function which is called when the amount of buffered, unread data
+        /// crosses a watermark. The argument is true when the data reaches the
+        /// high watermark and false when it drains to the low watermark.
+        /// @note the handler is called with the stream's internal lock held. It
+        ///       must not call back into the stream.
+        using watermark_handler = std::function<void(bool above_high)>;
+
+        /// Bound the amount of unread data held by the stream. The stream does
+        /// not refuse writes - it is up to the writer to stop writing when told.
+        /// Every call of the handler with true is eventually followed by exactly
+        /// one call with false, at the latest when the watermarks are cleared
+        /// or the stream is destroyed.
+        /// @pre low < high
+        void set_watermarks(std::size_t high, std::size_t low, watermark_handler handler)
+        {
+            assert(low < high);
+            auto lock = get_lock();
+            release_watermark(lock);
+            _high_watermark = high;
+            _low_watermark = low;
+            _watermark_handler = std::move(handler);
+            check_watermarks(lock);
+        }
+
+        /// Remove the watermark handler, notifying it if the stream is currently
+        /// above the high watermark
+        void clear_watermarks() noexcept
+        {
+            try {
+                auto lock = get_lock();
+                release_watermark(lock);
+                _watermark_handler = nullptr;
+            }
+            catch(...) {
+                // ignore
+            }
         }
 
         /// Mark the stream as in error. If there is an outstanding read operation,
@@ -82,6 +222,7 @@ namespace secr { namespace dispatch {
         /// Note that this call will always complete in a timely fashion (a small
         /// block may be involved to protect access during memory buffer tansfers)
         /// The size of the receive area within this object is more-or-less limitless
+        /// unless the writer respects the watermarks
         ///
         template<class ConstBufferSequence>
         std::size_t write_some(const ConstBufferSequence& buffers, error_code& ec)
@@ -96,10 +237,60 @@ namespace secr { namespace dispatch {
             auto copied = asio::buffer_copy(_bytes_recvd.prepare(asio::buffer_size(buffers)),
                                             buffers);
             _bytes_recvd.commit(copied);
+            _bytes_written += copied;
             flush_to_op(std::move(lock));
             return copied;
         }
 
+        /// Append data to the stream without copying it.
+        /// @param owner keeps the data alive until it has been consumed
+        /// @param handler is called with (error_code, bytes) on the write
+        ///        io_service once a reader has consumed all of the data, or
+        ///        with an error if the stream is in error or is reset before
+        ///        that happens. If the handler is empty nothing is posted and
+        ///        the owner is released with the attachment.
+        void attach(asio::const_buffer data,
+                    std::shared_ptr<const void> owner,
+                    attachment::handler_type handler)
+        {
+            attach(std::make_unique<attachment>(_write_io_service, data,
+                                                std::move(owner), std::move(handler)));
+        }
+
+        /// Append a region of a file to the stream. A reader which supports
+        /// attachments may send it without reading it into memory.
+        /// @param owner keeps the file open until it has been consumed
+        /// @see attach
+        void attach(file_region file,
+                    std::shared_ptr<const void> owner,
+                    attachment::handler_type handler)
+        {
+            attach(std::make_unique<attachment>(_write_io_service, file,
+                                                std::move(owner), std::move(handler)));
+        }
+
+    private:
+        void attach(attachment_ptr a)
+        {
+            auto lock = get_lock();
+            if (_error_code)
+            {
+                a->complete(_error_code);
+                return;
+            }
+            if (a->remaining() == 0)
+            {
+                a->complete(error_code());
+                return;
+            }
+            a->position = _bytes_written;
+            _attached_bytes += a->remaining();
+            _attachments.push_back(std::move(a));
+            flush_to_op(std::move(lock));
+        }
+
+    public:
+
         template<class ConstBufferSequence>
         std::size_t write_some(const ConstBufferSequence& buffers)
         {
@@ -114,23 +305,153 @@ namespace secr { namespace dispatch {
         {
             std::size_t bytes_flushed = 0;
             if (_consume_op) {
-                auto data = _bytes_recvd.data();
+                auto data = readable(lock);
                 if (asio::buffer_size(data))
                 {
                     auto consumed = _consume_op->consume(lock, data);
-                    _bytes_recvd.consume(consumed);
+                    consume_buffered(lock, consumed);
+                    check_watermarks(lock);
                     auto copy = std::move(_consume_op);
                     copy->commit(std::move(lock));
                 }
+                else if (not _attachments.empty())
+                {
+                    // a file is read with the lock released, during which
+                    // the op belongs to this call alone
+                    auto op = std::move(_consume_op);
+                    auto& front = _attachments.front();
+                    auto remaining = front->remaining();
+                    if (op->take(lock, front))
+                    {
+                        _attached_bytes -= remaining;
+                        _attachments.pop_front();
+                    }
+                    else if (auto ec = copy_attachment(lock, [&op, &lock](asio::const_buffer data) {
+                        return op->consume(lock, data);
+                    }))
+                    {
+                        op->set_error(lock, ec);
+                    }
+                    check_watermarks(lock);
+                    op->commit(std::move(lock));
+                }
                 else if (_error_code) {
                     _consume_op->set_error(lock, _error_code);
                     auto copy = std::move(_consume_op);
                     copy->commit(std::move(lock));
                 }
             }
+            else {
+                check_watermarks(lock);
+            }
             return bytes_flushed;
         }
         
+        /// @returns the buffered data which precedes the first attachment
+        asio::const_buffer readable(const lock_type& lock) const
+        {
+            asio::const_buffer data = _bytes_recvd.data();
+            if (not _attachments.empty())
+                data = asio::buffer(data, std::size_t(_attachments.front()->position - _bytes_read));
+            return data;
+        }
+        
+        void consume_buffered(const lock_type& lock, std::size_t bytes)
+        {
+            _bytes_recvd.consume(bytes);
+            _bytes_read += bytes;
+        }
+        
+        /// record bytes copied from the front attachment, releasing it once
+        /// they are all gone
+        void consume_attachment(const lock_type& lock, std::size_t bytes)
+        {
+            auto& front = _attachments.front();
+            front->consume(bytes);
+            _attached_bytes -= bytes;
+            if (front->remaining() == 0)
+            {
+                front->complete(error_code());
+                _attachments.pop_front();
+            }
+        }
+        
+        /// Offer the data of the front attachment to consume, reading it from
+        /// its file if necessary. The file is read with the lock released so
+        /// that writers are not held up by the file system.
+        /// @pre the caller is the only reader
+        /// @returns the stream's error if the file could not be read, or
+        ///          operation_aborted if the stream was reset while it was
+        ///          being read. Nothing is consumed in either case.
+        template<class Consume>
+        error_code copy_attachment(lock_type& lock, Consume&& consume)
+        {
+            auto& front = *_attachments.front();
+            if (not front.is_file())
+            {
+                consume_attachment(lock, consume(front.data()));
+                return error_code();
+            }
+            
+            char block[16384];
+            auto region = front.file();
+            auto owner = front.owner();
+            auto resets = _resets;
+            lock.unlock();
+            auto got = ::pread(region.fd, block, std::min(sizeof(block), region.size), off_t(region.offset));
+            auto err = errno;
+            lock.lock();
+            
+            // only reset() removes attachments from under the one reader
+            if (resets != _resets)
+                return asio::error::basic_errors::operation_aborted;
+            if (got <= 0)
+            {
+                // the data after the gap would be misplaced, so abandon it all
+                _error_code = got < 0
+                ? error_code(err, boost::system::system_category())
+                : error_code(asio::error::misc_errors::eof);
+                _bytes_recvd.consume(_bytes_recvd.size());
+                _attachments.clear();
+                _attached_bytes = 0;
+                return _error_code;
+            }
+            consume_attachment(lock, consume(asio::buffer(block, std::size_t(got))));
+            return error_code();
+        }
+        
+        /// notify the watermark handler if the buffered data has crossed a watermark
+        void check_watermarks(const lock_type& lock)
+        {
+            if (not _watermark_handler)
+                return;
+            
+            auto buffered = _bytes_recvd.size() + _attached_bytes;
+            if (not _above_high_watermark and buffered >= _high_watermark)
+            {
+                _above_high_watermark = true;
+                _watermark_handler(true);
+            }
+            else if (_above_high_watermark and buffered <= _low_watermark)
+            {
+                _above_high_watermark = false;
+                _watermark_handler(false);
+            }
+        }
+        
+        /// if the stream is above the high watermark, notify the handler that it
+        /// no longer is
+        void release_watermark(const lock_type& lock)
+        {
+            if (_above_high_watermark)
+            {
+                _above_high_watermark = false;
+                if (_watermark_handler) {
+                    _watermark_handler(false);
+                }
+            }
+        }
+        
         // AsyncWriteStream
     public:
         asio::io_service& get_write_io_service() { return _write_io_service; }
@@ -162,6 +483,24 @@ namespace secr { namespace dispatch {
         template<class MutableBufferSequence, class AsyncReadHandler>
         void async_read_some(MutableBufferSequence&& buffers, AsyncReadHandler&& handler);
         
+        /// Read some data asynchronously or, if the next data in the stream is
+        /// an attachment, take the attachment without copying it.
+        /// The handler is a model of
+        ///     void(const error_code&, std::size_t bytes, std::shared_ptr<attachment>)
+        /// Either bytes have been copied into the buffer or the attachment is
+        /// not null. The reader must call complete() on the attachment once
+        /// it has finished with the data.
+        template<class AsyncReadHandler>
+        void async_read_some_or_take(asio::mutable_buffer buffer, AsyncReadHandler&& handler);
+        
+        /// @returns the number of bytes, including attached bytes, which may
+        ///          be read without waiting for the writer
+        std::size_t available()
+        {
+            auto lock = get_lock();
+            return _bytes_recvd.size() + _attached_bytes;
+        }
+        
         // SyncReadStream
         
         template<class MutableBufferSequence>
@@ -178,7 +517,8 @@ namespace secr { namespace dispatch {
         
         /// Cancel all pending I/O operations
         /// @note cancels all I/O operations - including blocked synchronous
-        /// reads
+        /// reads. A read which is copying a block from a file completes
+        /// normally once the block has been read.
         void cancel() noexcept
         {
             try {
@@ -209,6 +549,11 @@ namespace secr { namespace dispatch {
             auto lock = get_lock();
             _error_code = error_code();
             _bytes_recvd.consume(asio::buffer_size(_bytes_recvd.data()));
+            _bytes_written = _bytes_read = 0;
+            _attachments.clear();
+            _attached_bytes = 0;
+            ++_resets;
+            check_watermarks(lock);
             if (_consume_op) {
                 _consume_op->set_error(lock, asio::error::basic_errors::operation_aborted);
                 auto copy = std::move(_consume_op);
@@ -221,6 +566,8 @@ namespace secr { namespace dispatch {
         struct async_read_op;
         template<class Handler, class MutableBufferSequence>
         friend struct async_read_op;
+        template<class Handler>
+        struct async_read_or_take_op;
 
         consume_op_ptr set_consume_op(consume_op_ptr ptr) { std::swap(ptr, _consume_op); return ptr; }
 
@@ -232,8 +579,24 @@ namespace secr { namespace dispatch {
         error_code _error_code;
         asio::streambuf _bytes_recvd;
         
+        /// the total number of bytes copied into and out of _bytes_recvd
+        std::uint64_t _bytes_written = 0;
+        std::uint64_t _bytes_read = 0;
+        
+        /// attached data, in stream order
+        std::deque<attachment_ptr> _attachments;
+        std::size_t _attached_bytes = 0;
+        
+        /// the number of calls to reset()
+        std::uint64_t _resets = 0;
+        
         std::unique_ptr<consume_op> _consume_op;
         
+        watermark_handler _watermark_handler;
+        std::size_t _high_watermark = 0;
+        std::size_t _low_watermark = 0;
+        bool _above_high_watermark = false;
+        
         std::mutex _mutex;
     };
     
@@ -353,6 +716,70 @@ namespace secr { namespace dispatch {
         flush_to_op(std::move(lock));
     }
     
+    template<class Handler>
+    struct fake_stream::async_read_or_take_op : fake_stream::consume_op
+    {
+        using handler_type = Handler;
+        
+        async_read_or_take_op(asio::mutable_buffer buffer, handler_type handler)
+        : consume_op()
+        , _buffer(buffer)
+        , _handler(std::move(handler))
+        {}
+        
+        std::size_t consume(const lock_type& lock, asio::const_buffer data) override
+        {
+            _count = asio::buffer_copy(_buffer, data);
+            return _count;
+        }
+        
+        bool take(const lock_type& lock, attachment_ptr& a) override
+        {
+            _attachment = std::move(a);
+            return true;
+        }
+        
+        void set_error(const lock_type& lock, error_code ec) override
+        {
+            _error_code = ec;
+        }
+        
+        void commit(lock_type lock) override
+        {
+            _handler(std::move(lock), _error_code, _count, std::move(_attachment));
+        }
+        
+        asio::mutable_buffer _buffer;
+        handler_type _handler;
+        std::size_t _count = 0;
+        std::shared_ptr<attachment> _attachment;
+        error_code _error_code = error_code();
+    };
+    
+    template<class AsyncReadHandler>
+    void fake_stream::async_read_some_or_take(asio::mutable_buffer buffer,
+                                              AsyncReadHandler&& handler)
+    {
+        using handler_type = std::decay_t<AsyncReadHandler>;
+        
+        auto lock = get_lock();
+        assert(not _consume_op);
+        
+        auto dispatch_handler = [this,
+                                 handler = handler_type(std::forward<AsyncReadHandler>(handler))]
+        (auto lock, auto& ec, auto size, std::shared_ptr<attachment> a) mutable
+        {
+            _read_io_service.post([handler = std::move(handler), ec, size, a = std::move(a)]() mutable
+            {
+                handler(ec, size, std::move(a));
+            });
+        };
+        
+        using op_type = async_read_or_take_op<decltype(dispatch_handler)>;
+        _consume_op = std::make_unique<op_type>(buffer, std::move(dispatch_handler));
+        flush_to_op(std::move(lock));
+    }
+    
     template<class MutableBufferSequence>
     std::size_t fake_stream::read_some(MutableBufferSequence&& buffers,
                                            error_code& ec)
@@ -360,16 +787,26 @@ namespace secr { namespace dispatch {
         using buffer_sequence_type = std::decay_t<MutableBufferSequence>;
         
         auto lock = get_lock();
-        auto available_data = _bytes_recvd.data();
+        auto available_data = readable(lock);
 
         if (asio::buffer_size(available_data))
         {
             transfer_to_buffers_op<buffer_sequence_type> transfer(std::forward<MutableBufferSequence>(buffers));
             auto transferred = transfer.transfer(available_data);
-            _bytes_recvd.consume(transferred);
+            consume_buffered(lock, transferred);
+            check_watermarks(lock);
             ec = error_code();
             return transferred;
         }
+        else if (not _attachments.empty())
+        {
+            transfer_to_buffers_op<buffer_sequence_type> transfer(std::forward<MutableBufferSequence>(buffers));
+            ec = copy_attachment(lock, [&transfer](asio::const_buffer data) {
+                return transfer.transfer(data);
+            });
+            check_watermarks(lock);
+            return transfer.count();
+        }
         else if (_error_code) {
             ec = _error_code;
             return 0;
@@ -476,6 +913,24 @@ namespace secr { namespace dispatch {
         {
             return _stream.write_some(buffers);
         }
+        
+        /// @see fake_stream::attach
+        void attach(asio::const_buffer data,
+                    std::shared_ptr<const void> owner,
+                    fake_stream::attachment::handler_type handler)
+        {
+            _stream.attach(data, std::move(owner), std::move(handler));
+        }
+        
+        /// @see fake_stream::attach
+        void attach(fake_stream::file_region file,
+                    std::shared_ptr<const void> owner,
+                    fake_stream::attachment::handler_type handler)
+        {
+            _stream.attach(file, std::move(owner), std::move(handler));
+        }
+        
+        asio::io_service& get_io_service() { return _stream.get_write_io_service(); }
 
         void close() {
             _stream.close();
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <boost/log/trivial.hpp>
+#include <cstddef>
+
+namespace secr { namespace dispatch { namespace http {
+
+    struct request_context;
+
+    struct access_log_options
+    {
+        /// Log one request in every sample_interval. 0 disables the access log.
+        std::size_t sample_interval = 1;
+
+        /// The severity at which access log lines are emitted
+        boost::log::trivial::severity_level severity = boost::log::trivial::info;
+
+        /// If true, the full header of every request is also logged as json,
+        /// at debug severity. This is expensive.
+        bool dump_headers = false;
+    };
+
+    /// The process-wide access log.
+    /// Each sampled request produces one compact line when its response is
+    /// complete:
+    ///   access <request id> <method> <path> <status> <bytes in> <bytes out> header_ms=<n> total_ms=<n> [error=<message>]
+    /// Nothing is rendered unless the record passes both the sampler and the
+    /// boost.log filter.
+    /// @note all methods are thread-safe and may be called at any time
+    struct access_log
+    {
+        static void configure(const access_log_options& options);
+        static access_log_options options();
+
+        static bool dump_headers();
+
+        /// Take a sampling decision
+        /// @returns true if the next completed request should be logged
+        static bool sample();
+
+        /// Log the completion of a request, subject to sampling
+        /// @param ec is the error, if any, which ended the response
+        static void request_complete(const request_context& context, const error_code& ec);
+    };
+
+}}}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <secr/dispatch/http/service_adapter.hpp>
+#include <secr/dispatch/secr_dispatch_batch.pb.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// The methods which may be called in a batch, by full name
+    /// (<package.Service>.<Method>)
+    class method_registry
+    {
+    public:
+        void add(std::shared_ptr<const method_binding> method);
+
+        /// Add every method of a service, bound through its descriptor
+        void add_service(const std::shared_ptr<google::protobuf::Service>& service);
+
+        /// Add every method of a dispatch table generated by
+        /// protoc-gen-secr_dispatch
+        template<class Table>
+        void add_service_table(const std::shared_ptr<typename Table::service_type>& service)
+        {
+            for (std::size_t i = 0 ; i < Table::method_count ; ++i)
+                add(Table::bind(service, int(i)));
+        }
+
+        /// @returns the method with the full name, or nullptr
+        std::shared_ptr<const method_binding> find(const std::string& full_name) const;
+
+        std::size_t size() const { return _methods.size(); }
+
+    private:
+        std::unordered_map<std::string, std::shared_ptr<const method_binding>> _methods;
+    };
+
+    /// Route POST to path to a batch of calls to the registered methods.
+    ///
+    /// The body is a BatchRequest, and the response a BatchResponse, in
+    /// either encoding as for add_service. The payloads of the calls are in
+    /// the binary encoding. The calls are posted to the dispatch io_service
+    /// to run concurrently, and their results are gathered in the order
+    /// of the calls.
+    ///
+    /// A call which cannot be made, fails its controller or throws before
+    /// it completes has its errors in its result. The other calls are not
+    /// affected and the batch as a whole succeeds. A batch of more than
+    /// options.max_batch_calls calls receives a 400.
+    void add_batch_endpoint(router& r,
+                            std::shared_ptr<const method_registry> methods,
+                            const service_options& options = service_options(),
+                            const std::string& path = "/batch");
+
+}}}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// An inclusive range of byte positions within a representation
+    struct byte_range
+    {
+        std::uint64_t first;
+        std::uint64_t last;
+
+        std::uint64_t size() const { return last - first + 1; }
+    };
+
+    inline bool operator==(const byte_range& l, const byte_range& r)
+    {
+        return l.first == r.first and l.last == r.last;
+    }
+
+    /// The outcome of applying a Range header to a representation
+    enum class range_disposition
+    {
+        /// the header is absent or malformed. Send the whole representation.
+        ignore,
+
+        /// at least one range overlaps the representation. Send those.
+        satisfiable,
+
+        /// no range overlaps the representation. Respond with 416.
+        unsatisfiable,
+    };
+
+    /// The most ranges a Range header may ask for. A header with more is
+    /// ignored.
+    constexpr std::size_t max_byte_ranges = 32;
+
+    /// Parse a Range header such as "bytes=0-499, -500, 9500-" against a
+    /// representation of size bytes. Suffix and open ranges are resolved and
+    /// ranges which overrun the end are truncated. Ranges which do not
+    /// overlap the representation are dropped.
+    /// Ranges which overlap or touch are merged, so no byte is sent twice.
+    /// A header with more than max_byte_ranges ranges is ignored.
+    /// @param ranges receives the satisfiable ranges in ascending order
+    range_disposition parse_byte_ranges(string_view header_value, std::uint64_t size,
+                                        std::vector<byte_range>& ranges);
+
+}}}
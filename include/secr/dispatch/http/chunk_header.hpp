@@ -0,0 +1,52 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+
+#include <cstdint>
+#include <iterator>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// The size line of one chunk of a chunked body, "<hex size>\r\n",
+    /// formatted into the object itself
+    class chunk_header
+    {
+    public:
+        explicit chunk_header(std::size_t size)
+        {
+            static const char digits[] = "0123456789abcdef";
+            auto p = std::end(_data);
+            *--p = '\n';
+            *--p = '\r';
+            do {
+                *--p = digits[size & 0xf];
+                size >>= 4;
+            } while (size);
+            _offset = std::uint8_t(p - std::begin(_data));
+        }
+
+        const char* data() const { return _data + _offset; }
+        std::size_t size() const { return sizeof(_data) - _offset; }
+
+        asio::const_buffer buffer() const { return asio::const_buffer(data(), size()); }
+
+    private:
+        char _data[sizeof(std::size_t) * 2 + 2];
+        std::uint8_t _offset;
+    };
+
+    /// the CRLF which follows the data of every chunk
+    inline asio::const_buffer chunk_trailer()
+    {
+        static const char crlf[] = { '\r', '\n' };
+        return asio::buffer(crlf);
+    }
+
+    /// the zero-length chunk and empty trailer which end a chunked body
+    inline asio::const_buffer last_chunk()
+    {
+        static const char last[] = { '0', '\r', '\n', '\r', '\n' };
+        return asio::buffer(last);
+    }
+
+}}}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// How response bodies are compressed
+    struct compression_options
+    {
+        /// If false, responses are never compressed. Compression is opt-in
+        /// for clients too: one which sends no Accept-Encoding is sent the
+        /// body as it is.
+        bool enabled = false;
+
+        /// The zlib level, from 1 (fastest) to 9 (smallest)
+        int level = 6;
+
+        /// Bodies smaller than this are sent as they are. A streamed body
+        /// is held back until it reaches this size, and sent uncompressed
+        /// with a Content-Length if it ends first.
+        std::size_t minimum_size = 1024;
+
+        /// Bodies of a known length up to this size are compressed whole so
+        /// that the response keeps a Content-Length. Larger ones are sent
+        /// chunked as they are compressed.
+        std::size_t buffer_limit = 64 * 1024;
+
+        /// A streamed body is compressed across writes, and flushed so that
+        /// the client can decompress all of it once this much has been
+        /// written since the last flush. A response with chunk coalescing
+        /// flushes at its coalescing size instead.
+        /// @see dispatch_context::response_object::flush_compression
+        std::size_t flush_size = 16 * 1024;
+    };
+
+    /// The content codings a compressor can produce
+    enum class content_coding
+    {
+        gzip,
+        deflate,
+    };
+
+    /// @returns the name of a coding, as used in Content-Encoding
+    string_view coding_name(content_coding coding);
+
+    /// How much of the compressed stream a call to compress brings out
+    enum class compress_flush
+    {
+        /// as much as zlib chooses. The rest is held for better compression.
+        none,
+        /// all of the input so far, so that a client can decompress
+        /// everything that has been written without waiting for the end
+        sync,
+        /// all of the input, and the stream is ended
+        finish,
+    };
+
+    /// A zlib deflate stream. Compressors are expensive to create, so they are
+    /// kept in a per-thread pool and reset between responses.
+    /// @see acquire_compressor
+    class compressor
+    {
+    public:
+        compressor(content_coding coding, int level);
+        compressor(const compressor&) = delete;
+        compressor& operator=(const compressor&) = delete;
+        ~compressor();
+
+        content_coding coding() const { return _coding; }
+
+        /// Compress input, appending whatever output is ready to out
+        void compress(asio::const_buffer input, compress_flush flush, std::vector<char>& out);
+
+        /// Prepare for another response at the given level
+        void reset(int level);
+
+    private:
+        struct impl;
+        std::unique_ptr<impl> _impl;
+        content_coding _coding;
+        int _level;
+    };
+
+    /// Returns a compressor to the pool of the thread which releases it
+    struct compressor_releaser
+    {
+        void operator()(compressor* p) const;
+    };
+    using compressor_ptr = std::unique_ptr<compressor, compressor_releaser>;
+
+    /// Take a compressor from this thread's pool, or create one if the pool
+    /// is empty
+    compressor_ptr acquire_compressor(content_coding coding, int level);
+
+}}}
@@ -7,6 +7,12 @@
 #include <secr/dispatch/api/exception.hpp>
 #include <secr/dispatch/api/json.hpp>
 #include <secr/dispatch/http/errors.hpp>
+#include <secr/dispatch/http/query.hpp>
+#include <secr/dispatch/http/chunk_header.hpp>
+#include <secr/dispatch/http/byte_range.hpp>
+#include <secr/dispatch/http/compression.hpp>
+#include <secr/dispatch/http/entity_tag.hpp>
+#include <boost/container/small_vector.hpp>
 
 
 namespace secr { namespace dispatch { namespace http {
@@ -61,6 +67,78 @@ namespace secr { namespace dispatch { namespace http {
                 return _request_context.request_manager().content_type();
             }
             
+            const accept_list& accept() {
+                return _request_context.request_manager().accept();
+            }
+            
+            const accept_encoding_list& accept_encoding() {
+                return _request_context.request_manager().accept_encoding();
+            }
+            
+            /// Choose the best of the media types offered by the handler
+            /// @returns nullptr if the client accepts none of them
+            const media_type_offer* negotiate(const offered_media_types& offered) {
+                return offered.negotiate(accept());
+            }
+            
+            /// Choose the best of the content codings offered by the handler
+            /// @returns nullptr if the client accepts none of them
+            const std::string* negotiate(const offered_encodings& offered) {
+                return offered.negotiate(accept_encoding());
+            }
+            
+            /// The request header as parsed, without conversion to protobuf
+            const raw_request_header& raw_header() const
+            {
+                return _request_context.raw_header();
+            }
+            
+            /// The path component of the uri, still percent-encoded
+            string_view raw_path() const
+            {
+                return raw_header().url_field(UF_PATH);
+            }
+            
+            /// The arena from which the request's data is allocated. It lives
+            /// as long as the request.
+            google::protobuf::Arena* arena()
+            {
+                return _request_context.arena();
+            }
+            
+            /// The percent-decoded path. Only a path which contains escapes
+            /// is copied, into the request's arena.
+            string_view path()
+            {
+                return percent_decode(arena(), raw_path(), false);
+            }
+            
+            /// The query string, split into parameters as it is iterated
+            query_parameters query() const
+            {
+                return query_parameters(raw_header().url_field(UF_QUERY));
+            }
+            
+            /// @returns the decoded value of the first query parameter with
+            ///          the given name
+            boost::optional<string_view> query_parameter(string_view name)
+            {
+                return query().get(arena(), name);
+            }
+            
+            /// Constant time lookup of the well-known request headers
+            const header_index& index() const
+            {
+                return _request_context.raw_header().index();
+            }
+            
+            /// @returns the value of the first occurrence of a well-known
+            ///          header, or an empty view
+            string_view header_value(header_id id) const
+            {
+                return index().value(id);
+            }
+            
             fake_stream_read_interface& stream()
             {
                 return _read_stream;
@@ -98,7 +176,7 @@ namespace secr { namespace dispatch { namespace http {
             void async_commit_header(Handler&& handler)
             {
                 assert(!_header_committed);
-                auto data = to_response_buffer(header()).shared();
+                auto data = to_response_buffer(header(), _request_context.date_header()).shared();
                 _header_committed = true;
                 return asio::async_write(stream(), asio::buffer(data),
                                          [handler = std::move(handler), data]
@@ -116,6 +194,26 @@ namespace secr { namespace dispatch { namespace http {
             std::size_t write_some(const ConstBufferSequence& buffers,
                                    error_code& ec);
 
+            /// Write data to the response stream without copying it, committing
+            /// the header if necessary. The response shares ownership of the data
+            /// until it has been written to the client, after which
+            /// handler(error_code, std::size_t) is called on the dispatch
+            /// io_service.
+            /// @pre as for write_some
+            template<class Handler>
+            void async_write(shared_byte_buffer data, Handler&& handler)
+            {
+                auto buffer = asio::const_buffer(data.data(), data.size());
+                async_write(buffer, data.pointer(), std::forward<Handler>(handler));
+            }
+            
+            /// As above, for data kept alive by owner. owner may be null if the
+            /// data lies in the request's arena.
+            template<class Handler>
+            void async_write(asio::const_buffer data,
+                             std::shared_ptr<const void> owner,
+                             Handler&& handler);
+
             /// perform a fixed-size write if possible and then close the channel
             template<class ConstBufferSequence>
             std::size_t flush(const ConstBufferSequence& buffers,
@@ -125,6 +223,25 @@ namespace secr { namespace dispatch { namespace http {
             error_code close(error_code& ec);
             void close();
             
+            /// Send a file as the whole response and close the stream. The
+            /// file is not read here: it is handed to the connection, which
+            /// sends it with sendfile(2) on a plain TCP connection and reads
+            /// it a block at a time otherwise.
+            /// A GET with a Range header (and, if present, an If-Range which
+            /// matches the file's Last-Modified) receives a 206 with the
+            /// requested ranges, as multipart/byteranges if there are several,
+            /// or a 416 if none of them overlaps the file.
+            /// @pre header is not committed
+            void send_file(const std::string& path, error_code& ec);
+            void send_file(const std::string& path);
+            
+            /// As above, for length bytes of an open regular file starting at
+            /// offset. A region which runs past the end of the file is cut
+            /// short at the end. The descriptor is duplicated, so the caller
+            /// may close it.
+            void send_file(int fd, std::uint64_t offset, std::uint64_t length, error_code& ec);
+            void send_file(int fd, std::uint64_t offset, std::uint64_t length);
+            
             bool header_committed() const {
                 return _header_committed;
             }
@@ -133,13 +250,140 @@ namespace secr { namespace dispatch { namespace http {
             void set_content_length(content_length_fixed);
             void set_content_length(content_length_variable);
             
+            /// In chunked mode, hold back writes until at least size bytes
+            /// have accumulated and send them as one chunk. Whatever is held
+            /// back is sent on close(). 0 (the default) sends every write as
+            /// a chunk of its own.
+            void set_chunk_coalescing(std::size_t size);
+            
+            /// Replace the connection's compression settings for this response.
+            /// The body is compressed if the options allow it, the client
+            /// accepts gzip or deflate and the handler has not set a
+            /// Content-Encoding of its own.
+            /// @pre header is not committed and nothing has been written
+            void set_compression(const compression_options& options);
+            
+            /// If the body is being streamed through the compressor, send all
+            /// that has been written so far in a form the client can
+            /// decompress, rather than waiting for more to compress with it.
+            /// Each flush costs compression and a few bytes of output, so it
+            /// belongs at the end of a unit the client must see at once, such
+            /// as a message. Chunk coalescing still applies to the output.
+            /// Does nothing to a body which is not being streamed.
+            void flush_compression(error_code& ec);
+            void flush_compression();
+            
+            /// Replace the connection's entity tag settings for this response.
+            /// @pre header is not committed and nothing has been written
+            void set_entity_tags(const entity_tag_options& options);
+            
+            /// Answer a conditional request without producing the body. The
+            /// response is given the entity tag (for example one made with
+            /// strong_entity_tag from a version number). If the request's
+            /// If-None-Match matches it, a 304 is sent and the response is
+            /// closed.
+            /// @returns true if the 304 was sent, false if the handler must
+            ///          go on to send the body
+            /// @pre header is not committed
+            bool check_not_modified(const std::string& entity_tag, error_code& ec);
+            bool check_not_modified(const std::string& entity_tag);
+            
             void set_exception(std::exception_ptr ep);
             
         private:
             void commit_with_exception(std::exception_ptr ep);
             
+            /// choose a response mode and commit the header if that has not
+            /// already been done
+            void prepare_write(error_code& ec);
+            
             template<class ConstBufferSequence>
             std::size_t write_chunk(const ConstBufferSequence& buffers, error_code& ec);
+            
+            /// write any coalesced data as a chunk, followed by the last
+            /// chunk, in one write
+            void write_last_chunk(error_code& ec);
+            
+            /// Decide whether the body is to be compressed, if that has not
+            /// been decided yet
+            /// @returns true if writes must go through the compressor
+            bool start_compression()
+            {
+                if (_compression_state == compression_state::undecided)
+                    decide_compression();
+                return compressing();
+            }
+            
+            bool compressing() const
+            {
+                return _compression_state == compression_state::pending
+                or _compression_state == compression_state::buffered
+                or _compression_state == compression_state::streaming;
+            }
+            
+            void decide_compression();
+            
+            template<class ConstBufferSequence>
+            std::size_t compress_some(const ConstBufferSequence& buffers, error_code& ec);
+            
+            /// a held back body has reached the minimum size: commit the
+            /// header and compress from here on
+            void begin_streaming_compression();
+            
+            /// bring out all of the compressed stream so far
+            void sync_compression();
+            
+            /// send whatever compressed output is ready
+            void write_compressed(error_code& ec);
+            
+            /// end the compressed stream and send the rest of the body
+            void finish_compression(error_code& ec);
+            
+            /// Decide whether the body is to be held back and hashed, if that
+            /// has not been decided yet
+            /// @returns true if writes must be held back
+            bool start_entity_tag()
+            {
+                if (_entity_tag_state == entity_tag_state::undecided)
+                    decide_entity_tag();
+                return _entity_tag_state == entity_tag_state::holding;
+            }
+            
+            void decide_entity_tag();
+            
+            template<class ConstBufferSequence>
+            std::size_t hold_body(const ConstBufferSequence& buffers, error_code& ec);
+            
+            /// tag the held back body and send it, or a 304 if the client
+            /// already has it
+            void send_held_body(error_code& ec);
+            
+            /// @returns true if an If-None-Match of the request matches
+            bool request_has_entity(const std::string& entity_tag) const;
+            
+            /// turn the response into a 304 with no body
+            void make_not_modified();
+            
+            /// @returns true if the response has no body (it answers a HEAD,
+            ///          or is a 304), so that whatever the handler writes is
+            ///          discarded
+            bool discarding_body() const
+            {
+                return _response_size_limit == 0;
+            }
+            
+            /// Decide, as the header is committed, whether the response is
+            /// to be offered to the response cache
+            void decide_cache_capture();
+            
+            /// record bytes of the body sent, if the response is to be cached
+            void capture_body(asio::const_buffer data);
+            
+            /// @param file owns the descriptor fd
+            /// @param modified the file's modification time, or 0 if unknown
+            void send_file(std::shared_ptr<const void> file, int fd,
+                           std::uint64_t offset, std::uint64_t length,
+                           std::time_t modified, error_code& ec);
 
             fake_stream_write_interface& stream()
             {
@@ -162,6 +406,40 @@ namespace secr { namespace dispatch { namespace http {
             static constexpr auto unlimited_size = std::numeric_limits<size_type>::max();
             size_type _response_size_limit = unlimited_size;
             error_code _last_error;
+            size_type _coalesce_size = 0;
+            std::vector<char> _coalesced;
+            size_type _content_length = 0;
+            
+            enum class compression_state {
+                undecided,
+                off,
+                pending,    // holding the body back until it reaches the minimum size
+                buffered,   // compressing the whole body before sending it with a length
+                streaming   // sending the body as it is compressed
+            };
+            compression_state _compression_state = compression_state::undecided;
+            compression_options _compression { _request_context.compression() };
+            compressor_ptr _compressor;
+            std::vector<char> _compression_input;
+            std::vector<char> _compressed;
+            size_type _written_since_sync = 0;
+            
+            enum class cache_capture {
+                undecided,
+                off,
+                on          // keeping a copy of the body for the response cache
+            };
+            cache_capture _cache_capture = cache_capture::undecided;
+            std::vector<char> _cache_body;
+            
+            enum class entity_tag_state {
+                undecided,
+                off,
+                holding     // holding the body back until it is complete
+            };
+            entity_tag_state _entity_tag_state = entity_tag_state::undecided;
+            entity_tag_options _entity_tags { _request_context.entity_tags() };
+            std::vector<char> _held_body;
 
         };
         
@@ -251,7 +529,7 @@ namespace secr { namespace dispatch { namespace http {
                 set_content_length(content_length_fixed(asio::buffer_size(buffers)));
                 break;
         }
-        if (not header_committed())
+        if (not start_compression() and not start_entity_tag() and not header_committed())
             commit_header(ec);
         auto written = write_some(buffers, ec);
         if (not ec)
@@ -264,19 +542,15 @@ namespace secr { namespace dispatch { namespace http {
     dispatch_context::response_object
     ::write_some(const ConstBufferSequence& buffers, error_code& ec)
     {
-        ec.clear();
-        if (_response_mode == response_mode::undecided) {
-            set_content_length(content_length_variable());
-        }
-
-        if (not header_committed()) {
-            if (not header().has_status()) {
-                auto stat = mutable_header().mutable_status();
-                stat->set_code(200);
-                stat->set_message("OK");
-            }
-            commit_header(ec);
-        }
+        if (start_compression())
+            return compress_some(buffers, ec);
+        
+        if (start_entity_tag())
+            return hold_body(buffers, ec);
+        
+        prepare_write(ec);
+        if (discarding_body())
+            return ec ? 0 : asio::buffer_size(buffers);
 
         switch(_response_mode)
         {
@@ -305,6 +579,7 @@ namespace secr { namespace dispatch { namespace http {
                     buffer = asio::buffer(buffer, total_to_write);
                 
                 auto written = stream().write_some(asio::const_buffers_1(buffer), ec);
+                capture_body(asio::buffer(buffer, written));
                 buffer = buffer + written;
                 if (total_to_write != unlimited_size)
                     total_to_write -= written;
@@ -314,25 +589,194 @@ namespace secr { namespace dispatch { namespace http {
         return total_written;
     }
     
+    template<class Handler>
+    void
+    dispatch_context::response_object
+    ::async_write(asio::const_buffer data,
+                  std::shared_ptr<const void> owner,
+                  Handler&& handler)
+    {
+        error_code ec;
+        
+        // compression copies the data, so it is finished with at once
+        if (start_compression())
+        {
+            auto size = compress_some(asio::const_buffers_1(data), ec);
+            stream().get_io_service().post([handler = std::forward<Handler>(handler), ec, size]() mutable
+                                           {
+                                               handler(ec, size);
+                                           });
+            return;
+        }
+        
+        // as is holding it back for an entity tag
+        if (start_entity_tag())
+        {
+            auto size = hold_body(asio::const_buffers_1(data), ec);
+            stream().get_io_service().post([handler = std::forward<Handler>(handler), ec, size]() mutable
+                                           {
+                                               handler(ec, size);
+                                           });
+            return;
+        }
+        
+        prepare_write(ec);
+        
+        auto data_size = asio::buffer_size(data);
+        if (not ec and discarding_body())
+        {
+            stream().get_io_service().post([handler = std::forward<Handler>(handler), data_size]() mutable
+                                           {
+                                               handler(error_code(), data_size);
+                                           });
+            return;
+        }
+        
+        if (not ec and data_size and _response_mode == response_mode::chunked)
+        {
+            // any held back data goes first, framed in the same write as the
+            // size line of this chunk
+            chunk_header held_header(_coalesced.size());
+            chunk_header header(data_size);
+            boost::container::small_vector<asio::const_buffer, 4> framing;
+            if (not _coalesced.empty())
+            {
+                framing.push_back(held_header.buffer());
+                framing.push_back(asio::buffer(_coalesced));
+                framing.push_back(chunk_trailer());
+            }
+            framing.push_back(header.buffer());
+            asio::write(stream(), framing, ec);
+            _coalesced.clear();
+            if (ec)
+            {
+                // the handler is still owed its call, and the data must live
+                // until then
+                _last_error = ec;
+                stream().get_io_service().post([handler = std::forward<Handler>(handler),
+                                                owner = std::move(owner),
+                                                ec]() mutable
+                                               {
+                                                   handler(ec, std::size_t(0));
+                                               });
+                return;
+            }
+            
+            // once attached, the stream calls the handler
+            stream().attach(data, std::move(owner), std::forward<Handler>(handler));
+            asio::write(stream(), chunk_trailer(), ec);
+            if (ec)
+                _last_error = ec;
+            return;
+        }
+        
+        if (ec or data_size == 0)
+        {
+            stream().get_io_service().post([handler = std::forward<Handler>(handler), ec]() mutable
+                                           {
+                                               handler(ec, std::size_t(0));
+                                           });
+            return;
+        }
+        
+        capture_body(data);
+        stream().attach(data, std::move(owner), std::forward<Handler>(handler));
+    }
+    
     template<class ConstBufferSequence>
     std::size_t
     dispatch_context::response_object::
-    write_chunk(const ConstBufferSequence& buffers, error_code& ec)
+    hold_body(const ConstBufferSequence& buffers, error_code& ec)
     {
-        static const std::string crlf = "\r\n";
-        auto total_size = asio::buffer_size(buffers);
-        std::ostringstream ss;
-        ss << std::hex << total_size;
-        auto chunk_header = ss.str() + crlf;
-        void(asio::write(stream(), asio::buffer(chunk_header), ec));
-        auto total_written = 0;
-        if (not ec) {
-            total_written += asio::write(stream(), buffers, ec);
+        ec.clear();
+        std::size_t total = 0;
+        for (auto buffer : buffers)
+        {
+            auto b = asio::const_buffer(buffer);
+            auto p = asio::buffer_cast<const char*>(b);
+            _held_body.insert(_held_body.end(), p, p + asio::buffer_size(b));
+            total += asio::buffer_size(b);
         }
-        if (not ec) {
-            void(asio::write(stream(), asio::buffer(crlf), ec));
+        if (_held_body.size() >= _content_length)
+            send_held_body(ec);
+        return total;
+    }
+    
+    template<class ConstBufferSequence>
+    std::size_t
+    dispatch_context::response_object::
+    compress_some(const ConstBufferSequence& buffers, error_code& ec)
+    {
+        ec.clear();
+        std::size_t total = 0;
+        for (auto buffer : buffers)
+        {
+            auto b = asio::const_buffer(buffer);
+            auto size = asio::buffer_size(b);
+            total += size;
+            if (_compression_state == compression_state::pending)
+            {
+                auto p = asio::buffer_cast<const char*>(b);
+                _compression_input.insert(_compression_input.end(), p, p + size);
+            }
+            else
+            {
+                _compressor->compress(b, compress_flush::none, _compressed);
+                _written_since_sync += size;
+            }
         }
-        return total_written;
+        
+        if (_compression_state == compression_state::pending
+            and _compression_input.size() >= _compression.minimum_size)
+        {
+            begin_streaming_compression();
+        }
+        
+        if (_compression_state == compression_state::streaming)
+        {
+            // small writes are compressed together, and brought out for the
+            // client once enough of them have gathered
+            auto sync_size = _coalesce_size ? _coalesce_size : _compression.flush_size;
+            if (_written_since_sync >= sync_size)
+                sync_compression();
+            write_compressed(ec);
+        }
+        return ec ? 0 : total;
+    }
+    
+    template<class ConstBufferSequence>
+    std::size_t
+    dispatch_context::response_object::
+    write_chunk(const ConstBufferSequence& buffers, error_code& ec)
+    {
+        auto data_size = asio::buffer_size(buffers);
+        
+        // a chunk of zero length would end the body
+        if (data_size == 0)
+            return 0;
+        
+        auto held = _coalesced.size();
+        if (held + data_size < _coalesce_size)
+        {
+            _coalesced.resize(held + data_size);
+            asio::buffer_copy(asio::buffer(_coalesced.data() + held, data_size), buffers);
+            return data_size;
+        }
+        
+        // frame the chunk on the stack and hand it to the stream in one write,
+        // so that the stream is locked and its reader woken once per chunk
+        chunk_header header(held + data_size);
+        boost::container::small_vector<asio::const_buffer, 8> chunk;
+        chunk.push_back(header.buffer());
+        if (held)
+            chunk.push_back(asio::buffer(_coalesced));
+        for (auto buffer : buffers)
+            chunk.push_back(asio::const_buffer(buffer));
+        chunk.push_back(chunk_trailer());
+        
+        asio::write(stream(), chunk, ec);
+        _coalesced.clear();
+        return ec ? 0 : data_size;
     }
 
     
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// How responses are given entity tags
+    struct entity_tag_options
+    {
+        /// If true, a complete body of known length is hashed before it is
+        /// sent and the response is given a strong ETag. A request whose
+        /// If-None-Match matches receives a 304 instead of the body.
+        bool enabled = false;
+
+        /// Only bodies up to this size are held back to be hashed
+        std::size_t buffer_limit = 256 * 1024;
+    };
+
+    /// The 64 bit xxHash of a block of memory
+    std::uint64_t xxh64(const void* data, std::size_t size, std::uint64_t seed = 0);
+
+    /// @returns a strong entity tag for a hash or version number, such as
+    ///          "\"00000000000004d2\""
+    std::string strong_entity_tag(std::uint64_t value);
+
+    /// @returns true if an If-None-Match header value matches an entity
+    ///          tag: it is "*" or lists the tag. Comparison is weak, so
+    ///          W/"x" matches "x".
+    bool if_none_match(string_view header_value, string_view entity_tag);
+
+}}}
@@ -1,4 +1,4 @@
-#pragma
+#pragma once
 #include <secr/dispatch/config.hpp>
 
 namespace secr { namespace dispatch { namespace http {
@@ -8,6 +8,8 @@ namespace secr { namespace dispatch { namespace http {
 	{
 		missing_status_line,
         response_mode_not_set,
+        bad_message_frame,
+        not_acceptable,
 	};
 
 
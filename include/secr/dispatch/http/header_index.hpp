@@ -0,0 +1,169 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    struct raw_header_field;
+
+    /// Canonical identifiers for the header names which the server and its
+    /// clients look up often
+    enum class header_id : std::uint8_t
+    {
+        unknown = 0,
+        accept,
+        accept_charset,
+        accept_encoding,
+        accept_language,
+        authorization,
+        cache_control,
+        connection,
+        content_encoding,
+        content_length,
+        content_type,
+        cookie,
+        date,
+        etag,
+        expect,
+        host,
+        if_match,
+        if_modified_since,
+        if_none_match,
+        if_range,
+        if_unmodified_since,
+        keep_alive,
+        last_modified,
+        origin,
+        range,
+        referer,
+        te,
+        trailer,
+        transfer_encoding,
+        upgrade,
+        user_agent,
+        vary,
+        x_forwarded_for,
+
+        count
+    };
+
+    constexpr std::size_t header_id_count = static_cast<std::size_t>(header_id::count);
+
+    /// @returns the canonical spelling of a header name, or an empty view for
+    ///          header_id::unknown
+    string_view header_name(header_id id);
+
+    /// Identify a header name, ignoring case.
+    /// This is a perfect hash over the well-known names, so costs one hash
+    /// and at most one comparison.
+    header_id identify_header(string_view name);
+
+    /// Compare two strings ignoring ascii case. Uses SSE2 where available.
+    bool iequals_ascii(string_view l, string_view r);
+
+    /// @returns true if name is the given well-known header, ignoring case
+    inline bool is_header(string_view name, header_id id)
+    {
+        auto canonical = header_name(id);
+        return name.size() == canonical.size() and iequals_ascii(name, canonical);
+    }
+
+    /// @returns true for the optional whitespace around header values and
+    ///          their tokens
+    inline bool is_space(char c) { return c == ' ' or c == '\t'; }
+
+    /// @returns s without leading or trailing optional whitespace
+    inline string_view trim(string_view s)
+    {
+        auto first = s.begin();
+        auto last = s.end();
+        while (first != last and is_space(*first)) ++first;
+        while (last != first and is_space(*(last - 1))) --last;
+        return string_view(first, std::size_t(last - first));
+    }
+
+    /// Visit each comma-separated token of a header value, with surrounding
+    /// whitespace removed. Empty tokens are skipped.
+    template<class F>
+    void for_each_token(string_view value, F&& f)
+    {
+        auto first = value.begin();
+        auto last = value.end();
+        while (first != last)
+        {
+            auto comma = first;
+            while (comma != last and *comma != ',') ++comma;
+            auto token = trim(string_view(first, std::size_t(comma - first)));
+            if (token.size())
+                f(token);
+            first = comma == last ? last : comma + 1;
+        }
+    }
+
+    /// Maps well-known header ids to the positions of the request header
+    /// fields which carry them. Built once when the request header is
+    /// complete, after which every lookup of a well-known header is constant
+    /// time.
+    /// @note the index refers to the field vector from which it was built.
+    ///       It must be rebuilt or cleared if that vector changes.
+    class header_index
+    {
+    public:
+        static constexpr std::size_t npos = std::size_t(-1);
+
+        void clear();
+
+        void build(const std::vector<raw_header_field>& fields);
+
+        /// @returns the number of fields carrying the header
+        std::size_t count(header_id id) const
+        {
+            return _count[static_cast<std::size_t>(id)];
+        }
+
+        /// @returns the position of the first field carrying the header, or npos
+        std::size_t position(header_id id) const
+        {
+            auto pos = _first[static_cast<std::size_t>(id)];
+            return pos ? pos - 1 : npos;
+        }
+
+        /// @returns the first field carrying the header, or nullptr
+        const raw_header_field* find(header_id id) const;
+
+        /// @returns the value of the first field carrying the header, or an
+        ///          empty view
+        string_view value(header_id id) const;
+
+        /// @returns the id of the field at a position
+        header_id id_at(std::size_t pos) const { return _ids[pos]; }
+
+        /// Call f(const raw_header_field&) for each field carrying the header,
+        /// in order
+        template<class F>
+        void for_each(header_id id, F&& f) const
+        {
+            auto n = count(id);
+            for (auto pos = position(id) ; n and pos < _ids.size() ; ++pos)
+            {
+                if (_ids[pos] == id)
+                {
+                    f((*_fields)[pos]);
+                    --n;
+                }
+            }
+        }
+
+    private:
+        const std::vector<raw_header_field>* _fields = nullptr;
+        std::array<std::uint32_t, header_id_count> _first {};
+        std::array<std::uint32_t, header_id_count> _count {};
+        std::vector<header_id> _ids;
+    };
+
+}}}
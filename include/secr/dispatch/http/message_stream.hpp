@@ -0,0 +1,145 @@
+#pragma once
+
+#include <secr/dispatch/http/dispatcher.hpp>
+#include <secr/dispatch/http/errors.hpp>
+
+#include <google/protobuf/message.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// each message in the binary encoding, preceded by its size as a varint
+    extern const char delimited_protobuf_media_type[];
+
+    /// each message as one line of compact json
+    extern const char ndjson_media_type[];
+
+    /// How the messages of a stream are separated
+    enum class message_framing
+    {
+        length_delimited,
+        ndjson
+    };
+
+    /// Append one framed message to out
+    /// @returns false if the message cannot be serialised
+    bool append_frame(std::string& out, const google::protobuf::Message& message, message_framing framing);
+
+    /// A response sent as a stream of messages, one at a time, in chunked
+    /// encoding. Only the message being written is held in memory, and the
+    /// client receives the first message as soon as it is written.
+    ///
+    /// Small messages may be gathered into fewer chunks with
+    /// context().response().set_chunk_coalescing before the first write.
+    ///
+    /// A stream is not thread safe: write to it from the dispatch
+    /// io_service, or otherwise one thread at a time.
+    class message_stream_writer
+    {
+    public:
+        /// Frame the messages as the client's Accept header prefers,
+        /// length-delimited on a tie. A client which accepts neither
+        /// framing is sent a 406 Not Acceptable at once, and the stream is
+        /// not accepted.
+        /// @pre header is not committed and nothing has been written
+        explicit message_stream_writer(dispatch_context context);
+
+        /// @pre as above
+        message_stream_writer(dispatch_context context, message_framing framing);
+
+        message_framing framing() const { return _framing; }
+
+        /// @returns false if the client was sent a 406 rather than the
+        ///          stream. Writes then fail with
+        ///          protocol_error_code::not_acceptable.
+        bool accepted() const { return _accepted; }
+
+        dispatch_context& context() { return _context; }
+
+        /// Send a message. It is copied, so may be reused at once.
+        void write(const google::protobuf::Message& message, error_code& ec);
+        void write(const google::protobuf::Message& message);
+
+        /// Send a message, calling handler(error_code, std::size_t) on the
+        /// dispatch io_service once the client has received it. Writing the
+        /// next message from the handler keeps a slow client from building
+        /// up a backlog of messages in the server.
+        template<class Handler>
+        void async_write(const google::protobuf::Message& message, Handler&& handler)
+        {
+            auto frame = std::make_shared<std::string>();
+            error_code ec;
+            if (not _accepted)
+                ec = make_error_code(protocol_error_code::not_acceptable);
+            else if (not append_frame(*frame, message, _framing))
+                ec = make_error_code(protocol_error_code::bad_message_frame);
+            if (ec)
+            {
+                _context.request().stream().get_io_service()
+                .post([handler = std::forward<Handler>(handler), ec]() mutable
+                      {
+                          handler(ec, std::size_t(0));
+                      });
+                return;
+            }
+            ++_messages_written;
+            auto buffer = asio::const_buffer(frame->data(), frame->size());
+            auto& response = _context.response();
+            response.async_write(buffer, std::move(frame), std::forward<Handler>(handler));
+            
+            // a compressed message has been taken in whole, and the handler
+            // told, already. A failure to send it shows on the next write.
+            response.flush_compression(ec);
+        }
+
+        /// End the stream
+        void close(error_code& ec);
+        void close();
+
+        std::size_t messages_written() const { return _messages_written; }
+
+    private:
+        /// send the header of the stream
+        void start();
+
+        /// answer 406 instead of sending the stream
+        void refuse();
+
+        dispatch_context _context;
+        message_framing _framing = message_framing::ndjson;
+        bool _accepted = true;
+        std::string _frame;
+        std::size_t _messages_written = 0;
+    };
+
+    /// The client side of a stream of messages. The dechunked body is fed
+    /// in as it arrives, in pieces of any size, and whole messages are
+    /// taken out as they become available.
+    class message_stream_reader
+    {
+    public:
+        explicit message_stream_reader(message_framing framing);
+
+        void feed(const char* data, std::size_t size);
+
+        /// Take the next complete message
+        /// @returns false if no complete message has arrived yet, or on error
+        bool next(google::protobuf::Message& message, error_code& ec);
+        bool next(google::protobuf::Message& message);
+
+        /// @returns true if part of a message is waiting for more data
+        bool incomplete() const { return _consumed < _buffer.size(); }
+
+    private:
+        /// discard the bytes of messages already taken
+        void compact();
+
+        message_framing _framing;
+        std::string _buffer;
+        std::size_t _consumed = 0;
+    };
+
+}}}
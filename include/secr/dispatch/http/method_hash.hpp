@@ -0,0 +1,29 @@
+#pragma once
+
+#include <secr/dispatch/string_view.hpp>
+
+#include <cstdint>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// The hash under which generated dispatch tables look up method names.
+    /// protoc-gen-secr_dispatch searches for a seed which gives each method
+    /// of a service a slot of its own, so a lookup costs one hash and one
+    /// string comparison.
+    /// @note the generator and the tables it generates must agree on this
+    ///       function. Changing it requires the tables to be regenerated.
+    inline std::uint32_t method_hash(string_view name, std::uint32_t seed)
+    {
+        std::uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+        for (auto c : name)
+        {
+            h ^= std::uint8_t(c);
+            h *= 16777619u;
+        }
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        return h;
+    }
+
+}}}
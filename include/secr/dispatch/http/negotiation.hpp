@@ -0,0 +1,133 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+#include <secr/dispatch/secr_dispatch_http.pb.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// A quality value in thousandths, so that 1.0 is 1000
+    using quality_type = std::uint16_t;
+    constexpr quality_type max_quality = 1000;
+
+    /// Parse a qvalue such as "0.5". Invalid values yield max_quality.
+    quality_type parse_quality(string_view text);
+
+    using media_parameter = std::pair<std::string, std::string>;
+
+    /// One element of an Accept header. type, subtype and parameter names
+    /// are held in lower case.
+    struct media_range
+    {
+        std::string type;
+        std::string subtype;
+        std::vector<media_parameter> parameters;
+        quality_type q = max_quality;
+
+        /// 0 for */*, 1 for type/*, 2 for type/subtype, 3 with parameters
+        int specificity() const;
+    };
+
+    /// A media type which the server is able to produce
+    struct media_type_offer
+    {
+        explicit media_type_offer(string_view text);
+
+        /// the media type as given, suitable for a Content-Type header
+        std::string text;
+        std::string type;
+        std::string subtype;
+        std::vector<media_parameter> parameters;
+    };
+
+    /// A parsed Accept header. The ranges are sorted most specific first, so
+    /// that the first range which matches a media type determines its quality.
+    /// @note parsed lists are immutable and shared through an intern cache.
+    ///       Use parse() rather than constructing them directly.
+    class accept_list
+    {
+    public:
+        explicit accept_list(string_view header_value);
+
+        /// @returns the parsed form of a header value. Identical values share
+        ///          one parsed object.
+        static std::shared_ptr<const accept_list> parse(string_view header_value);
+
+        const std::vector<media_range>& ranges() const { return _ranges; }
+
+        /// @returns true if the header was empty, in which case every media
+        ///          type is acceptable
+        bool empty() const { return _ranges.empty(); }
+
+        /// @returns the quality the client assigns to an offered type
+        quality_type quality(const media_type_offer& offer) const;
+
+    private:
+        std::vector<media_range> _ranges;
+    };
+
+    /// The content codings of an Accept-Encoding header
+    class accept_encoding_list
+    {
+    public:
+        explicit accept_encoding_list(string_view header_value);
+
+        static std::shared_ptr<const accept_encoding_list> parse(string_view header_value);
+
+        const std::vector<std::pair<std::string, quality_type>>& codings() const { return _codings; }
+
+        /// @returns the quality the client assigns to a content coding.
+        /// identity is acceptable unless explicitly refused. An empty header
+        /// accepts only identity. A missing header accepts any coding, and
+        /// is parsed as "*".
+        quality_type quality(string_view coding) const;
+
+    private:
+        std::vector<std::pair<std::string, quality_type>> _codings;
+        quality_type _wildcard = 0;
+        bool _has_wildcard = false;
+    };
+
+    /// The media types a handler can produce, in order of the server's
+    /// preference. Parsed once, when the handler is set up.
+    class offered_media_types
+    {
+    public:
+        offered_media_types(std::initializer_list<string_view> types);
+
+        /// Choose the offer with the highest quality. Ties go to the earlier
+        /// offer.
+        /// @returns the chosen offer or nullptr if the client accepts none of
+        ///          them (a 406 response is appropriate)
+        const media_type_offer* negotiate(const accept_list& accept) const;
+
+        const std::vector<media_type_offer>& offers() const { return _offers; }
+
+    private:
+        std::vector<media_type_offer> _offers;
+    };
+
+    /// The content codings a handler can produce, in order of preference
+    class offered_encodings
+    {
+    public:
+        offered_encodings(std::initializer_list<string_view> codings);
+
+        /// @returns the chosen coding or nullptr if none is acceptable
+        const std::string* negotiate(const accept_encoding_list& accept) const;
+
+    private:
+        std::vector<std::string> _codings;
+    };
+
+    /// Express an Accept header in the protobuf schema
+    AcceptMetaData& populate(AcceptMetaData& meta, const accept_list& accept);
+
+}}}
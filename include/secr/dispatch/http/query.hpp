@@ -0,0 +1,98 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+#include <google/protobuf/arena.h>
+#include <boost/optional.hpp>
+
+#include <iterator>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// @returns true if the text contains anything which percent_decode
+    ///          would change
+    bool needs_decoding(string_view text, bool plus_as_space);
+
+    /// Decode %XX escapes (and optionally '+' as space) into out, which must
+    /// have room for text.size() bytes. Malformed escapes are copied as they
+    /// are.
+    /// @returns the number of bytes written
+    std::size_t percent_decode(string_view text, char* out, bool plus_as_space);
+
+    /// Decode text into the arena.
+    /// @returns text itself if it contains nothing to decode, otherwise a
+    ///          view of the decoded copy in the arena
+    string_view percent_decode(google::protobuf::Arena* arena, string_view text, bool plus_as_space);
+
+    /// @returns true if the percent-decoded form of encoded equals decoded,
+    ///          without decoding into memory
+    bool decoded_equals(string_view encoded, string_view decoded, bool plus_as_space);
+
+    /// One name=value pair of a query string, still encoded
+    struct query_parameter
+    {
+        string_view name;
+        string_view value;
+        bool has_value = false;
+    };
+
+    /// A view of an application/x-www-form-urlencoded query string. Pairs are
+    /// split out as the view is iterated - nothing is copied or decoded
+    /// until asked for.
+    class query_parameters
+    {
+    public:
+        struct const_iterator
+        {
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = query_parameter;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const query_parameter*;
+            using reference = const query_parameter&;
+
+            const_iterator() = default;
+            const_iterator(const char* first, const char* last)
+            : _rest(first), _last(last)
+            {
+                advance();
+            }
+
+            reference operator*() const { return _current; }
+            pointer operator->() const { return std::addressof(_current); }
+
+            const_iterator& operator++() { advance(); return *this; }
+            const_iterator operator++(int) { auto tmp = *this; advance(); return tmp; }
+
+            bool operator==(const const_iterator& r) const { return _at_end == r._at_end and (_at_end or _pos == r._pos); }
+            bool operator!=(const const_iterator& r) const { return not (*this == r); }
+
+        private:
+            void advance();
+
+            const char* _pos = nullptr;
+            const char* _rest = nullptr;
+            const char* _last = nullptr;
+            query_parameter _current;
+            bool _at_end = true;
+        };
+
+        query_parameters() = default;
+        explicit query_parameters(string_view query) : _query(query) {}
+
+        const_iterator begin() const { return const_iterator(_query.begin(), _query.end()); }
+        const_iterator end() const { return const_iterator(); }
+
+        string_view raw() const { return _query; }
+
+        /// @returns the first parameter whose decoded name matches, or end()
+        const_iterator find(string_view name) const;
+
+        /// @returns the decoded value of the first parameter with the given
+        ///          name, decoded into the arena if necessary
+        boost::optional<string_view> get(google::protobuf::Arena* arena, string_view name) const;
+
+    private:
+        string_view _query;
+    };
+
+}}}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+#include <secr/dispatch/http/header_index.hpp>
+#include <secr/dispatch/secr_dispatch_http.pb.h>
+#include <contrib/http_parser/http_parser.h>
+#include <google/protobuf/arena.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// A block of memory into which a connection reads from its socket.
+    /// A request whose header refers into a block keeps that block alive
+    /// (pins it) for as long as the request exists.
+    struct read_block
+    {
+        static constexpr std::size_t block_size = 4096;
+
+        char* data() { return _data.data(); }
+        const char* data() const { return _data.data(); }
+        static constexpr std::size_t size() { return block_size; }
+
+        /// @returns true if a request refers into the block.
+        /// Pins are only taken on the connection's strand, and are released
+        /// with release ordering on whichever thread lets the request go, so
+        /// once the strand sees no pins it may read into the block again.
+        bool pinned() const { return _pins.load(std::memory_order_acquire) != 0; }
+
+    private:
+        friend class block_pin;
+
+        std::array<char, block_size> _data;
+        std::atomic<std::size_t> _pins { 0 };
+    };
+
+    using read_block_ptr = std::shared_ptr<read_block>;
+
+    /// Holds a pin on a read block for as long as it exists
+    class block_pin
+    {
+    public:
+        explicit block_pin(read_block_ptr block)
+        : _block(std::move(block))
+        {
+            _block->_pins.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        block_pin(block_pin&& other) noexcept = default;
+
+        block_pin& operator=(block_pin&& other) noexcept
+        {
+            release();
+            _block = std::move(other._block);
+            return *this;
+        }
+
+        ~block_pin() { release(); }
+
+        const read_block_ptr& block() const { return _block; }
+
+    private:
+        void release()
+        {
+            if (_block)
+            {
+                _block->_pins.fetch_sub(1, std::memory_order_release);
+                _block.reset();
+            }
+        }
+
+        read_block_ptr _block;
+    };
+
+    /// A view of one part of a request header (uri, field name or field value)
+    /// which grows as the parser delivers more data.
+    /// While the part lies in a single read block the slice is simply a view
+    /// into that block. If the part is split across two reads the
+    /// slice is copied into the request's arena.
+    struct header_slice
+    {
+        /// Extend the slice with more data from the parser
+        /// @param origin identifies the read block in which the data lies
+        void append(const void* origin,
+                    const char* begin, std::size_t size,
+                    google::protobuf::Arena* arena);
+
+        string_view view() const { return string_view(_begin, _size); }
+
+        std::size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+
+    private:
+        const char* _begin = "";
+        std::size_t _size = 0;
+        const void* _origin = nullptr;
+    };
+
+    struct raw_header_field
+    {
+        header_slice name;
+        header_slice value;
+    };
+
+    /// The request header as delivered by the parser, stored as views over the
+    /// connection's pinned read blocks.
+    /// @note all append and finalise methods must be called on the connection's
+    ///       strand. Once finalised, the object is immutable.
+    class raw_request_header
+    {
+        using Arena = google::protobuf::Arena;
+
+    public:
+
+        raw_request_header(Arena* arena)
+        : _arena(arena)
+        {
+            _fields.reserve(16);
+        }
+
+        /// Return to the empty state, releasing all pinned blocks but keeping
+        /// allocated capacity for the next request
+        /// @note any arena copies are invalidated when the arena is reset
+        void clear();
+        
+        /// ensure that the given read block lives at least as long as this object
+        void pin(const read_block_ptr& block)
+        {
+            if (_pinned.empty() or _pinned.back().block() != block) {
+                _pinned.emplace_back(block);
+            }
+        }
+
+        void append_uri(const read_block_ptr& block,
+                        const char* begin, std::size_t size);
+        void append_header_field(const read_block_ptr& block,
+                                 const char* begin, std::size_t size);
+        void append_header_value(const read_block_ptr& block,
+                                 const char* begin, std::size_t size);
+
+        /// Record the method and version, parse the uri and index the
+        /// well-known headers.
+        /// @throws invalid_url if the uri cannot be parsed
+        void finalise(http_parser* parser);
+
+        string_view method() const { return _method; }
+        string_view uri() const { return _uri.view(); }
+        int version_major() const { return _version_major; }
+        int version_minor() const { return _version_minor; }
+
+        const std::vector<raw_header_field>& fields() const { return _fields; }
+
+        /// The positions of the well-known headers
+        /// @pre finalise has been called
+        const header_index& index() const { return _index; }
+
+        /// @returns true if any Connection header carries the token "close"
+        bool connection_close() const { return _connection_close; }
+
+        /// @returns true if any Connection header carries the token "keep-alive"
+        bool connection_keep_alive() const { return _connection_keep_alive; }
+
+        /// @returns true if the response may leave the connection open:
+        ///          from HTTP/1.1 unless the client lists "close", and
+        ///          before HTTP/1.1 only if it lists "keep-alive"
+        bool keep_alive_requested() const
+        {
+            if (_version_major > 1 or (_version_major == 1 and _version_minor >= 1))
+                return not _connection_close;
+            return _connection_keep_alive and not _connection_close;
+        }
+
+        /// @returns the given component of the parsed uri, or an empty view
+        ///          if the component is not present
+        string_view url_field(http_parser_url_fields field) const
+        {
+            if (_url.field_set & (1 << field))
+            {
+                auto& slot = _url.field_data[field];
+                return string_view(uri().begin() + slot.off, slot.len);
+            }
+            return string_view();
+        }
+
+        bool has_url_field(http_parser_url_fields field) const
+        {
+            return (_url.field_set & (1 << field)) != 0;
+        }
+
+    private:
+        Arena* _arena;
+        std::vector<block_pin> _pinned;
+
+        header_slice _uri;
+        std::vector<raw_header_field> _fields;
+        enum class field_state {
+            none,
+            name,
+            value
+        };
+        field_state _field_state = field_state::none;
+
+        header_index _index;
+        bool _connection_close = false;
+        bool _connection_keep_alive = false;
+
+        string_view _method;
+        int _version_major = 0;
+        int _version_minor = 0;
+        http_parser_url _url {};
+    };
+
+    /// Build the protobuf representation of a raw header
+    HttpRequestHeader& populate(HttpRequestHeader& header, const raw_request_header& raw);
+
+}}}
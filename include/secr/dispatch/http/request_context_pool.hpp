@@ -0,0 +1,60 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/http/server_request.hpp>
+
+#include <memory>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// A pool of request_contexts, one per controller io_service.
+    /// When the last reference to a context acquired from the pool is released
+    /// (on whichever thread) the context is reset and returned to the pool, so
+    /// that its arena, streams and header storage are reused by the next
+    /// request. The size of each new arena's initial block is learned from the
+    /// usage of the thread which owns that block in previous requests, so that
+    /// in steady state that thread allocates no arena blocks. Other threads
+    /// which allocate from a request's arena add small blocks of their own,
+    /// which neither grow the initial block nor cause a context to be discarded.
+    class request_context_pool
+    : public asio::io_service::service
+    {
+    public:
+        static asio::io_service::id id;
+
+        struct statistics
+        {
+            /// contexts constructed because the pool had none available
+            std::size_t created = 0;
+
+            /// contexts taken from the pool
+            std::size_t reused = 0;
+
+            /// contexts destroyed on release, either because the pool was full
+            /// or because the owner of the context's initial block outgrew it
+            std::size_t discarded = 0;
+
+            /// the initial block size given to new contexts
+            std::size_t initial_block_size = 0;
+        };
+
+        explicit request_context_pool(asio::io_service& controller_service);
+
+        /// @returns a context whose controller service is this pool's
+        ///          io_service
+        std::shared_ptr<request_context> acquire(connection_id conn_id,
+                                                 asio::io_service& dispatcher_service);
+
+        /// Set the maximum number of idle contexts held for each dispatcher
+        void set_max_pooled(std::size_t max_pooled);
+
+        statistics get_statistics() const;
+
+    private:
+        void shutdown_service() override;
+
+        struct state;
+        std::shared_ptr<state> _state;
+    };
+
+}}}
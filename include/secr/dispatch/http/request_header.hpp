@@ -2,6 +2,8 @@
 
 #include <secr/dispatch/config.hpp>
 #include <secr/dispatch/buffered_stream.hpp>
+#include <secr/dispatch/string_view.hpp>
+#include <secr/dispatch/http/header_index.hpp>
 #include <secr/dispatch/secr_dispatch_http.pb.h>
 #include <contrib/http_parser/http_parser.h>
 #include <functional>
@@ -9,11 +11,18 @@
 
 namespace secr { namespace dispatch { namespace http {
     
+    /// Header names compare without regard to case
+    struct header_name_equal
+    {
+        bool operator()(string_view l, string_view r) const {
+            return iequals_ascii(l, r);
+        }
+    };
     
     template<class StringLike>
     struct unary_match_header_name
     {
-        using pred = std::equal_to<>;
+        using pred = header_name_equal;
         unary_match_header_name(StringLike value) : r(std::move(value)) {}
         
         bool operator()(const Header& l) const {
@@ -33,7 +42,7 @@ namespace secr { namespace dispatch { namespace http {
     
     struct binary_match_header_name
     {
-        using pred = std::equal_to<>;
+        using pred = header_name_equal;
         bool operator()(const Header& l, const Header& r) const {
             return _pred(l.name(), r.name());
         }
@@ -84,7 +93,7 @@ namespace secr { namespace dispatch { namespace http {
     find_headers_like(const HttpRequestHeader& request,
                       const std::string& like);
     
-    ContentType& populate(ContentType& ct, const std::string& header_value);
+    ContentType& populate(ContentType& ct, string_view header_value);
     ContentType& populate(ContentType& ct, const HttpRequestHeader& header_value);
 
 
@@ -103,6 +112,9 @@ namespace secr { namespace dispatch { namespace http {
         const element_type* data() const { return _ptr.get(); }
         std::size_t size() const { return _size; }
         
+        /// the owning pointer, so that others may share ownership
+        const ptr_type& pointer() const { return _ptr; }
+        
         element_type* begin() { return _ptr.get(); }
         const element_type* begin() const { return _ptr.get(); }
         element_type* end() { return begin() + size(); }
@@ -137,6 +149,13 @@ namespace secr { namespace dispatch { namespace http {
         element_type* data() { return _ptr.get(); }
         const element_type* data() const { return _ptr.get(); }
         std::size_t size() const { return _size; }
+        
+        /// Give up the tail of the buffer. The memory is not released.
+        void shrink(std::size_t size)
+        {
+            assert(size <= _size);
+            _size = size;
+        }
 
         element_type* begin() { return _ptr.get(); }
         const element_type* begin() const { return _ptr.get(); }
@@ -158,6 +177,11 @@ namespace secr { namespace dispatch { namespace http {
     };
     
     
+    /// Serialise a response header into its arena.
+    /// @param add_date if true and the header has no Date field, the current
+    ///        date is added
+    /// @see response_header.hpp
+    arena_byte_buffer to_response_buffer(const HttpResponseHeader& rmsg, bool add_date);
     arena_byte_buffer to_response_buffer(const HttpResponseHeader& rmsg);
     arena_byte_buffer to_response_buffer(const HttpResponseHeader* rmsg);
     
@@ -1,6 +1,7 @@
 #pragma once
 #include <secr/dispatch/config.hpp>
 #include <secr/dispatch/http/server_request.hpp>
+#include <secr/dispatch/http/access_log.hpp>
 #include <secr/dispatch/asioex/transfer.hpp>
 #include <secr/dispatch/asioex/errors.hpp>
 
@@ -72,6 +73,12 @@ namespace secr { namespace dispatch { namespace http {
                              });
         }
         
+        /// @returns true if a response is being written or is waiting to be written
+        /// @note must be called on the strand
+        bool busy() const {
+            return working();
+        }
+        
     private:
         
         void start_responding()
@@ -141,8 +148,10 @@ namespace secr { namespace dispatch { namespace http {
                                          bytes_read,
                                          bytes_written);
             
+            context->add_bytes_sent(bytes_written);
             
             if (write_error) {
+                access_log::request_complete(*context, write_error);
                 error_code sink;
 //                _socket.shutdown(asio::socket_base::shutdown_send, sink);
                 if (!_last_error)
@@ -151,6 +160,7 @@ namespace secr { namespace dispatch { namespace http {
             }
             else if (asioex::error_not_eof(read_error))
             {
+                access_log::request_complete(*context, read_error);
                 error_code sink;
 //                _socket.shutdown(asio::socket_base::shutdown_send, sink);
                 if (!_last_error)
@@ -159,6 +169,7 @@ namespace secr { namespace dispatch { namespace http {
             }
             else if (asioex::is_eof(read_error)) {
                 // eof
+                access_log::request_complete(*context, error_code());
                 if (context->must_force_close_on_response())
                 {
                     _last_error = asio::error::basic_errors::operation_aborted;
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+#include <secr/dispatch/http/raw_request_header.hpp>
+#include <secr/dispatch/secr_dispatch_http.pb.h>
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    struct request_context;
+
+    /// The size and shape of a response_cache
+    struct response_cache_options
+    {
+        /// If false, no cache is created
+        bool enabled = false;
+
+        /// The total number of bytes the cache may hold, including keys
+        std::size_t capacity = 64 * 1024 * 1024;
+
+        /// Responses larger than this are never stored
+        std::size_t max_entry_size = 1024 * 1024;
+
+        /// The number of independently locked parts of the cache
+        std::size_t shards = 16;
+    };
+
+    /// A memory-bounded cache of complete responses, shared by all the
+    /// connections of a server.
+    ///
+    /// Responses are keyed on method, host, uri and the values of the request
+    /// headers named in the response's Vary header. When a response names
+    /// different Vary headers, the variants stored under the old names are
+    /// dropped. A response is stored
+    /// only if its handler gave it a Cache-Control max-age or s-maxage and
+    /// did not mark it no-store, no-cache or private.
+    ///
+    /// Each shard keeps its entries in LRU order. When a shard is full a new
+    /// entry must have been requested more often than the entry it would
+    /// evict (TinyLFU admission), so that a burst of one-off requests does not
+    /// flush the popular responses.
+    class response_cache
+    {
+    public:
+        using clock_type = std::chrono::steady_clock;
+
+        /// A stored response. The header is held without the fields which
+        /// differ from one response to the next (Connection, Date, Age).
+        struct entry
+        {
+            std::string key;
+            std::size_t primary_size;
+            int status;
+            std::string reason;
+
+            /// "Name: value\r\n" for each stored header field
+            std::string fields;
+
+            /// the ETag and Last-Modified values, if the response had them
+            std::string entity_tag;
+            std::string last_modified;
+            std::vector<char> body;
+
+            clock_type::time_point stored;
+            clock_type::time_point expires;
+
+            std::size_t cost() const;
+        };
+        using entry_ptr = std::shared_ptr<const entry>;
+
+        explicit response_cache(const response_cache_options& options);
+        ~response_cache();
+
+        /// @returns a fresh response for the request, or null. Every lookup
+        ///          counts towards the request's popularity.
+        entry_ptr find(const raw_request_header& request,
+                       clock_type::time_point now = clock_type::now());
+
+        /// Offer a complete response to the cache
+        /// @returns true if it was stored
+        bool insert(const raw_request_header& request,
+                    const HttpResponseHeader& response,
+                    std::vector<char> body,
+                    clock_type::time_point now = clock_type::now());
+
+        std::size_t max_entry_size() const { return _options.max_entry_size; }
+        std::size_t size_in_bytes() const;
+        std::size_t entry_count() const;
+
+        /// @returns true if a response to this request could be stored: a
+        ///          GET without a body or credentials
+        static bool cacheable_request(const raw_request_header& request);
+
+        /// @returns the freshness lifetime the handler gave the response, or
+        ///          zero if it may not be stored
+        static std::chrono::seconds lifetime(const HttpResponseHeader& response);
+
+    private:
+        struct shard;
+        shard& shard_for(std::uint64_t hash);
+
+        response_cache_options _options;
+        std::vector<std::unique_ptr<shard>> _shards;
+    };
+
+    /// Write a cached response to a request's response stream without
+    /// dispatching it. The stored data is not copied. A request whose
+    /// If-None-Match lists the stored ETag, or whose If-Modified-Since is the
+    /// stored Last-Modified, receives a 304 instead.
+    /// @note called on the connection's strand
+    void respond_from_cache(request_context& context,
+                            response_cache::entry_ptr entry,
+                            response_cache::clock_type::time_point now = response_cache::clock_type::now());
+
+}}}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+
+#include <ctime>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// @returns the reason phrase registered for a status code, or an empty
+    ///          view if the code is not a standard one
+    string_view standard_reason(int code);
+
+    /// @returns a preformatted "HTTP/1.x NNN Reason\r\n" line if the version
+    ///          is 1.0 or 1.1 and the reason is the standard one for the code,
+    ///          otherwise an empty view
+    string_view standard_status_line(int version_major, int version_minor,
+                                     int code, string_view reason);
+
+    /// The length of an IMF-fixdate such as "Sun, 06 Nov 1994 08:49:37 GMT"
+    constexpr std::size_t http_date_size = 29;
+
+    /// Format t as an IMF-fixdate into out, which must have room for
+    /// http_date_size bytes
+    void format_http_date(std::time_t t, char* out);
+
+    /// Copy the current time as an IMF-fixdate into out. The text is
+    /// formatted at most once per second and shared by all threads.
+    void current_http_date(char* out);
+
+}}}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/string_view.hpp>
+#include <secr/dispatch/http/dispatcher.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// The values captured from a path by the parameters of a route, as
+    /// views into the path. Nothing is allocated while they are captured.
+    class route_parameters
+    {
+    public:
+        /// The most parameters, including a trailing wildcard, one route may have
+        static constexpr std::size_t max_size = 16;
+
+        std::size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+
+        /// @returns the value of the n'th parameter
+        string_view operator[](std::size_t n) const
+        {
+            assert(n < _size);
+            return _values[n];
+        }
+
+        /// @returns the value of the named parameter, or an empty view
+        string_view get(string_view name) const;
+
+        /// @returns the name of the n'th parameter
+        /// @pre a route has been matched
+        string_view name(std::size_t n) const
+        {
+            assert(_names and n < _size);
+            return (*_names)[n];
+        }
+
+    private:
+        friend class router;
+
+        void push(string_view value) { _values[_size++] = value; }
+        void pop() { --_size; }
+
+        std::array<string_view, max_size> _values;
+        std::size_t _size = 0;
+        const std::vector<std::string>* _names = nullptr;
+    };
+
+    /// Routes requests to handlers by method and path.
+    ///
+    /// A path template is matched segment by segment. It may contain
+    ///     {name}  - captures the rest of a segment, which must not be empty
+    ///     *name   - at the end only, captures the rest of the path (the
+    ///               name is optional)
+    /// for example "/users/{id}/items/*rest". Literal text takes precedence
+    /// over a parameter, which takes precedence over a wildcard.
+    ///
+    /// Templates are compiled into a radix trie as they are added, so the cost
+    /// of a match depends on the length of the path rather than on the
+    /// number of routes. Matching allocates nothing.
+    /// @note routes must all be added before the router is used concurrently
+    class router
+    {
+    public:
+        using handler_type = std::function<void(dispatch_context, const route_parameters&)>;
+
+        /// The outcome of matching a request
+        struct match_result
+        {
+            enum class status_type {
+                found,
+                not_found,
+
+                /// the path matches a route, but not for this method
+                method_not_allowed,
+            };
+
+            status_type status;
+
+            /// the handler of the route, if found
+            const handler_type* handler;
+
+            /// the methods accepted by the path, if it matches a route
+            string_view allow;
+        };
+
+        router();
+
+        /// Add a route. A HEAD request is routed to the GET handler unless
+        /// HEAD has a route of its own. The response discards the body that
+        /// handler writes.
+        /// @throws std::invalid_argument if the template is malformed, or
+        ///         names a parameter differently from a route which shares
+        ///         its position, or the route already exists
+        void add(string_view method, string_view path_template, handler_type handler);
+
+        /// Find the route for a method and path
+        /// @param parameters receives the values captured, which refer into path
+        match_result match(string_view method, string_view path,
+                           route_parameters& parameters) const;
+
+        /// Dispatch a request to its handler, or respond 404 or 405
+        void operator()(dispatch_context context) const;
+
+        std::size_t route_count() const { return _route_count; }
+
+    private:
+        using node_index = std::uint32_t;
+        static constexpr node_index no_node = node_index(-1);
+
+        struct route
+        {
+            std::string method;
+            handler_type handler;
+        };
+
+        struct node
+        {
+            /// the literal text consumed on the way in
+            std::string prefix;
+
+            /// the first character of the prefix of each static child, in
+            /// the same order as static_children
+            std::string first_chars;
+            std::vector<node_index> static_children;
+
+            node_index parameter_child = no_node;
+            node_index wildcard_child = no_node;
+
+            /// for parameter and wildcard nodes
+            std::string parameter_name;
+
+            /// the routes which end here, and their parameter names
+            std::vector<route> routes;
+            std::vector<std::string> parameter_names;
+            std::string allow;
+        };
+
+        node_index add_literal(node_index at, string_view text);
+        node_index add_parameter(node_index at, string_view name, bool wildcard);
+        node_index new_node();
+
+        node_index find(node_index at, string_view rest, route_parameters& parameters) const;
+
+        std::vector<node> _nodes;
+        std::size_t _route_count = 0;
+    };
+
+}}}
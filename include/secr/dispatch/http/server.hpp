@@ -0,0 +1,144 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/http/server_connection.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    struct server_options
+    {
+        /// The number of cores to run. Each core owns one io_service, one
+        /// thread and one listening socket. 0 means one per hardware thread.
+        std::size_t threads = 0;
+
+        /// The maximum number of connections accepted from the listen queue
+        /// each time an acceptor becomes readable
+        std::size_t accept_batch = 64;
+
+        /// The time for which a core stops accepting when the process or
+        /// system runs out of descriptors or buffers
+        std::chrono::milliseconds accept_backoff = std::chrono::milliseconds(100);
+
+        /// The listen backlog of each acceptor
+        int backlog = asio::socket_base::max_connections;
+
+        /// If true, core n's thread is pinned to cpu n (modulo the number of cpus)
+        bool pin_threads = true;
+
+        /// The number of requests from each connection which may be handled
+        /// concurrently. @see server_connection::set_dispatch_window
+        std::size_t dispatch_window = 1;
+        
+        /// The amount of unread request body at which a connection stops reading
+        /// from its socket, and the amount to which it must drain before reading
+        /// resumes. @see server_connection::set_request_watermarks
+        std::size_t request_high_watermark = 1024 * 1024;
+        std::size_t request_low_watermark = 256 * 1024;
+        
+        /// If true, responses which lack a Date header are given one
+        bool date_header = true;
+        
+        /// Compression of response bodies. Disabled by default.
+        /// @see compression_options
+        compression_options compression;
+        
+        /// Generation of ETags for response bodies. Disabled by default.
+        /// @see entity_tag_options
+        entity_tag_options entity_tags;
+        
+        /// A response cache shared by all connections. Disabled by default.
+        /// @see response_cache_options
+        response_cache_options cache;
+        
+        /// The timeouts applied to every connection
+        /// @see connection_timeouts
+        connection_timeouts timeouts = default_timeouts();
+        
+        static connection_timeouts default_timeouts()
+        {
+            using std::chrono::seconds;
+            connection_timeouts timeouts;
+            timeouts.idle = seconds(60);
+            timeouts.header = seconds(30);
+            timeouts.body_interval = seconds(30);
+            timeouts.body_min_bytes_per_sec = 1024;
+            timeouts.write = seconds(60);
+            return timeouts;
+        }
+    };
+
+    /// A multi-core http server front end.
+    /// Each core runs its own io_service on its own thread, with its own
+    /// SO_REUSEPORT acceptor bound to the same endpoint, so that the kernel
+    /// load-balances new connections across cores. Connections are accepted
+    /// and served entirely on the core that accepted them.
+    /// @note unless a dispatch io_service is supplied, requests are dispatched
+    ///       on the accepting core's io_service. Handlers which perform blocking
+    ///       reads of the request body must be given a separate dispatch
+    ///       io_service, otherwise they will deadlock the core.
+    struct server
+    {
+        using protocol = asio::ip::tcp;
+        using endpoint_type = protocol::endpoint;
+        using request_handler = std::function<void(dispatch_context)>;
+
+        /// Create a server which dispatches requests on the core on which
+        /// the connection was accepted
+        server(endpoint_type endpoint,
+               request_handler handler,
+               server_options options = server_options());
+
+        /// Create a server which dispatches all requests on the given io_service
+        server(endpoint_type endpoint,
+               request_handler handler,
+               asio::io_service& dispatch_service,
+               server_options options = server_options());
+
+        server(const server&) = delete;
+        server& operator=(const server&) = delete;
+
+        ~server() noexcept;
+
+        /// Start the threads of all cores and begin accepting connections
+        void start();
+
+        /// Stop all cores and join their threads. Any connections in progress
+        /// are destroyed.
+        void stop();
+
+        /// The endpoint on which all cores are listening. If the server was
+        /// created with port 0 this will contain the port chosen by the system.
+        const endpoint_type& local_endpoint() const { return _endpoint; }
+
+        std::size_t core_count() const { return _cores.size(); }
+
+        /// The total number of connections accepted by all cores
+        std::size_t connections_accepted() const { return _connections_accepted.load(); }
+
+        /// The shared response cache, or null if server_options::cache is
+        /// not enabled
+        const std::shared_ptr<http::response_cache>& cache() const { return _cache; }
+
+    private:
+        struct core;
+
+        void open_cores();
+
+        endpoint_type _endpoint;
+        request_handler _handler;
+        asio::io_service* _dispatch_service;
+        server_options _options;
+        std::shared_ptr<http::response_cache> _cache;
+        std::vector<std::unique_ptr<core>> _cores;
+        std::atomic<std::size_t> _connections_accepted { 0 };
+        bool _started = false;
+    };
+
+}}}
@@ -13,13 +13,38 @@
 
 #include <contrib/http_parser/http_parser.h>
 #include <secr/dispatch/http/server_request.hpp>
+#include <secr/dispatch/http/request_context_pool.hpp>
 #include <boost/optional.hpp>
 #include <secr/dispatch/http/responder.hpp>
+#include <secr/dispatch/asioex/timer_wheel.hpp>
 
 #include <boost/log/trivial.hpp>
 
 namespace secr { namespace dispatch { namespace http {
     
+    /// Limits on the time a connection may spend in each phase of its life.
+    /// A zero duration disables the corresponding limit.
+    struct connection_timeouts
+    {
+        using duration = asioex::timer_wheel_service::duration;
+        
+        /// The time allowed between requests while no response is outstanding
+        duration idle = duration::zero();
+        
+        /// The time allowed from the start of a request to the end of its header
+        duration header = duration::zero();
+        
+        /// The interval over which the progress of a request body is measured
+        duration body_interval = duration::zero();
+        
+        /// The minimum rate at which a request body must arrive, averaged over
+        /// each body_interval. Time spent paused by backpressure is not counted
+        /// against the client.
+        std::size_t body_min_bytes_per_sec = 0;
+        
+        /// The time allowed for any one write to the socket to complete
+        duration write = duration::zero();
+    };
     
     struct server_connection
     {
@@ -47,9 +72,72 @@ namespace secr { namespace dispatch { namespace http {
         server_connection(polymorphic_stream stream, asio::io_service& dispatch_io_service);
         
         // wait for the next avaiable dispatch request
+        // @note at most dispatch_window() calls may be outstanding at once
         template<class Handler>
         void async_wait_dispatch(Handler&& handler);
         
+        /// Set the maximum number of async_wait_dispatch calls which may be
+        /// outstanding at the same time. This is the number of requests from
+        /// this connection which may be handled concurrently on the dispatch
+        /// io_service. Responses are always written in request order.
+        /// @pre window > 0
+        /// @note must be called before async_start
+        void set_dispatch_window(std::size_t window) {
+            assert(window > 0);
+            _dispatch_window = window;
+        }
+        
+        std::size_t dispatch_window() const {
+            return _dispatch_window;
+        }
+        
+        /// Bound the amount of request body which may be buffered for a handler.
+        /// When a request's unread body reaches the high watermark the connection
+        /// stops reading from the socket, so that TCP flow control pushes back on
+        /// the client. Reading resumes once the handler has drained the body to
+        /// the low watermark.
+        /// @pre low < high
+        /// @note must be called before async_start
+        void set_request_watermarks(std::size_t high, std::size_t low) {
+            assert(low < high);
+            _request_high_watermark = high;
+            _request_low_watermark = low;
+        }
+        
+        
+        /// Add a Date header to every response which lacks one. Off by default.
+        /// @note must be called before async_start
+        void set_date_header(bool enable) {
+            _date_header = enable;
+        }
+        
+        /// Compress response bodies for clients which accept it. Off by default.
+        /// @note must be called before async_start
+        void set_compression(const compression_options& options) {
+            _compression = options;
+        }
+        
+        /// Give complete responses of known length a strong ETag and answer
+        /// matching conditional requests with 304. Off by default.
+        /// @note must be called before async_start
+        void set_entity_tags(const entity_tag_options& options) {
+            _entity_tags = options;
+        }
+        
+        /// Answer requests from a shared response cache where possible, and
+        /// offer it the responses of cacheable requests. None by default.
+        /// @note must be called before async_start
+        void set_response_cache(std::shared_ptr<http::response_cache> cache) {
+            _response_cache = std::move(cache);
+        }
+        
+        /// Set the timeouts for this connection. All timeouts are disabled by default.
+        /// Timers are managed by the socket io_service's timer_wheel_service.
+        /// Expiry of a timeout is treated as a transport error (timed_out).
+        /// @note must be called before async_start
+        void set_timeouts(const connection_timeouts& timeouts) {
+            _timeouts = timeouts;
+        }
         
         /// Start the server, dispatch all requests, send responses.
         /// Once complete, call the completion handler with the last error
@@ -79,7 +167,7 @@ namespace secr { namespace dispatch { namespace http {
         int handle_message_headers_complete();
         int handle_message_body(const char* begin, std::size_t size);
         void end_of_message_check();
-        void handle_message_fully_read();
+        int handle_message_fully_read();
         
         
         // pause the consumption of data
@@ -89,6 +177,9 @@ namespace secr { namespace dispatch { namespace http {
         void unpause();
         
         bool collect_more_data();
+        
+        /// select a read block which is not pinned by any request
+        void select_read_block();
         void handle_read(const error_code& ec, std::size_t bytes_available);
         
         void handle_transport_error(const error_code& ec);
@@ -101,6 +192,10 @@ namespace secr { namespace dispatch { namespace http {
         /// creates a new receiver
         void new_receiver();
         
+        /// called by a receiver's request stream when the unread body crosses
+        /// one of the watermarks
+        void handle_request_watermark(bool above_high);
+        
         /// aborts a receiver before it gets to the stage where it can be dispatched
         /// @note this will cause an async_dispatch to complete with the given error code
         void receiver_abort(std::exception_ptr exception);
@@ -121,6 +216,56 @@ namespace secr { namespace dispatch { namespace http {
         void attempt_dispatch();
         
         
+        // timeouts
+        
+        /// the phase of reading a request which the read timer is measuring
+        enum class read_phase
+        {
+            idle,
+            header,
+            body
+        };
+        
+        /// (re)start the read timer for the given phase
+        void arm_read_timeout(read_phase phase);
+        void cancel_read_timeout();
+        void handle_read_timeout(std::size_t generation);
+        
+        /// start the write timer. Called as each write to the socket starts
+        void arm_write_timeout();
+        void cancel_write_timeout();
+        void handle_write_timeout(std::size_t generation);
+        
+        /// fail the connection with a timed_out transport error
+        void handle_timeout(const char* phase);
+        
+        /// The stream through which the responder writes to the connection.
+        /// Forwards to the connection's stream, timing each write.
+        struct timed_write_stream
+        {
+            timed_write_stream(server_connection& owner)
+            : _owner(owner)
+            {}
+            
+            asio::io_service& get_io_service() {
+                return _owner._connection.get_io_service();
+            }
+            
+            template<class ConstBufferSequence, class WriteHandler>
+            void async_write_some(ConstBufferSequence&& buffers, WriteHandler&& handler);
+            
+            /// the connection's socket, so that files may be sent with sendfile
+            int native_socket() {
+                return _owner._connection.native_socket();
+            }
+            
+            template<class WaitHandler>
+            void async_wait_writable(WaitHandler&& handler);
+            
+        private:
+            server_connection& _owner;
+        };
+        
         void push_work();
         void pop_work();
         template<class F>
@@ -142,12 +287,41 @@ namespace secr { namespace dispatch { namespace http {
         http_parser* parser() { return std::addressof(_parser); }
         
         polymorphic_stream _connection;
-        std::array<char, 4096> _read_buffer;
+        
+        /// the block into which the next read will happen. Requests hold
+        /// views into the blocks in which their headers arrived, so
+        /// a block may only be reused once no request refers to it.
+        read_block_ptr _read_block;
+        
+        /// blocks previously used by this connection, available for reuse
+        /// once their requests have been destroyed
+        std::vector<read_block_ptr> _spare_read_blocks;
+        static constexpr std::size_t max_spare_read_blocks = 4;
         
         asio::io_service& _io_service { _connection.get_io_service() };
         asio::io_service::strand _strand { _io_service };
         asio::io_service& _dispatch_service;
         
+        /// the source of request contexts, shared by all connections on this io_service
+        request_context_pool& _context_pool { asio::use_service<request_context_pool>(_io_service) };
+        
+        connection_timeouts _timeouts;
+        asioex::wheel_timer _read_timer { _io_service };
+        read_phase _read_phase = read_phase::idle;
+        
+        /// incremented each time the read timer is armed or cancelled, so that
+        /// an expiry which was already in flight can be recognised as stale
+        std::size_t _read_timer_generation = 0;
+        
+        /// body bytes received since the body timer was last armed
+        std::size_t _body_bytes_this_interval = 0;
+        
+        /// the number of request streams which currently have reading paused
+        std::size_t _backpressure_pauses = 0;
+        
+        asioex::wheel_timer _write_timer { _io_service };
+        std::size_t _write_timer_generation = 0;
+        
         http_parser _parser;
         http_parser_settings _parser_settings;
         
@@ -198,8 +372,11 @@ namespace secr { namespace dispatch { namespace http {
             virtual void complete(std::exception_ptr errorr) = 0;
         };
         
-        /// the current oustanding wait_dispatch request
-        std::shared_ptr<dispatch_op> _pending_dispatch;
+        /// the oustanding wait_dispatch requests, in the order in which they were made
+        std::deque<std::shared_ptr<dispatch_op>> _pending_dispatches;
+        
+        /// the maximum size of _pending_dispatches
+        std::size_t _dispatch_window = 1;
         
         /// The operation to execute when the http server has finished all tasks
         std::unique_ptr<server_finished_op> _pending_finished;
@@ -208,6 +385,14 @@ namespace secr { namespace dispatch { namespace http {
         
         std::size_t _pause_count = 1;
         
+        std::size_t _request_high_watermark = 1024 * 1024;
+        std::size_t _request_low_watermark = 256 * 1024;
+        
+        bool _date_header = false;
+        compression_options _compression;
+        entity_tag_options _entity_tags;
+        std::shared_ptr<http::response_cache> _response_cache;
+        
         // the first error collected.
         // if there is an error, the service must stop and no more
         // dispatches may happen
@@ -218,11 +403,10 @@ namespace secr { namespace dispatch { namespace http {
         /// when this number reaches zero, we are eligible for completion
         std::size_t _work_count { 0 };
         
-        responder<polymorphic_stream> _responder { _strand, _connection };
+        timed_write_stream _write_stream { *this };
+        responder<timed_write_stream> _responder { _strand, _write_stream };
         bool _responder_complete = false;
         
-        connection_id _id { connection_id::generate };
-        
     };
     
     // wait for the next avaiable dispatch request
@@ -252,13 +436,12 @@ namespace secr { namespace dispatch { namespace http {
             handler_type _handler;
         };
         
-        assert(!_pending_dispatch);
         _strand.dispatch([this,
                           handler = std::move(handler)]() mutable {
             with_work(this, [this, handler = std::move(handler)]() mutable{
-                assert(!_pending_dispatch);
-                _pending_dispatch = std::make_shared<my_dispatch_op>(_dispatch_service,
-                                                                     std::move(handler));
+                assert(_pending_dispatches.size() < _dispatch_window);
+                _pending_dispatches.push_back(std::make_shared<my_dispatch_op>(_dispatch_service,
+                                                                               std::move(handler)));
                 attempt_dispatch();
             });
         });
@@ -308,12 +491,59 @@ namespace secr { namespace dispatch { namespace http {
                                            
                                            _pending_finished = std::make_unique<finish_handler>(std::move(handler));
                                            
+                                           arm_read_timeout(read_phase::idle);
                                            unpause();
                                        });
                          });
     }
     
+    template<class ConstBufferSequence, class WriteHandler>
+    void server_connection::timed_write_stream::async_write_some(ConstBufferSequence&& buffers,
+                                                                 WriteHandler&& handler)
+    {
+        using handler_type = std::decay_t<WriteHandler>;
+        auto& owner = _owner;
+        
+        if (owner._timeouts.write == connection_timeouts::duration::zero())
+        {
+            owner._connection.async_write_some(std::forward<ConstBufferSequence>(buffers),
+                                               std::forward<WriteHandler>(handler));
+            return;
+        }
+        
+        // the connection is kept alive by the responder, which is waiting on this write
+        owner._strand.dispatch([&owner] { owner.arm_write_timeout(); });
+        owner._connection.async_write_some(std::forward<ConstBufferSequence>(buffers),
+                                           owner._strand.wrap([&owner,
+                                                               handler = handler_type(std::forward<WriteHandler>(handler))]
+                                                              (const error_code& ec, std::size_t size) mutable
+                                                              {
+                                                                  owner.cancel_write_timeout();
+                                                                  handler(ec, size);
+                                                              }));
+    }
     
+    template<class WaitHandler>
+    void server_connection::timed_write_stream::async_wait_writable(WaitHandler&& handler)
+    {
+        using handler_type = std::decay_t<WaitHandler>;
+        auto& owner = _owner;
+        
+        if (owner._timeouts.write == connection_timeouts::duration::zero())
+        {
+            owner._connection.async_wait_writable(std::forward<WaitHandler>(handler));
+            return;
+        }
+        
+        // a peer which stops reading is timed out in the same way as a stalled write
+        owner._strand.dispatch([&owner] { owner.arm_write_timeout(); });
+        owner._connection.async_wait_writable(owner._strand.wrap([&owner,
+                                                                  handler = handler_type(std::forward<WaitHandler>(handler))]
+                                                                 (const error_code& ec) mutable
+                                                                 {
+                                                                     owner.cancel_write_timeout();
+                                                                     handler(ec);
+                                                                 }));
+    }
     
-    
-}}}
\ No newline at end of file
+}}}
@@ -4,11 +4,18 @@
 #include <secr/dispatch/http/identifiers.hpp>
 #include <contrib/http_parser/http_parser.h>
 #include <secr/dispatch/http/request_header.hpp>
+#include <secr/dispatch/http/raw_request_header.hpp>
+#include <secr/dispatch/http/negotiation.hpp>
+#include <secr/dispatch/http/compression.hpp>
+#include <secr/dispatch/http/entity_tag.hpp>
+#include <secr/dispatch/http/response_cache.hpp>
 #include <secr/dispatch/fake_stream.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/log/trivial.hpp>
+#include <chrono>
 #include <mutex>
 #include <memory>
+#include <thread>
 #include <utility>
 
 namespace secr { namespace dispatch { namespace http {
@@ -59,40 +66,131 @@ namespace secr { namespace dispatch { namespace http {
         }
     };
     
+    /// Owns the parsed request header.
+    /// The header is held as views over the connection's read buffers. The
+    /// protobuf representation is only built if somebody asks for it.
     class request_header_manager
     {
         using Arena = ::google::protobuf::Arena;
         
         using mutex_type = std::mutex;
         using lock_type = std::unique_lock<mutex_type>;
-        auto get_lock() { return lock_type(_mutex); }
+        auto get_lock() const { return lock_type(_mutex); }
 
-        unique_arena_ptr<HttpRequestHeader> _header;
+        Arena* _arena;
+        raw_request_header _raw;
         mutable std::mutex _mutex;
+        mutable unique_arena_ptr<HttpRequestHeader> _header = nullptr;
         unique_arena_ptr<ContentType> _content_type = nullptr;
+        std::shared_ptr<const accept_list> _accept;
+        std::shared_ptr<const accept_encoding_list> _accept_encoding;
         
-    public:
+        /// @returns the value of a header, with multiple occurrences joined
+        ///          by commas as RFC 7230 allows for list-valued headers
+        /// @pre the header occurs more than once
+        std::string joined_value(header_id id) const
+        {
+            std::string result;
+            _raw.index().for_each(id, [&result](const raw_header_field& field) {
+                if (not result.empty()) result += ", ";
+                auto v = field.value.view();
+                result.append(v.begin(), v.size());
+            });
+            return result;
+        }
         
-        const HttpRequestHeader& request_header() const {
-            return *_header;
+        template<class Parsed>
+        std::shared_ptr<const Parsed> parse_list_header(header_id id) const
+        {
+            if (_raw.index().count(id) > 1)
+                return Parsed::parse(joined_value(id));
+            return Parsed::parse(_raw.index().value(id));
         }
         
-        HttpRequestHeader& request_header() {
+        /// @pre _mutex is locked
+        HttpRequestHeader& build_header() const
+        {
+            if (not _header) {
+                _header = _header.create(_arena);
+                populate(*_header, _raw);
+            }
             return *_header;
         }
         
+    public:
+        
         request_header_manager(google::protobuf::Arena* arena)
-        : _header(google::protobuf::Arena::CreateMessage<HttpRequestHeader>(arena))
+        : _arena(arena)
+        , _raw(arena)
         {}
         
+        /// @note must only be modified on the connection's strand before the
+        ///       request is dispatched
+        raw_request_header& raw_header() {
+            return _raw;
+        }
+        
+        const raw_request_header& raw_header() const {
+            return _raw;
+        }
+        
+        const HttpRequestHeader& request_header() const {
+            auto lock = get_lock();
+            return build_header();
+        }
+        
+        HttpRequestHeader& request_header() {
+            auto lock = get_lock();
+            return build_header();
+        }
+        
+        /// Forget the current header in preparation for a new request
+        /// @note must be called before the arena is reset
+        void reset()
+        {
+            auto lock = get_lock();
+            _accept.reset();
+            _accept_encoding.reset();
+            _content_type.reset();
+            _header.reset();
+            _raw.clear();
+        }
+        
         const ContentType& content_type() {
             auto lock = get_lock();
             if (not _content_type) {
-                _content_type = _content_type.create(_header->GetArena());
-                populate(*_content_type, *_header);
+                auto& index = _raw.index();
+                if (index.count(header_id::content_type) > 1)
+                    throw std::runtime_error("duplicate header");
+                _content_type = _content_type.create(_arena);
+                if (auto field = index.find(header_id::content_type))
+                    populate(*_content_type, field->value.view());
             }
             return *_content_type;
         }
+        
+        /// The parsed Accept header, parsed on first use
+        const accept_list& accept() {
+            auto lock = get_lock();
+            if (not _accept)
+                _accept = parse_list_header<accept_list>(header_id::accept);
+            return *_accept;
+        }
+        
+        /// The parsed Accept-Encoding header, parsed on first use. A request
+        /// without one accepts any coding (RFC 9110 section 12.5.3), as if
+        /// it had sent "*".
+        const accept_encoding_list& accept_encoding() {
+            auto lock = get_lock();
+            if (not _accept_encoding)
+            {
+                if (_raw.index().count(header_id::accept_encoding))
+                    _accept_encoding = parse_list_header<accept_encoding_list>(header_id::accept_encoding);
+                else
+                    _accept_encoding = accept_encoding_list::parse("*");
+            }
+            return *_accept_encoding;
+        }
     };
     
     struct request_context
@@ -103,29 +201,109 @@ namespace secr { namespace dispatch { namespace http {
         ///        back to the controller will fire.
         /// @param dispatcher_service is the service on which all requests will
         ///        be dispatched
+        /// @param initial_block_size is the size of the block which the arena
+        ///        owns for its lifetime. Requests which fit in this block cause
+        ///        no arena allocations, provided that they allocate from one
+        ///        thread: the block serves only the first thread to allocate
+        ///        from the arena, and allocations made on other threads (such
+        ///        as by concurrent batch calls) take blocks from the heap.
         ///
         request_context(connection_id conn_id,
                         asio::io_service& controller_service,
-                        asio::io_service& dispatcher_service);
+                        asio::io_service& dispatcher_service,
+                        std::size_t initial_block_size = 0);
+        
+        /// Prepare this object for a new request. The header, the streams'
+        /// contents and all arena memory except the initial block are released
+        /// and a new request id is generated.
+        /// @pre nobody else refers to this object and no operations are
+        ///      outstanding on its streams
+        void reset();
+        
+        void set_connection_id(connection_id conn_id) { _connection_id = std::move(conn_id); }
+        
+        /// @returns the total number of arena blocks allocated by all request
+        ///          contexts in this process
+        static std::size_t arena_block_allocations();
+        
+        std::size_t initial_block_size() const { return _initial_block_size; }
+        std::size_t arena_space_allocated() const { return _arena.SpaceAllocated(); }
         
-        void append_uri(const char* begin, std::size_t size);
+        /// @returns the arena space which the owner of the initial block used
+        ///          for the request before the last reset(): the initial block
+        ///          and any blocks which that thread added to it. Blocks which
+        ///          other threads allocated for their own use are not counted.
+        std::size_t owner_space_allocated() const { return _owner_space_allocated; }
         
-        void append_header_field(const char* begin,
+        /// The header is not copied. The request pins the read block in which
+        /// the data lies.
+        void append_uri(const read_block_ptr& block,
+                        const char* begin, std::size_t size);
+        
+        void append_header_field(const read_block_ptr& block,
+                                 const char* begin,
                                  std::size_t size);
-        void append_header_value(const char* begin,
+        void append_header_value(const read_block_ptr& block,
+                                 const char* begin,
                                  std::size_t size);
         
         void consume_body(const char* begin,
                                  std::size_t size);
         void notify_eof();
         
+        // statistics for the access log
+        
+        using clock_type = std::chrono::steady_clock;
+        
+        /// the time at which the first byte of the request arrived
+        clock_type::time_point started() const { return _started; }
+        
+        /// the time at which the request header was complete
+        clock_type::time_point header_completed() const { return _header_completed; }
+        
+        /// Record that the first byte of a request has arrived. A pooled
+        /// context is stamped as it is acquired, so that the time it spent
+        /// idle in the pool is not counted.
+        void mark_started() { _started = _header_completed = clock_type::now(); }
+        
+        std::size_t bytes_received() const { return _bytes_received; }
+        std::size_t bytes_sent() const { return _bytes_sent; }
+        
+        /// record bytes of the response written to the client
+        /// @note called by the responder
+        void add_bytes_sent(std::size_t bytes) { _bytes_sent += bytes; }
+        
+        /// @returns the response status code, or 0 if none has been set
+        int response_status() const {
+            return _response_header->has_status() ? _response_header->status().code() : 0;
+        }
+        
         void finalise_header(http_parser* parser);
+        
+        /// If set, a Date header is added to responses which lack one.
+        /// The setting survives reset().
+        void set_date_header(bool enable) { _date_header = enable; }
+        bool date_header() const { return _date_header; }
+        
+        /// How the response body may be compressed. The setting survives reset().
+        void set_compression(const compression_options& options) { _compression = options; }
+        const compression_options& compression() const { return _compression; }
+        
+        /// How responses are given entity tags. The setting survives reset().
+        void set_entity_tags(const entity_tag_options& options) { _entity_tags = options; }
+        const entity_tag_options& entity_tags() const { return _entity_tags; }
+
+        /// The cache which complete responses are offered to, if any.
+        /// The setting survives reset().
+        void set_response_cache(std::shared_ptr<http::response_cache> cache) { _response_cache = std::move(cache); }
+        const std::shared_ptr<http::response_cache>& response_cache() const { return _response_cache; }
 
         Arena* arena() { return std::addressof(_arena); }
         
         
         const HttpRequestHeader& request_header() { return _request_manager.request_header(); }
         HttpRequestHeader& mutable_request_header() { return _request_manager.request_header(); }
+        const raw_request_header& raw_header() const { return _request_manager.raw_header(); }
         request_header_manager& request_manager() { return _request_manager; }
         fake_stream& request_stream() { return _request_stream; }
 
@@ -140,30 +318,37 @@ namespace secr { namespace dispatch { namespace http {
         
         bool must_force_close_on_response() const
         {
-            auto first_header = std::begin(_response_header->headers());
-            auto last_header = std::end(_response_header->headers());
-            auto iconnection = std::find_if(first_header,
-                                            last_header,
-                                            match_header_name("Connection"));
-            if (iconnection == last_header)
+            // one pass over the response headers
+            const Header* connection = nullptr;
+            const Header* content_length = nullptr;
+            const Header* transfer_encoding = nullptr;
+            for (auto& header : _response_header->headers())
+            {
+                auto& name = header.name();
+                if (not connection and is_header(name, header_id::connection))
+                    connection = std::addressof(header);
+                else if (not content_length and is_header(name, header_id::content_length))
+                    content_length = std::addressof(header);
+                else if (not transfer_encoding and is_header(name, header_id::transfer_encoding))
+                    transfer_encoding = std::addressof(header);
+            }
+            
+            if (not connection)
                 return true;
             
-            if (boost::iequals(iconnection->value(), "close"))
+            if (iequals_ascii(connection->value(), "close"))
                 return true;
             
-            if (boost::iequals(iconnection->value(), "keep-alive"))
+            if (iequals_ascii(connection->value(), "keep-alive"))
                 return false;
-            auto icontent_length = std::find_if(first_header, last_header,
-                                                match_header_name("Content-Length"));
-            if (icontent_length != last_header)
+            
+            if (content_length)
                 return false;
             
-            auto iTE = std::find_if(first_header, last_header,
-                                    match_header_name("Transfer-Encoding"));
-            if (iTE == last_header)
+            if (not transfer_encoding)
                 return true;
             
-            if (boost::iequals(iTE->value(), "chunked"))
+            if (iequals_ascii(transfer_encoding->value(), "chunked"))
                 return false;
             
             return true;
@@ -174,15 +359,17 @@ namespace secr { namespace dispatch { namespace http {
         asio::io_service& _controller_service;
         asio::io_service& _dispatcher_service;
 
+        std::size_t _initial_block_size;
+        std::unique_ptr<char[]> _initial_block;
         Arena _arena;
         
+        /// the thread which owns the arena's initial block
+        std::thread::id _arena_owner;
+        std::size_t _owner_space_allocated = 0;
+        
         request_header_manager _request_manager { std::addressof(_arena) };
         arena_ptr<HttpResponseHeader> _response_header;
         
-        Header * _current_header_object = nullptr;
-        std::string* _current_hdr_name = nullptr;
-        std::string* _current_hdr_value = nullptr;
-        
         /// fake streams
         
         /// The stream which the execution context will see as the 'read' stream
@@ -194,7 +381,16 @@ namespace secr { namespace dispatch { namespace http {
         
         request_id _id { request_id::generate };
         connection_id _connection_id;
-
+        
+        clock_type::time_point _started = clock_type::now();
+        clock_type::time_point _header_completed = _started;
+        std::size_t _bytes_received = 0;
+        std::size_t _bytes_sent = 0;
+        
+        bool _date_header = false;
+        compression_options _compression;
+        entity_tag_options _entity_tags;
+        std::shared_ptr<http::response_cache> _response_cache;
 
     };
     
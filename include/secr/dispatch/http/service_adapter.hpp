@@ -0,0 +1,184 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+#include <secr/dispatch/http/dispatcher.hpp>
+#include <secr/dispatch/http/router.hpp>
+
+#include <google/protobuf/message.h>
+#include <google/protobuf/service.h>
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// The media type of the binary protobuf encoding
+    extern const char protobuf_media_type[];
+
+    /// The controller handed to a method called over HTTP. A method may
+    /// downcast its RpcController to this to see the request.
+    /// Calls cannot be cancelled.
+    class rpc_controller : public google::protobuf::RpcController
+    {
+    public:
+        explicit rpc_controller(dispatch_context context)
+        : _context(std::move(context))
+        {}
+
+        ~rpc_controller();
+
+        /// The request being served
+        dispatch_context& context() { return _context; }
+
+        // google::protobuf::RpcController
+
+        void Reset() override;
+        bool Failed() const override { return _failed; }
+        std::string ErrorText() const override { return _error_text; }
+        void StartCancel() override {}
+        void SetFailed(const std::string& reason) override;
+        bool IsCanceled() const override { return false; }
+
+        /// The callback is called when the call completes, since it is
+        /// never cancelled
+        void NotifyOnCancel(google::protobuf::Closure* callback) override;
+
+        /// Run the callback registered with NotifyOnCancel, if any
+        void notify_complete();
+
+    private:
+        dispatch_context _context;
+        bool _failed = false;
+        std::string _error_text;
+        google::protobuf::Closure* _on_cancel = nullptr;
+    };
+
+    struct service_options
+    {
+        /// The largest request body accepted. A larger one receives a 413.
+        std::size_t max_request_size = 4 * 1024 * 1024;
+
+        /// The most calls one batch may contain. A larger batch receives a
+        /// 400 before any of its calls is made. @see add_batch_endpoint
+        std::size_t max_batch_calls = 1000;
+    };
+
+    /// How a call reaches one method of a service. add_service binds each
+    /// method through the service's descriptor. The dispatch tables which
+    /// protoc-gen-secr_dispatch generates bind them statically (see
+    /// service_table.hpp).
+    class method_binding
+    {
+    public:
+        virtual ~method_binding() = default;
+
+        /// The full name of the method, for diagnostics
+        virtual const std::string& full_name() const = 0;
+
+        /// @returns a new request or response message owned by the arena
+        virtual google::protobuf::Message* new_request(google::protobuf::Arena* arena) const = 0;
+        virtual google::protobuf::Message* new_response(google::protobuf::Arena* arena) const = 0;
+
+        /// The binary codec
+        virtual bool parse(google::protobuf::Message& request, const char* data, std::size_t size) const = 0;
+        virtual bool serialise(const google::protobuf::Message& response, std::string& out) const = 0;
+
+        /// Check a parsed request before the method is called
+        /// @returns an empty string, or why the request is refused. A refused
+        ///          request receives a 400.
+        virtual std::string refuse(const google::protobuf::Message&) const { return std::string(); }
+
+        /// Call the method. done is run when it completes.
+        virtual void call(rpc_controller& controller,
+                          const google::protobuf::Message* request,
+                          google::protobuf::Message* response,
+                          google::protobuf::Closure* done) const = 0;
+    };
+
+    /// One call of a method_binding, as made by serve_call and by each call of
+    /// a batch. It allocates the request and response in the request's
+    /// arena, calls the method and, as the method's done closure, hands the
+    /// outcome to the derived class. The call owns itself from the moment
+    /// the method is called until it completes.
+    class method_call
+    : public google::protobuf::Closure
+    , public std::enable_shared_from_this<method_call>
+    {
+    public:
+        method_call(dispatch_context context, std::shared_ptr<const method_binding> method)
+        : _controller(std::move(context))
+        , _method(std::move(method))
+        {}
+
+        /// the method's done closure
+        void Run() final;
+
+    protected:
+        /// Allocate the request and response messages
+        /// @pre there is a method
+        void create_messages();
+
+        /// Call the method with the request
+        /// @pre create_messages() has been called
+        void call_method();
+
+        /// The method has run its done closure. Any exception is passed to
+        /// failed().
+        virtual void completed() = 0;
+
+        /// The method threw before completing, or completed() threw
+        virtual void failed(std::exception_ptr ep) = 0;
+
+        rpc_controller& controller() { return _controller; }
+        dispatch_context& context() { return _controller.context(); }
+        bool has_method() const { return bool(_method); }
+        const method_binding& method() const { return *_method; }
+
+        /// allocated in the request's arena, which the context keeps alive
+        google::protobuf::Message& request() { return *_request; }
+        google::protobuf::Message& response() { return *_response; }
+
+    private:
+        rpc_controller _controller;
+        std::shared_ptr<const method_binding> _method;
+        google::protobuf::Message* _request = nullptr;
+        google::protobuf::Message* _response = nullptr;
+        std::shared_ptr<method_call> _self;
+
+        /// set by the done closure, which may run on another thread while
+        /// the method is still unwinding
+        std::atomic<bool> _completed { false };
+    };
+
+    /// Bind a method of a service through its descriptor
+    std::shared_ptr<const method_binding>
+    bind_method(std::shared_ptr<google::protobuf::Service> service,
+                const google::protobuf::MethodDescriptor* method);
+
+    /// Serve one call of a method: read the request body, call the method
+    /// and send its response, as described for add_service.
+    /// A null method receives a 404.
+    void serve_call(dispatch_context context,
+                    std::shared_ptr<const method_binding> method,
+                    const service_options& options);
+
+    /// Route POST /<package.Service>/<Method> to CallMethod of the service,
+    /// for each of its methods.
+    ///
+    /// The request and response messages are allocated in the request's
+    /// arena. A request whose Content-Type is application/x-protobuf is
+    /// parsed as binary, anything else as JSON. The response is encoded as
+    /// the client's Accept header prefers, or as the request was if it
+    /// expresses no preference.
+    ///
+    /// A request which cannot be parsed receives a 400. A method which
+    /// fails its controller, or throws before it completes, produces a 500
+    /// with the error as an api::Exception.
+    /// @note a method which throws must not run its done closure afterwards
+    void add_service(router& r,
+                     std::shared_ptr<google::protobuf::Service> service,
+                     const service_options& options = service_options());
+
+}}}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <secr/dispatch/http/method_hash.hpp>
+#include <secr/dispatch/http/service_adapter.hpp>
+
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#include <array>
+#include <memory>
+#include <string>
+
+namespace secr { namespace dispatch { namespace http {
+
+    /// A method bound at compile time: messages are created by type and
+    /// the service's member function is called directly, without
+    /// CallMethod or any descriptor lookup.
+    template<class Service, class Request, class Response>
+    class static_method_binding final : public method_binding
+    {
+    public:
+        using member_type = void (Service::*)(google::protobuf::RpcController*,
+                                              const Request*,
+                                              Response*,
+                                              google::protobuf::Closure*);
+
+        static_method_binding(std::shared_ptr<Service> service,
+                              std::string full_name,
+                              member_type member)
+        : _service(std::move(service))
+        , _full_name(std::move(full_name))
+        , _member(member)
+        {}
+
+        const std::string& full_name() const override { return _full_name; }
+
+        google::protobuf::Message* new_request(google::protobuf::Arena* arena) const override
+        {
+            return google::protobuf::Arena::CreateMessage<Request>(arena);
+        }
+
+        google::protobuf::Message* new_response(google::protobuf::Arena* arena) const override
+        {
+            return google::protobuf::Arena::CreateMessage<Response>(arena);
+        }
+
+        bool parse(google::protobuf::Message& request, const char* data, std::size_t size) const override
+        {
+            google::protobuf::io::ArrayInputStream in(data, int(size));
+            return static_cast<Request&>(request).ParseFromZeroCopyStream(std::addressof(in));
+        }
+
+        bool serialise(const google::protobuf::Message& response, std::string& out) const override
+        {
+            google::protobuf::io::StringOutputStream stream(std::addressof(out));
+            return static_cast<const Response&>(response).SerializeToZeroCopyStream(std::addressof(stream));
+        }
+
+        void call(rpc_controller& controller,
+                  const google::protobuf::Message* request,
+                  google::protobuf::Message* response,
+                  google::protobuf::Closure* done) const override
+        {
+            ((*_service).*_member)(std::addressof(controller),
+                                   static_cast<const Request*>(request),
+                                   static_cast<Response*>(response),
+                                   done);
+        }
+
+    private:
+        std::shared_ptr<Service> _service;
+        std::string _full_name;
+        member_type _member;
+    };
+
+    /// Bind a member function of a generated service class
+    template<class Service, class Request, class Response>
+    std::shared_ptr<const method_binding>
+    bind_method(std::shared_ptr<Service> service, std::string full_name,
+                void (Service::*member)(google::protobuf::RpcController*,
+                                        const Request*,
+                                        Response*,
+                                        google::protobuf::Closure*))
+    {
+        return std::make_shared<const static_method_binding<Service, Request, Response>>
+        (std::move(service), std::move(full_name), member);
+    }
+
+    /// Route POST /<package.Service>/{method} to the methods of a service
+    /// through a dispatch table generated by protoc-gen-secr_dispatch. The
+    /// calls behave as they do through add_service, but the method is found
+    /// by perfect hash and called without reflection. JSON requests and
+    /// responses still go through protobuf's reflection-based converter.
+    ///
+    /// Table is generated as:
+    ///     struct <Service>_dispatch_table
+    ///     {
+    ///         using service_type = <Service>;
+    ///         static constexpr const char* service_name;
+    ///         static constexpr std::size_t method_count;
+    ///
+    ///         /// @returns the index of the named method or -1
+    ///         static int find(string_view method_name);
+    ///
+    ///         /// @returns a binding of the index'th method
+    ///         static std::shared_ptr<const method_binding>
+    ///         bind(const std::shared_ptr<service_type>&, int index);
+    ///     };
+    template<class Table>
+    void add_service_table(router& r,
+                           std::shared_ptr<typename Table::service_type> service,
+                           const service_options& options = service_options())
+    {
+        std::array<std::shared_ptr<const method_binding>, Table::method_count> methods;
+        for (std::size_t i = 0 ; i < methods.size() ; ++i)
+            methods[i] = Table::bind(service, int(i));
+
+        r.add("POST", "/" + std::string(Table::service_name) + "/{method}",
+              [methods, options](dispatch_context context, const route_parameters& parameters)
+              {
+                  auto index = Table::find(parameters[0]);
+                  serve_call(std::move(context),
+                             index < 0 ? nullptr : methods[std::size_t(index)],
+                             options);
+              });
+    }
+
+}}}
@@ -11,6 +11,7 @@ namespace secr { namespace dispatch {
         using write_handler_function = std::function<void(const error_code& ec, std::size_t bytes_transferred)>;
         using read_handler_function = std::function<void(const error_code& ec, std::size_t bytes_transferred)>;
         using completion_handler_function = std::function<void()>;
+        using wait_handler_function = std::function<void(const error_code& ec)>;
         
         struct io_completion_handler {
             virtual void run(const error_code& ec, std::size_t) = 0;
@@ -29,6 +30,11 @@ namespace secr { namespace dispatch {
 
             virtual asio::io_service& get_io_service() = 0;
             
+            /// the socket in non-blocking mode if the stream writes to it
+            /// unchanged, otherwise -1
+            virtual int native_socket() = 0;
+            virtual void async_wait_writable(wait_handler_function&&) = 0;
+            
             virtual ~concept() = default;
         };
         using concept_ptr_type = std::unique_ptr<concept>;
@@ -81,9 +87,52 @@ namespace secr { namespace dispatch {
                 return _stream_wrapper.get().lowest_layer().cancel(ec);
             }
             
+            int native_socket() override
+            {
+                using is_plain_socket = std::is_base_of<typename stream_type::lowest_layer_type, stream_type>;
+                return native_socket(is_plain_socket());
+            }
+            
+            void async_wait_writable(wait_handler_function&& handler) override
+            {
+                using is_plain_socket = std::is_base_of<typename stream_type::lowest_layer_type, stream_type>;
+                async_wait_writable(std::move(handler), is_plain_socket());
+            }
             
             stream_type& stream() { return _stream_wrapper.get(); }
             
+        private:
+            int native_socket(std::true_type)
+            {
+                auto& socket = _stream_wrapper.get().lowest_layer();
+                error_code ec;
+                socket.native_non_blocking(true, ec);
+                return ec ? -1 : int(socket.native_handle());
+            }
+            
+            int native_socket(std::false_type)
+            {
+                return -1;
+            }
+            
+            void async_wait_writable(wait_handler_function&& handler, std::true_type)
+            {
+                stream().async_write_some(asio::null_buffers(),
+                                          [handler = std::move(handler)]
+                                          (auto& ec, auto) {
+                                              handler(ec);
+                                          });
+            }
+            
+            void async_wait_writable(wait_handler_function&& handler, std::false_type)
+            {
+                get_io_service().post([handler = std::move(handler)] {
+                    handler(asio::error::basic_errors::operation_not_supported);
+                });
+            }
+            
+        public:
+            
             wrapper_type _stream_wrapper;
         };
         
@@ -175,7 +224,8 @@ namespace secr { namespace dispatch {
                         _handler(ec, _total_written);
                     }
                     else {
-                        if (asio::buffer_size(_partial_buffer)) {
+                        // move on to the next buffer once this one is written
+                        if (asio::buffer_size(_partial_buffer) == 0) {
                             _partial_buffer = *_first;
                         }
                         _impl->async_write_some(asio::const_buffers_1(_partial_buffer),
@@ -241,6 +291,19 @@ namespace secr { namespace dispatch {
             return _impl->get_io_service();
         }
         
+        /// @returns the underlying socket, in non-blocking mode, if data written
+        ///          to this stream goes to it unchanged. Otherwise -1.
+        int native_socket() {
+            return _impl->native_socket();
+        }
+        
+        /// Call handler once the underlying socket can accept more data
+        template<class WaitHandler>
+        void async_wait_writable(WaitHandler&& handler)
+        {
+            _impl->async_wait_writable(wait_handler_function(std::forward<WaitHandler>(handler)));
+        }
+        
     private:
         concept_ptr_type _impl;
     };
@@ -0,0 +1,492 @@
+#pragma once
+
+#include <secr/dispatch/config.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace secr { namespace dispatch {
+
+    /// A pseudo stream like fake_stream, for exactly one writer and one
+    /// reader, built on a bounded byte ring. The ring's head and tail are
+    /// atomic and lie on cache lines of their own, so writes and reads take
+    /// no lock.
+    /// @note   It models:
+    ///         AsyncReadStream
+    ///         AsyncWriteStream
+    ///         SyncReadStream
+    ///         SyncWriteStream
+    /// plus has the following methods:
+    ///     set_error()
+    ///     cancel()
+    ///     close()
+    ///
+    /// Unlike fake_stream it holds no more than its capacity. A writer which
+    /// finds the ring full waits (or, writing asynchronously, is completed
+    /// later) until the reader makes room, so the reader and writer must not
+    /// share a single thread. There are no attachments or watermarks.
+    ///
+    /// A reader waiting for data is woken only by the write which takes the
+    /// ring from empty to non-empty, and a writer waiting for room only by
+    /// the read which takes it from full to not full; there is no other
+    /// contention between the two. A blocking call yields a few times before
+    /// it blocks, which is often enough for the other side to catch up.
+    ///
+    /// No production path uses it. Request and response bodies need
+    /// fake_stream's attachments, so that files and cached bodies are sent
+    /// without copying, and its watermarks, which apply backpressure to the
+    /// socket reader. This class exists to measure what those features cost
+    /// the copying path (see the fake_stream benchmark in the tests). It is
+    /// also a drop-in stream for a producer and consumer which need neither.
+    class spsc_fake_stream
+    {
+        static constexpr std::size_t cache_line_size = 64;
+        static constexpr int spin_limit = 16;
+
+        /// An operation waiting for the other side of the ring
+        struct waiter
+        {
+            /// Called once, from any thread. An empty ec means the
+            /// operation should try again.
+            virtual void wake(const error_code& ec) = 0;
+
+        protected:
+            ~waiter() = default;
+        };
+
+        /// A blocked read_some or write_some
+        struct sync_waiter : waiter
+        {
+            void wake(const error_code& ec) override
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _woken = true;
+                _error_code = ec;
+                _cv.notify_one();
+            }
+
+            error_code wait()
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this] { return _woken; });
+                return _error_code;
+            }
+
+        private:
+            std::mutex _mutex;
+            std::condition_variable _cv;
+            bool _woken = false;
+            error_code _error_code;
+        };
+
+        template<class MutableBufferSequence, class Handler>
+        struct async_read_op;
+        template<class ConstBufferSequence, class Handler>
+        struct async_write_op;
+
+    public:
+        static constexpr std::size_t default_capacity = 64 * 1024;
+
+        /// Construct a stream.
+        /// @param  read_io_service is the io_service on which async_read operations
+        ///         will complete.
+        /// @param  write_io_service is the io_service on which async_write operations
+        ///         will complete
+        /// @param  capacity is rounded up to a power of two
+        spsc_fake_stream(asio::io_service& read_io_service,
+                         asio::io_service& write_io_service,
+                         std::size_t capacity = default_capacity);
+
+        /// @pre no operation is in progress other than one which cancel()
+        ///      completes
+        ~spsc_fake_stream() noexcept {
+            cancel();
+        }
+
+        spsc_fake_stream(const spsc_fake_stream&) = delete;
+        spsc_fake_stream& operator=(const spsc_fake_stream&) = delete;
+
+        std::size_t capacity() const { return _mask + 1; }
+
+        /// Mark the stream as in error. The reader receives the data already
+        /// written before it sees the error; further writes fail at once.
+        /// The first error set is the one reported.
+        /// @pre ec *must not* be empty or equivalent to error_code()
+        void set_error(error_code ec);
+
+        /// `Closes` the fake socket
+        void close()
+        {
+            set_error(asio::error::misc_errors::eof);
+        }
+
+        /// Complete a waiting read or write with operation_aborted
+        /// @note cancels blocked synchronous calls too
+        void cancel() noexcept;
+
+        // SyncWriteStream
+
+        /// Copy as much of the data as fits into the ring, waiting for the
+        /// reader to make room if there is none.
+        template<class ConstBufferSequence>
+        std::size_t write_some(const ConstBufferSequence& buffers, error_code& ec)
+        {
+            ec = error_code();
+            if (asio::buffer_size(buffers) == 0)
+                return 0;
+            while (true)
+            {
+                auto written = produce(buffers, ec);
+                if (written or ec)
+                    return written;
+                if (spin_until([this] { return writable(); }))
+                    continue;
+                sync_waiter w;
+                park(_writer, w, [this] { return writable(); });
+                if ((ec = w.wait()))
+                    return 0;
+            }
+        }
+
+        template<class ConstBufferSequence>
+        std::size_t write_some(const ConstBufferSequence& buffers)
+        {
+            error_code ec;
+            auto s = write_some(buffers, ec);
+            if (ec) throw system_error(ec);
+            return s;
+        }
+
+        // AsyncWriteStream
+
+        asio::io_service& get_write_io_service() { return _write_io_service; }
+
+        template<class ConstBufferSequence, class Handler>
+        void async_write_some(const ConstBufferSequence& buffers, Handler&& handler);
+
+        // SyncReadStream
+
+        /// Copy out whatever data is in the ring, waiting for some if there
+        /// is none.
+        template<class MutableBufferSequence>
+        std::size_t read_some(const MutableBufferSequence& buffers, error_code& ec)
+        {
+            ec = error_code();
+            if (asio::buffer_size(buffers) == 0)
+                return 0;
+            while (true)
+            {
+                auto read = consume(buffers, ec);
+                if (read or ec)
+                    return read;
+                if (spin_until([this] { return readable(); }))
+                    continue;
+                sync_waiter w;
+                park(_reader, w, [this] { return readable(); });
+                if ((ec = w.wait()))
+                    return 0;
+            }
+        }
+
+        template<class MutableBufferSequence>
+        std::size_t read_some(const MutableBufferSequence& buffers)
+        {
+            error_code ec;
+            auto s = read_some(buffers, ec);
+            if (ec) throw system_error(ec);
+            return s;
+        }
+
+        // AsyncReadStream
+
+        asio::io_service& get_read_io_service() { return _read_io_service; }
+
+        template<class MutableBufferSequence, class Handler>
+        void async_read_some(const MutableBufferSequence& buffers, Handler&& handler);
+
+    private:
+        bool failed() const { return _failed.load(std::memory_order_acquire); }
+
+        /// @returns true if a read would not wait
+        bool readable() const
+        {
+            return _head.load() != _tail.load(std::memory_order_relaxed) or failed();
+        }
+
+        /// @returns true if a write would not wait
+        bool writable() const
+        {
+            return _head.load(std::memory_order_relaxed) - _tail.load() != capacity() or failed();
+        }
+
+        /// Offer w to the other side, unless what it waits for has already
+        /// happened. Storing w before checking, as the other side publishes
+        /// its position before looking for a waiter, means one of the two
+        /// always sees the other.
+        template<class Ready>
+        void park(std::atomic<waiter*>& slot, waiter& w, Ready&& ready)
+        {
+            assert(not slot.load(std::memory_order_relaxed));
+            slot.store(std::addressof(w));
+            if (ready())
+                wake(slot, error_code());
+        }
+
+        /// Give the other side a moment to catch up before blocking
+        /// @returns true if ready() became true
+        template<class Ready>
+        static bool spin_until(Ready&& ready)
+        {
+            for (int i = 0 ; i < spin_limit ; ++i)
+            {
+                if (ready())
+                    return true;
+                std::this_thread::yield();
+            }
+            return false;
+        }
+
+        static void wake(std::atomic<waiter*>& slot, const error_code& ec)
+        {
+            if (auto w = slot.exchange(nullptr))
+                w->wake(ec);
+        }
+
+        /// writer side: copy what fits and publish it
+        template<class ConstBufferSequence>
+        std::size_t produce(const ConstBufferSequence& buffers, error_code& ec)
+        {
+            if (failed())
+            {
+                ec = _error_code;
+                return 0;
+            }
+
+            auto head = _head.load(std::memory_order_relaxed);
+            if (head - _cached_tail == capacity())
+            {
+                _cached_tail = _tail.load(std::memory_order_acquire);
+                if (head - _cached_tail == capacity())
+                    return 0;
+            }
+            auto space = capacity() - (head - _cached_tail);
+
+            std::size_t written = 0;
+            for (auto first = buffers.begin() ; first != buffers.end() and written < space ; ++first)
+            {
+                asio::const_buffer buffer(*first);
+                auto data = asio::buffer_cast<const char*>(buffer);
+                auto size = std::min(asio::buffer_size(buffer), space - written);
+                while (size)
+                {
+                    auto offset = (head + written) & _mask;
+                    auto n = std::min(size, capacity() - offset);
+                    std::memcpy(_data.get() + offset, data, n);
+                    data += n;
+                    size -= n;
+                    written += n;
+                }
+            }
+
+            _head.store(head + written);
+            wake_if_waiting(_reader);
+            return written;
+        }
+
+        /// reader side: copy out what there is and release the room
+        template<class MutableBufferSequence>
+        std::size_t consume(const MutableBufferSequence& buffers, error_code& ec)
+        {
+            auto tail = _tail.load(std::memory_order_relaxed);
+            if (_cached_head == tail)
+            {
+                _cached_head = _head.load(std::memory_order_acquire);
+                if (_cached_head == tail)
+                {
+                    if (not failed())
+                        return 0;
+                    // data written before the error was set must not be lost
+                    _cached_head = _head.load(std::memory_order_acquire);
+                    if (_cached_head == tail)
+                    {
+                        ec = _error_code;
+                        return 0;
+                    }
+                }
+            }
+            auto available = _cached_head - tail;
+
+            std::size_t read = 0;
+            for (auto first = buffers.begin() ; first != buffers.end() and read < available ; ++first)
+            {
+                asio::mutable_buffer buffer(*first);
+                auto data = asio::buffer_cast<char*>(buffer);
+                auto size = std::min(asio::buffer_size(buffer), available - read);
+                while (size)
+                {
+                    auto offset = (tail + read) & _mask;
+                    auto n = std::min(size, capacity() - offset);
+                    std::memcpy(data, _data.get() + offset, n);
+                    data += n;
+                    size -= n;
+                    read += n;
+                }
+            }
+
+            _tail.store(tail + read);
+            wake_if_waiting(_writer);
+            return read;
+        }
+
+        /// a waiter is rare, so the slot stays in the other side's cache
+        /// and looking at it costs little
+        static void wake_if_waiting(std::atomic<waiter*>& slot)
+        {
+            if (slot.load())
+                wake(slot, error_code());
+        }
+
+    private:
+        asio::io_service& _read_io_service; ///! The io_service on which reads will complete
+        asio::io_service& _write_io_service; ///! The io_service on which write will complete
+        std::unique_ptr<char[]> _data;
+        std::size_t _mask;
+
+        char _pad0[cache_line_size];
+
+        /// written by the writer only
+        std::atomic<std::size_t> _head { 0 };
+        /// the writer's last sight of _tail
+        std::size_t _cached_tail = 0;
+
+        char _pad1[cache_line_size];
+
+        /// written by the reader only
+        std::atomic<std::size_t> _tail { 0 };
+        /// the reader's last sight of _head
+        std::size_t _cached_head = 0;
+
+        char _pad2[cache_line_size];
+
+        std::atomic<waiter*> _reader { nullptr };
+        std::atomic<waiter*> _writer { nullptr };
+        std::atomic<bool> _error_claimed { false };
+        std::atomic<bool> _failed { false };
+        error_code _error_code;
+    };
+
+    /// A waiting async_read_some. Once woken it owns itself and tries again
+    /// on the read io_service.
+    template<class MutableBufferSequence, class Handler>
+    struct spsc_fake_stream::async_read_op final : spsc_fake_stream::waiter
+    {
+        async_read_op(spsc_fake_stream& stream, MutableBufferSequence buffers, Handler handler)
+        : _stream(stream)
+        , _buffers(std::move(buffers))
+        , _handler(std::move(handler))
+        {}
+
+        void wake(const error_code& ec) override
+        {
+            _stream._read_io_service.post([self = std::shared_ptr<async_read_op>(this), ec]
+                                          {
+                                              self->resume(ec);
+                                          });
+        }
+
+        void resume(const error_code& ec)
+        {
+            if (ec)
+                return _handler(ec, std::size_t(0));
+            _stream.async_read_some(_buffers, std::move(_handler));
+        }
+
+        spsc_fake_stream& _stream;
+        MutableBufferSequence _buffers;
+        Handler _handler;
+    };
+
+    template<class MutableBufferSequence, class Handler>
+    void spsc_fake_stream::async_read_some(const MutableBufferSequence& buffers, Handler&& handler)
+    {
+        using handler_type = std::decay_t<Handler>;
+
+        error_code ec;
+        std::size_t read = 0;
+        if (asio::buffer_size(buffers))
+            read = consume(buffers, ec);
+        if (read or ec or asio::buffer_size(buffers) == 0)
+        {
+            _read_io_service.post([handler = handler_type(std::forward<Handler>(handler)), ec, read]() mutable
+                                  {
+                                      handler(ec, read);
+                                  });
+            return;
+        }
+
+        using op_type = async_read_op<MutableBufferSequence, handler_type>;
+        auto op = new op_type(*this, buffers, handler_type(std::forward<Handler>(handler)));
+        park(_reader, *op, [this] { return readable(); });
+    }
+
+    /// A waiting async_write_some. Once woken it owns itself and tries again
+    /// on the write io_service.
+    template<class ConstBufferSequence, class Handler>
+    struct spsc_fake_stream::async_write_op final : spsc_fake_stream::waiter
+    {
+        async_write_op(spsc_fake_stream& stream, ConstBufferSequence buffers, Handler handler)
+        : _stream(stream)
+        , _buffers(std::move(buffers))
+        , _handler(std::move(handler))
+        {}
+
+        void wake(const error_code& ec) override
+        {
+            _stream._write_io_service.post([self = std::shared_ptr<async_write_op>(this), ec]
+                                           {
+                                               self->resume(ec);
+                                           });
+        }
+
+        void resume(const error_code& ec)
+        {
+            if (ec)
+                return _handler(ec, std::size_t(0));
+            _stream.async_write_some(_buffers, std::move(_handler));
+        }
+
+        spsc_fake_stream& _stream;
+        ConstBufferSequence _buffers;
+        Handler _handler;
+    };
+
+    template<class ConstBufferSequence, class Handler>
+    void spsc_fake_stream::async_write_some(const ConstBufferSequence& buffers, Handler&& handler)
+    {
+        using handler_type = std::decay_t<Handler>;
+
+        error_code ec;
+        std::size_t written = 0;
+        if (asio::buffer_size(buffers))
+            written = produce(buffers, ec);
+        if (written or ec or asio::buffer_size(buffers) == 0)
+        {
+            _write_io_service.post([handler = handler_type(std::forward<Handler>(handler)), ec, written]() mutable
+                                   {
+                                       handler(ec, written);
+                                   });
+            return;
+        }
+
+        using op_type = async_write_op<ConstBufferSequence, handler_type>;
+        auto op = new op_type(*this, buffers, handler_type(std::forward<Handler>(handler)));
+        park(_writer, *op, [this] { return writable(); });
+    }
+
+}}
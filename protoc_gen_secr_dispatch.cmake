@@ -0,0 +1,40 @@
+#
+# secr_dispatch_configure_tables (HEADERS <var> OUTPUT_DIRECTORY <dir> FILES <proto>...)
+#
+# Run protoc-gen-secr_dispatch over each .proto file, generating
+# <name>.dispatch.pb.h into the output directory, which should be the
+# directory into which <name>.pb.h is copied.
+# The paths of the generated headers are returned in <var>. Add them to the
+# sources of a target so that they are generated before it is compiled.
+#
+# protoc is taken from SECR_DISPATCH_PROTOC, if set, and otherwise looked up
+# on the path.
+#
+
+find_program (SECR_DISPATCH_PROTOC protoc)
+
+function (secr_dispatch_configure_tables)
+	cmake_parse_arguments (_arg "" "HEADERS;OUTPUT_DIRECTORY" "FILES" ${ARGN})
+	if (NOT SECR_DISPATCH_PROTOC)
+		message (FATAL_ERROR "secr_dispatch_configure_tables: protoc not found")
+	endif ()
+
+	set (_headers)
+	foreach (_proto ${_arg_FILES})
+		get_filename_component (_base "${_proto}" NAME_WE)
+		get_filename_component (_path "${_proto}" ABSOLUTE)
+		get_filename_component (_dir "${_path}" DIRECTORY)
+		set (_header "${_arg_OUTPUT_DIRECTORY}/${_base}.dispatch.pb.h")
+		add_custom_command (OUTPUT "${_header}"
+							COMMAND ${CMAKE_COMMAND} -E make_directory "${_arg_OUTPUT_DIRECTORY}"
+							COMMAND ${SECR_DISPATCH_PROTOC}
+								"--plugin=protoc-gen-secr_dispatch=$<TARGET_FILE:protoc-gen-secr_dispatch>"
+								"--secr_dispatch_out=${_arg_OUTPUT_DIRECTORY}"
+								-I "${_dir}"
+								"${_path}"
+							DEPENDS protoc-gen-secr_dispatch "${_path}"
+							COMMENT "Generating dispatch tables for ${_proto}")
+		list (APPEND _headers "${_header}")
+	endforeach ()
+	set (${_arg_HEADERS} ${_headers} PARENT_SCOPE)
+endfunction ()
@@ -1,38 +1,728 @@
 #include <secr/dispatch/api/json.hpp>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 
+#include <algorithm>
+#include <cfloat>
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 
 namespace secr { namespace dispatch { namespace api {
 
+    namespace pb = google::protobuf;
+    namespace pbu = google::protobuf::util;
+
+    namespace {
+
+        /// Type resolvers are expensive to build, so keep one per descriptor
+        /// pool for the life of the program. Also remember which message types
+        /// the reflection writer can handle.
+        /// Each thread keeps its own copy of the answers it has seen, so a
+        /// cache hit takes no lock. Only a thread's first lookup of a pool or
+        /// descriptor goes to the shared maps.
+        struct json_type_cache
+        {
+            static json_type_cache& instance()
+            {
+                static json_type_cache cache;
+                return cache;
+            }
+
+            pbu::TypeResolver& resolver(const pb::DescriptorPool* pool)
+            {
+                thread_local std::unordered_map<const pb::DescriptorPool*, pbu::TypeResolver*> local;
+                auto& result = local[pool];
+                if (not result)
+                {
+                    auto lock = lock_type(_mutex);
+                    auto& ptr = _resolvers[pool];
+                    if (not ptr) {
+                        ptr.reset(pbu::NewTypeResolverForDescriptorPool("", pool));
+                    }
+                    result = ptr.get();
+                }
+                return *result;
+            }
+
+            bool writes_directly(const pb::Descriptor* descriptor)
+            {
+                thread_local std::unordered_map<const pb::Descriptor*, bool> local;
+                auto ilocal = local.find(descriptor);
+                if (ilocal != std::end(local))
+                    return ilocal->second;
+
+                auto lock = lock_type(_mutex);
+                auto ifind = _direct.find(descriptor);
+                if (ifind == std::end(_direct))
+                {
+                    std::unordered_set<const pb::Descriptor*> seen;
+                    ifind = _direct.emplace(descriptor, check_direct(descriptor, seen)).first;
+                }
+                local.emplace(descriptor, ifind->second);
+                return ifind->second;
+            }
+
+        private:
+            using mutex_type = std::mutex;
+            using lock_type = std::unique_lock<mutex_type>;
+
+            /// The reflection writer covers proto3 messages, whose fields are
+            /// declared in field number order and which do not contain any of
+            /// the well-known types (which have special json mappings)
+            static bool check_direct(const pb::Descriptor* descriptor,
+                                     std::unordered_set<const pb::Descriptor*>& seen)
+            {
+                if (not seen.insert(descriptor).second)
+                    return true;
+
+                auto file = descriptor->file();
+                if (file->syntax() != pb::FileDescriptor::SYNTAX_PROTO3)
+                    return false;
+                if (file->package() == "google.protobuf")
+                    return false;
+                if (descriptor->extension_range_count())
+                    return false;
+
+                for (int i = 0 ; i < descriptor->field_count() ; ++i)
+                {
+                    auto field = descriptor->field(i);
+                    if (i and field->number() < descriptor->field(i - 1)->number())
+                        return false;
+                    if (field->cpp_type() == pb::FieldDescriptor::CPPTYPE_MESSAGE
+                        and not check_direct(field->message_type(), seen))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            mutex_type _mutex;
+            std::unordered_map<const pb::DescriptorPool*, std::unique_ptr<pbu::TypeResolver>> _resolvers;
+            std::unordered_map<const pb::Descriptor*, bool> _direct;
+        };
+
+        /// Code points which protobuf escapes even though json does not
+        /// require it, so that the output is safe to embed in javascript
+        bool must_escape(std::uint32_t cp)
+        {
+            if (cp < 0xa0)
+                return cp >= 0x7f;
+            if (cp < 0x2000)
+                return cp == 0xad
+                or (cp >= 0x600 and cp <= 0x603)
+                or cp == 0x6dd
+                or cp == 0x70f
+                or cp == 0x17b4 or cp == 0x17b5;
+            if (cp < 0x2100)
+                return (cp >= 0x200b and cp <= 0x200f)
+                or (cp >= 0x2028 and cp <= 0x202e)
+                or (cp >= 0x2060 and cp <= 0x2064)
+                or (cp >= 0x206a and cp <= 0x206f);
+            return cp == 0xfeff
+            or (cp >= 0xfff9 and cp <= 0xfffb)
+            or (cp >= 0x1d173 and cp <= 0x1d17a)
+            or cp == 0xe0001
+            or (cp >= 0xe0020 and cp <= 0xe007f);
+        }
+
+        /// @returns the length of the valid utf-8 sequence at p, or 0
+        std::size_t decode_utf8(const unsigned char* p, const unsigned char* last, std::uint32_t& cp)
+        {
+            auto continuation = [](unsigned char c) { return (c & 0xc0) == 0x80; };
+            auto avail = std::size_t(last - p);
+            auto c = p[0];
+            if (c >= 0xc2 and c <= 0xdf)
+            {
+                if (avail < 2 or not continuation(p[1])) return 0;
+                cp = (std::uint32_t(c & 0x1f) << 6) | (p[1] & 0x3f);
+                return 2;
+            }
+            if (c >= 0xe0 and c <= 0xef)
+            {
+                if (avail < 3 or not continuation(p[1]) or not continuation(p[2])) return 0;
+                if (c == 0xe0 and p[1] < 0xa0) return 0;    // overlong
+                if (c == 0xed and p[1] >= 0xa0) return 0;   // surrogate
+                cp = (std::uint32_t(c & 0x0f) << 12) | (std::uint32_t(p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+                return 3;
+            }
+            if (c >= 0xf0 and c <= 0xf4)
+            {
+                if (avail < 4 or not continuation(p[1]) or not continuation(p[2]) or not continuation(p[3]))
+                    return 0;
+                if (c == 0xf0 and p[1] < 0x90) return 0;    // overlong
+                if (c == 0xf4 and p[1] >= 0x90) return 0;   // beyond U+10FFFF
+                cp = (std::uint32_t(c & 0x07) << 18) | (std::uint32_t(p[1] & 0x3f) << 12)
+                | (std::uint32_t(p[2] & 0x3f) << 6) | (p[3] & 0x3f);
+                return 4;
+            }
+            return 0;
+        }
+
+        /// Writes json by reflection, straight into the buffers of a zero
+        /// copy stream
+        struct json_writer
+        {
+            json_writer(pb::io::ZeroCopyOutputStream& out, const pbu::JsonOptions& opts)
+            : _out(out)
+            , _opts(opts)
+            {}
+
+            json_writer(const json_writer&) = delete;
+            json_writer& operator=(const json_writer&) = delete;
+
+            ~json_writer()
+            {
+                if (_pos != _end)
+                    _out.BackUp(int(_end - _pos));
+            }
+
+            void write_document(const pb::Message& msg)
+            {
+                write_message(msg, 0);
+                if (_opts.add_whitespace)
+                    put('\n');
+            }
+
+        private:
+
+            //
+            // output primitives
+            //
+
+            void next_buffer()
+            {
+                void* data;
+                int size;
+                do {
+                    if (not _out.Next(&data, &size))
+                        throw std::runtime_error("write_json: output stream failed");
+                } while (size == 0);
+                _pos = static_cast<char*>(data);
+                _end = _pos + size;
+            }
+
+            void put(char c)
+            {
+                if (_pos == _end) next_buffer();
+                *_pos++ = c;
+            }
+
+            void put(const char* p, std::size_t n)
+            {
+                while (n)
+                {
+                    if (_pos == _end) next_buffer();
+                    auto chunk = std::min(n, std::size_t(_end - _pos));
+                    std::memcpy(_pos, p, chunk);
+                    _pos += chunk;
+                    p += chunk;
+                    n -= chunk;
+                }
+            }
+
+            template<std::size_t N>
+            void put_literal(const char (&s)[N])
+            {
+                put(s, N - 1);
+            }
+
+            void put(const std::string& s)
+            {
+                put(s.data(), s.size());
+            }
+
+            void put_unsigned(std::uint64_t value)
+            {
+                char buf[20];
+                auto p = std::end(buf);
+                do {
+                    *--p = char('0' + value % 10);
+                    value /= 10;
+                } while (value);
+                put(p, std::size_t(std::end(buf) - p));
+            }
+
+            void put_signed(std::int64_t value)
+            {
+                if (value < 0) {
+                    put('-');
+                    put_unsigned(std::uint64_t(0) - std::uint64_t(value));
+                }
+                else {
+                    put_unsigned(std::uint64_t(value));
+                }
+            }
+
+            /// The same formatting as protobuf's SimpleDtoa and SimpleFtoa - the
+            /// shortest of two precisions which round-trips
+            template<class Real>
+            void put_real(Real value)
+            {
+                if (std::isnan(value))
+                    return put_literal("\"NaN\"");
+                if (std::isinf(value))
+                    return value > 0 ? put_literal("\"Infinity\"") : put_literal("\"-Infinity\"");
+
+                constexpr bool is_float = std::is_same<Real, float>::value;
+                constexpr int short_digits = is_float ? FLT_DIG : DBL_DIG;
+                constexpr int long_digits = is_float ? FLT_DIG + 3 : DBL_DIG + 2;
+
+                char buf[32];
+                auto len = std::snprintf(buf, sizeof(buf), "%.*g", short_digits, double(value));
+                auto round_trip = is_float
+                ? Real(std::strtof(buf, nullptr))
+                : Real(std::strtod(buf, nullptr));
+                if (round_trip != value)
+                    len = std::snprintf(buf, sizeof(buf), "%.*g", long_digits, double(value));
+                put(buf, delocalize_radix(buf, std::size_t(len)));
+            }
+
+            /// snprintf writes the radix character of the C locale, which the
+            /// program may have changed. Json always uses '.'
+            /// @returns the new length of the number
+            static std::size_t delocalize_radix(char* buf, std::size_t len)
+            {
+                auto radix = std::localeconv()->decimal_point;
+                if (radix[0] == '.' and radix[1] == 0)
+                    return len;
+
+                auto radix_len = std::strlen(radix);
+                auto last = buf + len;
+                auto pos = std::search(buf, last, radix, radix + radix_len);
+                if (pos == last)
+                    return len;
+
+                *pos = '.';
+                std::copy(pos + radix_len, last, pos + 1);
+                return len - (radix_len - 1);
+            }
+
+            void put_escaped(const std::string& s)
+            {
+                static const char hex[] = "0123456789abcdef";
+
+                auto escape = [this](std::uint32_t cp) {
+                    char buf[6] = { '\\', 'u', hex[(cp >> 12) & 0xf], hex[(cp >> 8) & 0xf], hex[(cp >> 4) & 0xf], hex[cp & 0xf] };
+                    put(buf, sizeof(buf));
+                };
+
+                put('"');
+                auto p = reinterpret_cast<const unsigned char*>(s.data());
+                auto last = p + s.size();
+                while (p != last)
+                {
+                    // copy runs of characters which need no escaping in one go
+                    auto run = p;
+                    while (run != last and *run >= 0x20 and *run < 0x7f
+                           and *run != '"' and *run != '\\' and *run != '<' and *run != '>')
+                    {
+                        ++run;
+                    }
+                    put(reinterpret_cast<const char*>(p), std::size_t(run - p));
+                    p = run;
+                    if (p == last)
+                        break;
+
+                    auto c = *p;
+                    if (c < 0x80)
+                    {
+                        switch(c)
+                        {
+                            case '"': put_literal("\\\""); break;
+                            case '\\': put_literal("\\\\"); break;
+                            case '\b': put_literal("\\b"); break;
+                            case '\f': put_literal("\\f"); break;
+                            case '\n': put_literal("\\n"); break;
+                            case '\r': put_literal("\\r"); break;
+                            case '\t': put_literal("\\t"); break;
+                            default: escape(c); break;
+                        }
+                        ++p;
+                        continue;
+                    }
+
+                    std::uint32_t cp;
+                    auto len = decode_utf8(p, last, cp);
+                    if (len == 0)
+                    {
+                        // invalid utf-8 - drop the byte
+                        ++p;
+                    }
+                    else if (not must_escape(cp))
+                    {
+                        put(reinterpret_cast<const char*>(p), len);
+                        p += len;
+                    }
+                    else if (cp > 0xffff)
+                    {
+                        cp -= 0x10000;
+                        escape(0xd800 + (cp >> 10));
+                        escape(0xdc00 + (cp & 0x3ff));
+                        p += len;
+                    }
+                    else
+                    {
+                        escape(cp);
+                        p += len;
+                    }
+                }
+                put('"');
+            }
+
+            void put_base64(const std::string& s)
+            {
+                static const char alphabet[] =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+                put('"');
+                auto p = reinterpret_cast<const unsigned char*>(s.data());
+                auto n = s.size();
+                for ( ; n >= 3 ; n -= 3, p += 3)
+                {
+                    char quad[4] = {
+                        alphabet[p[0] >> 2],
+                        alphabet[((p[0] & 0x03) << 4) | (p[1] >> 4)],
+                        alphabet[((p[1] & 0x0f) << 2) | (p[2] >> 6)],
+                        alphabet[p[2] & 0x3f]
+                    };
+                    put(quad, 4);
+                }
+                if (n == 1)
+                {
+                    char quad[4] = { alphabet[p[0] >> 2], alphabet[(p[0] & 0x03) << 4], '=', '=' };
+                    put(quad, 4);
+                }
+                else if (n == 2)
+                {
+                    char quad[4] = {
+                        alphabet[p[0] >> 2],
+                        alphabet[((p[0] & 0x03) << 4) | (p[1] >> 4)],
+                        alphabet[(p[1] & 0x0f) << 2],
+                        '='
+                    };
+                    put(quad, 4);
+                }
+                put('"');
+            }
+
+            //
+            // structure
+            //
+
+            void newline(int level)
+            {
+                if (_opts.add_whitespace)
+                {
+                    put('\n');
+                    for (int i = 0 ; i < level ; ++i)
+                        put(' ');
+                }
+            }
+
+            void begin_item(bool& first, int level)
+            {
+                if (not first) put(',');
+                first = false;
+                newline(level);
+            }
+
+            void end_container(bool empty, int level, char close)
+            {
+                if (not empty) newline(level);
+                put(close);
+            }
+
+            void put_name(const pb::FieldDescriptor* field)
+            {
+                put('"');
+                put(_opts.preserve_proto_field_names ? field->name() : field->json_name());
+                put('"');
+                put(':');
+                if (_opts.add_whitespace) put(' ');
+            }
+
+            void write_message(const pb::Message& msg, int level)
+            {
+                auto descriptor = msg.GetDescriptor();
+                auto& reflection = *msg.GetReflection();
+
+                put('{');
+                bool first = true;
+                auto member = [&](const pb::FieldDescriptor* field) {
+                    begin_item(first, level + 1);
+                    put_name(field);
+                    write_field(msg, reflection, field, level + 1);
+                };
+
+                auto count = descriptor->field_count();
+                if (_opts.always_print_primitive_fields)
+                {
+                    // protobuf writes default values in declaration order,
+                    // followed by the members of oneofs which are set
+                    for (int i = 0 ; i < count ; ++i)
+                    {
+                        auto field = descriptor->field(i);
+                        if (field->containing_oneof())
+                            continue;
+                        if (field->cpp_type() == pb::FieldDescriptor::CPPTYPE_MESSAGE
+                            and not field->is_repeated()
+                            and not reflection.HasField(msg, field))
+                        {
+                            continue;
+                        }
+                        member(field);
+                    }
+                    for (int i = 0 ; i < count ; ++i)
+                    {
+                        auto field = descriptor->field(i);
+                        if (field->containing_oneof() and reflection.HasField(msg, field))
+                            member(field);
+                    }
+                }
+                else
+                {
+                    for (int i = 0 ; i < count ; ++i)
+                    {
+                        auto field = descriptor->field(i);
+                        if (field->is_repeated()
+                            ? reflection.FieldSize(msg, field) != 0
+                            : reflection.HasField(msg, field))
+                        {
+                            member(field);
+                        }
+                    }
+                }
+                end_container(first, level, '}');
+            }
+
+            void write_field(const pb::Message& msg,
+                             const pb::Reflection& reflection,
+                             const pb::FieldDescriptor* field,
+                             int level)
+            {
+                if (field->is_map())
+                    return write_map(msg, reflection, field, level);
+
+                if (not field->is_repeated())
+                    return write_value(msg, reflection, field, -1, level);
+
+                put('[');
+                auto size = reflection.FieldSize(msg, field);
+                bool first = true;
+                for (int i = 0 ; i < size ; ++i)
+                {
+                    begin_item(first, level + 1);
+                    write_value(msg, reflection, field, i, level + 1);
+                }
+                end_container(first, level, ']');
+            }
+
+            void write_map(const pb::Message& msg,
+                           const pb::Reflection& reflection,
+                           const pb::FieldDescriptor* field,
+                           int level)
+            {
+                auto key_field = field->message_type()->map_key();
+                auto value_field = field->message_type()->map_value();
+
+                put('{');
+                auto size = reflection.FieldSize(msg, field);
+                bool first = true;
+                for (int i = 0 ; i < size ; ++i)
+                {
+                    auto& entry = reflection.GetRepeatedMessage(msg, field, i);
+                    auto& entry_reflection = *entry.GetReflection();
+                    begin_item(first, level + 1);
+                    write_key(entry, entry_reflection, key_field);
+                    put(':');
+                    if (_opts.add_whitespace) put(' ');
+                    write_value(entry, entry_reflection, value_field, -1, level + 1);
+                }
+                end_container(first, level, '}');
+            }
+
+            void write_key(const pb::Message& entry,
+                           const pb::Reflection& reflection,
+                           const pb::FieldDescriptor* key_field)
+            {
+                using FD = pb::FieldDescriptor;
+                switch(key_field->cpp_type())
+                {
+                    case FD::CPPTYPE_STRING:
+                        return put_escaped(reflection.GetStringReference(entry, key_field, &_scratch));
+                    case FD::CPPTYPE_BOOL:
+                        return reflection.GetBool(entry, key_field)
+                        ? put_literal("\"true\"")
+                        : put_literal("\"false\"");
+                    case FD::CPPTYPE_INT64:
+                    case FD::CPPTYPE_UINT64:
+                        // already quoted
+                        return write_value(entry, reflection, key_field, -1, 0);
+                    default:
+                        put('"');
+                        write_value(entry, reflection, key_field, -1, 0);
+                        put('"');
+                        return;
+                }
+            }
+
+            /// Write a singular value (index < 0) or an element of a repeated field
+            void write_value(const pb::Message& msg,
+                             const pb::Reflection& reflection,
+                             const pb::FieldDescriptor* field,
+                             int index,
+                             int level)
+            {
+                using FD = pb::FieldDescriptor;
+                bool repeated = index >= 0;
+
+                switch(field->cpp_type())
+                {
+                    case FD::CPPTYPE_INT32:
+                        return put_signed(repeated
+                                          ? reflection.GetRepeatedInt32(msg, field, index)
+                                          : reflection.GetInt32(msg, field));
+                    case FD::CPPTYPE_UINT32:
+                        return put_unsigned(repeated
+                                            ? reflection.GetRepeatedUInt32(msg, field, index)
+                                            : reflection.GetUInt32(msg, field));
+                    case FD::CPPTYPE_INT64:
+                        // 64 bit integers are quoted, since javascript cannot
+                        // represent them exactly
+                        put('"');
+                        put_signed(repeated
+                                   ? reflection.GetRepeatedInt64(msg, field, index)
+                                   : reflection.GetInt64(msg, field));
+                        put('"');
+                        return;
+                    case FD::CPPTYPE_UINT64:
+                        put('"');
+                        put_unsigned(repeated
+                                     ? reflection.GetRepeatedUInt64(msg, field, index)
+                                     : reflection.GetUInt64(msg, field));
+                        put('"');
+                        return;
+                    case FD::CPPTYPE_DOUBLE:
+                        return put_real(repeated
+                                        ? reflection.GetRepeatedDouble(msg, field, index)
+                                        : reflection.GetDouble(msg, field));
+                    case FD::CPPTYPE_FLOAT:
+                        return put_real(repeated
+                                        ? reflection.GetRepeatedFloat(msg, field, index)
+                                        : reflection.GetFloat(msg, field));
+                    case FD::CPPTYPE_BOOL:
+                        return (repeated
+                                ? reflection.GetRepeatedBool(msg, field, index)
+                                : reflection.GetBool(msg, field))
+                        ? put_literal("true")
+                        : put_literal("false");
+                    case FD::CPPTYPE_ENUM:
+                    {
+                        auto number = repeated
+                        ? reflection.GetRepeatedEnumValue(msg, field, index)
+                        : reflection.GetEnumValue(msg, field);
+                        auto value = _opts.always_print_enums_as_ints
+                        ? nullptr
+                        : field->enum_type()->FindValueByNumber(number);
+                        if (value)
+                        {
+                            put('"');
+                            put(value->name());
+                            put('"');
+                        }
+                        else
+                        {
+                            put_signed(number);
+                        }
+                        return;
+                    }
+                    case FD::CPPTYPE_STRING:
+                    {
+                        auto& value = repeated
+                        ? reflection.GetRepeatedStringReference(msg, field, index, &_scratch)
+                        : reflection.GetStringReference(msg, field, &_scratch);
+                        if (field->type() == FD::TYPE_BYTES)
+                            return put_base64(value);
+                        return put_escaped(value);
+                    }
+                    case FD::CPPTYPE_MESSAGE:
+                        return write_message(repeated
+                                             ? reflection.GetRepeatedMessage(msg, field, index)
+                                             : reflection.GetMessage(msg, field),
+                                             level);
+                }
+            }
+
+            pb::io::ZeroCopyOutputStream& _out;
+            const pbu::JsonOptions& _opts;
+            char* _pos = nullptr;
+            char* _end = nullptr;
+            std::string _scratch;
+        };
+
+        /// Convert through protobuf's own converter
+        void write_json_by_resolver(pb::io::ZeroCopyOutputStream& out,
+                                    const pb::Message& msg,
+                                    const pbu::JsonOptions& opts)
+        {
+            auto descriptor = msg.GetDescriptor();
+            auto& resolver = json_type_cache::instance().resolver(descriptor->file()->pool());
+
+            auto buffer = msg.SerializeAsString();
+            pb::io::ArrayInputStream zistream(buffer.data(), int(buffer.size()));
+            auto status = pbu::BinaryToJsonStream(std::addressof(resolver),
+                                                  "/" + descriptor->full_name(),
+                                                  std::addressof(zistream),
+                                                  std::addressof(out),
+                                                  opts);
+            if (!status.ok())
+            {
+                std::ostringstream ss;
+                ss << status;
+                throw std::runtime_error(ss.str());
+            }
+        }
+    }
+
+    void write_json(pb::io::ZeroCopyOutputStream& out,
+                    const pb::Message& msg,
+                    pbu::JsonOptions opts)
+    {
+        if (json_type_cache::instance().writes_directly(msg.GetDescriptor()))
+        {
+            json_writer writer(out, opts);
+            writer.write_document(msg);
+        }
+        else
+        {
+            write_json_by_resolver(out, msg, opts);
+        }
+    }
+
+    void append_json(std::string& out,
+                     const pb::Message& msg,
+                     pbu::JsonOptions opts)
+    {
+        pb::io::StringOutputStream zostream(std::addressof(out));
+        write_json(zostream, msg, opts);
+    }
+
     std::string as_json(const google::protobuf::Message& msg,
                         google::protobuf::util::JsonOptions opts)
     {
-        namespace pb = google::protobuf;
-        namespace pbu = google::protobuf::util;
-        
-        auto buffer = msg.SerializeAsString();
         std::string result;
-        pb::io::ArrayInputStream zistream(buffer.data(), buffer.size());
-        
-        auto resolver = std::unique_ptr<pbu::TypeResolver> {
-            pbu::NewTypeResolverForDescriptorPool("",
-                                                  pb::DescriptorPool::generated_pool())
-        };
-        
-        auto status = google::protobuf::util::BinaryToJsonString(resolver.get(),
-                                                                 "/" + msg.GetDescriptor()->full_name(),
-                                                                 buffer,
-                                                                 std::addressof(result),
-                                                                 opts);
-        if (!status.ok())
-        {
-            std::ostringstream ss;
-            ss << status;
-            throw std::runtime_error(ss.str());
-        }
+        append_json(result, msg, opts);
         return result;
     }
-    
+
     std::string as_json(const google::protobuf::Message* msg,
                         google::protobuf::util::JsonOptions opts)
     {
@@ -40,5 +730,5 @@ namespace secr { namespace dispatch { namespace api {
     }
 
 
-    
+
 }}}
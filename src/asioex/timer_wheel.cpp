@@ -0,0 +1,212 @@
+#include <secr/dispatch/asioex/timer_wheel.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace asioex {
+
+    asio::io_service::id timer_wheel_service::id;
+
+    constexpr std::size_t timer_wheel_service::slot_bits;
+    constexpr std::size_t timer_wheel_service::slots_per_level;
+    constexpr std::size_t timer_wheel_service::levels;
+
+    namespace {
+        constexpr std::uint64_t level_span(std::size_t level)
+        {
+            return std::uint64_t(1) << (timer_wheel_service::slot_bits * level);
+        }
+    }
+
+    timer_wheel_service::timer_wheel_service(asio::io_service& owner)
+    : asio::io_service::service(owner)
+    , _timer(owner)
+    {
+    }
+
+    void timer_wheel_service::set_tick_duration(duration tick)
+    {
+        auto lock = lock_type(_mutex);
+        assert(_size == 0);
+        assert(tick > duration::zero());
+        _tick = tick;
+        _origin = clock_type::now();
+        _current_tick = 0;
+    }
+
+    auto timer_wheel_service::tick_duration() const -> duration
+    {
+        auto lock = lock_type(_mutex);
+        return _tick;
+    }
+
+    std::size_t timer_wheel_service::size() const
+    {
+        auto lock = lock_type(_mutex);
+        return _size;
+    }
+
+    std::uint64_t timer_wheel_service::now_tick() const
+    {
+        return std::uint64_t((clock_type::now() - _origin) / _tick);
+    }
+
+    bool timer_wheel_service::schedule(entry& e, duration after, handler_type handler)
+    {
+        auto lock = lock_type(_mutex);
+        bool was_linked = e.linked();
+        if (was_linked) {
+            unlink(lock, e);
+            --_size;
+        }
+
+        // the wheel may lag real time, either because it was not driven while
+        // it was empty or because its timer has not yet been serviced, so
+        // measure from whichever is later
+        auto base = std::max(_current_tick, now_tick());
+        if (_size == 0) {
+            _current_tick = base;
+        }
+
+        // round up, so that the entry never fires early
+        auto ticks = std::uint64_t((after + _tick - duration(1)) / _tick);
+        ticks = std::max<std::uint64_t>(ticks, 1);
+        e._expiry_tick = std::min<std::uint64_t>(base + ticks,
+                                                 _current_tick + level_span(levels) - 1);
+        e._handler = std::move(handler);
+        insert(lock, e);
+        ++_size;
+        arm(lock);
+        return was_linked;
+    }
+
+    bool timer_wheel_service::cancel(entry& e)
+    {
+        auto lock = lock_type(_mutex);
+        if (not e.linked())
+            return false;
+        unlink(lock, e);
+        --_size;
+        e._handler = nullptr;
+        return true;
+    }
+
+    void timer_wheel_service::insert(const lock_type&, entry& e)
+    {
+        auto delta = e._expiry_tick - _current_tick;
+        std::size_t level = 0;
+        while (level + 1 < levels and delta >= level_span(level + 1)) {
+            ++level;
+        }
+        auto index = (e._expiry_tick >> (slot_bits * level)) & (slots_per_level - 1);
+        auto& head = _slots[level][index].head;
+        e._prev = head._prev;
+        e._next = std::addressof(head);
+        head._prev->_next = std::addressof(e);
+        head._prev = std::addressof(e);
+    }
+
+    void timer_wheel_service::unlink(const lock_type&, entry& e)
+    {
+        e._prev->_next = e._next;
+        e._next->_prev = e._prev;
+        e._prev = e._next = nullptr;
+    }
+
+    void timer_wheel_service::cascade(const lock_type& lock, std::size_t level)
+    {
+        auto index = (_current_tick >> (slot_bits * level)) & (slots_per_level - 1);
+        auto& s = _slots[level][index];
+        while (not s.empty())
+        {
+            auto& e = *s.head._next;
+            unlink(lock, e);
+            insert(lock, e);
+        }
+    }
+
+    std::size_t timer_wheel_service::tick(const lock_type& lock)
+    {
+        ++_current_tick;
+
+        // when a lower level wraps, redistribute the next slot of the level above
+        for (std::size_t level = 1 ; level < levels ; ++level)
+        {
+            if (_current_tick & (level_span(level) - 1))
+                break;
+            cascade(lock, level);
+        }
+
+        std::size_t fired = 0;
+        auto& s = _slots[0][_current_tick & (slots_per_level - 1)];
+        while (not s.empty())
+        {
+            auto& e = *s.head._next;
+            unlink(lock, e);
+            --_size;
+            get_io_service().post(std::move(e._handler));
+            e._handler = nullptr;
+            ++fired;
+        }
+        return fired;
+    }
+
+    std::size_t timer_wheel_service::advance(std::size_t ticks)
+    {
+        auto lock = lock_type(_mutex);
+        std::size_t fired = 0;
+        for ( ; ticks and _size ; --ticks) {
+            fired += tick(lock);
+        }
+        // nothing can expire on an empty wheel
+        _current_tick += ticks;
+        return fired;
+    }
+
+    void timer_wheel_service::arm(const lock_type&)
+    {
+        if (_timer_armed or _size == 0)
+            return;
+
+        _timer_armed = true;
+        _timer.expires_at(_origin + _tick * (_current_tick + 1));
+        _timer.async_wait([this](const error_code& ec) {
+            this->handle_timer(ec);
+        });
+    }
+
+    void timer_wheel_service::handle_timer(const error_code& ec)
+    {
+        if (ec == asio::error::operation_aborted)
+            return;
+
+        auto lock = lock_type(_mutex);
+        _timer_armed = false;
+        auto target = now_tick();
+        while (_current_tick < target and _size) {
+            tick(lock);
+        }
+        _current_tick = std::max(_current_tick, target);
+        arm(lock);
+    }
+
+    void timer_wheel_service::shutdown_service()
+    {
+        auto lock = lock_type(_mutex);
+        error_code sink;
+        _timer.cancel(sink);
+        for (auto& level : _slots)
+        {
+            for (auto& s : level)
+            {
+                while (not s.empty())
+                {
+                    auto& e = *s.head._next;
+                    unlink(lock, e);
+                    e._handler = nullptr;
+                }
+            }
+        }
+        _size = 0;
+    }
+
+}}}
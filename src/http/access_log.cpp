@@ -0,0 +1,86 @@
+#include <secr/dispatch/http/access_log.hpp>
+#include <secr/dispatch/http/server_request.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+#include <atomic>
+#include <chrono>
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+        std::atomic<std::size_t> sample_interval { 1 };
+        std::atomic<int> severity { boost::log::trivial::info };
+        std::atomic<bool> headers_dumped { false };
+        std::atomic<std::size_t> sample_counter { 0 };
+
+        template<class Duration>
+        long long milliseconds(Duration d)
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+        }
+
+        struct print_view
+        {
+            print_view(string_view view) : view(view) {}
+
+            friend std::ostream& operator<<(std::ostream& os, const print_view& pv)
+            {
+                if (pv.view.size() == 0)
+                    return os << '-';
+                return os.write(pv.view.begin(), pv.view.size());
+            }
+
+            string_view view;
+        };
+    }
+
+    void access_log::configure(const access_log_options& options)
+    {
+        sample_interval.store(options.sample_interval);
+        severity.store(options.severity);
+        headers_dumped.store(options.dump_headers);
+    }
+
+    access_log_options access_log::options()
+    {
+        access_log_options result;
+        result.sample_interval = sample_interval.load();
+        result.severity = static_cast<boost::log::trivial::severity_level>(severity.load());
+        result.dump_headers = headers_dumped.load();
+        return result;
+    }
+
+    bool access_log::dump_headers()
+    {
+        return headers_dumped.load(std::memory_order_relaxed);
+    }
+
+    bool access_log::sample()
+    {
+        auto interval = sample_interval.load(std::memory_order_relaxed);
+        if (interval == 0)
+            return false;
+        if (interval == 1)
+            return true;
+        return sample_counter.fetch_add(1, std::memory_order_relaxed) % interval == 0;
+    }
+
+    void access_log::request_complete(const request_context& context, const error_code& ec)
+    {
+        if (not sample())
+            return;
+
+        auto level = static_cast<boost::log::trivial::severity_level>(severity.load(std::memory_order_relaxed));
+        // BOOST_LOG_SEV only evaluates the stream expression if the record is enabled
+        BOOST_LOG_SEV(boost::log::trivial::logger::get(), level)
+        << "access " << context.get_request_id()
+        << ' ' << print_view(context.raw_header().method())
+        << ' ' << print_view(context.raw_header().url_field(UF_PATH))
+        << ' ' << context.response_status()
+        << ' ' << context.bytes_received()
+        << ' ' << context.bytes_sent()
+        << " header_ms=" << milliseconds(context.header_completed() - context.started())
+        << " total_ms=" << milliseconds(request_context::clock_type::now() - context.started())
+        << (ec ? " error=" : "") << (ec ? ec.message() : std::string());
+    }
+
+}}}
@@ -0,0 +1,202 @@
+#include <secr/dispatch/http/batch.hpp>
+#include <secr/dispatch/api/exception.hpp>
+
+#include <google/protobuf/descriptor.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        /// The calls of one batch which are still running
+        struct batch_state
+        {
+            batch_state(BatchResponse& response, google::protobuf::Closure* done, std::size_t outstanding)
+            : response(response)
+            , done(done)
+            , outstanding(outstanding)
+            {}
+
+            /// called once by each call. The last one completes the batch.
+            void complete_one()
+            {
+                if (--outstanding == 0)
+                    done->Run();
+            }
+
+            BatchResponse& response;
+            google::protobuf::Closure* done;
+            std::atomic<std::size_t> outstanding;
+        };
+
+        /// One call of a batch. When the method completes it records the
+        /// result.
+        class batch_call : public method_call
+        {
+        public:
+            batch_call(dispatch_context context,
+                       std::shared_ptr<batch_state> batch,
+                       std::size_t index,
+                       std::shared_ptr<const method_binding> method)
+            : method_call(std::move(context), std::move(method))
+            , _batch(std::move(batch))
+            , _index(index)
+            {}
+
+            void start(const BatchCall& call)
+            {
+                if (not has_method())
+                    return failed(std::make_exception_ptr(std::invalid_argument("no such method " + call.method())));
+
+                create_messages();
+                if (not method().parse(request(), call.payload().data(), call.payload().size()))
+                    return failed(std::make_exception_ptr(std::invalid_argument("cannot parse " + request().GetTypeName())));
+                call_method();
+            }
+
+        private:
+            void completed() override
+            {
+                auto& result = this->result();
+                if (controller().Failed())
+                {
+                    record_errors(result, std::make_exception_ptr(std::runtime_error(method().full_name() + " : "
+                                                                                     + controller().ErrorText())));
+                }
+                else if (not method().serialise(response(), *result.mutable_payload()))
+                {
+                    record_errors(result, std::make_exception_ptr(std::runtime_error("cannot serialise "
+                                                                                     + response().GetTypeName())));
+                }
+                _batch->complete_one();
+            }
+
+            void failed(std::exception_ptr ep) override
+            {
+                record_errors(result(), std::move(ep));
+                _batch->complete_one();
+            }
+
+            BatchResult& result() { return *_batch->response.mutable_results(int(_index)); }
+
+            static void record_errors(BatchResult& result, std::exception_ptr ep)
+            {
+                api::populate(result.mutable_errors(), std::vector<std::exception_ptr> { std::move(ep) });
+            }
+
+            std::shared_ptr<batch_state> _batch;
+            std::size_t _index;
+        };
+
+        /// The batch itself, served as a method with BatchRequest and
+        /// BatchResponse messages
+        class batch_binding final : public method_binding
+        {
+        public:
+            batch_binding(std::shared_ptr<const method_registry> methods, std::size_t max_calls)
+            : _methods(std::move(methods))
+            , _max_calls(max_calls)
+            {}
+
+            const std::string& full_name() const override
+            {
+                static const std::string name = "batch";
+                return name;
+            }
+
+            google::protobuf::Message* new_request(google::protobuf::Arena* arena) const override
+            {
+                return google::protobuf::Arena::CreateMessage<BatchRequest>(arena);
+            }
+
+            google::protobuf::Message* new_response(google::protobuf::Arena* arena) const override
+            {
+                return google::protobuf::Arena::CreateMessage<BatchResponse>(arena);
+            }
+
+            bool parse(google::protobuf::Message& request, const char* data, std::size_t size) const override
+            {
+                return static_cast<BatchRequest&>(request).ParseFromArray(data, int(size));
+            }
+
+            bool serialise(const google::protobuf::Message& response, std::string& out) const override
+            {
+                return static_cast<const BatchResponse&>(response).SerializeToString(std::addressof(out));
+            }
+
+            std::string refuse(const google::protobuf::Message& request) const override
+            {
+                auto size = std::size_t(static_cast<const BatchRequest&>(request).calls_size());
+                if (size <= _max_calls)
+                    return std::string();
+                return "a batch may contain at most " + std::to_string(_max_calls) + " calls";
+            }
+
+            void call(rpc_controller& controller,
+                      const google::protobuf::Message* request,
+                      google::protobuf::Message* response,
+                      google::protobuf::Closure* done) const override
+            {
+                auto& calls = static_cast<const BatchRequest*>(request)->calls();
+                auto& results = *static_cast<BatchResponse*>(response);
+                if (calls.empty())
+                    return done->Run();
+
+                // every result exists before any call can complete
+                for (int i = 0 ; i < calls.size() ; ++i)
+                    results.add_results();
+
+                auto batch = std::make_shared<batch_state>(results, done, std::size_t(calls.size()));
+                auto& context = controller.context();
+                auto& io_service = context.request().stream().get_io_service();
+                for (int i = 0 ; i < calls.size() ; ++i)
+                {
+                    auto& call = calls.Get(i);
+                    auto sub_call = std::make_shared<batch_call>(context, batch, std::size_t(i),
+                                                                 _methods->find(call.method()));
+                    io_service.post([sub_call, &call] { sub_call->start(call); });
+                }
+            }
+
+        private:
+            std::shared_ptr<const method_registry> _methods;
+            std::size_t _max_calls;
+        };
+    }
+
+    void method_registry::add(std::shared_ptr<const method_binding> method)
+    {
+        auto name = method->full_name();
+        _methods[std::move(name)] = std::move(method);
+    }
+
+    void method_registry::add_service(const std::shared_ptr<google::protobuf::Service>& service)
+    {
+        auto descriptor = service->GetDescriptor();
+        for (int i = 0 ; i < descriptor->method_count() ; ++i)
+            add(bind_method(service, descriptor->method(i)));
+    }
+
+    std::shared_ptr<const method_binding> method_registry::find(const std::string& full_name) const
+    {
+        auto i = _methods.find(full_name);
+        return i == _methods.end() ? nullptr : i->second;
+    }
+
+    void add_batch_endpoint(router& r,
+                            std::shared_ptr<const method_registry> methods,
+                            const service_options& options,
+                            const std::string& path)
+    {
+        auto batch = std::make_shared<const batch_binding>(std::move(methods), options.max_batch_calls);
+        r.add("POST", path, [batch, options](dispatch_context context, const route_parameters&)
+              {
+                  serve_call(std::move(context), batch, options);
+              });
+    }
+
+}}}
@@ -0,0 +1,118 @@
+#include <secr/dispatch/http/byte_range.hpp>
+#include <secr/dispatch/http/header_index.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        /// @returns false unless s is a non-empty run of digits which fits
+        bool parse_position(string_view s, std::uint64_t& result)
+        {
+            if (s.size() == 0)
+                return false;
+            result = 0;
+            for (auto c : s)
+            {
+                if (c < '0' or c > '9')
+                    return false;
+                auto digit = std::uint64_t(c - '0');
+                if (result > (std::numeric_limits<std::uint64_t>::max() - digit) / 10)
+                    return false;
+                result = result * 10 + digit;
+            }
+            return true;
+        }
+    }
+
+    range_disposition parse_byte_ranges(string_view header_value, std::uint64_t size,
+                                        std::vector<byte_range>& ranges)
+    {
+        ranges.clear();
+
+        static const string_view unit = "bytes=";
+        auto value = trim(header_value);
+        if (value.size() < unit.size() or string_view(value.begin(), unit.size()) != unit)
+            return range_disposition::ignore;
+
+        bool any = false;
+        std::size_t count = 0;
+        auto first = value.begin() + unit.size();
+        auto last = value.end();
+        while (first != last)
+        {
+            auto comma = std::find(first, last, ',');
+            auto spec = trim(string_view(first, std::size_t(comma - first)));
+            first = comma == last ? last : comma + 1;
+
+            // empty list elements are allowed
+            if (spec.size() == 0)
+                continue;
+
+            if (++count > max_byte_ranges)
+                return ranges.clear(), range_disposition::ignore;
+
+            auto dash = std::find(spec.begin(), spec.end(), '-');
+            if (dash == spec.end())
+                return ranges.clear(), range_disposition::ignore;
+
+            auto from = string_view(spec.begin(), std::size_t(dash - spec.begin()));
+            auto to = string_view(dash + 1, std::size_t(spec.end() - dash - 1));
+            std::uint64_t a = 0, b = 0;
+
+            if (from.size() == 0)
+            {
+                // suffix: the last b bytes
+                if (not parse_position(to, b))
+                    return ranges.clear(), range_disposition::ignore;
+                any = true;
+                if (b == 0 or size == 0)
+                    continue;
+                ranges.push_back({ size - std::min(b, size), size - 1 });
+            }
+            else
+            {
+                if (not parse_position(from, a))
+                    return ranges.clear(), range_disposition::ignore;
+                if (to.size() == 0)
+                    b = std::numeric_limits<std::uint64_t>::max();
+                else if (not parse_position(to, b) or b < a)
+                    return ranges.clear(), range_disposition::ignore;
+                any = true;
+                if (a >= size)
+                    continue;
+                ranges.push_back({ a, std::min(b, size - 1) });
+            }
+        }
+
+        if (not any)
+            return range_disposition::ignore;
+        if (ranges.empty())
+            return range_disposition::unsatisfiable;
+
+        // overlapping ranges would multiply the size of the response
+        std::sort(ranges.begin(), ranges.end(),
+                  [](const byte_range& l, const byte_range& r) { return l.first < r.first; });
+        auto merged = ranges.begin();
+        for (auto i = std::next(ranges.begin()) ; i != ranges.end() ; ++i)
+        {
+            if (i->first <= merged->last + 1)
+                merged->last = std::max(merged->last, i->last);
+            else
+                *++merged = *i;
+        }
+        ranges.erase(std::next(merged), ranges.end());
+
+        std::uint64_t total = 0;
+        for (auto& range : ranges)
+            total += range.size();
+        if (total > size)
+            return ranges.clear(), range_disposition::ignore;
+
+        return range_disposition::satisfiable;
+    }
+
+}}}
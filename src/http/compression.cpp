@@ -0,0 +1,129 @@
+#include <secr/dispatch/http/compression.hpp>
+
+#include <zlib.h>
+
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        /// zlib's window bits select the framing: 16 more for a gzip wrapper
+        int window_bits(content_coding coding)
+        {
+            return coding == content_coding::gzip ? MAX_WBITS + 16 : MAX_WBITS;
+        }
+
+        /// Compressors idle on this thread, one list per coding
+        struct compressor_pool
+        {
+            static constexpr std::size_t max_idle = 16;
+
+            std::array<std::vector<std::unique_ptr<compressor>>, 2> idle;
+        };
+
+        compressor_pool& this_thread_pool()
+        {
+            thread_local compressor_pool pool;
+            return pool;
+        }
+
+        std::size_t pool_index(content_coding coding)
+        {
+            return coding == content_coding::gzip ? 0 : 1;
+        }
+    }
+
+    string_view coding_name(content_coding coding)
+    {
+        switch (coding)
+        {
+            case content_coding::gzip:
+                return "gzip";
+            case content_coding::deflate:
+                return "deflate";
+        }
+        return "";
+    }
+
+    struct compressor::impl
+    {
+        z_stream stream {};
+    };
+
+    compressor::compressor(content_coding coding, int level)
+    : _impl(std::make_unique<impl>())
+    , _coding(coding)
+    , _level(level)
+    {
+        if (deflateInit2(std::addressof(_impl->stream), level, Z_DEFLATED,
+                         window_bits(coding), 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            throw std::runtime_error("deflateInit2 failed");
+        }
+    }
+
+    compressor::~compressor()
+    {
+        deflateEnd(std::addressof(_impl->stream));
+    }
+
+    void compressor::compress(asio::const_buffer input, compress_flush how, std::vector<char>& out)
+    {
+        auto& z = _impl->stream;
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(asio::buffer_cast<const char*>(input)));
+        z.avail_in = uInt(asio::buffer_size(input));
+
+        auto finish = how == compress_flush::finish;
+        auto flush = finish ? Z_FINISH : how == compress_flush::sync ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+        while (true)
+        {
+            // grow the output by at least the bound on what is left
+            auto used = out.size();
+            auto room = std::max<std::size_t>(deflateBound(std::addressof(z), z.avail_in), 64);
+            out.resize(used + room);
+            z.next_out = reinterpret_cast<Bytef*>(out.data() + used);
+            z.avail_out = uInt(room);
+
+            auto result = deflate(std::addressof(z), flush);
+            out.resize(out.size() - z.avail_out);
+            assert(result != Z_STREAM_ERROR);
+
+            if (finish ? result == Z_STREAM_END : (z.avail_in == 0 and z.avail_out != 0))
+                break;
+        }
+    }
+
+    void compressor::reset(int level)
+    {
+        deflateReset(std::addressof(_impl->stream));
+        if (level != _level)
+        {
+            deflateParams(std::addressof(_impl->stream), level, Z_DEFAULT_STRATEGY);
+            _level = level;
+        }
+    }
+
+    void compressor_releaser::operator()(compressor* p) const
+    {
+        std::unique_ptr<compressor> owned(p);
+        auto& idle = this_thread_pool().idle[pool_index(p->coding())];
+        if (idle.size() < compressor_pool::max_idle)
+            idle.push_back(std::move(owned));
+    }
+
+    compressor_ptr acquire_compressor(content_coding coding, int level)
+    {
+        auto& idle = this_thread_pool().idle[pool_index(coding)];
+        if (idle.empty())
+            return compressor_ptr(new compressor(coding, level));
+
+        auto p = std::move(idle.back());
+        idle.pop_back();
+        p->reset(level);
+        return compressor_ptr(p.release());
+    }
+
+}}}
@@ -2,8 +2,15 @@
 #include <stdexcept>
 #include <exception>
 #include <secr/dispatch/http/server_request.hpp>
+#include <secr/dispatch/http/response_header.hpp>
 #include <boost/log/trivial.hpp>
 #include <valuelib/stdext/exception.hpp>
+#include <algorithm>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace secr { namespace dispatch { namespace http {
     
@@ -60,20 +67,16 @@ namespace secr { namespace dispatch { namespace http {
     {
         assert(_response_mode == response_mode::undecided);
         set_header(mutable_header(), "Content-Length", std::to_string(len.size()));
+        _content_length = len.size();
         
         // determine whether we must close
         
-        auto ifind = find_only_header_like(_request_context.request_header(),
-                                           "Connection");
-        if (not ifind
-            or boost::iequals(ifind->value(), "close")
-            or (http_version(_request_context.request_header()) < std::make_tuple(1,1)
-                and not boost::iequals(ifind->value(), "keep-alive")))
+        if (_request_context.raw_header().keep_alive_requested())
         {
-            set_header(mutable_header(), "Connection", "close");
+            set_header(mutable_header(), "Connection", "keep-alive");
         }
         else {
-            set_header(mutable_header(), "Connection", "keep-alive");
+            set_header(mutable_header(), "Connection", "close");
         }
         _response_mode = response_mode::content_length;
     }
@@ -86,7 +89,7 @@ namespace secr { namespace dispatch { namespace http {
         static const std::string _keep_alive = "keep-alive";
         static const std::string _close = "close";
         
-        bool supports_chunked(const HttpRequestHeader& request)
+        bool supports_chunked(const raw_request_header& request)
         {
             if (request.version_major() < 1)
                 return false;
@@ -96,28 +99,6 @@ namespace secr { namespace dispatch { namespace http {
             }
             return true;
         }
-        
-        bool demanding_close(const HttpRequestHeader& request)
-        {
-            auto first = request.headers().begin();
-            auto last = request.headers().begin();
-            auto ifind = std::find_if(first,
-                                      last,
-                                      match_header_name(Connection));
-            if (std::make_tuple(request.version_major(), request.version_minor()) < std::make_tuple(1,1))
-            {
-                if (ifind == last or not boost::iequals(ifind->value(), _keep_alive))
-                    return true;
-                return false;
-            }
-            else {
-                if (ifind == last or boost::iequals(ifind->value(), _keep_alive))
-                {
-                    return false;
-                }
-            }
-            return true;
-        }
     }
     
     void
@@ -126,16 +107,17 @@ namespace secr { namespace dispatch { namespace http {
     {
         assert(_response_mode == response_mode::undecided);
         
-        auto headers = *mutable_header().mutable_headers();
-        headers.erase(headers.begin(), std::remove_if(headers.begin(),
-                                                      headers.end(),
-                                                      match_header_name(Content_Length)));
+        auto& headers = *mutable_header().mutable_headers();
+        headers.erase(std::remove_if(headers.begin(),
+                                     headers.end(),
+                                     match_header_name(Content_Length)),
+                      headers.end());
         
-        auto& request_header = _request_context.request_header();
+        auto& request_header = _request_context.raw_header();
         if (supports_chunked(request_header))
         {
             add_header(mutable_header(), Transfer_Encoding, _chunked);
-            if (demanding_close(request_header))
+            if (not request_header.keep_alive_requested())
             {
                 add_header(mutable_header(), Connection, _close);
             }
@@ -150,17 +132,269 @@ namespace secr { namespace dispatch { namespace http {
         }
     }
     
+    void dispatch_context::response_object::prepare_write(error_code& ec)
+    {
+        ec.clear();
+        if (_response_mode == response_mode::undecided) {
+            set_content_length(content_length_variable());
+        }
+        
+        if (not header_committed()) {
+            if (not header().has_status()) {
+                auto stat = mutable_header().mutable_status();
+                stat->set_code(200);
+                stat->set_message("OK");
+            }
+            commit_header(ec);
+        }
+    }
+    
+    void dispatch_context::response_object::set_chunk_coalescing(std::size_t size)
+    {
+        _coalesce_size = size;
+        _coalesced.reserve(size);
+    }
+    
+    void dispatch_context::response_object::set_compression(const compression_options& options)
+    {
+        assert(_compression_state == compression_state::undecided);
+        _compression = options;
+    }
+    
+    void dispatch_context::response_object::decide_compression()
+    {
+        _compression_state = compression_state::off;
+        if (not _compression.enabled or header_committed())
+            return;
+        
+        // only a complete, unencoded body may be compressed
+        auto code = header().has_status() ? header().status().code() : 200;
+        if (code < 200 or code == 204 or code == 206 or code == 304)
+            return;
+        auto& request = _request_context.raw_header();
+        if (request.method() == string_view("HEAD"))
+            return;
+        auto& headers = header().headers();
+        for (auto& name : { "Content-Encoding", "Content-Range" })
+        {
+            if (std::any_of(headers.begin(), headers.end(), match_header_name(name)))
+                return;
+        }
+        
+        // a body known to be too small is sent as it is to every client
+        if (_response_mode == response_mode::content_length
+            and _content_length < _compression.minimum_size)
+        {
+            return;
+        }
+        
+        // a client which sends no Accept-Encoding accepts any coding, but
+        // only a client which asks for one is sent a compressed body
+        static const offered_encodings offered { "gzip", "deflate", "identity" };
+        const std::string* coding = nullptr;
+        if (request.index().count(header_id::accept_encoding))
+            coding = offered.negotiate(_request_context.request_manager().accept_encoding());
+        if (not coding or *coding == "identity")
+        {
+            // another client could have been sent a compressed body
+            add_header(mutable_header(), "Vary", "Accept-Encoding");
+            return;
+        }
+        
+        switch (_response_mode)
+        {
+            case response_mode::content_length:
+                if (_content_length <= _compression.buffer_limit)
+                {
+                    _compression_state = compression_state::buffered;
+                }
+                else
+                {
+                    // the compressed length is not known until the end
+                    auto& mutable_headers = *mutable_header().mutable_headers();
+                    for (auto& name : { Content_Length, Connection })
+                    {
+                        mutable_headers.erase(std::remove_if(mutable_headers.begin(),
+                                                             mutable_headers.end(),
+                                                             match_header_name(name)),
+                                              mutable_headers.end());
+                    }
+                    _response_mode = response_mode::undecided;
+                    set_content_length(content_length_variable());
+                    _compression_state = compression_state::streaming;
+                }
+                break;
+                
+            case response_mode::undecided:
+            case response_mode::chunked:
+            case response_mode::raw:
+                _compression_state = compression_state::pending;
+                break;
+        }
+        
+        auto which = *coding == "gzip" ? content_coding::gzip : content_coding::deflate;
+        _compressor = acquire_compressor(which, _compression.level);
+        // a held back body which ends up too small is not compressed for
+        // any client, so it does not vary
+        if (_compression_state != compression_state::pending)
+        {
+            add_header(mutable_header(), "Vary", "Accept-Encoding");
+            add_header(mutable_header(), "Content-Encoding", coding_name(which).to_string());
+        }
+    }
+    
+    void dispatch_context::response_object::begin_streaming_compression()
+    {
+        assert(_compression_state == compression_state::pending);
+        add_header(mutable_header(), "Vary", "Accept-Encoding");
+        add_header(mutable_header(), "Content-Encoding", coding_name(_compressor->coding()).to_string());
+        _compression_state = compression_state::streaming;
+        _compressor->compress(asio::buffer(_compression_input), compress_flush::none, _compressed);
+        _written_since_sync = _compression_input.size();
+        _compression_input.clear();
+    }
+    
+    void dispatch_context::response_object::sync_compression()
+    {
+        if (_written_since_sync)
+            _compressor->compress(asio::const_buffer(), compress_flush::sync, _compressed);
+        _written_since_sync = 0;
+    }
+    
+    void dispatch_context::response_object::flush_compression(error_code& ec)
+    {
+        ec.clear();
+        if (_compression_state == compression_state::pending and not _compression_input.empty())
+            begin_streaming_compression();
+        if (_compression_state != compression_state::streaming)
+            return;
+        sync_compression();
+        write_compressed(ec);
+    }
+    
+    void dispatch_context::response_object::flush_compression()
+    {
+        error_code ec;
+        flush_compression(ec);
+        if (ec) throw system_error(ec);
+    }
+    
+    void dispatch_context::response_object::write_compressed(error_code& ec)
+    {
+        ec.clear();
+        if (_compressed.empty())
+            return;
+        
+        prepare_write(ec);
+        if (not ec)
+        {
+            if (_response_mode == response_mode::chunked)
+                write_chunk(asio::buffer(_compressed), ec);
+            else
+                asio::write(stream(), asio::buffer(_compressed), ec);
+        }
+        _compressed.clear();
+    }
+    
+    void dispatch_context::response_object::finish_compression(error_code& ec)
+    {
+        ec.clear();
+        auto state = _compression_state;
+        _compression_state = compression_state::off;
+        
+        switch (state)
+        {
+            case compression_state::pending: {
+                // too small to be worth compressing
+                auto body = std::move(_compression_input);
+                if (_response_mode == response_mode::undecided)
+                    set_content_length(content_length_fixed(body.size()));
+                prepare_write(ec);
+                if (not ec and not body.empty())
+                    write_some(asio::buffer(body), ec);
+            } break;
+                
+            case compression_state::buffered: {
+                _compressor->compress(asio::const_buffer(), compress_flush::finish, _compressed);
+                set_header(mutable_header(), Content_Length, std::to_string(_compressed.size()));
+                _content_length = _compressed.size();
+                if (start_entity_tag())
+                {
+                    // the tag is of the compressed representation
+                    _held_body = std::move(_compressed);
+                    send_held_body(ec);
+                }
+                else
+                {
+                    prepare_write(ec);
+                    if (not ec)
+                    {
+                        asio::write(stream(), asio::buffer(_compressed), ec);
+                        capture_body(asio::buffer(_compressed));
+                    }
+                }
+                _compressed.clear();
+            } break;
+                
+            case compression_state::streaming: {
+                _compressor->compress(asio::const_buffer(), compress_flush::finish, _compressed);
+                write_compressed(ec);
+            } break;
+                
+            case compression_state::undecided:
+            case compression_state::off:
+                break;
+        }
+        
+        // back to this thread's pool
+        _compressor.reset();
+    }
+    
+    void dispatch_context::response_object::write_last_chunk(error_code& ec)
+    {
+        chunk_header header(_coalesced.size());
+        boost::container::small_vector<asio::const_buffer, 4> buffers;
+        if (not _coalesced.empty())
+        {
+            buffers.push_back(header.buffer());
+            buffers.push_back(asio::buffer(_coalesced));
+            buffers.push_back(chunk_trailer());
+        }
+        buffers.push_back(last_chunk());
+        asio::write(stream(), buffers, ec);
+        _coalesced.clear();
+    }
+    
     auto dispatch_context::response_object::close(error_code& ec)
     -> error_code
     {
         
+        if (not _last_error and compressing()) {
+            finish_compression(ec);
+            if (ec) {
+                _last_error = ec;
+                return ec;
+            }
+        }
+        
+        // a body shorter than its Content-Length
+        if (not _last_error and _entity_tag_state == entity_tag_state::holding) {
+            send_held_body(ec);
+            if (ec) {
+                _last_error = ec;
+                return ec;
+            }
+        }
+        
         if (not _last_error) {
             ec.clear();
             switch(_response_mode)
             {
                 case response_mode::chunked: {
-                    static const char last_chunk[] = { '0', '\r', '\n', '\r', '\n' };
-                    asio::write(stream(), asio::buffer(last_chunk), ec);
+                    if (discarding_body())
+                        _coalesced.clear();
+                    else
+                        write_last_chunk(ec);
                     if (not ec) {
                         stream().close();
                     }
@@ -170,6 +404,13 @@ namespace secr { namespace dispatch { namespace http {
                 case response_mode::raw:
                 case response_mode::content_length: {
                     _last_error = asio::error::misc_errors::eof;
+                    if (_cache_capture == cache_capture::on)
+                    {
+                        _cache_capture = cache_capture::off;
+                        _request_context.response_cache()->insert(_request_context.raw_header(),
+                                                                  header(),
+                                                                  std::move(_cache_body));
+                    }
                     stream().close();
                 } break;
                     
@@ -190,6 +431,238 @@ namespace secr { namespace dispatch { namespace http {
         }
     }
     
+    void dispatch_context::response_object::close()
+    {
+        error_code ec;
+        close(ec);
+        if (ec) throw system_error(ec);
+    }
+    
+    namespace {
+        
+        /// closes the file once the response no longer needs it
+        struct file_handle
+        {
+            explicit file_handle(int fd) : fd(fd) {}
+            file_handle(const file_handle&) = delete;
+            file_handle& operator=(const file_handle&) = delete;
+            ~file_handle() { ::close(fd); }
+            int fd;
+        };
+        
+        error_code last_system_error()
+        {
+            return error_code(errno, boost::system::system_category());
+        }
+        
+        std::string make_boundary()
+        {
+            static const char digits[] = "0123456789abcdef";
+            thread_local std::mt19937_64 engine { std::random_device()() };
+            std::string result = "secr_dispatch_";
+            for (auto n = engine() ; result.size() < 30 ; n >>= 4)
+                result.push_back(digits[n & 0xf]);
+            return result;
+        }
+        
+        std::string content_range(const byte_range& range, std::uint64_t length)
+        {
+            return "bytes " + std::to_string(range.first) + "-" + std::to_string(range.last)
+            + "/" + std::to_string(length);
+        }
+        
+        void ignore_attachment(const error_code&, std::size_t) {}
+    }
+    
+    void dispatch_context::response_object::send_file(const std::string& path, error_code& ec)
+    {
+        auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            ec = last_system_error();
+            return;
+        }
+        auto file = std::make_shared<file_handle>(fd);
+        
+        struct stat st;
+        if (::fstat(fd, std::addressof(st)) < 0)
+        {
+            ec = last_system_error();
+            return;
+        }
+        if (not S_ISREG(st.st_mode))
+        {
+            ec = error_code(EISDIR, boost::system::system_category());
+            return;
+        }
+        send_file(std::move(file), fd, 0, std::uint64_t(st.st_size), st.st_mtime, ec);
+    }
+    
+    void dispatch_context::response_object::send_file(const std::string& path)
+    {
+        error_code ec;
+        send_file(path, ec);
+        if (ec) throw system_error(ec, path);
+    }
+    
+    void dispatch_context::response_object::send_file(int fd, std::uint64_t offset,
+                                                      std::uint64_t length, error_code& ec)
+    {
+        auto copy = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (copy < 0)
+        {
+            ec = last_system_error();
+            return;
+        }
+        auto file = std::make_shared<file_handle>(copy);
+        
+        struct stat st;
+        if (::fstat(copy, std::addressof(st)) < 0)
+        {
+            ec = last_system_error();
+            return;
+        }
+        if (not S_ISREG(st.st_mode))
+        {
+            ec = error_code(EINVAL, boost::system::system_category());
+            return;
+        }
+        
+        // the Content-Length is committed before the file is read, so it may
+        // only count bytes which the file holds
+        auto size = std::uint64_t(st.st_size);
+        offset = std::min(offset, size);
+        length = std::min(length, size - offset);
+        send_file(std::move(file), copy, offset, length, st.st_mtime, ec);
+    }
+    
+    void dispatch_context::response_object::send_file(int fd, std::uint64_t offset, std::uint64_t length)
+    {
+        error_code ec;
+        send_file(fd, offset, length, ec);
+        if (ec) throw system_error(ec, "send_file");
+    }
+    
+    void dispatch_context::response_object::send_file(std::shared_ptr<const void> file, int fd,
+                                                      std::uint64_t offset, std::uint64_t length,
+                                                      std::time_t modified, error_code& ec)
+    {
+        assert(not header_committed());
+        ec.clear();
+        _compression_state = compression_state::off;
+        _entity_tag_state = entity_tag_state::off;
+        _cache_capture = cache_capture::off;
+        
+        auto& header = mutable_header();
+        if (not header.has_status())
+            set_status(header, 200, "OK");
+        set_header(header, "Accept-Ranges", "bytes");
+        
+        char last_modified[http_date_size];
+        if (modified)
+        {
+            format_http_date(modified, last_modified);
+            set_header(header, "Last-Modified", std::string(last_modified, sizeof(last_modified)));
+        }
+        
+        auto& request = _request_context.raw_header();
+        auto is_head = request.method() == string_view("HEAD");
+        
+        // a validator which does not match asks for the whole file
+        std::vector<byte_range> ranges;
+        auto disposition = range_disposition::ignore;
+        if (header.status().code() == 200
+            and request.method() == string_view("GET")
+            and request.index().count(header_id::range))
+        {
+            auto if_range = request.index().value(header_id::if_range);
+            if (if_range.size() == 0
+                or (modified and if_range == string_view(last_modified, sizeof(last_modified))))
+            {
+                disposition = parse_byte_ranges(request.index().value(header_id::range),
+                                                length, ranges);
+            }
+        }
+        
+        auto attach = [&](const byte_range& range)
+        {
+            if (not is_head)
+                stream().attach(fake_stream::file_region { fd, offset + range.first, std::size_t(range.size()) },
+                                file, ignore_attachment);
+        };
+        
+        switch (disposition)
+        {
+            case range_disposition::unsatisfiable: {
+                set_status(header, 416, "Range Not Satisfiable");
+                set_header(header, "Content-Range", "bytes */" + std::to_string(length));
+                set_content_length(content_length_fixed(0));
+                commit_header(ec);
+            } break;
+                
+            case range_disposition::ignore: {
+                set_content_length(content_length_fixed(length));
+                commit_header(ec);
+                if (not ec and length)
+                    attach(byte_range { 0, length - 1 });
+            } break;
+                
+            case range_disposition::satisfiable: {
+                set_status(header, 206, "Partial Content");
+                if (ranges.size() == 1)
+                {
+                    set_header(header, "Content-Range", content_range(ranges.front(), length));
+                    set_content_length(content_length_fixed(ranges.front().size()));
+                    commit_header(ec);
+                    if (not ec)
+                        attach(ranges.front());
+                    break;
+                }
+                
+                // each part is introduced by a delimiter and its own header
+                auto boundary = make_boundary();
+                std::string part_type;
+                auto& headers = *header.mutable_headers();
+                auto type = std::find_if(headers.begin(), headers.end(), match_header_name("Content-Type"));
+                if (type != headers.end())
+                {
+                    part_type = "Content-Type: " + type->value() + "\r\n";
+                    headers.erase(type);
+                }
+                add_header(header, "Content-Type", "multipart/byteranges; boundary=" + boundary);
+                
+                std::vector<std::string> part_headers;
+                std::uint64_t content_length = 0;
+                for (auto& range : ranges)
+                {
+                    part_headers.push_back((part_headers.empty() ? "--" : "\r\n--") + boundary + "\r\n"
+                                           + part_type
+                                           + "Content-Range: " + content_range(range, length) + "\r\n"
+                                           + "\r\n");
+                    content_length += part_headers.back().size() + range.size();
+                }
+                auto closing = "\r\n--" + boundary + "--\r\n";
+                content_length += closing.size();
+                
+                set_content_length(content_length_fixed(content_length));
+                commit_header(ec);
+                for (std::size_t i = 0 ; i < ranges.size() and not ec and not is_head ; ++i)
+                {
+                    asio::write(stream(), asio::buffer(part_headers[i]), ec);
+                    if (not ec)
+                        attach(ranges[i]);
+                }
+                if (not ec and not is_head)
+                    asio::write(stream(), asio::buffer(closing), ec);
+            } break;
+        }
+        
+        if (ec)
+            _last_error = ec;
+        else
+            close(ec);
+    }
+    
     std::size_t dispatch_context::response_object::commit_header(error_code& ec)
     {
         assert(!_header_committed);
@@ -200,8 +673,13 @@ namespace secr { namespace dispatch { namespace http {
             return 0;
         }
         
-        auto data = to_response_buffer(header());
+        auto data = to_response_buffer(header(), _request_context.date_header());
         _header_committed = true;
+        
+        // the header of a response to HEAD describes a body which is not sent
+        if (_request_context.raw_header().method() == string_view("HEAD"))
+            _response_size_limit = 0;
+        decide_cache_capture();
         return asio::write(stream(), asio::buffer(data), ec);
     }
 
@@ -214,6 +692,154 @@ namespace secr { namespace dispatch { namespace http {
     }
 
     
+    void dispatch_context::response_object::set_entity_tags(const entity_tag_options& options)
+    {
+        assert(_entity_tag_state == entity_tag_state::undecided);
+        _entity_tags = options;
+    }
+    
+    void dispatch_context::response_object::decide_entity_tag()
+    {
+        _entity_tag_state = entity_tag_state::off;
+        if (not _entity_tags.enabled or header_committed())
+            return;
+        
+        // only a complete body of known length, which the handler has not
+        // tagged itself
+        if (_response_mode != response_mode::content_length
+            or _content_length > _entity_tags.buffer_limit)
+        {
+            return;
+        }
+        auto code = header().has_status() ? header().status().code() : 200;
+        if (code != 200)
+            return;
+        if (_request_context.raw_header().method() != string_view("GET"))
+            return;
+        auto& headers = header().headers();
+        if (std::any_of(headers.begin(), headers.end(), match_header_name("ETag")))
+            return;
+        
+        _entity_tag_state = entity_tag_state::holding;
+        _held_body.reserve(_content_length);
+    }
+    
+    bool dispatch_context::response_object::request_has_entity(const std::string& entity_tag) const
+    {
+        bool matched = false;
+        _request_context.raw_header().index().for_each(header_id::if_none_match,
+                                                       [&](const raw_header_field& field) {
+            if (if_none_match(field.value.view(), entity_tag))
+                matched = true;
+        });
+        return matched;
+    }
+    
+    void dispatch_context::response_object::make_not_modified()
+    {
+        auto& headers = *mutable_header().mutable_headers();
+        for (auto& name : { Content_Length, Transfer_Encoding })
+        {
+            headers.erase(std::remove_if(headers.begin(),
+                                         headers.end(),
+                                         match_header_name(name)),
+                          headers.end());
+        }
+        set_status(mutable_header(), 304, "Not Modified");
+        
+        // a 304 ends with its header, so no last chunk may follow it
+        if (_response_mode == response_mode::chunked)
+        {
+            _response_mode = response_mode::content_length;
+            _coalesced.clear();
+        }
+        
+        // whatever else the handler writes is discarded
+        _response_size_limit = 0;
+    }
+    
+    void dispatch_context::response_object::send_held_body(error_code& ec)
+    {
+        ec.clear();
+        _entity_tag_state = entity_tag_state::off;
+        auto body = std::move(_held_body);
+        _held_body.clear();
+        
+        auto entity_tag = strong_entity_tag(xxh64(body.data(), body.size()));
+        add_header(mutable_header(), "ETag", entity_tag);
+        if (request_has_entity(entity_tag))
+        {
+            make_not_modified();
+            prepare_write(ec);
+            return;
+        }
+        
+        prepare_write(ec);
+        if (not ec and not body.empty())
+        {
+            asio::write(stream(), asio::buffer(body), ec);
+            capture_body(asio::buffer(body));
+        }
+    }
+    
+    bool dispatch_context::response_object::check_not_modified(const std::string& entity_tag,
+                                                               error_code& ec)
+    {
+        assert(not header_committed());
+        ec.clear();
+        
+        // the handler's tag stands in for one made from the body
+        _entity_tag_state = entity_tag_state::off;
+        set_header(mutable_header(), "ETag", entity_tag);
+        if (not request_has_entity(entity_tag))
+            return false;
+        
+        _compression_state = compression_state::off;
+        if (_response_mode == response_mode::undecided)
+            set_content_length(content_length_fixed(0));
+        make_not_modified();
+        commit_header(ec);
+        if (not ec)
+            close(ec);
+        return true;
+    }
+    
+    bool dispatch_context::response_object::check_not_modified(const std::string& entity_tag)
+    {
+        error_code ec;
+        auto result = check_not_modified(entity_tag, ec);
+        if (ec) throw system_error(ec);
+        return result;
+    }
+    
+    void dispatch_context::response_object::decide_cache_capture()
+    {
+        if (_cache_capture != cache_capture::undecided)
+            return;
+        _cache_capture = cache_capture::off;
+        
+        // only a whole body of known length can be stored
+        auto& cache = _request_context.response_cache();
+        if (not cache
+            or _response_mode != response_mode::content_length
+            or _content_length > cache->max_entry_size()
+            or not response_cache::cacheable_request(_request_context.raw_header())
+            or response_cache::lifetime(header()).count() == 0)
+        {
+            return;
+        }
+        _cache_capture = cache_capture::on;
+        _cache_body.reserve(_content_length);
+    }
+    
+    void dispatch_context::response_object::capture_body(asio::const_buffer data)
+    {
+        if (_cache_capture != cache_capture::on)
+            return;
+        auto p = asio::buffer_cast<const char*>(data);
+        _cache_body.insert(_cache_body.end(), p, p + asio::buffer_size(data));
+    }
+    
     void
     dispatch_context::response_object::
     commit_with_exception(std::exception_ptr ep)
@@ -236,7 +862,8 @@ namespace secr { namespace dispatch { namespace http {
         set_header(header, "X-Secr-Message-Type", emsg->GetDescriptor()->full_name());
         try {
             commit_header();
-            asio::write(stream(), asio::buffer(body));
+            if (not discarding_body())
+                asio::write(stream(), asio::buffer(body));
             stream().close();
         }
         catch(...) {
@@ -0,0 +1,162 @@
+#include <secr/dispatch/http/entity_tag.hpp>
+#include <secr/dispatch/http/header_index.hpp>
+
+#include <cstring>
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        constexpr std::uint64_t prime1 = 0x9e3779b185ebca87ull;
+        constexpr std::uint64_t prime2 = 0xc2b2ae3d27d4eb4full;
+        constexpr std::uint64_t prime3 = 0x165667b19e3779f9ull;
+        constexpr std::uint64_t prime4 = 0x85ebca77c2b2ae63ull;
+        constexpr std::uint64_t prime5 = 0x27d4eb2f165667c5ull;
+
+        std::uint64_t rotl(std::uint64_t x, int r)
+        {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        std::uint64_t read64(const unsigned char* p)
+        {
+            std::uint64_t result;
+            std::memcpy(std::addressof(result), p, sizeof(result));
+            return result;
+        }
+
+        std::uint32_t read32(const unsigned char* p)
+        {
+            std::uint32_t result;
+            std::memcpy(std::addressof(result), p, sizeof(result));
+            return result;
+        }
+
+        std::uint64_t round(std::uint64_t acc, std::uint64_t input)
+        {
+            acc += input * prime2;
+            acc = rotl(acc, 31);
+            return acc * prime1;
+        }
+
+        std::uint64_t merge_round(std::uint64_t acc, std::uint64_t value)
+        {
+            acc ^= round(0, value);
+            return acc * prime1 + prime4;
+        }
+
+        /// the opaque part of an entity tag, without any weakness indicator
+        string_view opaque_tag(string_view tag)
+        {
+            if (tag.size() >= 2 and tag.begin()[0] == 'W' and tag.begin()[1] == '/')
+                tag = string_view(tag.begin() + 2, tag.size() - 2);
+            return tag;
+        }
+    }
+
+    std::uint64_t xxh64(const void* data, std::size_t size, std::uint64_t seed)
+    {
+        // little-endian hosts only, as for the rest of the wire handling
+        auto p = static_cast<const unsigned char*>(data);
+        auto end = p + size;
+        std::uint64_t h;
+
+        if (size >= 32)
+        {
+            auto v1 = seed + prime1 + prime2;
+            auto v2 = seed + prime2;
+            auto v3 = seed;
+            auto v4 = seed - prime1;
+            auto limit = end - 32;
+            do {
+                v1 = round(v1, read64(p)); p += 8;
+                v2 = round(v2, read64(p)); p += 8;
+                v3 = round(v3, read64(p)); p += 8;
+                v4 = round(v4, read64(p)); p += 8;
+            } while (p <= limit);
+
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge_round(h, v1);
+            h = merge_round(h, v2);
+            h = merge_round(h, v3);
+            h = merge_round(h, v4);
+        }
+        else
+        {
+            h = seed + prime5;
+        }
+
+        h += std::uint64_t(size);
+
+        while (p + 8 <= end)
+        {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * prime1 + prime4;
+            p += 8;
+        }
+        if (p + 4 <= end)
+        {
+            h ^= std::uint64_t(read32(p)) * prime1;
+            h = rotl(h, 23) * prime2 + prime3;
+            p += 4;
+        }
+        while (p < end)
+        {
+            h ^= (*p) * prime5;
+            h = rotl(h, 11) * prime1;
+            ++p;
+        }
+
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    std::string strong_entity_tag(std::uint64_t value)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string result(18, '"');
+        for (int i = 16 ; i > 0 ; --i)
+        {
+            result[i] = digits[value & 0xf];
+            value >>= 4;
+        }
+        return result;
+    }
+
+    bool if_none_match(string_view header_value, string_view entity_tag)
+    {
+        auto wanted = opaque_tag(entity_tag);
+        auto first = header_value.begin();
+        auto last = header_value.end();
+        while (first != last)
+        {
+            while (first != last and (is_space(*first) or *first == ','))
+                ++first;
+            if (first == last)
+                break;
+            if (*first == '*')
+                return true;
+
+            // an entity tag is [W/]"opaque", and the opaque part may contain commas
+            auto tag_first = first;
+            if (last - first >= 2 and first[0] == 'W' and first[1] == '/')
+                first += 2;
+            if (first == last or *first != '"')
+                return false;
+            auto close = first + 1;
+            while (close != last and *close != '"')
+                ++close;
+            if (close == last)
+                return false;
+            first = close + 1;
+            if (opaque_tag(string_view(tag_first, std::size_t(first - tag_first))) == wanted)
+                return true;
+        }
+        return false;
+    }
+
+}}}
@@ -20,6 +20,12 @@ namespace secr { namespace dispatch { namespace http {
                     case protocol_error_code::response_mode_not_set:
                         return "response mode not set";
                         
+                    case protocol_error_code::bad_message_frame:
+                        return "bad message frame";
+                        
+                    case protocol_error_code::not_acceptable:
+                        return "the client accepts none of the offered media types";
+                        
                     default:
                         return "unknown error: " + std::to_string(ev);
                 }
@@ -0,0 +1,187 @@
+#include <secr/dispatch/http/header_index.hpp>
+#include <secr/dispatch/http/raw_request_header.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        /// in the same order as header_id
+        const string_view header_names[header_id_count] = {
+            "",
+            "Accept",
+            "Accept-Charset",
+            "Accept-Encoding",
+            "Accept-Language",
+            "Authorization",
+            "Cache-Control",
+            "Connection",
+            "Content-Encoding",
+            "Content-Length",
+            "Content-Type",
+            "Cookie",
+            "Date",
+            "ETag",
+            "Expect",
+            "Host",
+            "If-Match",
+            "If-Modified-Since",
+            "If-None-Match",
+            "If-Range",
+            "If-Unmodified-Since",
+            "Keep-Alive",
+            "Last-Modified",
+            "Origin",
+            "Range",
+            "Referer",
+            "TE",
+            "Trailer",
+            "Transfer-Encoding",
+            "Upgrade",
+            "User-Agent",
+            "Vary",
+            "X-Forwarded-For",
+        };
+
+        constexpr char ascii_lower(char c)
+        {
+            return (c >= 'A' and c <= 'Z') ? char(c | 0x20) : c;
+        }
+
+        /// The multipliers were chosen by search so that every well-known name
+        /// lands in its own slot
+        constexpr std::size_t hash_slots = 64;
+
+        std::size_t header_hash(string_view name)
+        {
+            auto len = name.size();
+            auto p = name.begin();
+            return (len * 5
+                    + std::size_t(std::uint8_t(ascii_lower(p[0]))) * 17
+                    + std::size_t(std::uint8_t(ascii_lower(p[len - 1]))) * 21
+                    + std::size_t(std::uint8_t(ascii_lower(p[len / 2]))))
+            & (hash_slots - 1);
+        }
+
+        struct header_hash_table
+        {
+            header_hash_table()
+            {
+                _slots.fill(header_id::unknown);
+                for (std::size_t i = 1 ; i < header_id_count ; ++i)
+                {
+                    auto& slot = _slots[header_hash(header_names[i])];
+                    assert(slot == header_id::unknown);
+                    slot = static_cast<header_id>(i);
+                }
+            }
+
+            header_id lookup(string_view name) const
+            {
+                return _slots[header_hash(name)];
+            }
+
+            std::array<header_id, hash_slots> _slots;
+        };
+
+        const header_hash_table& hash_table()
+        {
+            static const header_hash_table table;
+            return table;
+        }
+    }
+
+    constexpr std::size_t header_index::npos;
+
+    string_view header_name(header_id id)
+    {
+        return header_names[static_cast<std::size_t>(id)];
+    }
+
+    header_id identify_header(string_view name)
+    {
+        if (name.size() == 0)
+            return header_id::unknown;
+        auto candidate = hash_table().lookup(name);
+        if (candidate != header_id::unknown and is_header(name, candidate))
+            return candidate;
+        return header_id::unknown;
+    }
+
+    bool iequals_ascii(string_view l, string_view r)
+    {
+        if (l.size() != r.size())
+            return false;
+
+        auto p = l.begin();
+        auto q = r.begin();
+        auto n = l.size();
+
+#if defined(__SSE2__)
+        // fold 'A'-'Z' to lower case 16 bytes at a time. Bytes >= 0x80 compare
+        // as negative and so are never folded.
+        const auto before_a = _mm_set1_epi8('A' - 1);
+        const auto after_z = _mm_set1_epi8('Z' + 1);
+        const auto case_bit = _mm_set1_epi8(0x20);
+        auto fold = [&](__m128i x) {
+            auto upper = _mm_and_si128(_mm_cmpgt_epi8(x, before_a), _mm_cmplt_epi8(x, after_z));
+            return _mm_or_si128(x, _mm_and_si128(upper, case_bit));
+        };
+        for ( ; n >= 16 ; n -= 16, p += 16, q += 16)
+        {
+            auto a = fold(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+            auto b = fold(_mm_loadu_si128(reinterpret_cast<const __m128i*>(q)));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xffff)
+                return false;
+        }
+#endif
+        for ( ; n ; --n, ++p, ++q)
+        {
+            if (ascii_lower(*p) != ascii_lower(*q))
+                return false;
+        }
+        return true;
+    }
+
+    void header_index::clear()
+    {
+        _fields = nullptr;
+        _first.fill(0);
+        _count.fill(0);
+        _ids.clear();
+    }
+
+    void header_index::build(const std::vector<raw_header_field>& fields)
+    {
+        clear();
+        _fields = std::addressof(fields);
+        _ids.reserve(fields.size());
+        for (std::size_t pos = 0 ; pos < fields.size() ; ++pos)
+        {
+            auto id = identify_header(fields[pos].name.view());
+            _ids.push_back(id);
+            auto i = static_cast<std::size_t>(id);
+            if (_count[i]++ == 0)
+                _first[i] = std::uint32_t(pos + 1);
+        }
+    }
+
+    const raw_header_field* header_index::find(header_id id) const
+    {
+        auto pos = position(id);
+        if (pos == npos or id == header_id::unknown)
+            return nullptr;
+        return std::addressof((*_fields)[pos]);
+    }
+
+    string_view header_index::value(header_id id) const
+    {
+        if (auto field = find(id))
+            return field->value.view();
+        return string_view();
+    }
+
+}}}
@@ -0,0 +1,61 @@
+#include <secr/dispatch/http/identifiers.hpp>
+#include <atomic>
+#include <cstdint>
+#include <random>
+
+#include <pthread.h>
+
+namespace secr { namespace dispatch { namespace http {
+    
+    namespace {
+        
+        std::uint64_t random_prefix()
+        {
+            std::random_device rd;
+            return (std::uint64_t(rd()) << 32) ^ std::uint64_t(rd());
+        }
+        
+        std::atomic<std::uint64_t> prefix { 0 };
+
+        void redraw_prefix()
+        {
+            prefix.store(random_prefix(), std::memory_order_relaxed);
+        }
+
+        std::uint64_t current_prefix()
+        {
+            static const bool drawn = [] {
+                redraw_prefix();
+                // a forked child would otherwise repeat its parent's ids
+                ::pthread_atfork(nullptr, nullptr, &redraw_prefix);
+                return true;
+            }();
+            (void)drawn;
+            return prefix.load(std::memory_order_relaxed);
+        }
+
+        void store_big_endian(std::uint8_t* dest, std::uint64_t value)
+        {
+            for (int i = 7 ; i >= 0 ; --i) {
+                dest[i] = std::uint8_t(value & 0xff);
+                value >>= 8;
+            }
+        }
+    }
+    
+    boost::uuids::uuid next_uuid()
+    {
+        static std::atomic<std::uint64_t> counter { 0 };
+        
+        boost::uuids::uuid result;
+        store_big_endian(result.data, current_prefix());
+        store_big_endian(result.data + 8, counter.fetch_add(1, std::memory_order_relaxed));
+        
+        // version 8 (custom layout), since the ids are not random
+        result.data[6] = (result.data[6] & 0x0f) | 0x80;
+        // variant 1 (RFC 4122). The top two bits of the counter are sacrificed.
+        result.data[8] = (result.data[8] & 0x3f) | 0x80;
+        return result;
+    }
+    
+}}}
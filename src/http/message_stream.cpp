@@ -0,0 +1,238 @@
+#include <secr/dispatch/http/message_stream.hpp>
+#include <secr/dispatch/http/negotiation.hpp>
+#include <secr/dispatch/http/response_header.hpp>
+#include <secr/dispatch/api/json.hpp>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/util/json_util.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace secr { namespace dispatch { namespace http {
+
+    const char delimited_protobuf_media_type[] = "application/x-protobuf-delimited";
+    const char ndjson_media_type[] = "application/x-ndjson";
+
+    namespace {
+
+        const char* media_type(message_framing framing)
+        {
+            return framing == message_framing::length_delimited
+            ? delimited_protobuf_media_type
+            : ndjson_media_type;
+        }
+
+        /// the largest message the reader accepts, as for a protobuf message
+        /// read through a CodedInputStream
+        constexpr std::uint64_t max_message_size = std::numeric_limits<int>::max();
+
+        enum class varint_result { complete, incomplete, bad };
+
+        varint_result read_varint(const char* first, const char* last, std::uint64_t& value, std::size_t& size)
+        {
+            value = 0;
+            for (size = 0 ; size < 10 ; ++size)
+            {
+                if (first + size == last)
+                    return varint_result::incomplete;
+                auto byte = std::uint8_t(first[size]);
+                value |= std::uint64_t(byte & 0x7f) << (7 * size);
+                if (not (byte & 0x80))
+                {
+                    ++size;
+                    return varint_result::complete;
+                }
+            }
+            return varint_result::bad;
+        }
+    }
+
+    bool append_frame(std::string& out, const google::protobuf::Message& message, message_framing framing)
+    {
+        if (framing == message_framing::ndjson)
+        {
+            // compact json escapes newlines within strings, so each message
+            // is exactly one line
+            api::append_json(out, message, api::json_options(api::compact_json, api::include_defaults));
+            out += '\n';
+            return true;
+        }
+
+        auto size = message.ByteSizeLong();
+        if (size > max_message_size)
+            return false;
+
+        auto prefix_size = google::protobuf::io::CodedOutputStream::VarintSize32(std::uint32_t(size));
+        auto offset = out.size();
+        out.resize(offset + prefix_size + size);
+        auto data = reinterpret_cast<std::uint8_t*>(&out[offset]);
+        data = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(std::uint32_t(size), data);
+        message.SerializeWithCachedSizesToArray(data);
+        return true;
+    }
+
+    message_stream_writer::message_stream_writer(dispatch_context context)
+    : _context(std::move(context))
+    {
+        static const offered_media_types offers { delimited_protobuf_media_type, ndjson_media_type };
+        auto offer = _context.request().negotiate(offers);
+        if (not offer)
+        {
+            refuse();
+            return;
+        }
+        if (offer->text == delimited_protobuf_media_type)
+            _framing = message_framing::length_delimited;
+        start();
+    }
+
+    message_stream_writer::message_stream_writer(dispatch_context context, message_framing framing)
+    : _context(std::move(context))
+    , _framing(framing)
+    {
+        start();
+    }
+
+    void message_stream_writer::start()
+    {
+        auto& response = _context.response();
+        set_header(response.mutable_header(), "Content-Type", media_type(_framing));
+        response.set_content_length(content_length_variable());
+    }
+
+    void message_stream_writer::refuse()
+    {
+        static const std::string text = std::string(delimited_protobuf_media_type)
+        + " or " + ndjson_media_type + " only";
+        _accepted = false;
+        auto& response = _context.response();
+        auto& header = response.mutable_header();
+        set_status(header, 406, standard_reason(406).to_string());
+        set_header(header, "Content-Type", "text/plain");
+        error_code ec;
+        response.flush(asio::buffer(text), ec);
+    }
+
+    void message_stream_writer::write(const google::protobuf::Message& message, error_code& ec)
+    {
+        if (not _accepted)
+        {
+            ec = make_error_code(protocol_error_code::not_acceptable);
+            return;
+        }
+        _frame.clear();
+        if (not append_frame(_frame, message, _framing))
+        {
+            ec = make_error_code(protocol_error_code::bad_message_frame);
+            return;
+        }
+        auto& response = _context.response();
+        response.write_some(asio::buffer(_frame), ec);
+        if (not ec)
+            response.flush_compression(ec);
+        if (not ec)
+            ++_messages_written;
+    }
+
+    void message_stream_writer::write(const google::protobuf::Message& message)
+    {
+        error_code ec;
+        write(message, ec);
+        if (ec) throw system_error(ec);
+    }
+
+    void message_stream_writer::close(error_code& ec)
+    {
+        // a refused stream was closed with its 406
+        if (not _accepted)
+        {
+            ec.clear();
+            return;
+        }
+        _context.response().close(ec);
+    }
+
+    void message_stream_writer::close()
+    {
+        error_code ec;
+        close(ec);
+        if (ec) throw system_error(ec);
+    }
+
+    message_stream_reader::message_stream_reader(message_framing framing)
+    : _framing(framing)
+    {}
+
+    void message_stream_reader::feed(const char* data, std::size_t size)
+    {
+        compact();
+        _buffer.append(data, size);
+    }
+
+    bool message_stream_reader::next(google::protobuf::Message& message, error_code& ec)
+    {
+        ec.clear();
+        auto first = _buffer.data() + _consumed;
+        auto last = _buffer.data() + _buffer.size();
+
+        if (_framing == message_framing::ndjson)
+        {
+            auto eol = std::find(first, last, '\n');
+            if (eol == last)
+                return false;
+            auto status = google::protobuf::util::JsonStringToMessage(std::string(first, eol), &message);
+            if (not status.ok())
+            {
+                ec = make_error_code(protocol_error_code::bad_message_frame);
+                return false;
+            }
+            _consumed += std::size_t(eol - first) + 1;
+            return true;
+        }
+
+        std::uint64_t size;
+        std::size_t prefix_size;
+        switch (read_varint(first, last, size, prefix_size))
+        {
+            case varint_result::incomplete:
+                return false;
+            case varint_result::bad:
+                ec = make_error_code(protocol_error_code::bad_message_frame);
+                return false;
+            case varint_result::complete:
+                break;
+        }
+        if (size > max_message_size)
+        {
+            ec = make_error_code(protocol_error_code::bad_message_frame);
+            return false;
+        }
+        if (std::uint64_t(last - first) - prefix_size < size)
+            return false;
+
+        if (not message.ParseFromArray(first + prefix_size, int(size)))
+        {
+            ec = make_error_code(protocol_error_code::bad_message_frame);
+            return false;
+        }
+        _consumed += prefix_size + std::size_t(size);
+        return true;
+    }
+
+    bool message_stream_reader::next(google::protobuf::Message& message)
+    {
+        error_code ec;
+        auto result = next(message, ec);
+        if (ec) throw system_error(ec);
+        return result;
+    }
+
+    void message_stream_reader::compact()
+    {
+        _buffer.erase(0, _consumed);
+        _consumed = 0;
+    }
+
+}}}
@@ -0,0 +1,362 @@
+#include <secr/dispatch/http/negotiation.hpp>
+#include <secr/dispatch/http/header_index.hpp>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        std::string lower(string_view s)
+        {
+            std::string result(s.begin(), s.end());
+            for (auto& c : result)
+                if (c >= 'A' and c <= 'Z') c = char(c | 0x20);
+            return result;
+        }
+
+        std::string unquote(string_view s)
+        {
+            if (s.size() >= 2 and *s.begin() == '"' and *(s.end() - 1) == '"')
+            {
+                std::string result;
+                for (auto p = s.begin() + 1 ; p != s.end() - 1 ; ++p)
+                {
+                    if (*p == '\\' and p + 1 != s.end() - 1) ++p;
+                    result.push_back(*p);
+                }
+                return result;
+            }
+            return std::string(s.begin(), s.end());
+        }
+
+        /// call f(part) for each ';' separated part, trimmed
+        template<class F>
+        void for_each_part(string_view s, F&& f)
+        {
+            auto first = s.begin();
+            auto last = s.end();
+            while (true)
+            {
+                auto semi = std::find(first, last, ';');
+                f(trim(string_view(first, std::size_t(semi - first))));
+                if (semi == last)
+                    break;
+                first = semi + 1;
+            }
+        }
+
+        /// Parse "type/subtype *(; name=value)". If q is not null, a q
+        /// parameter ends the media type parameters and sets *q.
+        /// @returns false if the media type is malformed
+        bool parse_media_type(string_view text,
+                              std::string& type,
+                              std::string& subtype,
+                              std::vector<media_parameter>& parameters,
+                              quality_type* q)
+        {
+            bool first = true;
+            bool valid = true;
+            bool in_extensions = false;
+            for_each_part(text, [&](string_view part)
+            {
+                if (first)
+                {
+                    first = false;
+                    auto slash = std::find(part.begin(), part.end(), '/');
+                    if (slash == part.begin() or slash == part.end() or slash + 1 == part.end())
+                    {
+                        valid = false;
+                        return;
+                    }
+                    type = lower(trim(string_view(part.begin(), std::size_t(slash - part.begin()))));
+                    subtype = lower(trim(string_view(slash + 1, std::size_t(part.end() - slash - 1))));
+                    return;
+                }
+                if (part.size() == 0 or in_extensions)
+                    return;
+
+                auto equals = std::find(part.begin(), part.end(), '=');
+                auto name = lower(trim(string_view(part.begin(), std::size_t(equals - part.begin()))));
+                auto value = equals == part.end()
+                ? string_view()
+                : trim(string_view(equals + 1, std::size_t(part.end() - equals - 1)));
+                if (q and name == "q")
+                {
+                    // anything after q is an accept-extension
+                    *q = parse_quality(value);
+                    in_extensions = true;
+                    return;
+                }
+                parameters.emplace_back(std::move(name), unquote(value));
+            });
+            return valid and not type.empty() and not subtype.empty();
+        }
+
+        bool matches(const media_range& range, const media_type_offer& offer)
+        {
+            if (range.type != "*" and range.type != offer.type)
+                return false;
+            if (range.subtype != "*" and range.subtype != offer.subtype)
+                return false;
+            for (auto& param : range.parameters)
+            {
+                auto ifind = std::find_if(std::begin(offer.parameters),
+                                          std::end(offer.parameters),
+                                          [&](const media_parameter& p) {
+                                              return p.first == param.first;
+                                          });
+                if (ifind == std::end(offer.parameters)
+                    or not iequals_ascii(ifind->second, param.second))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// Clients send the same few Accept headers over and over, so parsed
+        /// values are shared. A hit costs a hash and a comparison and allocates
+        /// nothing.
+        template<class Parsed>
+        struct intern_cache
+        {
+            static constexpr std::size_t max_entries = 256;
+            static constexpr std::size_t max_key_length = 1024;
+
+            std::shared_ptr<const Parsed> get(string_view key)
+            {
+                if (key.size() > max_key_length)
+                    return std::make_shared<const Parsed>(key);
+
+                auto h = hash(key);
+                {
+                    auto lock = lock_type(_mutex);
+                    auto ifind = _entries.find(h);
+                    if (ifind != std::end(_entries)
+                        and ifind->second.first.size() == key.size()
+                        and std::equal(key.begin(), key.end(), ifind->second.first.begin()))
+                    {
+                        return ifind->second.second;
+                    }
+                }
+
+                auto parsed = std::make_shared<const Parsed>(key);
+                auto lock = lock_type(_mutex);
+                if (_entries.size() >= max_entries)
+                    _entries.clear();
+                _entries[h] = std::make_pair(std::string(key.begin(), key.end()), parsed);
+                return parsed;
+            }
+
+        private:
+            using mutex_type = std::mutex;
+            using lock_type = std::unique_lock<mutex_type>;
+
+            static std::uint64_t hash(string_view key)
+            {
+                // FNV-1a
+                std::uint64_t h = 14695981039346656037ULL;
+                for (auto c : key)
+                {
+                    h ^= std::uint8_t(c);
+                    h *= 1099511628211ULL;
+                }
+                return h;
+            }
+
+            mutex_type _mutex;
+            std::unordered_map<std::uint64_t, std::pair<std::string, std::shared_ptr<const Parsed>>> _entries;
+        };
+
+        template<class Parsed>
+        intern_cache<Parsed>& cache_of()
+        {
+            static intern_cache<Parsed> cache;
+            return cache;
+        }
+    }
+
+    quality_type parse_quality(string_view text)
+    {
+        auto p = text.begin();
+        auto last = text.end();
+        if (p == last or (*p != '0' and *p != '1'))
+            return max_quality;
+
+        quality_type result = quality_type(*p++ - '0') * 1000;
+        if (p != last and *p == '.')
+        {
+            ++p;
+            quality_type scale = 100;
+            for ( ; p != last and scale and *p >= '0' and *p <= '9' ; ++p, scale /= 10)
+                result += quality_type(*p - '0') * scale;
+        }
+        return std::min(result, max_quality);
+    }
+
+    int media_range::specificity() const
+    {
+        if (type == "*")
+            return 0;
+        if (subtype == "*")
+            return 1;
+        return parameters.empty() ? 2 : 3;
+    }
+
+    media_type_offer::media_type_offer(string_view text)
+    : text(text.begin(), text.end())
+    {
+        if (not parse_media_type(text, type, subtype, parameters, nullptr))
+            throw std::invalid_argument("invalid media type: " + this->text);
+    }
+
+    accept_list::accept_list(string_view header_value)
+    {
+        for_each_token(header_value, [this](string_view token)
+        {
+            media_range range;
+            if (parse_media_type(token, range.type, range.subtype, range.parameters, std::addressof(range.q)))
+                _ranges.push_back(std::move(range));
+        });
+
+        std::stable_sort(std::begin(_ranges), std::end(_ranges),
+                         [](const media_range& l, const media_range& r) {
+                             return l.specificity() > r.specificity();
+                         });
+    }
+
+    std::shared_ptr<const accept_list> accept_list::parse(string_view header_value)
+    {
+        return cache_of<accept_list>().get(header_value);
+    }
+
+    quality_type accept_list::quality(const media_type_offer& offer) const
+    {
+        if (empty())
+            return max_quality;
+        for (auto& range : _ranges)
+        {
+            if (matches(range, offer))
+                return range.q;
+        }
+        return 0;
+    }
+
+    accept_encoding_list::accept_encoding_list(string_view header_value)
+    {
+        for_each_token(header_value, [this](string_view token)
+        {
+            auto semi = std::find(token.begin(), token.end(), ';');
+            auto coding = lower(trim(string_view(token.begin(), std::size_t(semi - token.begin()))));
+            quality_type q = max_quality;
+            if (semi != token.end())
+            {
+                for_each_part(string_view(semi + 1, std::size_t(token.end() - semi - 1)),
+                              [&](string_view part) {
+                                  auto equals = std::find(part.begin(), part.end(), '=');
+                                  if (iequals_ascii(trim(string_view(part.begin(), std::size_t(equals - part.begin()))), "q")
+                                      and equals != part.end())
+                                  {
+                                      q = parse_quality(trim(string_view(equals + 1, std::size_t(part.end() - equals - 1))));
+                                  }
+                              });
+            }
+            if (coding == "*")
+            {
+                _wildcard = q;
+                _has_wildcard = true;
+            }
+            else if (not coding.empty())
+            {
+                _codings.emplace_back(std::move(coding), q);
+            }
+        });
+    }
+
+    std::shared_ptr<const accept_encoding_list> accept_encoding_list::parse(string_view header_value)
+    {
+        return cache_of<accept_encoding_list>().get(header_value);
+    }
+
+    quality_type accept_encoding_list::quality(string_view coding) const
+    {
+        for (auto& entry : _codings)
+        {
+            if (iequals_ascii(entry.first, coding))
+                return entry.second;
+        }
+        if (_has_wildcard)
+            return _wildcard;
+        if (iequals_ascii(coding, "identity"))
+            return max_quality;
+        return 0;
+    }
+
+    offered_media_types::offered_media_types(std::initializer_list<string_view> types)
+    {
+        _offers.reserve(types.size());
+        for (auto& t : types)
+            _offers.emplace_back(t);
+    }
+
+    const media_type_offer* offered_media_types::negotiate(const accept_list& accept) const
+    {
+        const media_type_offer* best = nullptr;
+        quality_type best_q = 0;
+        for (auto& offer : _offers)
+        {
+            auto q = accept.quality(offer);
+            if (q > best_q)
+            {
+                best = std::addressof(offer);
+                best_q = q;
+            }
+        }
+        return best;
+    }
+
+    offered_encodings::offered_encodings(std::initializer_list<string_view> codings)
+    {
+        _codings.reserve(codings.size());
+        for (auto& c : codings)
+            _codings.push_back(lower(c));
+    }
+
+    const std::string* offered_encodings::negotiate(const accept_encoding_list& accept) const
+    {
+        const std::string* best = nullptr;
+        quality_type best_q = 0;
+        for (auto& coding : _codings)
+        {
+            auto q = accept.quality(coding);
+            if (q > best_q)
+            {
+                best = std::addressof(coding);
+                best_q = q;
+            }
+        }
+        return best;
+    }
+
+    AcceptMetaData& populate(AcceptMetaData& meta, const accept_list& accept)
+    {
+        for (auto& range : accept.ranges())
+        {
+            auto mr = meta.add_media_ranges();
+            mr->set_type(range.type);
+            mr->set_subtype(range.subtype);
+            mr->set_q(range.q / double(max_quality));
+            for (auto& param : range.parameters)
+            {
+                auto token = mr->add_tokens();
+                token->set_name(param.first);
+                token->set_value(param.second);
+            }
+        }
+        return meta;
+    }
+
+}}}
@@ -0,0 +1,167 @@
+#include <secr/dispatch/http/query.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        int hex_value(char c)
+        {
+            if (c >= '0' and c <= '9') return c - '0';
+            if (c >= 'a' and c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' and c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        /// @returns a pointer to the first '%' (or '+' if plus_as_space) in
+        ///          [first, last), or last
+        const char* find_special(const char* first, const char* last, bool plus_as_space)
+        {
+#if defined(__SSE2__)
+            const auto percent = _mm_set1_epi8('%');
+            const auto plus = _mm_set1_epi8(plus_as_space ? '+' : '%');
+            for ( ; last - first >= 16 ; first += 16)
+            {
+                auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+                auto hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, percent), _mm_cmpeq_epi8(chunk, plus));
+                auto mask = _mm_movemask_epi8(hits);
+                if (mask)
+                    return first + __builtin_ctz(unsigned(mask));
+            }
+#endif
+            for ( ; first != last ; ++first)
+            {
+                if (*first == '%' or (plus_as_space and *first == '+'))
+                    return first;
+            }
+            return last;
+        }
+
+        /// Decode one special character at p
+        /// @returns the decoded char and advances p
+        char decode_one(const char*& p, const char* last)
+        {
+            if (*p == '+')
+            {
+                ++p;
+                return ' ';
+            }
+            if (last - p >= 3)
+            {
+                auto hi = hex_value(p[1]);
+                auto lo = hex_value(p[2]);
+                if (hi >= 0 and lo >= 0)
+                {
+                    p += 3;
+                    return char((hi << 4) | lo);
+                }
+            }
+            // malformed escape - keep it as it is
+            return *p++;
+        }
+    }
+
+    bool needs_decoding(string_view text, bool plus_as_space)
+    {
+        return find_special(text.begin(), text.end(), plus_as_space) != text.end();
+    }
+
+    std::size_t percent_decode(string_view text, char* out, bool plus_as_space)
+    {
+        auto first = text.begin();
+        auto last = text.end();
+        auto start = out;
+        while (first != last)
+        {
+            // copy the run up to the next escape in one go
+            auto special = find_special(first, last, plus_as_space);
+            std::memcpy(out, first, std::size_t(special - first));
+            out += special - first;
+            first = special;
+            if (first != last)
+                *out++ = decode_one(first, last);
+        }
+        return std::size_t(out - start);
+    }
+
+    string_view percent_decode(google::protobuf::Arena* arena, string_view text, bool plus_as_space)
+    {
+        if (not needs_decoding(text, plus_as_space))
+            return text;
+        auto buffer = google::protobuf::Arena::CreateArray<char>(arena, text.size());
+        auto size = percent_decode(text, buffer, plus_as_space);
+        return string_view(buffer, size);
+    }
+
+    bool decoded_equals(string_view encoded, string_view decoded, bool plus_as_space)
+    {
+        auto p = encoded.begin();
+        auto last = encoded.end();
+        auto q = decoded.begin();
+        auto qlast = decoded.end();
+        while (p != last)
+        {
+            auto special = find_special(p, last, plus_as_space);
+            auto run = std::size_t(special - p);
+            if (std::size_t(qlast - q) < run or not std::equal(p, special, q))
+                return false;
+            q += run;
+            p = special;
+            if (p != last)
+            {
+                if (q == qlast or decode_one(p, last) != *q++)
+                    return false;
+            }
+        }
+        return q == qlast;
+    }
+
+    void query_parameters::const_iterator::advance()
+    {
+        while (_rest and _rest != _last)
+        {
+            auto first = _rest;
+            auto amp = std::find(first, _last, '&');
+            _rest = amp == _last ? _last : amp + 1;
+            if (amp == first)
+                continue;   // empty pair
+
+            auto equals = std::find(first, amp, '=');
+            _current.name = string_view(first, std::size_t(equals - first));
+            _current.has_value = equals != amp;
+            _current.value = _current.has_value
+            ? string_view(equals + 1, std::size_t(amp - equals - 1))
+            : string_view();
+            _pos = first;
+            _at_end = false;
+            return;
+        }
+        _at_end = true;
+    }
+
+    auto query_parameters::find(string_view name) const -> const_iterator
+    {
+        auto i = begin();
+        for ( ; i != end() ; ++i)
+        {
+            if (decoded_equals(i->name, name, true))
+                break;
+        }
+        return i;
+    }
+
+    boost::optional<string_view> query_parameters::get(google::protobuf::Arena* arena, string_view name) const
+    {
+        auto i = find(name);
+        if (i == end())
+            return boost::none;
+        return percent_decode(arena, i->value, true);
+    }
+
+}}}
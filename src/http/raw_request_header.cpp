@@ -0,0 +1,144 @@
+#include <secr/dispatch/http/raw_request_header.hpp>
+#include <secr/dispatch/http/exception.hpp>
+#include <cstring>
+
+namespace secr { namespace dispatch { namespace http {
+
+    void header_slice::append(const void* origin,
+                              const char* begin, std::size_t size,
+                              google::protobuf::Arena* arena)
+    {
+        if (_size == 0)
+        {
+            _begin = begin;
+            _size = size;
+            _origin = origin;
+        }
+        else if (origin == _origin and _begin + _size == begin)
+        {
+            // contiguous within the same read block
+            _size += size;
+        }
+        else
+        {
+            // split across reads - fall back to a copy in the arena
+            auto copy = google::protobuf::Arena::CreateArray<char>(arena, _size + size);
+            std::memcpy(copy, _begin, _size);
+            std::memcpy(copy + _size, begin, size);
+            _begin = copy;
+            _size += size;
+            _origin = copy;
+        }
+    }
+
+    void raw_request_header::clear()
+    {
+        _pinned.clear();
+        _uri = header_slice();
+        _fields.clear();
+        _field_state = field_state::none;
+        _index.clear();
+        _connection_close = false;
+        _connection_keep_alive = false;
+        _method = string_view();
+        _version_major = 0;
+        _version_minor = 0;
+        http_parser_url_init(std::addressof(_url));
+    }
+    
+    void raw_request_header::append_uri(const read_block_ptr& block,
+                                        const char* begin, std::size_t size)
+    {
+        pin(block);
+        _uri.append(block.get(), begin, size, _arena);
+    }
+
+    void raw_request_header::append_header_field(const read_block_ptr& block,
+                                                 const char* begin, std::size_t size)
+    {
+        pin(block);
+        if (_field_state != field_state::name)
+        {
+            _fields.emplace_back();
+            _field_state = field_state::name;
+        }
+        _fields.back().name.append(block.get(), begin, size, _arena);
+    }
+
+    void raw_request_header::append_header_value(const read_block_ptr& block,
+                                                 const char* begin, std::size_t size)
+    {
+        pin(block);
+        assert(not _fields.empty());
+        _field_state = field_state::value;
+        _fields.back().value.append(block.get(), begin, size, _arena);
+    }
+
+    void raw_request_header::finalise(http_parser* parser)
+    {
+        _field_state = field_state::none;
+        _method = http_method_str(static_cast<http_method>(parser->method));
+        _version_major = parser->http_major;
+        _version_minor = parser->http_minor;
+
+        _index.build(_fields);
+        _index.for_each(header_id::connection, [this](const raw_header_field& field) {
+            for_each_token(field.value.view(), [this](string_view token) {
+                if (iequals_ascii(token, "close"))
+                    _connection_close = true;
+                else if (iequals_ascii(token, "keep-alive"))
+                    _connection_keep_alive = true;
+            });
+        });
+
+        http_parser_url_init(std::addressof(_url));
+        auto result = http_parser_parse_url(uri().begin(),
+                                            uri().size(),
+                                            parser->method == HTTP_CONNECT,
+                                            std::addressof(_url));
+        if (result) {
+            throw invalid_url(uri().to_string());
+        }
+    }
+
+    namespace
+    {
+        void check_url_field(const raw_request_header& raw,
+                             HttpRequestHeader::QueryParts& parts,
+                             std::string* (HttpRequestHeader::QueryParts::*locate)(),
+                             http_parser_url_fields field)
+        {
+            if (raw.has_url_field(field))
+            {
+                auto value = raw.url_field(field);
+                (parts.*locate)()->assign(value.begin(), value.size());
+            }
+        }
+    }
+
+    HttpRequestHeader& populate(HttpRequestHeader& header, const raw_request_header& raw)
+    {
+        header.mutable_method()->assign(raw.method().begin(), raw.method().size());
+        header.mutable_uri()->assign(raw.uri().begin(), raw.uri().size());
+        header.set_version_major(raw.version_major());
+        header.set_version_minor(raw.version_minor());
+
+        for (auto& field : raw.fields())
+        {
+            auto hdr = header.add_headers();
+            hdr->mutable_name()->assign(field.name.view().begin(), field.name.size());
+            hdr->mutable_value()->assign(field.value.view().begin(), field.value.size());
+        }
+
+        auto& parts = *header.mutable_query();
+        check_url_field(raw, parts, &HttpRequestHeader::QueryParts::mutable_schema, UF_SCHEMA);
+        check_url_field(raw, parts, &HttpRequestHeader::QueryParts::mutable_host, UF_HOST);
+        check_url_field(raw, parts, &HttpRequestHeader::QueryParts::mutable_port, UF_PORT);
+        check_url_field(raw, parts, &HttpRequestHeader::QueryParts::mutable_path, UF_PATH);
+        check_url_field(raw, parts, &HttpRequestHeader::QueryParts::mutable_query, UF_QUERY);
+        check_url_field(raw, parts, &HttpRequestHeader::QueryParts::mutable_fragment, UF_FRAGMENT);
+        check_url_field(raw, parts, &HttpRequestHeader::QueryParts::mutable_user_info, UF_USERINFO);
+        return header;
+    }
+
+}}}
@@ -0,0 +1,186 @@
+#include <secr/dispatch/http/request_context_pool.hpp>
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    asio::io_service::id request_context_pool::id;
+
+    namespace
+    {
+        constexpr std::size_t minimum_initial_block = 4096;
+        constexpr std::size_t maximum_initial_block = 256 * 1024;
+
+        std::size_t round_up_to_power_of_2(std::size_t x)
+        {
+            std::size_t result = minimum_initial_block;
+            while (result < x) {
+                result <<= 1;
+            }
+            return result;
+        }
+    }
+
+    /// The part of the pool which outlives the service, so that contexts
+    /// released after the io_service has been destroyed are simply deleted
+    struct request_context_pool::state
+    : std::enable_shared_from_this<state>
+    {
+        using mutex_type = std::mutex;
+        using lock_type = std::unique_lock<mutex_type>;
+        using context_ptr = std::unique_ptr<request_context>;
+
+        state(asio::io_service& controller_service)
+        : controller_service(controller_service)
+        {}
+
+        /// the idle contexts for one dispatcher io_service
+        struct free_list
+        {
+            asio::io_service* dispatcher_service;
+            std::vector<context_ptr> contexts;
+        };
+
+        free_list& free_list_for(const lock_type&, asio::io_service& dispatcher_service)
+        {
+            auto ifind = std::find_if(std::begin(free_lists), std::end(free_lists),
+                                      [&](const free_list& fl) {
+                                          return fl.dispatcher_service == std::addressof(dispatcher_service);
+                                      });
+            if (ifind != std::end(free_lists))
+                return *ifind;
+            free_lists.push_back(free_list { std::addressof(dispatcher_service), {} });
+            return free_lists.back();
+        }
+
+        std::shared_ptr<request_context> acquire(connection_id conn_id,
+                                                 asio::io_service& dispatcher_service)
+        {
+            context_ptr context;
+            std::size_t block_size;
+            {
+                auto lock = lock_type(mutex);
+                auto& fl = free_list_for(lock, dispatcher_service);
+                if (not fl.contexts.empty())
+                {
+                    context = std::move(fl.contexts.back());
+                    fl.contexts.pop_back();
+                    ++stats.reused;
+                }
+                else
+                {
+                    ++stats.created;
+                }
+                block_size = stats.initial_block_size;
+            }
+
+            if (context) {
+                context->set_connection_id(std::move(conn_id));
+                context->mark_started();
+            }
+            else {
+                context = std::make_unique<request_context>(std::move(conn_id),
+                                                            controller_service,
+                                                            dispatcher_service,
+                                                            block_size);
+            }
+
+            return std::shared_ptr<request_context>(context.release(),
+                                                    [self = shared_from_this(),
+                                                     &dispatcher_service](request_context* p)
+                                                    {
+                                                        self->release(context_ptr(p), dispatcher_service);
+                                                    });
+        }
+
+        void release(context_ptr context, asio::io_service& dispatcher_service)
+        {
+            // reset now rather than on reuse, so that the read blocks pinned by
+            // the request are released as early as possible
+            context->reset();
+            
+            // blocks which other threads, such as those of a separate dispatch
+            // io_service, allocated for their own use would not fit in the
+            // initial block however large it was, so only the owner's are judged
+            auto allocated = context->owner_space_allocated();
+            
+            auto lock = lock_type(mutex);
+            if (allocated > stats.initial_block_size) {
+                stats.initial_block_size = std::min(maximum_initial_block,
+                                                    round_up_to_power_of_2(allocated));
+            }
+
+            if (shut_down
+                or allocated > context->initial_block_size()
+                or context->initial_block_size() < stats.initial_block_size)
+            {
+                // a context which has outgrown its initial block would allocate on
+                // every request. Let it be replaced by one with a larger block.
+                ++stats.discarded;
+                lock.unlock();
+                return;
+            }
+
+            auto& fl = free_list_for(lock, dispatcher_service);
+            if (fl.contexts.size() >= max_pooled)
+            {
+                ++stats.discarded;
+                lock.unlock();
+                return;
+            }
+
+            fl.contexts.push_back(std::move(context));
+        }
+
+        void shutdown()
+        {
+            std::vector<free_list> discard;
+            auto lock = lock_type(mutex);
+            shut_down = true;
+            std::swap(discard, free_lists);
+            lock.unlock();
+        }
+
+        asio::io_service& controller_service;
+        mutable mutex_type mutex;
+        std::vector<free_list> free_lists;
+        std::size_t max_pooled = 64;
+        statistics stats;
+        bool shut_down = false;
+    };
+
+    request_context_pool::request_context_pool(asio::io_service& controller_service)
+    : asio::io_service::service(controller_service)
+    , _state(std::make_shared<state>(controller_service))
+    {
+        _state->stats.initial_block_size = minimum_initial_block;
+    }
+
+    std::shared_ptr<request_context>
+    request_context_pool::acquire(connection_id conn_id,
+                                  asio::io_service& dispatcher_service)
+    {
+        return _state->acquire(std::move(conn_id), dispatcher_service);
+    }
+
+    void request_context_pool::set_max_pooled(std::size_t max_pooled)
+    {
+        auto lock = state::lock_type(_state->mutex);
+        _state->max_pooled = max_pooled;
+    }
+
+    auto request_context_pool::get_statistics() const -> statistics
+    {
+        auto lock = state::lock_type(_state->mutex);
+        return _state->stats;
+    }
+
+    void request_context_pool::shutdown_service()
+    {
+        _state->shutdown();
+    }
+
+}}}
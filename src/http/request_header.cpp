@@ -8,7 +8,6 @@
 #include <boost/token_iterator.hpp>
 #include <regex>
 #include <iostream>
-#include <boost/format.hpp>
 #include <numeric>
 
 namespace secr { namespace dispatch { namespace http {
@@ -20,7 +19,7 @@ namespace secr { namespace dispatch { namespace http {
         
         for (auto& header : headers)
         {
-            if (boost::iequals(header.name(), like)) {
+            if (iequals_ascii(header.name(), like)) {
                 if (found) {
                     throw std::runtime_error("duplicate header");
                 }
@@ -48,7 +47,7 @@ namespace secr { namespace dispatch { namespace http {
 
         for (auto& header : headers)
         {
-            if (boost::iequals(header.name(), like)) {
+            if (iequals_ascii(header.name(), like)) {
                 results.push_back(header);
             }
         }
@@ -62,7 +61,7 @@ namespace secr { namespace dispatch { namespace http {
     {
         auto& headers = request.headers();
         auto i = std::find_if(headers.begin(), headers.end(),
-                              match_header_name(value));
+                              match_header_name(name));
         if (i == headers.end())
         {
             auto hdr = request.add_headers();
@@ -207,7 +206,7 @@ namespace secr { namespace dispatch { namespace http {
         }
     }
     
-    ContentType& populate(ContentType& ct, const std::string& header_value)
+    ContentType& populate(ContentType& ct, string_view header_value)
     {
         parse(ct, header_value.begin(), header_value.end());
         return ct;
@@ -298,57 +297,4 @@ namespace secr { namespace dispatch { namespace http {
 
 
     
-    struct add_representation_length
-    {
-        std::size_t operator()(std::size_t x, const Header& hdr) const
-        {
-            return x + hdr.name().length() + 2 + hdr.value().length() + 2;
-        }
-    };
-    
-    arena_byte_buffer to_response_buffer(const HttpResponseHeader& rmsg)
-    {
-        assert(rmsg.has_status());
-        assert(not rmsg.status().message().empty());
-
-        static const char colon[2] = { ':', ' ' };
-        static const char crlf[2] = { '\r', '\n' };
-        
-        auto status_line = (boost::format("HTTP/%1%.%2% %3% %4%\r\n")
-        % rmsg.version_major()
-        % rmsg.version_minor()
-        % rmsg.status().code()
-        % rmsg.status().message()).str();
-        
-        auto response_length = status_line.size()
-        + std::accumulate(std::begin(rmsg.headers()),
-                          std::end(rmsg.headers()),
-                          std::size_t(0),
-                          add_representation_length())
-        + 2;
-        
-        auto buffer = arena_byte_buffer(rmsg.GetArena(), response_length);
-        auto i = buffer.begin();
-        i = std::copy(status_line.begin(), status_line.end(), i);
-        for (auto& header : rmsg.headers())
-        {
-            i = std::copy(header.name().begin(), header.name().end(), i);
-            i = std::copy(std::begin(colon), std::end(colon), i);
-            i = std::copy(header.value().begin(), header.value().end(), i);
-            i = std::copy(std::begin(crlf), std::end(crlf), i);
-        }
-        i = std::copy(std::begin(crlf), std::end(crlf), i);
-        assert(i == std::end(buffer));
-        return buffer;
-    }
-
-    arena_byte_buffer to_response_buffer(const HttpResponseHeader* rmsg)
-    {
-        return to_response_buffer(*rmsg);
-    }
-
-
-
-    
-    
 }}}
\ No newline at end of file
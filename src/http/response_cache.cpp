@@ -0,0 +1,564 @@
+#include <secr/dispatch/http/response_cache.hpp>
+#include <secr/dispatch/http/response_header.hpp>
+#include <secr/dispatch/http/request_header.hpp>
+#include <secr/dispatch/http/server_request.hpp>
+#include <secr/dispatch/http/entity_tag.hpp>
+#include <secr/dispatch/http/header_index.hpp>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        template<class F>
+        void for_each_response_header(const HttpResponseHeader& response, header_id id, F&& f)
+        {
+            for (auto& header : response.headers())
+                if (is_header(header.name(), id))
+                    f(string_view(header.value()));
+        }
+
+        /// call f(value) for every request header with the given name
+        template<class F>
+        void for_each_request_header(const raw_request_header& request, string_view name, F&& f)
+        {
+            auto id = identify_header(name);
+            if (id != header_id::unknown)
+            {
+                request.index().for_each(id, [&](const raw_header_field& field) {
+                    f(field.value.view());
+                });
+                return;
+            }
+            for (auto& field : request.fields())
+                if (iequals_ascii(field.name.view(), name))
+                    f(field.value.view());
+        }
+
+        bool has_directive(const raw_request_header& request, string_view directive)
+        {
+            bool found = false;
+            for_each_request_header(request, "Cache-Control", [&](string_view value) {
+                for_each_token(value, [&](string_view element) {
+                    if (iequals_ascii(element, directive))
+                        found = true;
+                });
+            });
+            return found;
+        }
+
+        /// Statuses which may be cached without further qualification
+        bool cacheable_status(int code)
+        {
+            switch (code)
+            {
+                case 200: case 203: case 204: case 300: case 301:
+                case 404: case 405: case 410: case 414: case 501:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        /// Fields which are written afresh for every response
+        bool per_response_field(string_view name)
+        {
+            return is_header(name, header_id::connection)
+            or is_header(name, header_id::keep_alive)
+            or is_header(name, header_id::date)
+            or is_header(name, header_id::transfer_encoding)
+            or iequals_ascii(name, "Age");
+        }
+
+        /// method, host and uri. The server speaks only http, so the scheme
+        /// is the same for every request.
+        std::string primary_key(const raw_request_header& request)
+        {
+            auto host = request.index().value(header_id::host);
+            std::string key;
+            key.reserve(request.method().size() + 1 + host.size() + 1 + request.uri().size());
+            key.append(request.method().begin(), request.method().end());
+            key.push_back(' ');
+            for (auto c : host)
+                key.push_back(c >= 'A' and c <= 'Z' ? char(c - 'A' + 'a') : c);
+            key.push_back(' ');
+            key.append(request.uri().begin(), request.uri().end());
+            return key;
+        }
+
+        /// the primary key, followed by the value of each header named by Vary
+        std::string full_key(std::string key,
+                             const std::vector<std::string>& vary,
+                             const raw_request_header& request)
+        {
+            for (auto& name : vary)
+            {
+                key.push_back('\0');
+                bool first = true;
+                for_each_request_header(request, name, [&](string_view value) {
+                    if (not first) key.push_back(',');
+                    key.append(value.begin(), value.end());
+                    first = false;
+                });
+            }
+            return key;
+        }
+
+        std::uint64_t mix(std::uint64_t h)
+        {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        std::uint64_t hash_of(const std::string& s)
+        {
+            return mix(std::hash<std::string>()(s));
+        }
+
+        /// A count-min sketch of 4 bit counters. Counts are halved every
+        /// few thousand additions so that popularity fades.
+        class frequency_sketch
+        {
+        public:
+            explicit frequency_sketch(std::size_t width)
+            : _mask(width - 1)
+            , _sample_size(width * 10)
+            , _rows(rows * width)
+            {
+                assert((width & _mask) == 0);
+            }
+
+            void record(std::uint64_t hash)
+            {
+                for (std::size_t row = 0 ; row < rows ; ++row)
+                {
+                    auto& counter = _rows[slot(hash, row)];
+                    if (counter < max_count)
+                        ++counter;
+                }
+                if (++_additions >= _sample_size)
+                    age();
+            }
+
+            int estimate(std::uint64_t hash) const
+            {
+                int result = max_count;
+                for (std::size_t row = 0 ; row < rows ; ++row)
+                    result = std::min<int>(result, _rows[slot(hash, row)]);
+                return result;
+            }
+
+        private:
+            static constexpr std::size_t rows = 4;
+            static constexpr std::uint8_t max_count = 15;
+
+            std::size_t slot(std::uint64_t hash, std::size_t row) const
+            {
+                return row * (_mask + 1) + (mix(hash + row * 0x9e3779b97f4a7c15ull) & _mask);
+            }
+
+            void age()
+            {
+                for (auto& counter : _rows)
+                    counter >>= 1;
+                _additions /= 2;
+            }
+
+            std::size_t _mask;
+            std::size_t _sample_size;
+            std::size_t _additions = 0;
+            std::vector<std::uint8_t> _rows;
+        };
+
+        std::size_t power_of_two_at_least(std::size_t n)
+        {
+            std::size_t result = 1;
+            while (result < n)
+                result <<= 1;
+            return result;
+        }
+
+        /// @returns true if the request's validators match the stored
+        ///          response. If-Modified-Since is compared exactly with the
+        ///          stored Last-Modified, and is ignored if If-None-Match is
+        ///          present.
+        bool not_modified(const raw_request_header& request, const response_cache::entry& e)
+        {
+            auto& index = request.index();
+            if (index.count(header_id::if_none_match))
+            {
+                bool matched = false;
+                if (not e.entity_tag.empty())
+                {
+                    index.for_each(header_id::if_none_match, [&](const raw_header_field& field) {
+                        if (if_none_match(field.value.view(), e.entity_tag))
+                            matched = true;
+                    });
+                }
+                return matched;
+            }
+            auto since = index.value(header_id::if_modified_since);
+            return since.size() != 0 and not e.last_modified.empty()
+            and trim(since) == string_view(e.last_modified);
+        }
+
+        /// The stored fields without Content-Length, for a 304
+        std::string not_modified_fields(const std::string& fields)
+        {
+            std::string result;
+            std::size_t pos = 0;
+            while (pos < fields.size())
+            {
+                auto eol = fields.find("\r\n", pos) + 2;
+                auto colon = fields.find(':', pos);
+                if (not is_header(string_view(fields.data() + pos, colon - pos), header_id::content_length))
+                    result.append(fields, pos, eol - pos);
+                pos = eol;
+            }
+            return result;
+        }
+
+        /// Bytes charged for each entry over and above its data
+        constexpr std::size_t entry_overhead = 256;
+
+        /// The expected size of an entry, used to size the frequency sketch
+        constexpr std::size_t typical_entry_size = 4096;
+    }
+
+    std::size_t response_cache::entry::cost() const
+    {
+        return key.size() + reason.size() + fields.size() + entity_tag.size() + last_modified.size()
+        + body.size() + entry_overhead;
+    }
+
+    struct response_cache::shard
+    {
+        shard(std::size_t capacity)
+        : capacity(capacity)
+        , sketch(power_of_two_at_least(std::max<std::size_t>(capacity / typical_entry_size, 1024)))
+        {}
+
+        using lru_list = std::list<entry_ptr>;
+
+        /// The Vary header names last seen for a primary key, and the stored
+        /// variants which were keyed on them
+        struct vary_spec
+        {
+            std::vector<std::string> names;
+            std::vector<const entry*> variants;
+        };
+
+        void remove(lru_list::iterator pos)
+        {
+            auto& e = **pos;
+            auto spec = vary.find(e.key.substr(0, e.primary_size));
+            if (spec != vary.end())
+            {
+                auto& variants = spec->second.variants;
+                variants.erase(std::remove(variants.begin(), variants.end(), &e), variants.end());
+                if (variants.empty())
+                    vary.erase(spec);
+            }
+            bytes -= e.cost();
+            index.erase(e.key);
+            lru.erase(pos);
+        }
+
+        std::mutex mutex;
+        std::size_t capacity;
+        std::size_t bytes = 0;
+        lru_list lru;
+        std::unordered_map<std::string, lru_list::iterator> index;
+        std::unordered_map<std::string, vary_spec> vary;
+        frequency_sketch sketch;
+    };
+
+    response_cache::response_cache(const response_cache_options& options)
+    : _options(options)
+    {
+        auto count = std::max<std::size_t>(options.shards, 1);
+        _shards.reserve(count);
+        for (std::size_t i = 0 ; i < count ; ++i)
+            _shards.push_back(std::make_unique<shard>(options.capacity / count));
+    }
+
+    response_cache::~response_cache() = default;
+
+    auto response_cache::shard_for(std::uint64_t hash) -> shard&
+    {
+        return *_shards[hash % _shards.size()];
+    }
+
+    bool response_cache::cacheable_request(const raw_request_header& request)
+    {
+        if (request.method() != string_view("GET"))
+            return false;
+        auto& index = request.index();
+        if (index.count(header_id::authorization) or index.count(header_id::transfer_encoding))
+            return false;
+        auto length = index.value(header_id::content_length);
+        return length.size() == 0 or length == string_view("0");
+    }
+
+    std::chrono::seconds response_cache::lifetime(const HttpResponseHeader& response)
+    {
+        long max_age = -1;
+        long s_maxage = -1;
+        bool forbidden = false;
+        for_each_response_header(response, header_id::cache_control, [&](string_view value) {
+            for_each_token(value, [&](string_view directive) {
+                auto equals = std::find(directive.begin(), directive.end(), '=');
+                auto name = trim(string_view(directive.begin(), std::size_t(equals - directive.begin())));
+                if (iequals_ascii(name, "no-store") or iequals_ascii(name, "no-cache")
+                    or iequals_ascii(name, "private"))
+                {
+                    forbidden = true;
+                }
+                else if (equals != directive.end()
+                         and (iequals_ascii(name, "max-age") or iequals_ascii(name, "s-maxage")))
+                {
+                    auto text = trim(string_view(equals + 1, std::size_t(directive.end() - equals - 1)));
+                    long seconds = 0;
+                    for (auto c : text)
+                    {
+                        if (c < '0' or c > '9' or seconds > 100000000)
+                            return;
+                        seconds = seconds * 10 + (c - '0');
+                    }
+                    (iequals_ascii(name, "max-age") ? max_age : s_maxage) = seconds;
+                }
+            });
+        });
+
+        // a shared cache prefers s-maxage
+        auto seconds = s_maxage >= 0 ? s_maxage : max_age;
+        if (forbidden or seconds <= 0)
+            return std::chrono::seconds(0);
+        return std::chrono::seconds(seconds);
+    }
+
+    auto response_cache::find(const raw_request_header& request, clock_type::time_point now)
+    -> entry_ptr
+    {
+        if (not cacheable_request(request)
+            or has_directive(request, "no-cache")
+            or has_directive(request, "no-store"))
+        {
+            return nullptr;
+        }
+
+        auto primary = primary_key(request);
+        auto hash = hash_of(primary);
+        auto& s = shard_for(hash);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.sketch.record(hash);
+
+        auto spec = s.vary.find(primary);
+        if (spec == s.vary.end())
+            return nullptr;
+        auto pos = s.index.find(full_key(std::move(primary), spec->second.names, request));
+        if (pos == s.index.end())
+            return nullptr;
+
+        auto item = pos->second;
+        if ((*item)->expires <= now)
+        {
+            s.remove(item);
+            return nullptr;
+        }
+        s.lru.splice(s.lru.begin(), s.lru, item);
+        return *item;
+    }
+
+    bool response_cache::insert(const raw_request_header& request,
+                                const HttpResponseHeader& response,
+                                std::vector<char> body,
+                                clock_type::time_point now)
+    {
+        if (not cacheable_request(request) or has_directive(request, "no-store"))
+            return false;
+        if (not response.has_status() or not cacheable_status(response.status().code()))
+            return false;
+        auto ttl = lifetime(response);
+        if (ttl.count() == 0)
+            return false;
+
+        std::vector<std::string> vary;
+        bool refused = false;
+        for (auto& header : response.headers())
+        {
+            auto& name = header.name();
+            if (is_header(name, header_id::vary))
+            {
+                for_each_token(header.value(), [&](string_view element) {
+                    if (element == string_view("*"))
+                        refused = true;
+                    vary.push_back(element.to_string());
+                });
+            }
+            else if (iequals_ascii(name, "Set-Cookie"))
+            {
+                refused = true;
+            }
+            else if (is_header(name, header_id::content_length)
+                     and header.value() != std::to_string(body.size()))
+            {
+                // the handler did not finish the body
+                refused = true;
+            }
+        }
+        if (refused)
+            return false;
+
+        auto e = std::make_shared<entry>();
+        auto primary = primary_key(request);
+        auto hash = hash_of(primary);
+        e->primary_size = primary.size();
+        e->key = full_key(primary, vary, request);
+        e->status = response.status().code();
+        e->reason = response.status().message();
+        for (auto& header : response.headers())
+        {
+            if (per_response_field(header.name()))
+                continue;
+            e->fields += header.name() + ": " + header.value() + "\r\n";
+            if (is_header(header.name(), header_id::etag))
+                e->entity_tag = header.value();
+            else if (is_header(header.name(), header_id::last_modified))
+                e->last_modified = header.value();
+        }
+        e->body = std::move(body);
+        e->stored = now;
+        e->expires = now + ttl;
+
+        auto cost = e->cost();
+        auto& s = shard_for(hash);
+        if (cost > _options.max_entry_size or cost > s.capacity)
+            return false;
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto existing = s.index.find(e->key);
+        if (existing != s.index.end())
+            s.remove(existing->second);
+
+        // variants keyed on other Vary names could no longer be found
+        auto old = s.vary.find(primary);
+        if (old != s.vary.end() and old->second.names != vary)
+        {
+            auto stale = old->second.variants;
+            for (auto v : stale)
+                s.remove(s.index.find(v->key)->second);
+        }
+
+        // make room, but only at the expense of less popular responses
+        auto frequency = s.sketch.estimate(hash);
+        while (s.bytes + cost > s.capacity)
+        {
+            auto victim = std::prev(s.lru.end());
+            auto& v = **victim;
+            if (v.expires > now
+                and frequency <= s.sketch.estimate(hash_of(v.key.substr(0, v.primary_size))))
+            {
+                return false;
+            }
+            s.remove(victim);
+        }
+
+        auto& spec = s.vary[primary];
+        spec.names = std::move(vary);
+        spec.variants.push_back(e.get());
+        s.lru.push_front(e);
+        s.index.emplace(e->key, s.lru.begin());
+        s.bytes += cost;
+        return true;
+    }
+
+    std::size_t response_cache::size_in_bytes() const
+    {
+        std::size_t result = 0;
+        for (auto& s : _shards)
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            result += s->bytes;
+        }
+        return result;
+    }
+
+    std::size_t response_cache::entry_count() const
+    {
+        std::size_t result = 0;
+        for (auto& s : _shards)
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            result += s->index.size();
+        }
+        return result;
+    }
+
+    void respond_from_cache(request_context& context,
+                            response_cache::entry_ptr entry,
+                            response_cache::clock_type::time_point now)
+    {
+        auto& request = context.raw_header();
+        auto keep_alive = request.keep_alive_requested();
+        auto unchanged = not_modified(request, *entry);
+        auto status = unchanged ? 304 : entry->status;
+        auto reason = unchanged ? std::string("Not Modified") : entry->reason;
+
+        // the response header is consulted by the responder and the access log
+        auto& header = context.response_header();
+        set_status(header, status, reason);
+        if (not unchanged)
+            set_header(header, "Content-Length", std::to_string(entry->body.size()));
+        set_header(header, "Connection", keep_alive ? "keep-alive" : "close");
+
+        auto status_line = standard_status_line(request.version_major(), request.version_minor(),
+                                                status, reason);
+        std::string head;
+        if (status_line.size() == 0)
+        {
+            head = "HTTP/" + std::to_string(request.version_major()) + "." + std::to_string(request.version_minor())
+            + " " + std::to_string(status) + " " + reason + "\r\n";
+            status_line = head;
+        }
+
+        auto age = std::chrono::duration_cast<std::chrono::seconds>(now - entry->stored).count();
+        std::string tail = keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+        tail += "Age: " + std::to_string(age) + "\r\n";
+        if (context.date_header())
+        {
+            char date[http_date_size];
+            current_http_date(date);
+            tail += "Date: ";
+            tail.append(date, sizeof(date));
+            tail += "\r\n";
+        }
+        tail += "\r\n";
+
+        // the stored parts are lent to the stream, which releases them once
+        // they have been written
+        auto& stream = context.response_stream();
+        stream.write_some(asio::buffer(status_line.begin(), status_line.size()));
+        if (unchanged)
+        {
+            stream.write_some(asio::buffer(not_modified_fields(entry->fields)));
+            stream.write_some(asio::buffer(tail));
+        }
+        else
+        {
+            stream.attach(asio::buffer(entry->fields), entry, nullptr);
+            stream.write_some(asio::buffer(tail));
+            stream.attach(asio::buffer(entry->body), entry, nullptr);
+        }
+        stream.close();
+    }
+
+}}}
@@ -0,0 +1,312 @@
+#include <secr/dispatch/http/response_header.hpp>
+#include <secr/dispatch/http/request_header.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <string>
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        constexpr int first_status_code = 100;
+        constexpr int last_status_code = 599;
+        constexpr std::size_t status_code_count = last_status_code - first_status_code + 1;
+
+        struct status_table
+        {
+            status_table()
+            {
+                auto reason = [this](int code, const char* text) {
+                    _reasons[code - first_status_code] = text;
+                };
+                reason(100, "Continue");
+                reason(101, "Switching Protocols");
+                reason(200, "OK");
+                reason(201, "Created");
+                reason(202, "Accepted");
+                reason(203, "Non-Authoritative Information");
+                reason(204, "No Content");
+                reason(205, "Reset Content");
+                reason(206, "Partial Content");
+                reason(300, "Multiple Choices");
+                reason(301, "Moved Permanently");
+                reason(302, "Found");
+                reason(303, "See Other");
+                reason(304, "Not Modified");
+                reason(305, "Use Proxy");
+                reason(307, "Temporary Redirect");
+                reason(308, "Permanent Redirect");
+                reason(400, "Bad Request");
+                reason(401, "Unauthorized");
+                reason(402, "Payment Required");
+                reason(403, "Forbidden");
+                reason(404, "Not Found");
+                reason(405, "Method Not Allowed");
+                reason(406, "Not Acceptable");
+                reason(407, "Proxy Authentication Required");
+                reason(408, "Request Timeout");
+                reason(409, "Conflict");
+                reason(410, "Gone");
+                reason(411, "Length Required");
+                reason(412, "Precondition Failed");
+                reason(413, "Payload Too Large");
+                reason(414, "URI Too Long");
+                reason(415, "Unsupported Media Type");
+                reason(416, "Range Not Satisfiable");
+                reason(417, "Expectation Failed");
+                reason(421, "Misdirected Request");
+                reason(422, "Unprocessable Entity");
+                reason(426, "Upgrade Required");
+                reason(428, "Precondition Required");
+                reason(429, "Too Many Requests");
+                reason(431, "Request Header Fields Too Large");
+                reason(451, "Unavailable For Legal Reasons");
+                reason(500, "Internal Server Error");
+                reason(501, "Not Implemented");
+                reason(502, "Bad Gateway");
+                reason(503, "Service Unavailable");
+                reason(504, "Gateway Timeout");
+                reason(505, "HTTP Version Not Supported");
+                reason(511, "Network Authentication Required");
+
+                for (std::size_t i = 0 ; i < status_code_count ; ++i)
+                {
+                    if (_reasons[i].size() == 0)
+                        continue;
+                    auto code_and_reason = " " + std::to_string(first_status_code + i)
+                    + " " + _reasons[i].to_string() + "\r\n";
+                    _lines[0][i] = "HTTP/1.0" + code_and_reason;
+                    _lines[1][i] = "HTTP/1.1" + code_and_reason;
+                }
+            }
+
+            std::array<string_view, status_code_count> _reasons;
+            std::array<std::string, status_code_count> _lines[2];
+        };
+
+        const status_table& statuses()
+        {
+            static const status_table table;
+            return table;
+        }
+
+        /// The current date, shared between threads under a sequence lock.
+        /// Readers never block: a reader which finds the text being replaced
+        /// formats its own copy.
+        struct date_cache
+        {
+            static constexpr std::size_t word_count = (http_date_size + 7) / 8;
+
+            void copy(std::time_t now, char* out)
+            {
+                auto sequence = _sequence.load(std::memory_order_acquire);
+                if ((sequence & 1) == 0)
+                {
+                    std::uint64_t words[word_count];
+                    auto second = _second.load(std::memory_order_relaxed);
+                    for (std::size_t i = 0 ; i < word_count ; ++i)
+                        words[i] = _words[i].load(std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (_sequence.load(std::memory_order_relaxed) == sequence)
+                    {
+                        if (second == now)
+                        {
+                            std::memcpy(out, words, http_date_size);
+                            return;
+                        }
+
+                        // stale. Try to become the writer.
+                        if (_sequence.compare_exchange_strong(sequence, sequence + 1,
+                                                              std::memory_order_acq_rel))
+                        {
+                            std::atomic_thread_fence(std::memory_order_release);
+                            format_http_date(now, reinterpret_cast<char*>(words));
+                            for (std::size_t i = 0 ; i < word_count ; ++i)
+                                _words[i].store(words[i], std::memory_order_relaxed);
+                            _second.store(now, std::memory_order_relaxed);
+                            _sequence.store(sequence + 2, std::memory_order_release);
+                            std::memcpy(out, words, http_date_size);
+                            return;
+                        }
+                    }
+                }
+                format_http_date(now, out);
+            }
+
+        private:
+            std::atomic<std::uint64_t> _sequence { 0 };
+            std::atomic<std::time_t> _second { 0 };
+            std::array<std::atomic<std::uint64_t>, word_count> _words {};
+        };
+
+        date_cache& the_date_cache()
+        {
+            static date_cache cache;
+            return cache;
+        }
+
+        void put2(char* p, int n)
+        {
+            p[0] = char('0' + n / 10);
+            p[1] = char('0' + n % 10);
+        }
+
+        /// Appends to an arena buffer which grows by doubling. The header
+        /// is serialised in one pass over its fields.
+        struct response_writer
+        {
+            response_writer(google::protobuf::Arena* arena, std::size_t capacity)
+            : _arena(arena)
+            , _buffer(arena, capacity)
+            , _p(_buffer.begin())
+            {}
+
+            void append(const char* data, std::size_t size)
+            {
+                if (std::size_t(_buffer.end() - _p) < size)
+                    grow(size);
+                std::memcpy(_p, data, size);
+                _p += size;
+            }
+
+            void append(string_view s) { append(s.begin(), s.size()); }
+            void append(const std::string& s) { append(s.data(), s.size()); }
+
+            arena_byte_buffer finish()
+            {
+                _buffer.shrink(std::size_t(_p - _buffer.begin()));
+                return std::move(_buffer);
+            }
+
+        private:
+            void grow(std::size_t extra)
+            {
+                auto used = std::size_t(_p - _buffer.begin());
+                auto capacity = std::max(_buffer.size() * 2, used + extra);
+                arena_byte_buffer bigger(_arena, capacity);
+                std::memcpy(bigger.begin(), _buffer.begin(), used);
+                _buffer = std::move(bigger);
+                _p = _buffer.begin() + used;
+            }
+
+            google::protobuf::Arena* _arena;
+            arena_byte_buffer _buffer;
+            arena_byte_buffer::element_type* _p;
+        };
+
+        /// Most response headers fit. Those which don't cost one copy.
+        constexpr std::size_t initial_response_capacity = 512;
+    }
+
+    string_view standard_reason(int code)
+    {
+        if (code < first_status_code or code > last_status_code)
+            return string_view();
+        return statuses()._reasons[code - first_status_code];
+    }
+
+    string_view standard_status_line(int version_major, int version_minor,
+                                     int code, string_view reason)
+    {
+        if (version_major != 1 or (version_minor != 0 and version_minor != 1))
+            return string_view();
+        auto standard = standard_reason(code);
+        if (standard.size() == 0 or standard != reason)
+            return string_view();
+        return statuses()._lines[version_minor][code - first_status_code];
+    }
+
+    void format_http_date(std::time_t t, char* out)
+    {
+        static const char days[] = "SunMonTueWedThuFriSat";
+        static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+        std::tm tm;
+        gmtime_r(std::addressof(t), std::addressof(tm));
+
+        std::memcpy(out, days + tm.tm_wday * 3, 3);
+        out[3] = ',';
+        out[4] = ' ';
+        put2(out + 5, tm.tm_mday);
+        out[7] = ' ';
+        std::memcpy(out + 8, months + tm.tm_mon * 3, 3);
+        out[11] = ' ';
+        auto year = tm.tm_year + 1900;
+        put2(out + 12, year / 100);
+        put2(out + 14, year % 100);
+        out[16] = ' ';
+        put2(out + 17, tm.tm_hour);
+        out[19] = ':';
+        put2(out + 20, tm.tm_min);
+        out[22] = ':';
+        put2(out + 23, tm.tm_sec);
+        std::memcpy(out + 25, " GMT", 4);
+    }
+
+    void current_http_date(char* out)
+    {
+        the_date_cache().copy(std::time(nullptr), out);
+    }
+
+    arena_byte_buffer to_response_buffer(const HttpResponseHeader& rmsg, bool add_date)
+    {
+        assert(rmsg.has_status());
+        assert(not rmsg.status().message().empty());
+
+        static const char colon[2] = { ':', ' ' };
+        static const char crlf[2] = { '\r', '\n' };
+
+        response_writer writer(rmsg.GetArena(), initial_response_capacity);
+
+        auto& status = rmsg.status();
+        auto status_line = standard_status_line(rmsg.version_major(), rmsg.version_minor(),
+                                                status.code(), status.message());
+        if (status_line.size())
+        {
+            writer.append(status_line);
+        }
+        else
+        {
+            writer.append("HTTP/" + std::to_string(rmsg.version_major())
+                          + "." + std::to_string(rmsg.version_minor())
+                          + " " + std::to_string(status.code())
+                          + " ");
+            writer.append(status.message());
+            writer.append(crlf, sizeof(crlf));
+        }
+
+        for (auto& header : rmsg.headers())
+        {
+            if (add_date and is_header(header.name(), header_id::date))
+                add_date = false;
+            writer.append(header.name());
+            writer.append(colon, sizeof(colon));
+            writer.append(header.value());
+            writer.append(crlf, sizeof(crlf));
+        }
+
+        if (add_date)
+        {
+            char date[6 + http_date_size + 2] = { 'D', 'a', 't', 'e', ':', ' ' };
+            current_http_date(date + 6);
+            std::memcpy(date + 6 + http_date_size, crlf, sizeof(crlf));
+            writer.append(date, sizeof(date));
+        }
+
+        writer.append(crlf, sizeof(crlf));
+        return writer.finish();
+    }
+
+    arena_byte_buffer to_response_buffer(const HttpResponseHeader& rmsg)
+    {
+        return to_response_buffer(rmsg, false);
+    }
+
+    arena_byte_buffer to_response_buffer(const HttpResponseHeader* rmsg)
+    {
+        return to_response_buffer(*rmsg, false);
+    }
+
+}}}
@@ -0,0 +1,300 @@
+#include <secr/dispatch/http/router.hpp>
+#include <secr/dispatch/http/request_header.hpp>
+#include <secr/dispatch/http/response_header.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        std::size_t common_prefix(string_view l, string_view r)
+        {
+            auto limit = std::min(l.size(), r.size());
+            std::size_t n = 0;
+            while (n < limit and l.begin()[n] == r.begin()[n])
+                ++n;
+            return n;
+        }
+
+        bool starts_with(string_view s, string_view prefix)
+        {
+            return s.size() >= prefix.size()
+            and std::equal(prefix.begin(), prefix.end(), s.begin());
+        }
+
+        string_view tail(string_view s, std::size_t from)
+        {
+            return string_view(s.begin() + from, s.size() - from);
+        }
+
+        [[noreturn]] void bad_template(string_view path_template, const char* why)
+        {
+            throw std::invalid_argument("route " + path_template.to_string() + " : " + why);
+        }
+
+        void respond_without_body(dispatch_context& context, int code, string_view allow)
+        {
+            auto& response = context.response();
+            auto& header = response.mutable_header();
+            set_status(header, code, standard_reason(code).to_string());
+            if (allow.size())
+                set_header(header, "Allow", allow.to_string());
+            error_code ec;
+            response.set_content_length(content_length_fixed(0));
+            response.commit_header(ec);
+            if (not ec)
+                response.close(ec);
+        }
+    }
+
+    string_view route_parameters::get(string_view name) const
+    {
+        if (_names)
+        {
+            for (std::size_t i = 0 ; i < _size ; ++i)
+                if (name == string_view((*_names)[i]))
+                    return _values[i];
+        }
+        return string_view();
+    }
+
+    router::router()
+    {
+        new_node();
+    }
+
+    auto router::new_node() -> node_index
+    {
+        _nodes.emplace_back();
+        return node_index(_nodes.size() - 1);
+    }
+
+    auto router::add_literal(node_index at, string_view text) -> node_index
+    {
+        while (text.size())
+        {
+            auto pos = _nodes[at].first_chars.find(text.begin()[0]);
+            if (pos == std::string::npos)
+            {
+                auto child = new_node();
+                _nodes[child].prefix = text.to_string();
+                _nodes[at].first_chars.push_back(text.begin()[0]);
+                _nodes[at].static_children.push_back(child);
+                return child;
+            }
+
+            auto child = _nodes[at].static_children[pos];
+            auto common = common_prefix(_nodes[child].prefix, text);
+            if (common < _nodes[child].prefix.size())
+            {
+                // split the edge where the new text diverges from it
+                auto middle = new_node();
+                _nodes[middle].prefix = _nodes[child].prefix.substr(0, common);
+                _nodes[child].prefix.erase(0, common);
+                _nodes[middle].first_chars.push_back(_nodes[child].prefix[0]);
+                _nodes[middle].static_children.push_back(child);
+                _nodes[at].static_children[pos] = middle;
+                child = middle;
+            }
+            text = tail(text, common);
+            at = child;
+        }
+        return at;
+    }
+
+    auto router::add_parameter(node_index at, string_view name, bool wildcard) -> node_index
+    {
+        auto child = wildcard ? _nodes[at].wildcard_child : _nodes[at].parameter_child;
+        if (child == no_node)
+        {
+            child = new_node();
+            _nodes[child].parameter_name = name.to_string();
+            (wildcard ? _nodes[at].wildcard_child : _nodes[at].parameter_child) = child;
+        }
+        else if (name != string_view(_nodes[child].parameter_name))
+        {
+            throw std::invalid_argument("route parameter " + name.to_string()
+                                        + " conflicts with " + _nodes[child].parameter_name);
+        }
+        return child;
+    }
+
+    void router::add(string_view method, string_view path_template, handler_type handler)
+    {
+        if (path_template.size() == 0 or path_template.begin()[0] != '/')
+            bad_template(path_template, "must begin with /");
+
+        std::vector<std::string> names;
+        node_index at = 0;
+        auto first = path_template.begin();
+        auto last = path_template.end();
+        while (first != last)
+        {
+            if ((*first == '{' or *first == '*') and names.size() == route_parameters::max_size)
+                bad_template(path_template, "too many parameters");
+
+            if (*first == '{')
+            {
+                auto close = std::find(first, last, '}');
+                if (close == last)
+                    bad_template(path_template, "unterminated parameter");
+                auto name = string_view(first + 1, std::size_t(close - first - 1));
+                if (name.size() == 0 or std::find(name.begin(), name.end(), '/') != name.end())
+                    bad_template(path_template, "bad parameter name");
+                if (close + 1 != last and close[1] != '/')
+                    bad_template(path_template, "a parameter must end its segment");
+                at = add_parameter(at, name, false);
+                names.push_back(name.to_string());
+                first = close + 1;
+            }
+            else if (*first == '*')
+            {
+                auto name = string_view(first + 1, std::size_t(last - first - 1));
+                if (std::find_if(name.begin(), name.end(), [](char c) {
+                    return c == '/' or c == '{' or c == '*';
+                }) != name.end())
+                {
+                    bad_template(path_template, "a wildcard must end the template");
+                }
+                at = add_parameter(at, name, true);
+                names.push_back(name.to_string());
+                first = last;
+            }
+            else
+            {
+                auto literal_end = std::find_if(first, last, [](char c) { return c == '{' or c == '*'; });
+                at = add_literal(at, string_view(first, std::size_t(literal_end - first)));
+                first = literal_end;
+            }
+        }
+
+        auto& terminal = _nodes[at];
+        for (auto& r : terminal.routes)
+            if (method == string_view(r.method))
+                bad_template(path_template, "already routed for this method");
+
+        terminal.routes.push_back(route { method.to_string(), std::move(handler) });
+        terminal.parameter_names = std::move(names);
+
+        // a GET route also answers HEAD, unless HEAD has a route of its own
+        auto routed = [&terminal](string_view m) {
+            return std::any_of(terminal.routes.begin(), terminal.routes.end(),
+                               [m](const route& r) { return m == string_view(r.method); });
+        };
+        terminal.allow.clear();
+        for (auto& r : terminal.routes)
+        {
+            if (terminal.allow.size())
+                terminal.allow += ", ";
+            terminal.allow += r.method;
+            if (r.method == "GET" and not routed("HEAD"))
+                terminal.allow += ", HEAD";
+        }
+        ++_route_count;
+    }
+
+    auto router::find(node_index at, string_view rest, route_parameters& parameters) const
+    -> node_index
+    {
+        auto& n = _nodes[at];
+        if (rest.size() == 0)
+        {
+            if (not n.routes.empty())
+                return at;
+            if (n.wildcard_child != no_node and not _nodes[n.wildcard_child].routes.empty())
+            {
+                parameters.push(rest);
+                return n.wildcard_child;
+            }
+            return no_node;
+        }
+
+        auto pos = n.first_chars.find(rest.begin()[0]);
+        if (pos != std::string::npos)
+        {
+            auto child = n.static_children[pos];
+            auto& prefix = _nodes[child].prefix;
+            if (starts_with(rest, prefix))
+            {
+                auto result = find(child, tail(rest, prefix.size()), parameters);
+                if (result != no_node)
+                    return result;
+            }
+        }
+
+        if (n.parameter_child != no_node)
+        {
+            auto end = std::size_t(std::find(rest.begin(), rest.end(), '/') - rest.begin());
+            if (end)
+            {
+                parameters.push(string_view(rest.begin(), end));
+                auto result = find(n.parameter_child, tail(rest, end), parameters);
+                if (result != no_node)
+                    return result;
+                parameters.pop();
+            }
+        }
+
+        if (n.wildcard_child != no_node and not _nodes[n.wildcard_child].routes.empty())
+        {
+            parameters.push(rest);
+            return n.wildcard_child;
+        }
+
+        return no_node;
+    }
+
+    auto router::match(string_view method, string_view path,
+                       route_parameters& parameters) const -> match_result
+    {
+        parameters._size = 0;
+        parameters._names = nullptr;
+
+        auto at = find(0, path, parameters);
+        if (at == no_node)
+        {
+            parameters._size = 0;
+            return { match_result::status_type::not_found, nullptr, string_view() };
+        }
+
+        auto& terminal = _nodes[at];
+        parameters._names = std::addressof(terminal.parameter_names);
+
+        auto route_for = [&terminal](string_view m) -> const route* {
+            for (auto& r : terminal.routes)
+                if (m == string_view(r.method))
+                    return std::addressof(r);
+            return nullptr;
+        };
+        auto r = route_for(method);
+        if (not r and method == string_view("HEAD"))
+            r = route_for("GET");
+        if (not r)
+            return { match_result::status_type::method_not_allowed, nullptr, terminal.allow };
+        return { match_result::status_type::found, std::addressof(r->handler), terminal.allow };
+    }
+
+    void router::operator()(dispatch_context context) const
+    {
+        route_parameters parameters;
+        auto& request = context.request();
+        auto result = match(request.raw_header().method(), request.raw_path(), parameters);
+        switch (result.status)
+        {
+            case match_result::status_type::found:
+                (*result.handler)(std::move(context), parameters);
+                break;
+
+            case match_result::status_type::not_found:
+                respond_without_body(context, 404, string_view());
+                break;
+
+            case match_result::status_type::method_not_allowed:
+                respond_without_body(context, 405, result.allow);
+                break;
+        }
+    }
+
+}}}
@@ -0,0 +1,336 @@
+#include <secr/dispatch/http/server.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/optional.hpp>
+#include <stdexcept>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace secr { namespace dispatch { namespace http {
+
+    namespace {
+
+        using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+        /// accept one connection from a non-blocking listening socket
+        /// @returns the new socket's descriptor or -1 with errno set
+        int accept_native(int listen_fd)
+        {
+#if defined(__linux__)
+            return ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+#else
+            auto fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+            return fd;
+#endif
+        }
+
+        void pin_to_cpu(std::thread& thread, std::size_t index)
+        {
+#if defined(__linux__)
+            auto cpus = std::max(1u, std::thread::hardware_concurrency());
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(index % cpus, &set);
+            if (auto err = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set))
+            {
+                BOOST_LOG_TRIVIAL(warning) << "server - cannot pin core " << index
+                << " : " << error_code(err, boost::system::system_category()).message();
+            }
+#else
+            (void)thread;
+            (void)index;
+#endif
+        }
+    }
+
+    struct server::core
+    {
+        core(server& owner, std::size_t index)
+        : _owner(owner)
+        , _index(index)
+        {}
+
+        /// open, bind and listen on the endpoint
+        /// @returns the endpoint actually bound
+        endpoint_type open(const endpoint_type& endpoint, int backlog)
+        {
+            _acceptor.open(endpoint.protocol());
+            _acceptor.set_option(protocol::acceptor::reuse_address(true));
+            _acceptor.set_option(reuse_port(true));
+            _acceptor.bind(endpoint);
+            _acceptor.listen(backlog);
+            _acceptor.non_blocking(true);
+            auto bound = _acceptor.local_endpoint();
+            _protocol = bound.protocol();
+            return bound;
+        }
+
+        void start()
+        {
+            _io_service.post([this] { wait_acceptable(); });
+            _thread = std::thread([this] { run(); });
+            if (_owner._options.pin_threads) {
+                pin_to_cpu(_thread, _index);
+            }
+        }
+
+        void stop()
+        {
+            _work.reset();
+            _io_service.stop();
+            if (_thread.joinable()) {
+                _thread.join();
+            }
+            error_code sink;
+            _backoff.cancel(sink);
+            _acceptor.close(sink);
+        }
+
+    private:
+
+        void run()
+        {
+            while (not _io_service.stopped())
+            {
+                try {
+                    _io_service.run();
+                }
+                catch(const std::exception& e) {
+                    BOOST_LOG_TRIVIAL(error) << "server - core " << _index
+                    << " : unhandled exception : " << e.what();
+                }
+            }
+        }
+
+        void wait_acceptable()
+        {
+            _acceptor.async_wait(protocol::acceptor::wait_read,
+                                 [this](const error_code& ec)
+                                 {
+                                     this->handle_acceptable(ec);
+                                 });
+        }
+
+        void handle_acceptable(const error_code& ec)
+        {
+            if (ec == asio::error::operation_aborted or not _acceptor.is_open())
+                return;
+
+            if (ec) {
+                BOOST_LOG_TRIVIAL(warning) << "server - core " << _index
+                << " : wait error : " << ec.message();
+                back_off();
+                return;
+            }
+            if (not accept_batch()) {
+                back_off();
+                return;
+            }
+            wait_acceptable();
+        }
+
+        /// the process or system is out of descriptors or buffers, or the wait
+        /// on the listener failed. The pending connections remain queued, so
+        /// the listener stays readable (and a failing wait fails again);
+        /// waiting on it again at once would spin. Wait a while instead.
+        void back_off()
+        {
+            _backoff.expires_from_now(_owner._options.accept_backoff);
+            _backoff.async_wait([this](const error_code& ec)
+                                {
+                                    if (ec == asio::error::operation_aborted or not _acceptor.is_open())
+                                        return;
+                                    this->wait_acceptable();
+                                });
+        }
+
+        static bool is_resource_error(int err)
+        {
+            return err == EMFILE or err == ENFILE or err == ENOBUFS or err == ENOMEM;
+        }
+
+        /// accept up to accept_batch connections which are queued on the
+        /// listening socket without returning to the reactor
+        /// @returns false if accepting stopped because resources are exhausted
+        bool accept_batch()
+        {
+            auto limit = std::max<std::size_t>(1, _owner._options.accept_batch);
+            auto listen_fd = _acceptor.native_handle();
+            for (std::size_t i = 0 ; i < limit ; ++i)
+            {
+                auto fd = accept_native(listen_fd);
+                if (fd < 0)
+                {
+                    auto err = errno;
+                    if (err == EINTR or err == ECONNABORTED)
+                        continue;
+                    if (err == EAGAIN or err == EWOULDBLOCK)
+                        return true;
+                    BOOST_LOG_TRIVIAL(warning) << "server - core " << _index
+                    << " : accept error : "
+                    << error_code(err, boost::system::system_category()).message();
+                    return not is_resource_error(err);
+                }
+
+                protocol::socket socket(_io_service);
+                error_code ec;
+                socket.assign(_protocol, fd, ec);
+                if (ec) {
+                    ::close(fd);
+                    BOOST_LOG_TRIVIAL(warning) << "server - core " << _index
+                    << " : cannot assign socket : " << ec.message();
+                    continue;
+                }
+                ++_owner._connections_accepted;
+                start_connection(std::move(socket));
+            }
+            return true;
+        }
+
+        asio::io_service& dispatch_service()
+        {
+            return _owner._dispatch_service ? *_owner._dispatch_service : _io_service;
+        }
+
+        void start_connection(protocol::socket socket)
+        {
+            auto connection = std::make_shared<server_connection>(std::move(socket),
+                                                                  dispatch_service());
+            connection->set_dispatch_window(std::max<std::size_t>(1, _owner._options.dispatch_window));
+            connection->set_request_watermarks(_owner._options.request_high_watermark,
+                                               _owner._options.request_low_watermark);
+            connection->set_timeouts(_owner._options.timeouts);
+            connection->set_date_header(_owner._options.date_header);
+            connection->set_compression(_owner._options.compression);
+            connection->set_entity_tags(_owner._options.entity_tags);
+            connection->set_response_cache(_owner._cache);
+            auto& io_service = _io_service;
+            connection->async_start([connection, &io_service](std::exception_ptr) mutable
+                                    {
+                                        // release the connection from a clean stack rather
+                                        // than from within its own completion
+                                        io_service.post([connection = std::move(connection)] {});
+                                    });
+            for (std::size_t i = 1 ; i < connection->dispatch_window() ; ++i) {
+                dispatch_next(connection);
+            }
+            dispatch_next(std::move(connection));
+        }
+
+        void dispatch_next(std::shared_ptr<server_connection> connection)
+        {
+            auto& conn = *connection;
+            conn.async_wait_dispatch([this, connection = std::move(connection)]
+                                     (const dispatch_shared_future& future)
+                                     {
+                                         boost::optional<dispatch_context> context;
+                                         try {
+                                             context.emplace(future.get());
+                                         }
+                                         catch(...) {
+                                             // the connection has finished. no more dispatches
+                                             return;
+                                         }
+                                         context->action([&] { _owner._handler(*context); });
+                                         this->dispatch_next(connection);
+                                     });
+        }
+
+        using dispatch_shared_future = server_connection::dispatch_shared_future;
+
+        server& _owner;
+        std::size_t _index;
+        asio::io_service _io_service;
+        std::unique_ptr<asio::io_service::work> _work { new asio::io_service::work(_io_service) };
+        protocol::acceptor _acceptor { _io_service };
+        protocol _protocol = protocol::v4();
+        asio::steady_timer _backoff { _io_service };
+        std::thread _thread;
+    };
+
+    server::server(endpoint_type endpoint,
+                   request_handler handler,
+                   server_options options)
+    : _endpoint(std::move(endpoint))
+    , _handler(std::move(handler))
+    , _dispatch_service(nullptr)
+    , _options(std::move(options))
+    , _cache(_options.cache.enabled ? std::make_shared<response_cache>(_options.cache) : nullptr)
+    {
+        open_cores();
+    }
+
+    server::server(endpoint_type endpoint,
+                   request_handler handler,
+                   asio::io_service& dispatch_service,
+                   server_options options)
+    : _endpoint(std::move(endpoint))
+    , _handler(std::move(handler))
+    , _dispatch_service(std::addressof(dispatch_service))
+    , _options(std::move(options))
+    , _cache(_options.cache.enabled ? std::make_shared<response_cache>(_options.cache) : nullptr)
+    {
+        open_cores();
+    }
+
+    server::~server() noexcept
+    {
+        try {
+            stop();
+        }
+        catch(const std::exception& e) {
+            BOOST_LOG_TRIVIAL(warning) << "server::~server : exception : " << e.what();
+        }
+    }
+
+    void server::open_cores()
+    {
+        if (not _handler)
+            throw std::invalid_argument("server: no request handler");
+
+        auto threads = _options.threads;
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        _cores.reserve(threads);
+        for (std::size_t i = 0 ; i < threads ; ++i)
+        {
+            _cores.push_back(std::make_unique<core>(*this, i));
+            // the first core resolves any wildcard port. the remaining cores
+            // share that port through SO_REUSEPORT
+            _endpoint = _cores.back()->open(_endpoint, _options.backlog);
+        }
+    }
+
+    void server::start()
+    {
+        assert(not _started);
+        _started = true;
+        for (auto& core : _cores) {
+            core->start();
+        }
+    }
+
+    void server::stop()
+    {
+        if (not _started)
+            return;
+        _started = false;
+        for (auto& core : _cores) {
+            core->stop();
+        }
+    }
+
+}}}
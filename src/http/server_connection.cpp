@@ -1,6 +1,7 @@
 #include <secr/dispatch/http/server_connection.hpp>
 #include <secr/dispatch/http/server_request.hpp>
 #include <secr/dispatch/http/parse.hpp>
+#include <algorithm>
 
 
 namespace secr { namespace dispatch { namespace http {
@@ -55,6 +56,9 @@ namespace secr { namespace dispatch { namespace http {
         settings->on_headers_complete = [](http_parser* p) {
             return to_this(p)->handle_message_headers_complete();
         };
+        settings->on_message_complete = [](http_parser* p) {
+            return to_this(p)->handle_message_fully_read();
+        };
     }
     
     bool server_connection::collect_more_data()
@@ -65,7 +69,8 @@ namespace secr { namespace dispatch { namespace http {
 
         pause();
         push_work();
-        _connection.async_read_some(asio::buffer(_read_buffer),
+        select_read_block();
+        _connection.async_read_some(asio::buffer(_read_block->data(), _read_block->size()),
                                     _strand.wrap([this]
                                                  (auto& ec, auto bytes)
                                                  {
@@ -76,6 +81,35 @@ namespace secr { namespace dispatch { namespace http {
         return true;
     }
     
+    void server_connection::select_read_block()
+    {
+        assert(_strand.running_in_this_thread());
+        if (_read_block and not _read_block->pinned())
+            return;
+        
+        // an unpinned block is referred to by no request. Since only this
+        // strand pins blocks, it cannot become pinned again behind our backs.
+        auto first = std::begin(_spare_read_blocks);
+        auto last = std::end(_spare_read_blocks);
+        auto ifree = std::find_if(first, last,
+                                  [](const read_block_ptr& p) { return not p->pinned(); });
+        // take the position now: push_back below may reallocate the vector
+        auto found = ifree != last;
+        auto index = std::distance(first, ifree);
+        
+        if (_read_block and _spare_read_blocks.size() < max_spare_read_blocks) {
+            _spare_read_blocks.push_back(std::move(_read_block));
+        }
+
+        if (found) {
+            _read_block = std::move(_spare_read_blocks[index]);
+            _spare_read_blocks.erase(std::begin(_spare_read_blocks) + index);
+        }
+        else {
+            _read_block = std::make_shared<read_block>();
+        }
+    }
+    
     void server_connection::pause()
     {
         SECR_DISPATCH_TRACE_METHOD("server_connection", __func__);
@@ -103,7 +137,7 @@ namespace secr { namespace dispatch { namespace http {
         {
             http_parser_execute(parser(),
                                 parser_settings(),
-                                _read_buffer.data(),
+                                _read_block->data(),
                                 bytes_available);
         }
         handle_protocol_error(parser_error(parser()));
@@ -119,6 +153,7 @@ namespace secr { namespace dispatch { namespace http {
         receiver_end_request(asio::error::misc_errors::eof);
         assert(!_current_receiver);
         new_receiver();
+        arm_read_timeout(read_phase::header);
         return 0;
     }
     
@@ -129,7 +164,7 @@ namespace secr { namespace dispatch { namespace http {
         assert(_strand.running_in_this_thread());
         assert(_current_receiver);
         try {
-            _current_receiver->append_uri(begin, size);
+            _current_receiver->append_uri(_read_block, begin, size);
         }
         catch(...)
         {
@@ -147,7 +182,7 @@ namespace secr { namespace dispatch { namespace http {
         assert(_strand.running_in_this_thread());
         assert(_current_receiver);
         try {
-            _current_receiver->append_header_field(begin, size);
+            _current_receiver->append_header_field(_read_block, begin, size);
         }
         catch(...)
         {
@@ -164,7 +199,7 @@ namespace secr { namespace dispatch { namespace http {
         assert(_strand.running_in_this_thread());
         assert(_current_receiver);
         try {
-            _current_receiver->append_header_value(begin, size);
+            _current_receiver->append_header_value(_read_block, begin, size);
         }
         catch(...) {
             handle_protocol_error(std::current_exception());
@@ -181,6 +216,7 @@ namespace secr { namespace dispatch { namespace http {
         try {
             _current_receiver->finalise_header(parser());
             receiver_available_for_dispatch();
+            arm_read_timeout(read_phase::body);
         }
         catch(...)
         {
@@ -197,6 +233,7 @@ namespace secr { namespace dispatch { namespace http {
                                      static_cast<const void*>(data), size);
         assert(_strand.running_in_this_thread());
         try {
+            _body_bytes_this_interval += size;
             _current_receiver->consume_body(data, size);
             if (_parser.content_length == 0) {
                 receiver_end_request(asio::error::misc_errors::eof);
@@ -209,11 +246,20 @@ namespace secr { namespace dispatch { namespace http {
         }
     }
     
+    int server_connection::handle_message_fully_read()
+    {
+        SECR_DISPATCH_TRACE_METHOD("server_connection", __func__);
+        assert(_strand.running_in_this_thread());
+        arm_read_timeout(read_phase::idle);
+        return 0;
+    }
+    
     void server_connection::handle_transport_error(const error_code &ec)
     {
         SECR_DISPATCH_TRACE_METHOD_N("server_connection", __func__, ec.message());
         assert(_strand.running_in_this_thread());
         if (ec && !_error) {
+            cancel_read_timeout();
             pause(); // note - not matched with an unpause. prevents any more reading from stream
             receiver_end_request(ec);
             if (not asioex::is_eof(ec)) {
@@ -221,6 +267,7 @@ namespace secr { namespace dispatch { namespace http {
             }
             _responder.submit_error(ec);
             _error = std::make_exception_ptr(system_error(ec));
+            attempt_dispatch();
         }
     }
     
@@ -242,6 +289,7 @@ namespace secr { namespace dispatch { namespace http {
         assert(_strand.running_in_this_thread());
         if (ep && !_error)
         {
+            cancel_read_timeout();
             pause();
             
             receiver_end_request(asio::error::basic_errors::operation_aborted);
@@ -260,9 +308,41 @@ namespace secr { namespace dispatch { namespace http {
         SECR_DISPATCH_TRACE_METHOD("server_connection",__func__);
         assert(_strand.running_in_this_thread());
         assert(not _current_receiver);
-        _current_receiver = std::make_shared<request_context>(_connection_id,
-                                                              _strand.get_io_service(),
-                                                              _dispatch_service);
+        _current_receiver = _context_pool.acquire(_connection_id, _dispatch_service);
+        _current_receiver->set_date_header(_date_header);
+        _current_receiver->set_compression(_compression);
+        _current_receiver->set_entity_tags(_entity_tags);
+        _current_receiver->set_response_cache(_response_cache);
+        _current_receiver->request_stream().set_watermarks(_request_high_watermark,
+                                                           _request_low_watermark,
+                                                           [this](bool above_high) {
+                                                               this->handle_request_watermark(above_high);
+                                                           });
+    }
+    
+    void server_connection::handle_request_watermark(bool above_high)
+    {
+        SECR_DISPATCH_TRACE_METHOD_N("server_connection", __func__, above_high);
+        if (above_high)
+        {
+            // the request stream only grows in consume_body, which runs on the strand.
+            // the work keeps this object alive until the matching notification
+            // below has run
+            assert(_strand.running_in_this_thread());
+            ++_backpressure_pauses;
+            pause();
+            push_work();
+        }
+        else
+        {
+            // the handler may drain the stream on any thread, or the stream may
+            // be destroyed with the request
+            _strand.post([this] {
+                --this->_backpressure_pauses;
+                this->unpause();
+                this->pop_work();
+            });
+        }
     }
 
     void server_connection::receiver_end_request(error_code ec)
@@ -271,6 +351,10 @@ namespace secr { namespace dispatch { namespace http {
         assert(_strand.running_in_this_thread());
         if (_current_receiver) {
             _current_receiver->request_stream().set_error(ec);
+            if (not asioex::is_eof(ec)) {
+                // nobody will read the rest of this body. Don't wait for it to drain.
+                _current_receiver->request_stream().clear_watermarks();
+            }
             _current_receiver.reset();
         }
     }
@@ -280,8 +364,21 @@ namespace secr { namespace dispatch { namespace http {
         SECR_DISPATCH_TRACE_METHOD("server_connection",__func__);
         assert(_strand.running_in_this_thread());
         if (_current_receiver) {
-            _requests_pending_dispatch.push_back(_current_receiver);
-            attempt_dispatch();
+            auto entry = _response_cache
+            ? _response_cache->find(_current_receiver->raw_header())
+            : nullptr;
+            if (entry)
+            {
+                // answered here. The responder writes the stored response
+                // and the dispatch service never sees the request.
+                _current_receiver->request_stream().clear_watermarks();
+                respond_from_cache(*_current_receiver, std::move(entry));
+            }
+            else
+            {
+                _requests_pending_dispatch.push_back(_current_receiver);
+                attempt_dispatch();
+            }
             receiver_available_for_response();
         }
     }
@@ -298,20 +395,163 @@ namespace secr { namespace dispatch { namespace http {
     {
         SECR_DISPATCH_TRACE_METHOD("server_connection",__func__);
         assert(_strand.running_in_this_thread());
-        if (_pending_dispatch)
+        while (not _pending_dispatches.empty())
         {
             if (not _requests_pending_dispatch.empty())
             {
-                auto op_ptr = std::move(_pending_dispatch);
+                auto op_ptr = std::move(_pending_dispatches.front());
+                _pending_dispatches.pop_front();
                 auto context = std::move(_requests_pending_dispatch.front());
                 _requests_pending_dispatch.pop_front();
                 op_ptr->complete(context);
             }
             else if (_error) {
-                auto op_ptr = std::move(_pending_dispatch);
+                auto op_ptr = std::move(_pending_dispatches.front());
+                _pending_dispatches.pop_front();
                 op_ptr->complete(_error);
             }
+            else {
+                break;
+            }
+        }
+    }
+    
+    void server_connection::arm_read_timeout(read_phase phase)
+    {
+        SECR_DISPATCH_TRACE_METHOD("server_connection", __func__);
+        assert(_strand.running_in_this_thread());
+        
+        connection_timeouts::duration timeout;
+        switch (phase)
+        {
+            case read_phase::idle:
+                timeout = _timeouts.idle;
+                break;
+            case read_phase::header:
+                timeout = _timeouts.header;
+                break;
+            case read_phase::body:
+                timeout = _timeouts.body_min_bytes_per_sec
+                ? _timeouts.body_interval
+                : connection_timeouts::duration::zero();
+                _body_bytes_this_interval = 0;
+                break;
         }
+        
+        if (_error or timeout == connection_timeouts::duration::zero()) {
+            cancel_read_timeout();
+            return;
+        }
+        
+        _read_phase = phase;
+        auto generation = ++_read_timer_generation;
+        // the work is popped either by the expiry handler or by whoever
+        // cancels the timer before it expires
+        push_work();
+        if (_read_timer.expires_after(timeout,
+                                      _strand.wrap([this, generation] {
+                                          this->handle_read_timeout(generation);
+                                      })))
+        {
+            pop_work();
+        }
+    }
+    
+    void server_connection::cancel_read_timeout()
+    {
+        SECR_DISPATCH_TRACE_METHOD("server_connection", __func__);
+        assert(_strand.running_in_this_thread());
+        ++_read_timer_generation;
+        if (_read_timer.cancel()) {
+            pop_work();
+        }
+    }
+    
+    void server_connection::handle_read_timeout(std::size_t generation)
+    {
+        SECR_DISPATCH_TRACE_METHOD_N("server_connection", __func__, generation);
+        assert(_strand.running_in_this_thread());
+        if (generation == _read_timer_generation and not _error)
+        {
+            switch (_read_phase)
+            {
+                case read_phase::idle:
+                    if (_responder.busy()) {
+                        // a response is still outstanding. The client is
+                        // waiting for us, not the other way round
+                        arm_read_timeout(read_phase::idle);
+                    }
+                    else {
+                        handle_timeout("idle");
+                    }
+                    break;
+                    
+                case read_phase::header:
+                    handle_timeout("header");
+                    break;
+                    
+                case read_phase::body:
+                {
+                    using seconds = std::chrono::duration<double>;
+                    auto interval = std::chrono::duration_cast<seconds>(_timeouts.body_interval).count();
+                    auto required = std::size_t(interval * _timeouts.body_min_bytes_per_sec);
+                    if (_backpressure_pauses or _body_bytes_this_interval >= required) {
+                        arm_read_timeout(read_phase::body);
+                    }
+                    else {
+                        handle_timeout("body progress");
+                    }
+                    break;
+                }
+            }
+        }
+        pop_work();
+    }
+    
+    void server_connection::arm_write_timeout()
+    {
+        SECR_DISPATCH_TRACE_METHOD("server_connection", __func__);
+        assert(_strand.running_in_this_thread());
+        auto generation = ++_write_timer_generation;
+        push_work();
+        if (_write_timer.expires_after(_timeouts.write,
+                                       _strand.wrap([this, generation] {
+                                           this->handle_write_timeout(generation);
+                                       })))
+        {
+            pop_work();
+        }
+    }
+    
+    void server_connection::cancel_write_timeout()
+    {
+        SECR_DISPATCH_TRACE_METHOD("server_connection", __func__);
+        assert(_strand.running_in_this_thread());
+        ++_write_timer_generation;
+        if (_write_timer.cancel()) {
+            pop_work();
+        }
+    }
+    
+    void server_connection::handle_write_timeout(std::size_t generation)
+    {
+        SECR_DISPATCH_TRACE_METHOD_N("server_connection", __func__, generation);
+        assert(_strand.running_in_this_thread());
+        if (generation == _write_timer_generation) {
+            handle_timeout("write");
+        }
+        pop_work();
+    }
+    
+    void server_connection::handle_timeout(const char* phase)
+    {
+        SECR_DISPATCH_TRACE_METHOD_N("server_connection", __func__, phase);
+        assert(_strand.running_in_this_thread());
+        BOOST_LOG_TRIVIAL(info) << "server_connection " << _connection_id << " - " << phase << " timeout";
+        handle_transport_error(asio::error::timed_out);
+        // abandon any read or write in progress
+        error_code sink;
+        _connection.cancel(sink);
     }
     
     void server_connection::push_work()
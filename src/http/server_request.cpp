@@ -1,5 +1,10 @@
 #include <secr/dispatch/http/server_connection.hpp>
 #include <secr/dispatch/http/server_request.hpp>
+#include <secr/dispatch/http/access_log.hpp>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <thread>
 
 
 namespace secr { namespace dispatch { namespace http {
@@ -16,11 +21,75 @@ namespace secr { namespace dispatch { namespace http {
     };
     
 
+    namespace
+    {
+        std::atomic<std::size_t> arena_blocks_allocated { 0 };
+        
+        /// Each arena block is preceded by the id of the thread which
+        /// allocated it. A protobuf arena gives its initial block to one
+        /// thread only, and other threads which allocate from the arena add
+        /// blocks of their own, so this tells the owner's blocks apart.
+        struct block_prefix
+        {
+            std::thread::id allocated_by;
+        };
+        constexpr std::size_t block_prefix_size = alignof(std::max_align_t);
+        static_assert(sizeof(block_prefix) <= block_prefix_size, "block prefix too large");
+        
+        /// The arena being reset on this thread, if any
+        struct reset_tally
+        {
+            std::thread::id owner;
+            std::size_t owner_space = 0;
+        };
+        thread_local reset_tally* current_reset = nullptr;
+        
+        void* counting_block_alloc(std::size_t size)
+        {
+            ++arena_blocks_allocated;
+            auto base = static_cast<char*>(::operator new(size + block_prefix_size));
+            new (base) block_prefix { std::this_thread::get_id() };
+            return base + block_prefix_size;
+        }
+        
+        void counting_block_dealloc(void* p, std::size_t size)
+        {
+            auto base = static_cast<char*>(p) - block_prefix_size;
+            auto prefix = reinterpret_cast<block_prefix*>(base);
+            if (current_reset and prefix->allocated_by == current_reset->owner) {
+                current_reset->owner_space += size;
+            }
+            prefix->~block_prefix();
+            ::operator delete(base);
+        }
+        
+        google::protobuf::ArenaOptions arena_options(char* initial_block,
+                                                     std::size_t initial_block_size)
+        {
+            google::protobuf::ArenaOptions options;
+            options.initial_block = initial_block;
+            options.initial_block_size = initial_block_size;
+            options.block_alloc = &counting_block_alloc;
+            options.block_dealloc = &counting_block_dealloc;
+            return options;
+        }
+    }
+    
+    std::size_t request_context::arena_block_allocations()
+    {
+        return arena_blocks_allocated.load();
+    }
+
     request_context::request_context(connection_id conn_id,
                                      asio::io_service& controller_service,
-                                     asio::io_service& dispatcher_service)
+                                     asio::io_service& dispatcher_service,
+                                     std::size_t initial_block_size)
     : _controller_service(controller_service)
     , _dispatcher_service(dispatcher_service)
+    , _initial_block_size(initial_block_size)
+    , _initial_block(initial_block_size ? new char[initial_block_size] : nullptr)
+    , _arena(arena_options(_initial_block.get(), _initial_block_size))
+    , _arena_owner(std::this_thread::get_id())
     , _request_manager(arena())
     , _response_header{ Arena::CreateMessage<HttpResponseHeader>(arena()), arena() }
     , _request_stream(_dispatcher_service, _controller_service)
@@ -28,97 +97,75 @@ namespace secr { namespace dispatch { namespace http {
     , _connection_id(std::move(conn_id))
     {}
     
+    void request_context::reset()
+    {
+        _request_stream.clear_watermarks();
+        _request_stream.reset();
+        _response_stream.reset();
+        _request_manager.reset();
+        
+        // the response header belongs to the arena
+        _response_header.release();
+        reset_tally tally { _arena_owner };
+        current_reset = std::addressof(tally);
+        _arena.Reset();
+        current_reset = nullptr;
+        _owner_space_allocated = _initial_block_size + tally.owner_space;
+        
+        // the arena gives its initial block to the thread which resets it
+        _arena_owner = std::this_thread::get_id();
+        _response_header.reset(Arena::CreateMessage<HttpResponseHeader>(arena()));
+        
+        _id = request_id(request_id::generate);
+        _bytes_received = 0;
+        _bytes_sent = 0;
+    }
+    
     
     
-    void request_context::append_uri(const char* begin, std::size_t size)
+    void request_context::append_uri(const read_block_ptr& block,
+                                     const char* begin, std::size_t size)
     {
-        _request_manager.request_header().mutable_uri()->append(begin, size);
+        _request_manager.raw_header().append_uri(block, begin, size);
     }
 
-    void request_context::append_header_field(const char* begin,
-                             std::size_t size)
+    void request_context::append_header_field(const read_block_ptr& block,
+                                              const char* begin,
+                                              std::size_t size)
     {
-        if (_current_hdr_value)
-        {
-            _current_header_object = nullptr;
-            _current_hdr_value = nullptr;
-        }
-        if (not _current_hdr_name) {
-            _current_header_object = mutable_request_header().add_headers();
-            _current_hdr_name = _current_header_object->mutable_name();
-        }
-        _current_hdr_name->append(begin, size);
+        _request_manager.raw_header().append_header_field(block, begin, size);
     }
     
-    void request_context::append_header_value(const char* begin,
-                             std::size_t size)
+    void request_context::append_header_value(const read_block_ptr& block,
+                                              const char* begin,
+                                              std::size_t size)
     {
-        if (_current_hdr_name) {
-            _current_hdr_name = nullptr;
-        }
-        assert(_current_header_object);
-        if (not _current_hdr_value) {
-            _current_hdr_value = _current_header_object->mutable_value();
-        }
-        _current_hdr_value->append(begin, size);
+        _request_manager.raw_header().append_header_value(block, begin, size);
     }
     
-    namespace
-    {
-        void check_url_field(http_parser_url& url_parser,
-                             HttpRequestHeader& msg,
-                             std::string* (HttpRequestHeader::QueryParts::*locate)(),
-                             int field)
-        {
-            if (url_parser.field_set & (1 << field))
-            {
-                auto& slot = url_parser.field_data[field];
-                std::size_t offset = slot.off;
-                std::size_t length = slot.len;
-                auto source = msg.uri().data();
-                auto& parts = *(msg.mutable_query());
-                (parts.*locate)()->append(source + offset, length);
-            }
-        }
-    }
-
     void request_context::finalise_header(http_parser* parser)
     {
-        _current_hdr_value = nullptr;
-        _current_hdr_name = nullptr;
-        _current_header_object = nullptr;
-        
-        http_parser_url url_parser;
-        http_parser_url_init(std::addressof(url_parser));
-        auto result = http_parser_parse_url(mutable_request_header().uri().data(),
-                                            mutable_request_header().uri().size(),
-                                            parser->method == HTTP_CONNECT,
-                                            std::addressof(url_parser));
-        if (result) {
-            BOOST_LOG_TRIVIAL(info) << "request_context::finalise_header - invalid url\n" << api::as_json(request_header());
-            throw invalid_url(request_header().uri());
+        try {
+            _request_manager.raw_header().finalise(parser);
         }
-        
-        check_url_field(url_parser, mutable_request_header(), &HttpRequestHeader::QueryParts::mutable_schema, UF_SCHEMA);
-        check_url_field(url_parser, mutable_request_header(), &HttpRequestHeader::QueryParts::mutable_host, UF_HOST);
-        check_url_field(url_parser, mutable_request_header(), &HttpRequestHeader::QueryParts::mutable_port, UF_PORT);
-        check_url_field(url_parser, mutable_request_header(), &HttpRequestHeader::QueryParts::mutable_path, UF_PATH);
-        check_url_field(url_parser, mutable_request_header(), &HttpRequestHeader::QueryParts::mutable_query, UF_QUERY);
-        check_url_field(url_parser, mutable_request_header(), &HttpRequestHeader::QueryParts::mutable_fragment, UF_FRAGMENT);
-        check_url_field(url_parser, mutable_request_header(), &HttpRequestHeader::QueryParts::mutable_user_info, UF_USERINFO);
-        mutable_request_header().set_method(http_method_str(static_cast<http_method>(parser->method)));
-        mutable_request_header().set_version_major(parser->http_major);
-        mutable_request_header().set_version_minor(parser->http_minor);
+        catch(const invalid_url&) {
+            BOOST_LOG_TRIVIAL(info) << "request_context::finalise_header - invalid url: "
+            << _request_manager.raw_header().uri();
+            throw;
+        }
+        _header_completed = clock_type::now();
         _response_header->set_version_major(parser->http_major);
         _response_header->set_version_minor(parser->http_minor);
-        BOOST_LOG_TRIVIAL(info) << "request_context::finalise_header - header complete:\n" << api::as_json(request_header());
+        if (access_log::dump_headers()) {
+            BOOST_LOG_TRIVIAL(debug) << "request_context::finalise_header - header complete:\n" << api::as_json(request_header());
+        }
     }
     
     void request_context::consume_body(const char *begin,
                                               std::size_t size)
     {
+        _bytes_received += size;
         asio::write(_request_stream, asio::buffer(begin, size));
-        
     }
     
     void request_context::notify_eof()
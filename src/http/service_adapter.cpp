@@ -0,0 +1,326 @@
+#include <secr/dispatch/http/service_adapter.hpp>
+#include <secr/dispatch/http/header_index.hpp>
+#include <secr/dispatch/http/negotiation.hpp>
+#include <secr/dispatch/http/request_header.hpp>
+#include <secr/dispatch/http/response_header.hpp>
+#include <secr/dispatch/api/json.hpp>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/util/json_util.h>
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace secr { namespace dispatch { namespace http {
+
+    const char protobuf_media_type[] = "application/x-protobuf";
+
+    namespace {
+
+        const char json_media_type[] = "application/json";
+
+        enum class codec { binary, json };
+
+        /// the server prefers to answer in the encoding of the request
+        const offered_media_types& offers_for(codec preferred)
+        {
+            static const offered_media_types binary_first { protobuf_media_type, json_media_type };
+            static const offered_media_types json_first { json_media_type, protobuf_media_type };
+            return preferred == codec::binary ? binary_first : json_first;
+        }
+
+        codec request_codec(dispatch_context& context)
+        {
+            auto& type = context.request().content_type();
+            if (iequals_ascii(type.type(), "application") and iequals_ascii(type.subtype(), "x-protobuf"))
+                return codec::binary;
+            return codec::json;
+        }
+
+        void respond_with_error(dispatch_context& context, int code, const std::string& text)
+        {
+            auto& response = context.response();
+            auto& header = response.mutable_header();
+            set_status(header, code, standard_reason(code).to_string());
+            set_header(header, "Content-Type", "text/plain");
+            error_code ec;
+            response.flush(asio::buffer(text), ec);
+        }
+
+        /// One call of a method over HTTP. It reads the request body, calls
+        /// the method and, when the method completes, sends the response.
+        class call : public method_call
+        {
+        public:
+            call(dispatch_context context,
+                 std::shared_ptr<const method_binding> method,
+                 codec request_codec,
+                 codec response_codec,
+                 std::size_t max_request_size)
+            : method_call(std::move(context), std::move(method))
+            , _request_codec(request_codec)
+            , _response_codec(response_codec)
+            , _max_request_size(max_request_size)
+            {}
+
+            void read_body()
+            {
+                if (_received == _body.size())
+                {
+                    // one byte beyond the limit shows that the body exceeds it
+                    auto limit = _max_request_size + 1;
+                    _body.resize(std::min(std::max(_body.size() * 2, std::size_t(4096)), limit));
+                }
+
+                auto& stream = context().request().stream();
+                stream.async_read_some(asio::buffer(_body.data() + _received, _body.size() - _received),
+                                       [self = shared_from_this(), this](const error_code& ec, std::size_t size)
+                                       {
+                                           handle_read(ec, size);
+                                       });
+            }
+
+        private:
+            void handle_read(const error_code& ec, std::size_t size)
+            {
+                _received += size;
+                if (_received > _max_request_size)
+                    return respond_with_error(context(), 413, "request body too large");
+                if (ec == asio::error::misc_errors::eof)
+                    return invoke();
+                if (ec)
+                    return;     // the connection has gone
+                read_body();
+            }
+
+            bool parse_request()
+            {
+                if (_request_codec == codec::binary)
+                {
+                    if (method().parse(request(), _body.data(), _received))
+                        return true;
+                    respond_with_error(context(), 400, "cannot parse " + request().GetTypeName());
+                    return false;
+                }
+
+                auto status = google::protobuf::util::JsonStringToMessage(std::string(_body.data(), _received),
+                                                                           std::addressof(request()));
+                if (status.ok())
+                    return true;
+                respond_with_error(context(), 400, status.ToString());
+                return false;
+            }
+
+            void invoke()
+            {
+                create_messages();
+                if (not parse_request())
+                    return;
+                auto reason = method().refuse(request());
+                if (not reason.empty())
+                    return respond_with_error(context(), 400, reason);
+                call_method();
+            }
+
+            void completed() override
+            {
+                if (controller().Failed())
+                    throw std::runtime_error(method().full_name() + " : " + controller().ErrorText());
+
+                auto& response = context().response();
+                std::string data;
+                if (_response_codec == codec::binary)
+                {
+                    if (not method().serialise(this->response(), data))
+                        throw std::runtime_error("cannot serialise " + this->response().GetTypeName());
+                    set_header(response.mutable_header(), "Content-Type", protobuf_media_type);
+                }
+                else
+                {
+                    api::append_json(data, this->response(), api::json_options(api::compact_json,
+                                                                               api::include_defaults));
+                    set_header(response.mutable_header(), "Content-Type", json_media_type);
+                }
+                error_code ec;
+                response.flush(asio::buffer(data), ec);
+            }
+
+            void failed(std::exception_ptr ep) override
+            {
+                context().response().set_exception(std::move(ep));
+            }
+
+            codec _request_codec;
+            codec _response_codec;
+            std::size_t _max_request_size;
+
+            std::vector<char> _body;
+            std::size_t _received = 0;
+        };
+
+        /// A method bound through the service's descriptor
+        class reflection_binding final : public method_binding
+        {
+        public:
+            reflection_binding(std::shared_ptr<google::protobuf::Service> service,
+                               const google::protobuf::MethodDescriptor* method)
+            : _service(std::move(service))
+            , _method(method)
+            {}
+
+            const std::string& full_name() const override
+            {
+                return _method->full_name();
+            }
+
+            google::protobuf::Message* new_request(google::protobuf::Arena* arena) const override
+            {
+                return _service->GetRequestPrototype(_method).New(arena);
+            }
+
+            google::protobuf::Message* new_response(google::protobuf::Arena* arena) const override
+            {
+                return _service->GetResponsePrototype(_method).New(arena);
+            }
+
+            bool parse(google::protobuf::Message& request, const char* data, std::size_t size) const override
+            {
+                return request.ParseFromArray(data, int(size));
+            }
+
+            bool serialise(const google::protobuf::Message& response, std::string& out) const override
+            {
+                return response.SerializeToString(std::addressof(out));
+            }
+
+            void call(rpc_controller& controller,
+                      const google::protobuf::Message* request,
+                      google::protobuf::Message* response,
+                      google::protobuf::Closure* done) const override
+            {
+                _service->CallMethod(_method, std::addressof(controller), request, response, done);
+            }
+
+        private:
+            std::shared_ptr<google::protobuf::Service> _service;
+            const google::protobuf::MethodDescriptor* _method;
+        };
+    }
+
+    void method_call::Run()
+    {
+        auto self = std::move(_self);
+        _completed = true;
+        try {
+            completed();
+        }
+        catch(...) {
+            failed(std::current_exception());
+        }
+        _controller.notify_complete();
+    }
+
+    void method_call::create_messages()
+    {
+        auto arena = context().request().arena();
+        _request = _method->new_request(arena);
+        _response = _method->new_response(arena);
+    }
+
+    void method_call::call_method()
+    {
+        _self = shared_from_this();
+        try {
+            _method->call(_controller, _request, _response, this);
+        }
+        catch(...)
+        {
+            if (_completed)
+            {
+                BOOST_LOG_TRIVIAL(warning) << "method call - " << _method->full_name()
+                << " threw after completing";
+                return;
+            }
+            auto self = std::move(_self);
+            failed(std::current_exception());
+        }
+    }
+
+    rpc_controller::~rpc_controller()
+    {
+        // a call which never completes
+        if (_on_cancel)
+            _on_cancel->Run();
+    }
+
+    void rpc_controller::Reset()
+    {
+        _failed = false;
+        _error_text.clear();
+        _on_cancel = nullptr;
+    }
+
+    void rpc_controller::SetFailed(const std::string& reason)
+    {
+        _failed = true;
+        _error_text = reason;
+    }
+
+    void rpc_controller::NotifyOnCancel(google::protobuf::Closure* callback)
+    {
+        _on_cancel = callback;
+    }
+
+    void rpc_controller::notify_complete()
+    {
+        if (auto callback = _on_cancel)
+        {
+            _on_cancel = nullptr;
+            callback->Run();
+        }
+    }
+
+    std::shared_ptr<const method_binding>
+    bind_method(std::shared_ptr<google::protobuf::Service> service,
+                const google::protobuf::MethodDescriptor* method)
+    {
+        return std::make_shared<const reflection_binding>(std::move(service), method);
+    }
+
+    void serve_call(dispatch_context context,
+                    std::shared_ptr<const method_binding> method,
+                    const service_options& options)
+    {
+        if (not method)
+            return respond_with_error(context, 404, "no such method");
+
+        auto in = request_codec(context);
+        auto offer = context.request().negotiate(offers_for(in));
+        if (not offer)
+            return respond_with_error(context, 406, "application/x-protobuf or application/json only");
+        auto out = offer->text == protobuf_media_type ? codec::binary : codec::json;
+
+        std::make_shared<call>(std::move(context), std::move(method),
+                               in, out, options.max_request_size)->read_body();
+    }
+
+    void add_service(router& r,
+                     std::shared_ptr<google::protobuf::Service> service,
+                     const service_options& options)
+    {
+        auto descriptor = service->GetDescriptor();
+        for (int i = 0 ; i < descriptor->method_count() ; ++i)
+        {
+            auto method = descriptor->method(i);
+            auto binding = bind_method(service, method);
+            r.add("POST", "/" + descriptor->full_name() + "/" + method->name(),
+                  [binding, options](dispatch_context context, const route_parameters&)
+                  {
+                      serve_call(std::move(context), binding, options);
+                  });
+        }
+    }
+
+}}}
@@ -0,0 +1,50 @@
+#include <secr/dispatch/spsc_fake_stream.hpp>
+
+namespace secr { namespace dispatch {
+
+    namespace {
+
+        std::size_t round_up_to_power_of_two(std::size_t n)
+        {
+            std::size_t result = 1;
+            while (result < n)
+                result *= 2;
+            return result;
+        }
+    }
+
+    spsc_fake_stream::spsc_fake_stream(asio::io_service& read_io_service,
+                                       asio::io_service& write_io_service,
+                                       std::size_t capacity)
+    : _read_io_service(read_io_service)
+    , _write_io_service(write_io_service)
+    , _data(new char[round_up_to_power_of_two(capacity)])
+    , _mask(round_up_to_power_of_two(capacity) - 1)
+    {
+    }
+
+    void spsc_fake_stream::set_error(error_code ec)
+    {
+        assert(ec);
+        bool expected = false;
+        if (_error_claimed.compare_exchange_strong(expected, true))
+        {
+            _error_code = ec;
+            _failed.store(true);
+        }
+        wake(_reader, error_code());
+        wake(_writer, error_code());
+    }
+
+    void spsc_fake_stream::cancel() noexcept
+    {
+        try {
+            wake(_reader, asio::error::basic_errors::operation_aborted);
+            wake(_writer, asio::error::basic_errors::operation_aborted);
+        }
+        catch(...) {
+            // ignore
+        }
+    }
+
+}}
@@ -0,0 +1,32 @@
+#include <gtest/gtest.h>
+
+#include <secr/dispatch/http/access_log.hpp>
+
+#include <cstddef>
+
+TEST(access_log_tests, samples_one_in_interval)
+{
+    using namespace secr::dispatch;
+    
+    auto saved = http::access_log::options();
+    
+    http::access_log_options options;
+    options.sample_interval = 4;
+    options.severity = boost::log::trivial::debug;
+    http::access_log::configure(options);
+    EXPECT_EQ(4, http::access_log::options().sample_interval);
+    EXPECT_EQ(boost::log::trivial::debug, http::access_log::options().severity);
+    EXPECT_FALSE(http::access_log::dump_headers());
+    
+    std::size_t sampled = 0;
+    for (int i = 0 ; i < 100 ; ++i)
+        if (http::access_log::sample()) ++sampled;
+    EXPECT_EQ(25, sampled);
+    
+    options.sample_interval = 0;
+    http::access_log::configure(options);
+    for (int i = 0 ; i < 100 ; ++i)
+        EXPECT_FALSE(http::access_log::sample());
+    
+    http::access_log::configure(saved);
+}
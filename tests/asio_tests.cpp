@@ -574,3 +574,79 @@ TEST_F(http_server_test, valid_get_with_response)
     
 }
 
+
+TEST_F(http_server_test, dispatch_window_responds_in_request_order)
+{
+    namespace asio = secr::dispatch::asio;
+    using secr::dispatch::http::dispatch_context;
+    ASSERT_TRUE(tie_sockets(client_socket, server_socket));
+    
+    auto server_service_result = std::async(std::launch::async, [&]{
+        while (not server_service.stopped())
+            server_service.run_one();
+    });
+    
+    secr::dispatch::http::server_connection http_server(std::move(server_socket),
+                                                        dispatch_service);
+    http_server.set_dispatch_window(2);
+    
+    bool stopped { false };
+    http_server.async_start(client_service.wrap([&](std::exception_ptr errors)
+                                                {
+                                                    stopped = true;
+                                                }));
+    
+    secr::dispatch::error_code client_error;
+    write(client_socket, buffers_of(valid_get_text), client_error);
+    ASSERT_FALSE(client_error) << client_error.message();
+    client_socket.shutdown(boost::asio::socket_base::shutdown_send, client_error);
+    ASSERT_FALSE(client_error) << client_error.message();
+    
+    //
+    // both requests are dispatched before either has responded
+    //
+    std::vector<dispatch_context> contexts;
+    auto collect = [&](auto& future)
+    {
+        ASSERT_TRUE(ready(future));
+        try {
+            contexts.push_back(future.get());
+        }
+        catch(...) {
+            FAIL() << value::debug::unwrap();
+        }
+    };
+    http_server.async_wait_dispatch(collect);
+    http_server.async_wait_dispatch(collect);
+    
+    ASSERT_TRUE(spins_once_within(dispatch_service, a_moment())) << "notification of dispatch 1";
+    ASSERT_TRUE(spins_once_within(dispatch_service, a_moment())) << "notification of dispatch 2";
+    ASSERT_EQ(2, contexts.size());
+    
+    //
+    // the second handler completes first, but its response must follow the first
+    //
+    auto respond = [](dispatch_context& context, const std::string& text) {
+        secr::dispatch::error_code ec;
+        context.response().flush(asio::buffer(text), ec);
+        EXPECT_FALSE(ec) << ec.message();
+    };
+    respond(contexts[1], "second");
+    EXPECT_EQ("", consume_available_in(client_socket, 10ms));
+    respond(contexts[0], "first");
+    contexts.clear();
+    
+    auto response = consume_available_in(client_socket, a_moment());
+    EXPECT_EQ("HTTP/1.1 200 OK\r\nContent-Length: 5\r\nConnection: keep-alive\r\n\r\nfirst"
+              "HTTP/1.1 200 OK\r\nContent-Length: 6\r\nConnection: close\r\n\r\nsecond",
+              response);
+    
+    ASSERT_TRUE(spins_once_within(client_service, a_moment())) << "notification of server completion";
+    ASSERT_TRUE(stopped);
+    
+    server_service.stop();
+    ASSERT_NO_THROW(server_service_result.get());
+    
+    dispatch_service.stop();
+    client_service.stop();
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+
+#include <secr/dispatch/http/batch.hpp>
+#include <secr/dispatch/http/server.hpp>
+#include <secr/dispatch/testing.pb.h>
+
+#include <memory>
+#include <string>
+
+namespace {
+
+    namespace asio = secr::dispatch::asio;
+    namespace http = secr::dispatch::http;
+    namespace test_proto = ::secr::testing;
+    using protocol = asio::ip::tcp;
+
+    void add_call(http::BatchRequest& batch, const std::string& method, int x, int y)
+    {
+        test_proto::IntPair pair;
+        pair.set_x(x);
+        pair.set_y(y);
+        auto call = batch.add_calls();
+        call->set_method("secr.testing.TestService." + method);
+        call->set_payload(pair.SerializeAsString());
+    }
+
+    int result_of(const http::BatchResult& result)
+    {
+        test_proto::Int value;
+        EXPECT_EQ(http::BatchResult::kPayload, result.outcome_case());
+        EXPECT_TRUE(value.ParseFromString(result.payload()));
+        return value.z();
+    }
+
+    std::string error_of(const http::BatchResult& result)
+    {
+        EXPECT_EQ(http::BatchResult::kErrors, result.outcome_case());
+        return result.errors().exceptions_size() ? result.errors().exceptions(0).what() : std::string();
+    }
+}
+
+TEST(batch_tests, gathers_results_in_order)
+{
+    auto service = std::make_shared<test_service>();
+    auto methods = std::make_shared<http::method_registry>();
+    methods->add_service(service);
+    EXPECT_EQ(5, methods->size());
+
+    http::router router;
+    http::add_batch_endpoint(router, methods);
+
+    http::server_options options;
+    options.threads = 1;
+    http::server server(http::server::endpoint_type(asio::ip::address_v4::loopback(), 0),
+                        [&router](http::dispatch_context context) { router(std::move(context)); },
+                        options);
+    server.start();
+
+    http::BatchRequest batch;
+    add_call(batch, "complete_async_after_delay", 30, 2);
+    add_call(batch, "complete_sync", 2, 3);
+    add_call(batch, "complete_async_after_delay", 1, 7);
+    add_call(batch, "no_such_method", 0, 0);
+    add_call(batch, "sync_throw_nocomplete", 0, 0);
+    add_call(batch, "parameterised_test", 0, 0);
+    batch.add_calls()->set_method("secr.testing.TestService.complete_sync");
+    batch.mutable_calls(6)->set_payload("\xff\xff");
+
+    auto body = batch.SerializeAsString();
+    asio::io_service client_service;
+    auto response = round_trip(client_service, server.local_endpoint(),
+                               "POST /batch HTTP/1.1\r\n"
+                               "Host: localhost\r\n"
+                               "Content-Type: application/x-protobuf\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n"
+                               "\r\n"
+                               + body);
+    server.stop();
+
+    auto header_end = response.find("\r\n\r\n");
+    ASSERT_NE(std::string::npos, header_end);
+    EXPECT_EQ(0, response.find("HTTP/1.1 200 OK\r\n"));
+
+    // one failure does not fail the batch
+    http::BatchResponse results;
+    ASSERT_TRUE(results.ParseFromString(response.substr(header_end + 4)));
+    ASSERT_EQ(7, results.results_size());
+    EXPECT_EQ(60, result_of(results.results(0)));
+    EXPECT_EQ(5, result_of(results.results(1)));
+    EXPECT_EQ(7, result_of(results.results(2)));
+    EXPECT_EQ("no such method secr.testing.TestService.no_such_method", error_of(results.results(3)));
+    EXPECT_EQ("no completion", error_of(results.results(4)));
+    EXPECT_NE(std::string::npos, error_of(results.results(5)).find("not implemented"));
+    EXPECT_EQ("cannot parse secr.testing.IntPair", error_of(results.results(6)));
+}
+
+TEST(batch_tests, refuses_large_batches)
+{
+    auto service = std::make_shared<test_service>();
+    auto methods = std::make_shared<http::method_registry>();
+    methods->add_service(service);
+
+    http::service_options limits;
+    limits.max_batch_calls = 2;
+    http::router router;
+    http::add_batch_endpoint(router, methods, limits);
+
+    http::server_options options;
+    options.threads = 1;
+    http::server server(http::server::endpoint_type(asio::ip::address_v4::loopback(), 0),
+                        [&router](http::dispatch_context context) { router(std::move(context)); },
+                        options);
+    server.start();
+
+    http::BatchRequest batch;
+    for (int i = 0 ; i < 3 ; ++i)
+        add_call(batch, "complete_async_after_delay", 1, i);
+
+    auto body = batch.SerializeAsString();
+    asio::io_service client_service;
+    auto response = round_trip(client_service, server.local_endpoint(),
+                               "POST /batch HTTP/1.1\r\n"
+                               "Host: localhost\r\n"
+                               "Content-Type: application/x-protobuf\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n"
+                               "\r\n"
+                               + body);
+    server.stop();
+
+    // none of the calls was made
+    EXPECT_EQ(0, response.find("HTTP/1.1 400 Bad Request\r\n")) << response;
+    EXPECT_TRUE(service->threads.empty());
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <secr/dispatch/http/compression.hpp>
+
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace secr::dispatch;
+
+    /// inflate either framing, as a client would
+    std::string inflate_all(const std::vector<char>& data)
+    {
+        z_stream z {};
+        EXPECT_EQ(Z_OK, inflateInit2(&z, MAX_WBITS + 32));
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        z.avail_in = uInt(data.size());
+
+        std::string result;
+        int status = Z_OK;
+        while (status == Z_OK)
+        {
+            char block[4096];
+            z.next_out = reinterpret_cast<Bytef*>(block);
+            z.avail_out = sizeof(block);
+            status = inflate(&z, Z_NO_FLUSH);
+            result.append(block, sizeof(block) - z.avail_out);
+        }
+        EXPECT_EQ(Z_STREAM_END, status);
+        inflateEnd(&z);
+        return result;
+    }
+
+    std::string sample_json(std::size_t records)
+    {
+        std::string result = "[";
+        for (std::size_t i = 0 ; i < records ; ++i)
+        {
+            if (i) result += ",";
+            result += "{\"id\":" + std::to_string(i) + ",\"name\":\"record " + std::to_string(i)
+            + "\",\"active\":true,\"tags\":[\"alpha\",\"beta\"]}";
+        }
+        return result + "]";
+    }
+}
+
+TEST(compression_tests, round_trip)
+{
+    auto text = sample_json(1000);
+
+    for (auto coding : { http::content_coding::gzip, http::content_coding::deflate })
+    {
+        auto c = http::acquire_compressor(coding, 6);
+        std::vector<char> out;
+
+        // in several pieces, as a handler would write them
+        for (std::size_t pos = 0 ; pos < text.size() ; pos += 1000)
+            c->compress(asio::buffer(text.data() + pos, std::min<std::size_t>(1000, text.size() - pos)),
+                        http::compress_flush::none, out);
+        c->compress(asio::const_buffer(), http::compress_flush::finish, out);
+
+        EXPECT_EQ(text, inflate_all(out));
+        EXPECT_LT(out.size() * 8, text.size());
+
+        // gzip has its own magic number
+        ASSERT_LE(2, out.size());
+        EXPECT_EQ(coding == http::content_coding::gzip,
+                  std::uint8_t(out[0]) == 0x1f and std::uint8_t(out[1]) == 0x8b);
+    }
+}
+
+TEST(compression_tests, sync_flush_brings_out_everything_written)
+{
+    auto text = sample_json(100);
+    auto half = text.size() / 2;
+
+    auto c = http::acquire_compressor(http::content_coding::gzip, 6);
+    std::vector<char> out;
+    c->compress(asio::buffer(text.data(), half), http::compress_flush::sync, out);
+
+    // a client can read the first half before the stream ends
+    z_stream z {};
+    ASSERT_EQ(Z_OK, inflateInit2(&z, MAX_WBITS + 32));
+    z.next_in = reinterpret_cast<Bytef*>(out.data());
+    z.avail_in = uInt(out.size());
+    std::string first(text.size(), 0);
+    z.next_out = reinterpret_cast<Bytef*>(&first[0]);
+    z.avail_out = uInt(first.size());
+    EXPECT_EQ(Z_OK, inflate(&z, Z_SYNC_FLUSH));
+    first.resize(first.size() - z.avail_out);
+    inflateEnd(&z);
+    EXPECT_EQ(text.substr(0, half), first);
+
+    c->compress(asio::buffer(text.data() + half, text.size() - half), http::compress_flush::finish, out);
+    EXPECT_EQ(text, inflate_all(out));
+}
+
+TEST(compression_tests, compressors_are_reused)
+{
+    auto text = sample_json(10);
+
+    const http::compressor* first = nullptr;
+    {
+        auto c = http::acquire_compressor(http::content_coding::gzip, 6);
+        first = c.get();
+
+        // abandoned half way through
+        std::vector<char> out;
+        c->compress(asio::buffer(text), http::compress_flush::none, out);
+    }
+
+    auto c = http::acquire_compressor(http::content_coding::gzip, 1);
+    EXPECT_EQ(first, c.get());
+
+    // a reused compressor starts a fresh stream
+    std::vector<char> out;
+    c->compress(asio::buffer(text), http::compress_flush::finish, out);
+    EXPECT_EQ(text, inflate_all(out));
+
+    // each coding has its own pool
+    auto d = http::acquire_compressor(http::content_coding::deflate, 6);
+    EXPECT_NE(first, d.get());
+    EXPECT_EQ(http::content_coding::deflate, d->coding());
+}
@@ -1,73 +1,441 @@
 #include <gtest/gtest.h>
 #include "test_utils.hpp"
 #include <secr/dispatch/fake_stream.hpp>
+#include <secr/dispatch/spsc_fake_stream.hpp>
+#include <secr/dispatch/asioex/transfer.hpp>
+#include <boost/asio/local/connect_pair.hpp>
 #include <vector>
 #include <thread>
 #include <future>
 #include <random>
 #include <algorithm>
 #include <iterator>
+#include <unistd.h>
 
 
-TEST(fake_stream_tests, mass_transport)
-{
+namespace {
+
     using char_buffer = std::vector<char>;
     using char_buffers = std::vector<char_buffer>;
+
+    /// Buffers of 40 to 80 random capital letters
+    char_buffers random_buffers(std::size_t count)
+    {
+        std::random_device rd;
+        std::default_random_engine eng(rd());
+        std::uniform_int_distribution<int> length(40, 80);
+        std::uniform_int_distribution<int> chars('A', 'Z');
+        
+        char_buffers vv;
+        for (std::size_t i = 0 ; i < count ; ++i)
+        {
+            char_buffer v;
+            std::generate_n(std::back_inserter(v),
+                            length(eng),
+                            [&eng, &chars] { return char(chars(eng)); });
+            vv.push_back(std::move(v));
+        }
+        return vv;
+    }
+
+    /// Send the buffers through a stream, a few at a time, from this thread
+    /// to a reader on another, which reads read_size bytes at a time
+    template<class ReadStream, class WriteStream>
+    void mass_transport(ReadStream& sread, WriteStream& swrite,
+                        const char_buffers& vv, std::size_t read_size)
+    {
+        std::default_random_engine eng;
+
+        auto frecv = std::async(std::launch::async,
+                                [&]
+        {
+            std::string result;
+            std::vector<char> buf(read_size);
+            secr::dispatch::error_code ec;
+            while (not ec) {
+                auto size = secr::dispatch::asio::read(sread, secr::dispatch::asio::buffer(buf), ec);
+                result.append(buf.data(), size);
+            }
+            return result;
+        });
+
+        std::string sent;
+        for (std::size_t i = 0 ; i < vv.size() ; )
+        {
+            auto remaining = vv.size() - i;
+            auto to_send = std::uniform_int_distribution<std::size_t>(1,5)(eng);
+            to_send = std::min(remaining, to_send);
+            auto buffers = buffers_of(std::begin(vv) + i , std::begin(vv) + i + to_send);
+            secr::dispatch::error_code ec;
+            secr::dispatch::asio::write(swrite, buffers, ec);
+            EXPECT_FALSE(ec);
+            for (auto x = i ; x < i + to_send ; ++x) {
+                sent.append(vv[x].begin(), vv[x].end());
+            }
+            i += to_send;
+        }
+        swrite.close();
+
+        std::string srecv;
+        EXPECT_NO_THROW(srecv = frecv.get());
+        EXPECT_EQ(sent, srecv);
+    }
+}
+
+TEST(fake_stream_tests, mass_transport)
+{
+    boost::asio::io_service s, d;
+    secr::dispatch::fake_stream fs(s, d);
+    auto sread = secr::dispatch::fake_stream_read_interface(fs);
+    auto swrite = secr::dispatch::fake_stream_write_interface(fs);
+    mass_transport(sread, swrite, random_buffers(100), 30);
+}
+
+TEST(fake_stream_tests, spsc_mass_transport)
+{
+    // short reads which end midway through the writes and wrap around the ring
+    auto vv = random_buffers(100);
+    boost::asio::io_service s, d;
+    secr::dispatch::spsc_fake_stream fs(s, d, 256);
+    mass_transport(fs, fs, vv, 30);
+}
+
+// a benchmark, which is run with --gtest_also_run_disabled_tests
+TEST(fake_stream_tests, DISABLED_mass_transport_benchmark)
+{
+    auto vv = random_buffers(1000);
+    std::size_t bytes = 0;
+    for (auto& v : vv)
+        bytes += v.size();
+    constexpr std::size_t rounds = 200;
+    boost::asio::io_service s, d;
     
-    char_buffers vv;
+    report_timing("fake_stream", rounds, "bytes", [&]
+    {
+        secr::dispatch::fake_stream fs(s, d);
+        auto sread = secr::dispatch::fake_stream_read_interface(fs);
+        auto swrite = secr::dispatch::fake_stream_write_interface(fs);
+        mass_transport(sread, swrite, vv, 4096);
+        return bytes;
+    });
     
-    std::random_device rd;
-    std::default_random_engine eng(rd());
-    std::uniform_int_distribution<int> length(40, 80);
-    std::uniform_int_distribution<char> chars('A', 'Z');
+    report_timing("spsc_fake_stream", rounds, "bytes", [&]
+    {
+        secr::dispatch::spsc_fake_stream fs(s, d);
+        mass_transport(fs, fs, vv, 4096);
+        return bytes;
+    });
+}
+
+TEST(fake_stream_tests, watermarks)
+{
+    namespace asio = secr::dispatch::asio;
+    
+    asio::io_service s, d;
+    std::vector<bool> notifications;
     
-    for (int i = 0 ; i < 100 ; ++i)
     {
-        char_buffer v;
-        std::generate_n(std::back_inserter(v),
-                        length(eng),
-                        [&eng, &chars] { return chars(eng); });
-        vv.push_back(std::move(v));
+        secr::dispatch::fake_stream fs(s, d);
+        fs.set_watermarks(10, 4, [&](bool above_high) { notifications.push_back(above_high); });
+        
+        std::string data(8, 'x');
+        fs.write_some(asio::buffer(data));
+        EXPECT_EQ(std::vector<bool>(), notifications);
+        
+        fs.write_some(asio::buffer(data));
+        EXPECT_EQ(std::vector<bool>({ true }), notifications);
+        
+        // writing more does not notify again
+        fs.write_some(asio::buffer(data));
+        EXPECT_EQ(std::vector<bool>({ true }), notifications);
+        
+        char buf[16];
+        fs.read_some(asio::buffer(buf, 16));
+        EXPECT_EQ(std::vector<bool>({ true }), notifications);
+        
+        fs.read_some(asio::buffer(buf, 4));
+        EXPECT_EQ(std::vector<bool>({ true, false }), notifications);
+        
+        fs.write_some(asio::buffer(data));
+        EXPECT_EQ(std::vector<bool>({ true, false, true }), notifications);
     }
     
-    boost::asio::io_service s, d;
+    // destroying the stream while above the high watermark releases the writer
+    EXPECT_EQ(std::vector<bool>({ true, false, true, false }), notifications);
+}
+
+TEST(fake_stream_tests, attachments_keep_their_place)
+{
+    namespace asio = secr::dispatch::asio;
+    using secr::dispatch::error_code;
     
+    asio::io_service s, d;
     secr::dispatch::fake_stream fs(s, d);
-    auto sread = secr::dispatch::fake_stream_read_interface(fs);
-    auto swrite = secr::dispatch::fake_stream_write_interface(fs);
     
+    auto body = std::make_shared<std::string>("the body");
+    std::vector<std::pair<error_code, std::size_t>> completions;
+    auto record = [&](const error_code& ec, std::size_t size) { completions.emplace_back(ec, size); };
     
-    auto frecv = std::async(std::launch::async,
-                            [&]
+    fs.write_some(asio::buffer(std::string("head ")));
+    fs.attach(asio::buffer(*body), body, record);
+    fs.write_some(asio::buffer(std::string(" tail")));
+    fs.close();
+    
+    // the data is copied out in order, in small pieces
+    std::string result;
+    error_code ec;
+    while (not ec)
     {
-        std::string result;
-        char buf [30];
-        secr::dispatch::error_code ec;
-        while (not ec) {
-            auto size = secr::dispatch::asio::read(sread, secr::dispatch::asio::buffer(buf), ec);
-            result.append(buf, size);
+        char buf[3];
+        auto size = fs.read_some(asio::buffer(buf), ec);
+        result.append(buf, size);
+    }
+    EXPECT_EQ(asio::error::eof, ec);
+    EXPECT_EQ("head the body tail", result);
+    
+    // the owner is told once the data has been consumed
+    EXPECT_TRUE(completions.empty());
+    d.run();
+    ASSERT_EQ(1, completions.size());
+    EXPECT_FALSE(completions[0].first);
+    EXPECT_EQ(body->size(), completions[0].second);
+    
+    // attachments which are never read are aborted on reset
+    d.reset();
+    completions.clear();
+    fs.reset();
+    fs.attach(asio::buffer(*body), body, record);
+    fs.reset();
+    d.run();
+    ASSERT_EQ(1, completions.size());
+    EXPECT_EQ(asio::error::operation_aborted, completions[0].first);
+}
+
+namespace {
+    
+    /// an AsyncWriteStream which remembers where its data came from
+    struct recording_stream
+    {
+        recording_stream(secr::dispatch::asio::io_service& io_service) : _io_service(io_service) {}
+        
+        secr::dispatch::asio::io_service& get_io_service() { return _io_service; }
+        
+        template<class ConstBufferSequence, class Handler>
+        void async_write_some(const ConstBufferSequence& buffers, Handler&& handler)
+        {
+            std::size_t total = 0;
+            for (auto b : buffers)
+            {
+                auto data = secr::dispatch::asio::buffer_cast<const char*>(b);
+                auto size = secr::dispatch::asio::buffer_size(b);
+                if (size)
+                    sources.push_back(data);
+                written.append(data, size);
+                total += size;
+            }
+            _io_service.post([handler = std::forward<Handler>(handler), total]() mutable {
+                handler(secr::dispatch::error_code(), total);
+            });
         }
-        return result;
+        
+        secr::dispatch::asio::io_service& _io_service;
+        std::string written;
+        std::vector<const char*> sources;
+    };
+}
+
+TEST(fake_stream_tests, transfer_does_not_copy_attachments)
+{
+    namespace asio = secr::dispatch::asio;
+    using secr::dispatch::error_code;
+    
+    asio::io_service s, d;
+    secr::dispatch::fake_stream fs(s, d);
+    recording_stream destination(s);
+    
+    auto body = std::make_shared<std::string>(100000, 'x');
+    bool written = false;
+    fs.write_some(asio::buffer(std::string("head ")));
+    fs.attach(asio::buffer(*body), body, [&](const error_code& ec, std::size_t size) {
+        EXPECT_FALSE(ec);
+        EXPECT_EQ(100000, size);
+        written = true;
     });
+    fs.write_some(asio::buffer(std::string(" tail")));
+    fs.close();
+    
+    bool done = false;
+    secr::dispatch::asioex::transfer(fs, destination, [&](auto& read_error, auto& write_error, auto read, auto wrote) {
+        EXPECT_EQ(asio::error::eof, read_error);
+        EXPECT_FALSE(write_error);
+        EXPECT_EQ(100010, read);
+        EXPECT_EQ(100010, wrote);
+        done = true;
+    });
+    s.run();
+    d.run();
+    
+    EXPECT_TRUE(done);
+    EXPECT_TRUE(written);
+    EXPECT_EQ("head " + *body + " tail", destination.written);
+    EXPECT_NE(destination.sources.end(),
+              std::find(destination.sources.begin(), destination.sources.end(), body->data()));
+}
+
+namespace {
+    
+    /// a temporary file holding the given text, removed on destruction
+    struct temp_file
+    {
+        temp_file(const std::string& content)
+        {
+            fd = ::mkstemp(path);
+            EXPECT_LE(0, fd);
+            EXPECT_EQ(ssize_t(content.size()), ::write(fd, content.data(), content.size()));
+        }
+        
+        ~temp_file()
+        {
+            ::close(fd);
+            ::unlink(path);
+        }
+        
+        char path[40] = "/tmp/secr_dispatch_fake_stream_XXXXXX";
+        int fd;
+    };
     
-    std::string sent;
-    for (int i = 0 ; i < vv.size() ; )
+    /// A socket which offers itself to async_send_file
+    struct native_socket_stream
     {
-        auto remaining = vv.size() - i;
-        auto to_send = std::uniform_int_distribution<std::size_t>(1,5)(eng);
-        to_send = std::min(remaining, to_send);
-        auto buffers = buffers_of(std::begin(vv) + i , std::begin(vv) + i + to_send);
-        secr::dispatch::error_code ec;
-        secr::dispatch::asio::write(swrite, buffers, ec);
-        for (int x = i ; x < i + to_send ; ++x) {
-            sent.append(vv[x].begin(), vv[x].end());
+        using socket_type = secr::dispatch::asio::local::stream_protocol::socket;
+        
+        native_socket_stream(socket_type& socket) : _socket(socket) {}
+        
+        secr::dispatch::asio::io_service& get_io_service() { return _socket.get_io_service(); }
+        
+        template<class ConstBufferSequence, class Handler>
+        void async_write_some(const ConstBufferSequence& buffers, Handler&& handler)
+        {
+            _socket.async_write_some(buffers, std::forward<Handler>(handler));
+        }
+        
+        int native_socket()
+        {
+            _socket.native_non_blocking(true);
+            ++native_socket_calls;
+            return _socket.native_handle();
+        }
+        
+        template<class Handler>
+        void async_wait_writable(Handler&& handler)
+        {
+            _socket.async_write_some(secr::dispatch::asio::null_buffers(),
+                                     [handler = std::forward<Handler>(handler)](auto& ec, auto) mutable {
+                                         handler(ec);
+                                     });
         }
-        i += to_send;
+        
+        socket_type& _socket;
+        int native_socket_calls = 0;
+    };
+}
+
+TEST(fake_stream_tests, file_attachments)
+{
+    namespace asio = secr::dispatch::asio;
+    using secr::dispatch::error_code;
+    using secr::dispatch::fake_stream;
+    
+    std::string content;
+    for (int i = 0 ; i < 100000 ; ++i)
+        content += char('a' + i % 26);
+    temp_file file(content);
+    auto owner = std::make_shared<int>(0);
+    
+    std::vector<std::pair<error_code, std::size_t>> completions;
+    auto record = [&](const error_code& ec, std::size_t size) { completions.emplace_back(ec, size); };
+    auto fill = [&](fake_stream& fs) {
+        fs.write_some(asio::buffer(std::string("head ")));
+        fs.attach(fake_stream::file_region { file.fd, 10, 50000 }, owner, record);
+        fs.write_some(asio::buffer(std::string(" tail")));
+        fs.close();
+    };
+    auto expected = "head " + content.substr(10, 50000) + " tail";
+    
+    // a plain reader receives a copy of the file
+    {
+        asio::io_service s, d;
+        fake_stream fs(s, d);
+        fill(fs);
+        
+        std::string result;
+        error_code ec;
+        while (not ec)
+        {
+            char buf[1000];
+            auto size = fs.read_some(asio::buffer(buf), ec);
+            result.append(buf, size);
+        }
+        EXPECT_EQ(asio::error::eof, ec);
+        EXPECT_EQ(expected, result);
+        d.run();
+        ASSERT_EQ(1, completions.size());
+        EXPECT_FALSE(completions[0].first);
+        EXPECT_EQ(50000, completions[0].second);
     }
-    swrite.close();
     
-    frecv.wait_for(a_moment());
-    std::string srecv;
-    EXPECT_NO_THROW(srecv = frecv.get());
-    EXPECT_EQ(sent, srecv);
-}
\ No newline at end of file
+    // transfer to a stream without a socket reads the file a block at a time
+    {
+        completions.clear();
+        asio::io_service s, d;
+        fake_stream fs(s, d);
+        recording_stream destination(s);
+        fill(fs);
+        
+        bool done = false;
+        secr::dispatch::asioex::transfer(fs, destination, [&](auto& read_error, auto& write_error, auto read, auto wrote) {
+            EXPECT_EQ(asio::error::eof, read_error);
+            EXPECT_FALSE(write_error);
+            EXPECT_EQ(expected.size(), read);
+            EXPECT_EQ(expected.size(), wrote);
+            done = true;
+        });
+        s.run();
+        d.run();
+        EXPECT_TRUE(done);
+        EXPECT_EQ(expected, destination.written);
+        ASSERT_EQ(1, completions.size());
+        EXPECT_FALSE(completions[0].first);
+    }
+    
+    // transfer to a socket hands the file to the kernel
+    {
+        completions.clear();
+        asio::io_service s, d;
+        fake_stream fs(s, d);
+        native_socket_stream::socket_type local(s), remote(s);
+        asio::local::connect_pair(local, remote);
+        native_socket_stream destination(local);
+        fill(fs);
+        
+        bool done = false;
+        secr::dispatch::asioex::transfer(fs, destination, [&](auto& read_error, auto& write_error, auto read, auto wrote) {
+            EXPECT_EQ(asio::error::eof, read_error);
+            EXPECT_FALSE(write_error);
+            EXPECT_EQ(expected.size(), wrote);
+            done = true;
+        });
+        std::thread runner([&] { s.run(); });
+        
+        std::string received(expected.size(), 0);
+        asio::read(remote, asio::buffer(&received[0], received.size()));
+        runner.join();
+        d.run();
+        
+        EXPECT_TRUE(done);
+        EXPECT_EQ(expected, received);
+        EXPECT_EQ(1, destination.native_socket_calls);
+        ASSERT_EQ(1, completions.size());
+        EXPECT_FALSE(completions[0].first);
+    }
+}
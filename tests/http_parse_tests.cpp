@@ -6,6 +6,9 @@
 #include <boost/spirit/include/phoenix.hpp>
 #include <boost/fusion/include/adapted.hpp>
 
+#include <secr/dispatch/http/raw_request_header.hpp>
+
+#include <cstring>
 #include <utility>
 #include <vector>
 #include <string>
@@ -260,6 +263,7 @@ TEST(spirit_test, test1)
 #include <valuelib/debug/demangle.hpp>
 #include "test_utils.hpp"
 #include <secr/dispatch/http/request_header.hpp>
+#include <secr/dispatch/http/negotiation.hpp>
 #include <secr/dispatch/api/json.hpp>
 
 TEST(http_header_analise, test1)
@@ -273,9 +277,14 @@ TEST(http_header_analise, test1)
     
     set_unique_header(rh, "Accept", "text/plain; q=0.5, text/html, text/x-dvi; q=0.8, text/x-c");
     
-    //    analyse(rh);
+    auto accept = secr::dispatch::http::accept_list::parse(rh.headers(0).value());
+    secr::dispatch::http::AcceptMetaData meta;
+    populate(meta, *accept);
     
-    //    ASSERT_EQ(4, rh.meta_data().accept().media_ranges().size());
+    ASSERT_EQ(4, meta.media_ranges().size());
+    EXPECT_EQ("plain", meta.media_ranges(0).subtype());
+    EXPECT_DOUBLE_EQ(0.5, meta.media_ranges(0).q());
+    EXPECT_DOUBLE_EQ(1.0, meta.media_ranges(1).q());
     
     
     /*
@@ -311,3 +320,354 @@ TEST(http_parse_tests, content_type)
 }
 
 
+
+#include <boost/algorithm/string/case_conv.hpp>
+
+namespace {
+    
+    /// feed a request to http_parser in pieces, each piece in its own read block
+    struct raw_header_parser
+    {
+        using raw_request_header = secr::dispatch::http::raw_request_header;
+        using read_block = secr::dispatch::http::read_block;
+        
+        raw_header_parser(raw_request_header& raw)
+        : raw(raw)
+        {
+            http_parser_init(std::addressof(parser), HTTP_REQUEST);
+            parser.data = this;
+            http_parser_settings_init(std::addressof(settings));
+            settings.on_url = [](http_parser* p, const char* data, std::size_t size) {
+                auto self = reinterpret_cast<raw_header_parser*>(p->data);
+                self->raw.append_uri(self->block, data, size);
+                return 0;
+            };
+            settings.on_header_field = [](http_parser* p, const char* data, std::size_t size) {
+                auto self = reinterpret_cast<raw_header_parser*>(p->data);
+                self->raw.append_header_field(self->block, data, size);
+                return 0;
+            };
+            settings.on_header_value = [](http_parser* p, const char* data, std::size_t size) {
+                auto self = reinterpret_cast<raw_header_parser*>(p->data);
+                self->raw.append_header_value(self->block, data, size);
+                return 0;
+            };
+            settings.on_headers_complete = [](http_parser* p) {
+                auto self = reinterpret_cast<raw_header_parser*>(p->data);
+                self->raw.finalise(p);
+                return 0;
+            };
+        }
+        
+        void feed(const std::string& piece)
+        {
+            block = std::make_shared<read_block>();
+            std::memcpy(block->data(), piece.data(), piece.size());
+            http_parser_execute(std::addressof(parser), std::addressof(settings),
+                                block->data(), piece.size());
+            ASSERT_EQ(HPE_OK, HTTP_PARSER_ERRNO(std::addressof(parser)));
+        }
+        
+        raw_request_header& raw;
+        secr::dispatch::http::read_block_ptr block;
+        http_parser parser;
+        http_parser_settings settings;
+    };
+}
+
+TEST(http_parse_tests, raw_header_views)
+{
+    using namespace secr::dispatch;
+    google::protobuf::Arena arena;
+    http::raw_request_header raw(std::addressof(arena));
+    raw_header_parser parser(raw);
+    
+    parser.feed("GET /moo?x=1 HTTP/1.1\r\nHost: local");
+    std::weak_ptr<http::read_block> first_block = parser.block;
+    parser.feed("host\r\nAccept: text/plain\r\n\r\n");
+    
+    EXPECT_EQ("GET", raw.method().to_string());
+    EXPECT_EQ("/moo?x=1", raw.uri().to_string());
+    EXPECT_EQ("/moo", raw.url_field(UF_PATH).to_string());
+    EXPECT_EQ("x=1", raw.url_field(UF_QUERY).to_string());
+    ASSERT_EQ(2, raw.fields().size());
+    EXPECT_EQ("Host", raw.fields()[0].name.view().to_string());
+    EXPECT_EQ("localhost", raw.fields()[0].value.view().to_string());
+    EXPECT_EQ("Accept", raw.fields()[1].name.view().to_string());
+    EXPECT_EQ("text/plain", raw.fields()[1].value.view().to_string());
+    
+    // the split value was copied, but the uri still refers to the first block
+    EXPECT_FALSE(first_block.expired());
+    EXPECT_EQ(parser.block->data() + 14, raw.fields()[1].value.view().begin());
+    
+    http::HttpRequestHeader header;
+    http::populate(header, raw);
+    EXPECT_EQ("GET", header.method());
+    EXPECT_EQ(1, header.version_major());
+    EXPECT_EQ(1, header.version_minor());
+    EXPECT_EQ("/moo", header.query().path());
+    EXPECT_EQ("x=1", header.query().query());
+    ASSERT_EQ(2, header.headers_size());
+    EXPECT_EQ("localhost", header.headers(0).value());
+    
+    // clearing the header releases its pins, so the block may be read into again
+    EXPECT_TRUE(parser.block->pinned());
+    raw.clear();
+    EXPECT_FALSE(parser.block->pinned());
+}
+
+TEST(http_parse_tests, header_index)
+{
+    using namespace secr::dispatch;
+    
+    // every well-known name is found by the perfect hash, in any case
+    for (std::size_t i = 1 ; i < http::header_id_count ; ++i)
+    {
+        auto id = static_cast<http::header_id>(i);
+        auto name = http::header_name(id).to_string();
+        EXPECT_EQ(id, http::identify_header(name)) << name;
+        boost::algorithm::to_upper(name);
+        EXPECT_EQ(id, http::identify_header(name)) << name;
+    }
+    EXPECT_EQ(http::header_id::unknown, http::identify_header(""));
+    EXPECT_EQ(http::header_id::unknown, http::identify_header("X-Custom"));
+    EXPECT_EQ(http::header_id::unknown, http::identify_header("Contents-Length"));
+    
+    EXPECT_TRUE(http::iequals_ascii("Transfer-Encoding: Chunked/Gzip", "tRANSFER-eNCODING: cHUNKED/gZIP"));
+    EXPECT_FALSE(http::iequals_ascii("Transfer-Encoding: Chunked/Gzip", "Transfer-Encoding: Chunked/Gzip!"));
+    EXPECT_FALSE(http::iequals_ascii("Transfer-Encoding: Chunked/Gzip", "Transfer-Encoding: Chunked-Gzip"));
+    EXPECT_FALSE(http::iequals_ascii("[", "{"));
+    EXPECT_FALSE(http::iequals_ascii("abcdefghijklmnop@", "abcdefghijklmnop`"));
+    
+    google::protobuf::Arena arena;
+    http::raw_request_header raw(std::addressof(arena));
+    raw_header_parser parser(raw);
+    parser.feed("GET / HTTP/1.1\r\n"
+                "host: localhost\r\n"
+                "X-Custom: 1\r\n"
+                "CONNECTION: Upgrade, Close\r\n"
+                "Accept: text/plain\r\n"
+                "Accept: text/html\r\n"
+                "\r\n");
+    
+    auto& index = raw.index();
+    EXPECT_EQ("localhost", index.value(http::header_id::host).to_string());
+    EXPECT_EQ(0, index.position(http::header_id::host));
+    EXPECT_EQ(http::header_id::unknown, index.id_at(1));
+    EXPECT_EQ(2, index.count(http::header_id::accept));
+    EXPECT_EQ(0, index.count(http::header_id::content_length));
+    EXPECT_EQ(nullptr, index.find(http::header_id::content_length));
+    EXPECT_EQ(http::header_index::npos, index.position(http::header_id::content_length));
+    
+    std::vector<std::string> accepts;
+    index.for_each(http::header_id::accept, [&](const http::raw_header_field& field) {
+        accepts.push_back(field.value.view().to_string());
+    });
+    EXPECT_EQ((std::vector<std::string> { "text/plain", "text/html" }), accepts);
+    
+    EXPECT_TRUE(raw.connection_close());
+    EXPECT_FALSE(raw.connection_keep_alive());
+    
+    raw.clear();
+    EXPECT_EQ(0, raw.index().count(http::header_id::host));
+    EXPECT_FALSE(raw.connection_close());
+}
+
+TEST(http_parse_tests, negotiation)
+{
+    using namespace secr::dispatch;
+    
+    const http::offered_media_types offered { "application/json", "application/x-protobuf" };
+    
+    auto choose = [&](const char* accept) -> std::string {
+        auto chosen = offered.negotiate(*http::accept_list::parse(accept));
+        return chosen ? chosen->text : "none";
+    };
+    
+    EXPECT_EQ("application/json", choose(""));
+    EXPECT_EQ("application/json", choose("*/*"));
+    EXPECT_EQ("application/x-protobuf", choose("application/x-protobuf"));
+    EXPECT_EQ("application/x-protobuf", choose("application/json;q=0.5, application/*"));
+    EXPECT_EQ("application/json", choose("Application/JSON, application/x-protobuf"));
+    EXPECT_EQ("application/json", choose("application/*;q=0.2, */*;q=0.1, application/x-protobuf;q=0"));
+    EXPECT_EQ("none", choose("text/html, text/*;q=0.9"));
+    EXPECT_EQ("none", choose("*/*;q=0"));
+    
+    // the most specific range decides, whatever the order
+    auto accept = http::accept_list::parse("text/*;q=0.3, text/html;q=0.7, text/html;level=1, */*;q=0.5");
+    ASSERT_EQ(4, accept->ranges().size());
+    EXPECT_EQ(3, accept->ranges()[0].specificity());
+    EXPECT_EQ(0, accept->ranges()[3].specificity());
+    EXPECT_EQ(1000, accept->quality(http::media_type_offer("text/html;level=1")));
+    EXPECT_EQ(700, accept->quality(http::media_type_offer("text/html")));
+    EXPECT_EQ(300, accept->quality(http::media_type_offer("text/plain")));
+    EXPECT_EQ(500, accept->quality(http::media_type_offer("image/jpeg")));
+    
+    // identical header values share the parsed form
+    EXPECT_EQ(accept, http::accept_list::parse("text/*;q=0.3, text/html;q=0.7, text/html;level=1, */*;q=0.5"));
+    EXPECT_NE(accept, http::accept_list::parse("text/*;q=0.3"));
+    
+    const http::offered_encodings encodings { "gzip", "identity" };
+    auto encode = [&](const char* accept_encoding) -> std::string {
+        auto chosen = encodings.negotiate(*http::accept_encoding_list::parse(accept_encoding));
+        return chosen ? *chosen : "none";
+    };
+    EXPECT_EQ("identity", encode(""));
+    EXPECT_EQ("gzip", encode("gzip, deflate"));
+    EXPECT_EQ("identity", encode("gzip;q=0.5, identity"));
+    EXPECT_EQ("identity", encode("br"));
+    EXPECT_EQ("gzip", encode("*"));
+    EXPECT_EQ("none", encode("identity;q=0, *;q=0"));
+    
+    EXPECT_EQ(1000, http::parse_quality("1"));
+    EXPECT_EQ(1000, http::parse_quality("1.000"));
+    EXPECT_EQ(0, http::parse_quality("0"));
+    EXPECT_EQ(125, http::parse_quality("0.125"));
+    EXPECT_EQ(500, http::parse_quality("0.5"));
+}
+
+#include <secr/dispatch/http/query.hpp>
+
+TEST(http_parse_tests, query_parameters)
+{
+    using namespace secr::dispatch;
+    google::protobuf::Arena arena;
+    
+    // nothing to decode - the original text is returned
+    string_view plain = "/a/plain/path/which/is/longer/than/sixteen";
+    EXPECT_EQ(plain.begin(), http::percent_decode(std::addressof(arena), plain, false).begin());
+    
+    EXPECT_EQ("/a b/c+d", http::percent_decode(std::addressof(arena), "/a%20b/c+d", false).to_string());
+    EXPECT_EQ("a b c", http::percent_decode(std::addressof(arena), "a+b%20c", true).to_string());
+    EXPECT_EQ("0123456789abcdef/\xc3\xa9", http::percent_decode(std::addressof(arena), "0123456789abcdef%2F%c3%A9", true).to_string());
+    EXPECT_EQ("100%zz%", http::percent_decode(std::addressof(arena), "100%zz%", true).to_string());
+    
+    EXPECT_TRUE(http::decoded_equals("first%20name", "first name", true));
+    EXPECT_TRUE(http::decoded_equals("first+name", "first name", true));
+    EXPECT_FALSE(http::decoded_equals("first+name", "first name", false));
+    EXPECT_FALSE(http::decoded_equals("first%20name", "first names", true));
+    EXPECT_FALSE(http::decoded_equals("first%20names", "first name", true));
+    
+    http::query_parameters query("a=1&&b&first+name=J%C3%B6rg&a=2&empty=");
+    std::vector<std::string> names;
+    for (auto& p : query)
+        names.push_back(p.name.to_string() + (p.has_value ? "=" + p.value.to_string() : ""));
+    EXPECT_EQ((std::vector<std::string> { "a=1", "b", "first+name=J%C3%B6rg", "a=2", "empty=" }), names);
+    
+    EXPECT_EQ("1", query.get(std::addressof(arena), "a").value().to_string());
+    EXPECT_EQ("J\xc3\xb6rg", query.get(std::addressof(arena), "first name").value().to_string());
+    EXPECT_EQ("", query.get(std::addressof(arena), "b").value().to_string());
+    EXPECT_EQ("", query.get(std::addressof(arena), "empty").value().to_string());
+    EXPECT_FALSE(query.get(std::addressof(arena), "missing"));
+    EXPECT_TRUE(http::query_parameters().begin() == http::query_parameters().end());
+}
+
+#include <secr/dispatch/http/chunk_header.hpp>
+
+TEST(http_parse_tests, chunk_header)
+{
+    using namespace secr::dispatch;
+    
+    auto text = [](std::size_t size) {
+        http::chunk_header header(size);
+        return std::string(header.data(), header.size());
+    };
+    EXPECT_EQ("0\r\n", text(0));
+    EXPECT_EQ("a\r\n", text(10));
+    EXPECT_EQ("10\r\n", text(16));
+    EXPECT_EQ("1234abcd\r\n", text(0x1234abcd));
+    EXPECT_EQ(std::string(sizeof(std::size_t) * 2, 'f') + "\r\n", text(~std::size_t(0)));
+    
+    // the header refers to its own storage and survives copying
+    http::chunk_header original(255);
+    auto copy = original;
+    EXPECT_EQ("ff\r\n", std::string(asio::buffer_cast<const char*>(copy.buffer()), asio::buffer_size(copy.buffer())));
+}
+
+#include <secr/dispatch/http/byte_range.hpp>
+
+TEST(http_parse_tests, byte_ranges)
+{
+    using namespace secr::dispatch;
+    using http::byte_range;
+    using http::range_disposition;
+    
+    std::vector<byte_range> ranges;
+    auto parse = [&](const char* value, std::uint64_t size) {
+        return http::parse_byte_ranges(value, size, ranges);
+    };
+    
+    EXPECT_EQ(range_disposition::satisfiable, parse("bytes=0-499", 10000));
+    EXPECT_EQ(std::vector<byte_range>({ { 0, 499 } }), ranges);
+    
+    EXPECT_EQ(range_disposition::satisfiable, parse("bytes=9500-, 500-999, -500 ,", 10000));
+    EXPECT_EQ(std::vector<byte_range>({ { 500, 999 }, { 9500, 9999 } }), ranges);
+    
+    // overlapping and adjacent ranges are merged, so nothing is sent twice
+    EXPECT_EQ(range_disposition::satisfiable, parse("bytes=0-,0-,0-,0-", 100));
+    EXPECT_EQ(std::vector<byte_range>({ { 0, 99 } }), ranges);
+    EXPECT_EQ(range_disposition::satisfiable, parse("bytes=10-19,20-29,25-40,50-59", 100));
+    EXPECT_EQ(std::vector<byte_range>({ { 10, 40 }, { 50, 59 } }), ranges);
+    
+    // too many ranges are ignored
+    std::string many = "bytes=0-0";
+    for (std::size_t i = 1 ; i <= http::max_byte_ranges ; ++i)
+        many += "," + std::to_string(i * 2) + "-" + std::to_string(i * 2);
+    EXPECT_EQ(range_disposition::ignore, parse(many.c_str(), 1000));
+    EXPECT_TRUE(ranges.empty());
+    
+    // overruns are truncated and suffixes longer than the file take all of it
+    EXPECT_EQ(range_disposition::satisfiable, parse("bytes=90-200", 100));
+    EXPECT_EQ(std::vector<byte_range>({ { 90, 99 } }), ranges);
+    EXPECT_EQ(range_disposition::satisfiable, parse("bytes=-200", 100));
+    EXPECT_EQ(std::vector<byte_range>({ { 0, 99 } }), ranges);
+    
+    // ranges which miss the file are dropped
+    EXPECT_EQ(range_disposition::satisfiable, parse("bytes=100-, 0-0", 100));
+    EXPECT_EQ(std::vector<byte_range>({ { 0, 0 } }), ranges);
+    EXPECT_EQ(range_disposition::unsatisfiable, parse("bytes=100-", 100));
+    EXPECT_TRUE(ranges.empty());
+    EXPECT_EQ(range_disposition::unsatisfiable, parse("bytes=-0", 100));
+    EXPECT_EQ(range_disposition::unsatisfiable, parse("bytes=0-", 0));
+    
+    // anything malformed is ignored
+    for (auto value : { "", "bytes=", "items=0-1", "bytes=1", "bytes=5-4", "bytes=a-b",
+                        "bytes=0-1,x", "bytes=99999999999999999999-" })
+    {
+        EXPECT_EQ(range_disposition::ignore, parse(value, 100)) << value;
+        EXPECT_TRUE(ranges.empty()) << value;
+    }
+}
+
+#include <secr/dispatch/http/entity_tag.hpp>
+#include <algorithm>
+
+TEST(http_parse_tests, entity_tags)
+{
+    using namespace secr::dispatch::http;
+    
+    // reference values of xxHash64
+    EXPECT_EQ(0xef46db3751d8e999ull, xxh64("", 0));
+    EXPECT_EQ(0xd24ec4f1a98c6e5bull, xxh64("a", 1));
+    EXPECT_EQ(0x44bc2cf5ad770999ull, xxh64("abc", 3));
+    
+    // every tail length hashes differently
+    std::string text(100, 'x');
+    std::vector<std::uint64_t> hashes;
+    for (std::size_t size = 0 ; size <= text.size() ; ++size)
+        hashes.push_back(xxh64(text.data(), size));
+    std::sort(hashes.begin(), hashes.end());
+    EXPECT_EQ(hashes.end(), std::adjacent_find(hashes.begin(), hashes.end()));
+    
+    EXPECT_EQ("\"00000000000004d2\"", strong_entity_tag(1234));
+    
+    auto tag = strong_entity_tag(0xabc);
+    EXPECT_TRUE(if_none_match(tag, tag));
+    EXPECT_TRUE(if_none_match("*", tag));
+    EXPECT_TRUE(if_none_match("\"x\", " + tag, tag));
+    EXPECT_TRUE(if_none_match("W/" + tag, tag));
+    EXPECT_TRUE(if_none_match("\"a,b\"", "W/\"a,b\""));
+    EXPECT_FALSE(if_none_match("\"x\", \"y\"", tag));
+    EXPECT_FALSE(if_none_match("", tag));
+    EXPECT_FALSE(if_none_match("garbage, " + tag, tag));
+}
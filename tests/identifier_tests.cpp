@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <secr/dispatch/http/identifiers.hpp>
+
+#include <boost/uuid/uuid.hpp>
+
+#include <algorithm>
+#include <sys/wait.h>
+#include <unistd.h>
+
+TEST(identifier_tests, ids_are_unique_version_8_uuids)
+{
+    using namespace secr::dispatch;
+    
+    http::request_id a { http::request_id::generate };
+    http::request_id b { http::request_id::generate };
+    http::connection_id c { http::connection_id::generate };
+    
+    EXPECT_NE(a, b);
+    EXPECT_NE(b, c);
+    EXPECT_LT(a, b);
+    for (auto& id : { boost::uuids::uuid(a), boost::uuids::uuid(b), boost::uuids::uuid(c) })
+    {
+        EXPECT_EQ(0x80, id.data[6] & 0xf0);
+        EXPECT_EQ(boost::uuids::uuid::variant_rfc_4122, id.variant());
+    }
+}
+
+TEST(identifier_tests, forked_children_draw_their_own_prefix)
+{
+    using namespace secr::dispatch;
+    
+    auto parent = http::next_uuid();
+    
+    int fds[2];
+    ASSERT_EQ(0, ::pipe(fds));
+    auto pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        auto child = http::next_uuid();
+        auto written = ::write(fds[1], child.data, child.size());
+        ::_exit(written == ssize_t(child.size()) ? 0 : 1);
+    }
+    ::close(fds[1]);
+    boost::uuids::uuid child;
+    auto got = ::read(fds[0], child.data, child.size());
+    ::close(fds[0]);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    
+    ASSERT_EQ(ssize_t(child.size()), got);
+    EXPECT_FALSE(std::equal(parent.data, parent.data + 6, child.data));
+}
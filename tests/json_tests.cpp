@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+#include <secr/dispatch/api/json.hpp>
+#include <secr/dispatch/api/exception.hpp>
+#include <secr/dispatch/secr_dispatch_test.pb.h>
+#include <secr/dispatch/secr_dispatch_http.pb.h>
+#include <secr/dispatch/fake_stream.hpp>
+
+#include <google/protobuf/timestamp.pb.h>
+#include <google/protobuf/util/type_resolver_util.h>
+
+#include <clocale>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+    using namespace secr::dispatch;
+    namespace pb = google::protobuf;
+    namespace pbu = google::protobuf::util;
+
+    /// the reference conversion
+    std::string protobuf_json(const pb::Message& msg, const pbu::JsonOptions& opts)
+    {
+        std::string result;
+        auto status = pbu::MessageToJsonString(msg, std::addressof(result), opts);
+        EXPECT_TRUE(status.ok());
+        return result;
+    }
+
+    /// the conversion as it was done before the reflection writer
+    std::string resolver_per_call_json(const pb::Message& msg, const pbu::JsonOptions& opts)
+    {
+        auto buffer = msg.SerializeAsString();
+        auto resolver = std::unique_ptr<pbu::TypeResolver> {
+            pbu::NewTypeResolverForDescriptorPool("", pb::DescriptorPool::generated_pool())
+        };
+        std::string result;
+        pbu::BinaryToJsonString(resolver.get(),
+                                "/" + msg.GetDescriptor()->full_name(),
+                                buffer,
+                                std::addressof(result),
+                                opts);
+        return result;
+    }
+
+    std::vector<pbu::JsonOptions> all_options()
+    {
+        std::vector<pbu::JsonOptions> result;
+        for (int bits = 0 ; bits < 16 ; ++bits)
+        {
+            pbu::JsonOptions opts;
+            opts.add_whitespace = bits & 1;
+            opts.always_print_primitive_fields = bits & 2;
+            opts.always_print_enums_as_ints = bits & 4;
+            opts.preserve_proto_field_names = bits & 8;
+            result.push_back(opts);
+        }
+        return result;
+    }
+
+    test::JsonSample make_sample()
+    {
+        test::JsonSample m;
+        m.set_int32_value(-5);
+        m.set_int64_value(-1234567890123LL);
+        m.set_uint32_value(4000000000u);
+        m.set_uint64_value(18446744073709551615ULL);
+        m.set_sint32_value(-77);
+        m.set_fixed64_value(99);
+        m.set_double_value(0.1);
+        m.set_float_value(1.0f / 3);
+        m.set_bool_value(true);
+        m.set_string_value("quote \" backslash \\ <tag> \n\t\x01 caf\xc3\xa9 \xe2\x80\xa8 \xf0\x9d\x85\xb3 \xf0\x9f\x98\x80");
+        m.set_bytes_value(std::string("\x00\x01\xff hello", 9));
+        m.set_colour(test::JSON_COLOUR_GREEN);
+        m.mutable_nested()->set_id(3);
+        m.add_nested_list()->set_name("x");
+        m.add_nested_list();
+        m.add_int64_list(1);
+        m.add_int64_list(-2);
+        m.add_string_list("a");
+        m.add_string_list("");
+        (*m.mutable_counts())["a\"b"] = 1;
+        (*m.mutable_nested_by_id())[7].set_name("q");
+        m.set_choice_number(0);
+        m.add_colours(test::JsonColour(5));
+        m.add_colours(test::JSON_COLOUR_RED);
+        for (double d : { double(NAN), double(INFINITY), -double(INFINITY), 1e20, 1.0,
+                          123456789.125, 1e-7, -0.0, 1.0 / 3, 5e-324 })
+        {
+            m.add_double_list(d);
+        }
+        return m;
+    }
+}
+
+TEST(json_tests, matches_protobuf_output)
+{
+    std::vector<std::unique_ptr<pb::Message>> messages;
+    messages.push_back(std::make_unique<test::JsonSample>());
+    messages.push_back(std::make_unique<test::JsonSample>(make_sample()));
+    {
+        auto m = std::make_unique<test::JsonSample>();
+        m->set_choice_name("");
+        (*m->mutable_nested_by_id())[1];
+        (*m->mutable_counts())[""] = 0;
+        messages.push_back(std::move(m));
+    }
+    {
+        auto m = std::make_unique<api::Exception>();
+        m->set_name("std::runtime_error");
+        m->set_what("outer");
+        m->mutable_nested()->set_what("inner");
+        messages.push_back(std::move(m));
+    }
+    {
+        auto m = std::make_unique<http::HttpRequestHeader>();
+        m->set_method("GET");
+        m->set_uri("/a?b=c");
+        m->set_version_major(1);
+        m->set_version_minor(1);
+        auto h = m->add_headers();
+        h->set_name("Host");
+        h->set_value("example.com");
+        messages.push_back(std::move(m));
+    }
+    {
+        // well-known types go through the cached resolver
+        auto m = std::make_unique<pb::Timestamp>();
+        m->set_seconds(1500000000);
+        m->set_nanos(5000);
+        messages.push_back(std::move(m));
+    }
+
+    for (auto& msg : messages)
+    {
+        for (auto& opts : all_options())
+        {
+            EXPECT_EQ(protobuf_json(*msg, opts), api::as_json(*msg, opts))
+            << msg->GetDescriptor()->full_name()
+            << " whitespace=" << opts.add_whitespace
+            << " defaults=" << opts.always_print_primitive_fields
+            << " ints=" << opts.always_print_enums_as_ints
+            << " proto_names=" << opts.preserve_proto_field_names;
+        }
+    }
+}
+
+TEST(json_tests, appends_and_streams)
+{
+    auto msg = make_sample();
+    auto opts = api::json_options(api::compact_json);
+    auto expected = protobuf_json(msg, opts);
+
+    std::string appended = "prefix:";
+    api::append_json(appended, msg, opts);
+    EXPECT_EQ("prefix:" + expected, appended);
+
+    // enough list entries to span several output buffers
+    for (int i = 0 ; i < 2000 ; ++i)
+        msg.add_string_list("entry " + std::to_string(i));
+    expected = protobuf_json(msg, opts);
+
+    asio::io_service ios;
+    fake_stream stream(ios, ios);
+    auto written = api::write_json(stream, msg, opts);
+    stream.close();
+    EXPECT_EQ(expected.size(), written);
+
+    asio::streambuf sb;
+    error_code ec;
+    asio::read(stream, sb, ec);
+    EXPECT_EQ(asio::error::eof, ec);
+    EXPECT_EQ(expected, std::string(asio::buffers_begin(sb.data()), asio::buffers_end(sb.data())));
+}
+
+TEST(json_tests, numbers_ignore_the_locale)
+{
+    auto msg = make_sample();
+    auto opts = api::json_options(api::compact_json);
+    auto expected = protobuf_json(msg, opts);
+
+    // a locale whose radix character is a comma
+    std::string saved = std::setlocale(LC_NUMERIC, nullptr);
+    const char* comma_locale = nullptr;
+    for (auto name : { "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "fr_FR" })
+    {
+        if (std::setlocale(LC_NUMERIC, name)) {
+            comma_locale = name;
+            break;
+        }
+    }
+    if (not comma_locale)
+        GTEST_SKIP() << "no locale with a comma radix is installed";
+
+    auto json = api::as_json(msg, opts);
+    std::setlocale(LC_NUMERIC, saved.c_str());
+
+    EXPECT_EQ(expected, json) << comma_locale;
+    EXPECT_NE(std::string::npos, json.find("\"doubleValue\":0.1")) << json;
+}
+
+// a benchmark, which is run with --gtest_also_run_disabled_tests
+TEST(json_tests, DISABLED_as_json_benchmark)
+{
+    auto msg = make_sample();
+    for (int i = 0 ; i < 100 ; ++i) {
+        auto n = msg.add_nested_list();
+        n->set_id(i);
+        n->set_name("name " + std::to_string(i));
+    }
+    auto opts = api::json_options(api::pretty_json, api::include_defaults);
+    constexpr std::size_t iterations = 2000;
+
+    report_timing("resolver per call", iterations, "bytes", [&] { return resolver_per_call_json(msg, opts).size(); });
+    report_timing("MessageToJsonString", iterations, "bytes", [&] { return protobuf_json(msg, opts).size(); });
+    report_timing("as_json", iterations, "bytes", [&] { return api::as_json(msg, opts).size(); });
+}
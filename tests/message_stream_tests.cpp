@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+
+#include <secr/dispatch/http/message_stream.hpp>
+#include <secr/dispatch/http/server.hpp>
+#include <secr/dispatch/secr_dispatch_test.pb.h>
+#include <secr/dispatch/testing.pb.h>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace {
+
+    namespace asio = secr::dispatch::asio;
+    namespace http = secr::dispatch::http;
+    namespace test_proto = ::secr::testing;
+    using protocol = asio::ip::tcp;
+    using secr::dispatch::error_code;
+
+    std::string dechunk(const std::string& body)
+    {
+        std::string result;
+        std::size_t pos = 0;
+        while (true)
+        {
+            auto eol = body.find("\r\n", pos);
+            auto size = std::stoul(body.substr(pos, eol - pos), nullptr, 16);
+            if (size == 0)
+                return result;
+            result += body.substr(eol + 2, size);
+            pos = eol + 2 + size + 2;
+        }
+    }
+
+    secr::dispatch::test::JsonSample sample(int i)
+    {
+        secr::dispatch::test::JsonSample message;
+        message.set_int32_value(i);
+        message.set_string_value("line " + std::to_string(i) + "\nand the next");
+        message.set_bytes_value(std::string(std::size_t(i) * 100, '\x80'));
+        return message;
+    }
+
+    /// Counts to a limit, writing each number once the client has the one
+    /// before it
+    struct counter : std::enable_shared_from_this<counter>
+    {
+        counter(http::dispatch_context context, int limit)
+        : stream(std::move(context))
+        , limit(limit)
+        {}
+
+        void next()
+        {
+            if (stream.messages_written() == std::size_t(limit))
+            {
+                error_code ec;
+                stream.close(ec);
+                return;
+            }
+            test_proto::Int value;
+            value.set_z(int(stream.messages_written()));
+            stream.async_write(value, [self = shared_from_this()](const error_code& ec, std::size_t)
+                               {
+                                   if (not ec)
+                                       self->next();
+                               });
+        }
+
+        http::message_stream_writer stream;
+        int limit;
+    };
+
+    /// Writes one message and then holds the stream open for five seconds,
+    /// or until release is called
+    struct holds_open : std::enable_shared_from_this<holds_open>
+    {
+        explicit holds_open(http::dispatch_context context)
+        : stream(std::move(context), http::message_framing::ndjson)
+        , timer(stream.context().request().stream().get_io_service())
+        {}
+
+        void start()
+        {
+            test_proto::Int value;
+            value.set_z(0);
+            stream.write(value);
+            timer.expires_from_now(5s);
+            timer.async_wait([self = shared_from_this()](const error_code&)
+                             {
+                                 self->closed = true;
+                                 self->stream.close();
+                             });
+        }
+
+        void release()
+        {
+            timer.get_io_service().post([self = shared_from_this()] { self->timer.cancel(); });
+        }
+
+        http::message_stream_writer stream;
+        asio::steady_timer timer;
+        std::atomic<bool> closed { false };
+    };
+}
+
+TEST(message_stream_tests, reads_frames_fed_a_byte_at_a_time)
+{
+    for (auto framing : { http::message_framing::length_delimited, http::message_framing::ndjson })
+    {
+        std::string data;
+        for (int i = 0 ; i < 5 ; ++i)
+            ASSERT_TRUE(http::append_frame(data, sample(i), framing));
+
+        http::message_stream_reader reader(framing);
+        secr::dispatch::test::JsonSample message;
+        int count = 0;
+        for (auto c : data)
+        {
+            reader.feed(&c, 1);
+            while (reader.next(message))
+            {
+                EXPECT_EQ(sample(count).SerializeAsString(), message.SerializeAsString());
+                ++count;
+            }
+        }
+        EXPECT_EQ(5, count);
+        EXPECT_FALSE(reader.incomplete());
+    }
+}
+
+TEST(message_stream_tests, rejects_bad_frames)
+{
+    test_proto::Int message;
+    error_code ec;
+
+    http::message_stream_reader json_reader(http::message_framing::ndjson);
+    json_reader.feed("{\"z\":1}\nnot json\n", 17);
+    EXPECT_TRUE(json_reader.next(message, ec));
+    EXPECT_EQ(1, message.z());
+    EXPECT_FALSE(json_reader.next(message, ec));
+    EXPECT_EQ(http::make_error_code(http::protocol_error_code::bad_message_frame), ec);
+
+    http::message_stream_reader binary_reader(http::message_framing::length_delimited);
+    binary_reader.feed("\x02\xff\xff", 3);
+    EXPECT_FALSE(binary_reader.next(message, ec));
+    EXPECT_EQ(http::make_error_code(http::protocol_error_code::bad_message_frame), ec);
+    EXPECT_THROW(binary_reader.next(message), secr::dispatch::system_error);
+}
+
+TEST(message_stream_tests, streams_messages_in_chunks)
+{
+    http::server_options options;
+    options.threads = 1;
+    http::server server(http::server::endpoint_type(asio::ip::address_v4::loopback(), 0),
+                        [](http::dispatch_context context)
+                        {
+                            std::make_shared<counter>(std::move(context), 100)->next();
+                        },
+                        options);
+    server.start();
+
+    asio::io_service client_service;
+    auto request = [&](const std::string& accept)
+    {
+        auto response = round_trip(client_service, server.local_endpoint(),
+                                   "GET /count HTTP/1.1\r\n"
+                                   "Host: localhost\r\n"
+                                   + accept +
+                                   "Connection: close\r\n"
+                                   "\r\n");
+        auto header_end = response.find("\r\n\r\n");
+        EXPECT_NE(std::string::npos, header_end);
+        return std::make_pair(response.substr(0, header_end + 4), dechunk(response.substr(header_end + 4)));
+    };
+
+    auto check = [](http::message_framing framing, const std::string& body)
+    {
+        http::message_stream_reader reader(framing);
+        reader.feed(body.data(), body.size());
+        test_proto::Int value;
+        int count = 0;
+        while (reader.next(value))
+            EXPECT_EQ(count++, value.z());
+        EXPECT_EQ(100, count);
+        EXPECT_FALSE(reader.incomplete());
+    };
+
+    auto binary = request("Accept: application/x-protobuf-delimited\r\n");
+    EXPECT_NE(std::string::npos, binary.first.find("Transfer-Encoding: chunked\r\n"));
+    EXPECT_NE(std::string::npos, binary.first.find("Content-Type: application/x-protobuf-delimited\r\n"));
+    check(http::message_framing::length_delimited, binary.second);
+
+    auto json = request("Accept: application/x-ndjson\r\n");
+    EXPECT_NE(std::string::npos, json.first.find("Content-Type: application/x-ndjson\r\n"));
+    EXPECT_EQ(0, json.second.find("{\"z\":0}\n{\"z\":1}\n"));
+    check(http::message_framing::ndjson, json.second);
+
+    // a client which can read neither framing is refused, as by serve_call
+    auto refused = round_trip(client_service, server.local_endpoint(),
+                              "GET /count HTTP/1.1\r\n"
+                              "Host: localhost\r\n"
+                              "Accept: text/html\r\n"
+                              "Connection: close\r\n"
+                              "\r\n");
+    EXPECT_EQ(0, refused.find("HTTP/1.1 406 Not Acceptable\r\n"));
+    EXPECT_EQ(std::string::npos, refused.find("Transfer-Encoding"));
+
+    server.stop();
+}
+
+TEST(message_stream_tests, first_message_arrives_while_the_stream_is_open)
+{
+    std::promise<std::shared_ptr<holds_open>> writer;
+    auto writer_future = writer.get_future();
+
+    http::server_options options;
+    options.threads = 1;
+    http::server server(http::server::endpoint_type(asio::ip::address_v4::loopback(), 0),
+                        [&](http::dispatch_context context)
+                        {
+                            auto op = std::make_shared<holds_open>(std::move(context));
+                            op->start();
+                            writer.set_value(op);
+                        },
+                        options);
+    server.start();
+
+    asio::io_service client_service;
+    protocol::socket socket(client_service);
+    socket.connect(server.local_endpoint());
+    asio::write(socket, asio::buffer(std::string("GET /first HTTP/1.1\r\n"
+                                                 "Host: localhost\r\n"
+                                                 "Accept: application/x-ndjson\r\n"
+                                                 "Connection: close\r\n"
+                                                 "\r\n")));
+
+    // the frame must not wait for more data or for the end of the stream
+    asio::streambuf response;
+    asio::read_until(socket, response, "{\"z\":0}\n");
+    auto op = writer_future.get();
+    EXPECT_FALSE(op->closed);
+
+    op->release();
+    error_code ec;
+    asio::read(socket, response, ec);
+    EXPECT_EQ(asio::error::eof, ec);
+    std::string text(asio::buffers_begin(response.data()), asio::buffers_end(response.data()));
+    EXPECT_EQ(text.size() - 5, text.rfind("0\r\n\r\n"));
+
+    server.stop();
+}
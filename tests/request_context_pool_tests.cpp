@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <secr/dispatch/http/request_context_pool.hpp>
+#include <secr/dispatch/http/server_request.hpp>
+
+#include <chrono>
+#include <thread>
+
+TEST(request_context_pool_tests, reused_context_excludes_idle_time)
+{
+    using namespace secr::dispatch;
+    using namespace std::literals;
+    using clock_type = http::request_context::clock_type;
+    
+    asio::io_service ios;
+    auto& pool = asio::use_service<http::request_context_pool>(ios);
+    
+    auto context = pool.acquire(http::connection_id(http::connection_id::generate), ios);
+    auto first = context.get();
+    context.reset();
+    
+    // hold the context idle in the pool before it is reused
+    std::this_thread::sleep_for(50ms);
+    auto before = clock_type::now();
+    
+    context = pool.acquire(http::connection_id(http::connection_id::generate), ios);
+    ASSERT_EQ(first, context.get());
+    EXPECT_EQ(1, pool.get_statistics().reused);
+    EXPECT_LE(before, context->started());
+    EXPECT_LE(before, context->header_completed());
+}
+
+TEST(request_context_pool_tests, dispatcher_thread_allocations_do_not_discard_contexts)
+{
+    using namespace secr::dispatch;
+    
+    asio::io_service ios;
+    asio::io_service dispatch_service;
+    auto& pool = asio::use_service<http::request_context_pool>(ios);
+    
+    auto use_from_dispatcher = [](http::request_context& context)
+    {
+        // a thread other than the one which reset the arena allocates blocks
+        // of its own rather than using the initial block
+        std::thread dispatcher([&] {
+            google::protobuf::Arena::CreateArray<char>(context.arena(), 1000);
+        });
+        dispatcher.join();
+    };
+    
+    auto context = pool.acquire(http::connection_id(http::connection_id::generate), dispatch_service);
+    auto first = context.get();
+    auto block_size = pool.get_statistics().initial_block_size;
+    use_from_dispatcher(*context);
+    context.reset();
+    
+    for (int i = 0 ; i < 16 ; ++i)
+    {
+        context = pool.acquire(http::connection_id(http::connection_id::generate), dispatch_service);
+        ASSERT_EQ(first, context.get());
+        use_from_dispatcher(*context);
+        context.reset();
+    }
+    
+    auto stats = pool.get_statistics();
+    EXPECT_EQ(1, stats.created);
+    EXPECT_EQ(16, stats.reused);
+    EXPECT_EQ(0, stats.discarded);
+    EXPECT_EQ(block_size, stats.initial_block_size);
+}
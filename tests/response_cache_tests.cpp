@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+
+#include <secr/dispatch/http/response_cache.hpp>
+#include <secr/dispatch/http/request_header.hpp>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace secr::dispatch;
+    using clock_type = http::response_cache::clock_type;
+
+    /// a request header parsed from text, with the block it refers to
+    struct parsed_request
+    {
+        explicit parsed_request(const std::string& text)
+        : raw(std::addressof(arena))
+        {
+            std::memcpy(block->data(), text.data(), text.size());
+            http_parser parser;
+            http_parser_init(std::addressof(parser), HTTP_REQUEST);
+            parser.data = this;
+            http_parser_settings settings;
+            http_parser_settings_init(std::addressof(settings));
+            settings.on_url = [](http_parser* p, const char* data, std::size_t size) {
+                auto self = reinterpret_cast<parsed_request*>(p->data);
+                self->raw.append_uri(self->block, data, size);
+                return 0;
+            };
+            settings.on_header_field = [](http_parser* p, const char* data, std::size_t size) {
+                auto self = reinterpret_cast<parsed_request*>(p->data);
+                self->raw.append_header_field(self->block, data, size);
+                return 0;
+            };
+            settings.on_header_value = [](http_parser* p, const char* data, std::size_t size) {
+                auto self = reinterpret_cast<parsed_request*>(p->data);
+                self->raw.append_header_value(self->block, data, size);
+                return 0;
+            };
+            settings.on_headers_complete = [](http_parser* p) {
+                auto self = reinterpret_cast<parsed_request*>(p->data);
+                self->raw.finalise(p);
+                return 0;
+            };
+            http_parser_execute(std::addressof(parser), std::addressof(settings),
+                                block->data(), text.size());
+        }
+
+        google::protobuf::Arena arena;
+        http::read_block_ptr block = std::make_shared<http::read_block>();
+        http::raw_request_header raw;
+    };
+
+    std::string get(const std::string& uri, const std::string& headers = "")
+    {
+        return "GET " + uri + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n";
+    }
+
+    http::HttpResponseHeader make_response(const std::string& cache_control,
+                                           std::size_t length)
+    {
+        http::HttpResponseHeader response;
+        response.set_version_major(1);
+        response.set_version_minor(1);
+        http::set_status(response, 200, "OK");
+        http::add_header(response, "Content-Type", "text/plain");
+        http::add_header(response, "Content-Length", std::to_string(length));
+        http::add_header(response, "Connection", "keep-alive");
+        if (not cache_control.empty())
+            http::add_header(response, "Cache-Control", cache_control);
+        return response;
+    }
+
+    std::vector<char> make_body(const std::string& text)
+    {
+        return std::vector<char>(text.begin(), text.end());
+    }
+
+    bool offer(http::response_cache& cache, const std::string& request,
+               const http::HttpResponseHeader& response, const std::string& body,
+               clock_type::time_point now = clock_type::now())
+    {
+        parsed_request parsed(request);
+        return cache.insert(parsed.raw, response, make_body(body), now);
+    }
+
+    http::response_cache::entry_ptr lookup(http::response_cache& cache, const std::string& request,
+                                           clock_type::time_point now = clock_type::now())
+    {
+        parsed_request parsed(request);
+        return cache.find(parsed.raw, now);
+    }
+}
+
+TEST(response_cache_tests, lifetime)
+{
+    using std::chrono::seconds;
+    EXPECT_EQ(seconds(60), http::response_cache::lifetime(make_response("max-age=60", 0)));
+    EXPECT_EQ(seconds(10), http::response_cache::lifetime(make_response("max-age=60, s-maxage=10", 0)));
+    EXPECT_EQ(seconds(0), http::response_cache::lifetime(make_response("", 0)));
+    EXPECT_EQ(seconds(0), http::response_cache::lifetime(make_response("max-age=60, private", 0)));
+    EXPECT_EQ(seconds(0), http::response_cache::lifetime(make_response("no-store, max-age=60", 0)));
+    EXPECT_EQ(seconds(0), http::response_cache::lifetime(make_response("max-age=6x", 0)));
+}
+
+TEST(response_cache_tests, stores_and_expires)
+{
+    http::response_cache_options options;
+    options.enabled = true;
+    http::response_cache cache(options);
+
+    auto now = clock_type::now();
+    EXPECT_FALSE(lookup(cache, get("/a"), now));
+    ASSERT_TRUE(offer(cache, get("/a"), make_response("max-age=60", 5), "hello", now));
+    EXPECT_EQ(1, cache.entry_count());
+
+    auto entry = lookup(cache, get("/a"), now + std::chrono::seconds(30));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(200, entry->status);
+    EXPECT_EQ("OK", entry->reason);
+    EXPECT_EQ("hello", std::string(entry->body.begin(), entry->body.end()));
+
+    // the connection's own fields are not stored
+    EXPECT_EQ("Content-Type: text/plain\r\nContent-Length: 5\r\nCache-Control: max-age=60\r\n",
+              entry->fields);
+
+    // the request may refuse a stored response
+    EXPECT_FALSE(lookup(cache, get("/a", "Cache-Control: no-cache\r\n"), now));
+    EXPECT_FALSE(lookup(cache, get("/b"), now));
+
+    EXPECT_FALSE(lookup(cache, get("/a"), now + std::chrono::seconds(61)));
+    EXPECT_EQ(0, cache.entry_count());
+    EXPECT_EQ(0, cache.size_in_bytes());
+}
+
+TEST(response_cache_tests, refuses_uncacheable_responses)
+{
+    http::response_cache_options options;
+    options.enabled = true;
+    options.max_entry_size = 4096;
+    http::response_cache cache(options);
+
+    EXPECT_FALSE(offer(cache, get("/a"), make_response("", 5), "hello"));
+    EXPECT_FALSE(offer(cache, get("/a"), make_response("no-store", 5), "hello"));
+    EXPECT_FALSE(offer(cache, get("/a"), make_response("max-age=60", 9), "hello"));
+    EXPECT_FALSE(offer(cache, get("/a"), make_response("max-age=60", 5000), std::string(5000, 'x')));
+    EXPECT_FALSE(offer(cache, get("/a", "Authorization: Basic Zm9vOmJhcg==\r\n"),
+                       make_response("max-age=60", 5), "hello"));
+    EXPECT_FALSE(offer(cache, "POST /a HTTP/1.1\r\nContent-Length: 0\r\n\r\n",
+                       make_response("max-age=60", 5), "hello"));
+
+    auto cookie = make_response("max-age=60", 5);
+    http::add_header(cookie, "Set-Cookie", "session=1");
+    EXPECT_FALSE(offer(cache, get("/a"), cookie, "hello"));
+
+    auto any = make_response("max-age=60", 5);
+    http::add_header(any, "Vary", "*");
+    EXPECT_FALSE(offer(cache, get("/a"), any, "hello"));
+
+    auto created = make_response("max-age=60", 5);
+    http::set_status(created, 201, "Created");
+    EXPECT_FALSE(offer(cache, get("/a"), created, "hello"));
+
+    EXPECT_EQ(0, cache.entry_count());
+}
+
+TEST(response_cache_tests, vary)
+{
+    http::response_cache_options options;
+    options.enabled = true;
+    http::response_cache cache(options);
+
+    auto response = make_response("max-age=60", 5);
+    http::add_header(response, "Vary", "Accept-Encoding, X-Tenant");
+    ASSERT_TRUE(offer(cache, get("/v", "Accept-Encoding: gzip\r\nX-Tenant: a\r\n"), response, "gzip!"));
+    ASSERT_TRUE(offer(cache, get("/v", "X-Tenant: a\r\n"), response, "plain"));
+
+    auto gzip = lookup(cache, get("/v", "x-tenant: a\r\naccept-encoding: gzip\r\n"));
+    ASSERT_TRUE(gzip);
+    EXPECT_EQ("gzip!", std::string(gzip->body.begin(), gzip->body.end()));
+
+    auto plain = lookup(cache, get("/v", "X-Tenant: a\r\n"));
+    ASSERT_TRUE(plain);
+    EXPECT_EQ("plain", std::string(plain->body.begin(), plain->body.end()));
+
+    EXPECT_FALSE(lookup(cache, get("/v", "Accept-Encoding: gzip\r\nX-Tenant: b\r\n")));
+
+    // a new response for the same request replaces the old one
+    ASSERT_TRUE(offer(cache, get("/v", "X-Tenant: a\r\n"), response, "fresh"));
+    EXPECT_EQ(2, cache.entry_count());
+
+    // a response which varies on other headers drops the old variants
+    auto narrower = make_response("max-age=60", 5);
+    http::add_header(narrower, "Vary", "X-Tenant");
+    ASSERT_TRUE(offer(cache, get("/v", "X-Tenant: a\r\n"), narrower, "fewer"));
+    EXPECT_EQ(1, cache.entry_count());
+    auto fewer = lookup(cache, get("/v", "Accept-Encoding: gzip\r\nX-Tenant: a\r\n"));
+    ASSERT_TRUE(fewer);
+    EXPECT_EQ("fewer", std::string(fewer->body.begin(), fewer->body.end()));
+}
+
+TEST(response_cache_tests, keyed_on_host)
+{
+    http::response_cache_options options;
+    options.enabled = true;
+    http::response_cache cache(options);
+
+    auto get_from = [](const std::string& host)
+    {
+        return "GET /h HTTP/1.1\r\nHost: " + host + "\r\n\r\n";
+    };
+    ASSERT_TRUE(offer(cache, get_from("a.example"), make_response("max-age=60", 5), "hello"));
+    EXPECT_TRUE(lookup(cache, get_from("A.Example")));
+    EXPECT_FALSE(lookup(cache, get_from("b.example")));
+}
+
+TEST(response_cache_tests, admission_keeps_popular_responses)
+{
+    http::response_cache_options options;
+    options.enabled = true;
+    options.shards = 1;
+    options.capacity = 16 * 1024;
+    http::response_cache cache(options);
+
+    std::string body(1000, 'x');
+    auto response = make_response("max-age=600", body.size());
+
+    // a handful of responses which are requested often
+    for (int i = 0 ; i < 4 ; ++i)
+    {
+        auto uri = "/popular/" + std::to_string(i);
+        for (int n = 0 ; n < 5 ; ++n)
+            lookup(cache, get(uri));
+        ASSERT_TRUE(offer(cache, get(uri), response, body));
+    }
+
+    // followed by a scan of responses which are requested once each
+    for (int i = 0 ; i < 200 ; ++i)
+    {
+        auto uri = "/once/" + std::to_string(i);
+        lookup(cache, get(uri));
+        offer(cache, get(uri), response, body);
+        EXPECT_LE(cache.size_in_bytes(), options.capacity);
+    }
+
+    for (int i = 0 ; i < 4 ; ++i)
+        EXPECT_TRUE(lookup(cache, get("/popular/" + std::to_string(i)))) << i;
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+
+#include <secr/dispatch/http/request_header.hpp>
+#include <secr/dispatch/http/response_header.hpp>
+
+#include <boost/format.hpp>
+
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    using namespace secr::dispatch;
+
+    /// the serialiser as it was, formatting the status line every time and
+    /// measuring the header before writing it
+    std::string boost_format_response(const http::HttpResponseHeader& rmsg)
+    {
+        auto status_line = (boost::format("HTTP/%1%.%2% %3% %4%\r\n")
+                            % rmsg.version_major()
+                            % rmsg.version_minor()
+                            % rmsg.status().code()
+                            % rmsg.status().message()).str();
+        auto length = std::accumulate(std::begin(rmsg.headers()), std::end(rmsg.headers()),
+                                      status_line.size() + 2,
+                                      [](std::size_t x, const http::Header& h) {
+                                          return x + h.name().size() + 2 + h.value().size() + 2;
+                                      });
+        std::string result;
+        result.reserve(length);
+        result += status_line;
+        for (auto& header : rmsg.headers())
+            result += header.name() + ": " + header.value() + "\r\n";
+        result += "\r\n";
+        return result;
+    }
+
+    std::string as_string(const http::arena_byte_buffer& buffer)
+    {
+        return std::string(buffer.begin(), buffer.end());
+    }
+
+    void make_response(http::HttpResponseHeader& rmsg, int code, const std::string& message)
+    {
+        rmsg.set_version_major(1);
+        rmsg.set_version_minor(1);
+        http::set_status(rmsg, code, message);
+        http::add_header(rmsg, "Content-Type", "application/json");
+        http::add_header(rmsg, "Content-Length", "1234");
+        http::add_header(rmsg, "Connection", "keep-alive");
+        http::add_header(rmsg, "X-Secr-Message-Type", "secr.dispatch.api.Exception");
+    }
+}
+
+TEST(response_header_tests, status_lines)
+{
+    EXPECT_EQ("Not Found", http::standard_reason(404).to_string());
+    EXPECT_EQ("", http::standard_reason(299).to_string());
+    EXPECT_EQ("", http::standard_reason(99).to_string());
+    EXPECT_EQ("", http::standard_reason(600).to_string());
+
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n", http::standard_status_line(1, 1, 200, "OK").to_string());
+    EXPECT_EQ("HTTP/1.0 503 Service Unavailable\r\n", http::standard_status_line(1, 0, 503, "Service Unavailable").to_string());
+    EXPECT_EQ("", http::standard_status_line(1, 1, 200, "Fine").to_string());
+    EXPECT_EQ("", http::standard_status_line(2, 0, 200, "OK").to_string());
+    EXPECT_EQ("", http::standard_status_line(1, 1, 299, "Odd").to_string());
+}
+
+TEST(response_header_tests, matches_previous_serialisation)
+{
+    google::protobuf::Arena arena;
+
+    for (auto status : { std::make_pair(200, "OK"),
+                         std::make_pair(500, "Internal Server Error"),
+                         std::make_pair(200, "Fine"),
+                         std::make_pair(299, "Odd") })
+    {
+        auto rmsg = google::protobuf::Arena::CreateMessage<http::HttpResponseHeader>(std::addressof(arena));
+        make_response(*rmsg, status.first, status.second);
+        EXPECT_EQ(boost_format_response(*rmsg), as_string(http::to_response_buffer(*rmsg)));
+
+        rmsg->set_version_minor(0);
+        EXPECT_EQ(boost_format_response(*rmsg), as_string(http::to_response_buffer(*rmsg)));
+    }
+
+    // larger than the initial buffer
+    http::HttpResponseHeader big;
+    make_response(big, 200, "OK");
+    for (int i = 0 ; i < 50 ; ++i)
+        http::add_header(big, "X-Header-" + std::to_string(i), std::string(i * 3, 'v'));
+    EXPECT_EQ(boost_format_response(big), as_string(http::to_response_buffer(big)));
+}
+
+TEST(response_header_tests, date_header)
+{
+    char date[http::http_date_size];
+    http::format_http_date(784111777, date);
+    EXPECT_EQ("Sun, 06 Nov 1994 08:49:37 GMT", std::string(date, sizeof(date)));
+    http::format_http_date(0, date);
+    EXPECT_EQ("Thu, 01 Jan 1970 00:00:00 GMT", std::string(date, sizeof(date)));
+
+    // every thread sees a well formed date
+    std::vector<std::thread> threads;
+    std::atomic<int> malformed { 0 };
+    for (int t = 0 ; t < 4 ; ++t)
+    {
+        threads.emplace_back([&] {
+            for (int i = 0 ; i < 100000 ; ++i)
+            {
+                char now[http::http_date_size];
+                http::current_http_date(now);
+                if (std::string(now + 25, 4) != " GMT" or now[3] != ',')
+                    ++malformed;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(0, malformed.load());
+
+    http::HttpResponseHeader rmsg;
+    make_response(rmsg, 200, "OK");
+    auto text = as_string(http::to_response_buffer(rmsg, true));
+    auto date_pos = text.find("\r\nDate: ");
+    ASSERT_NE(std::string::npos, date_pos);
+    EXPECT_EQ(date_pos + 2 + 6 + http::http_date_size + 4, text.size());
+
+    // a date supplied by the handler is left alone
+    http::add_header(rmsg, "date", "Sun, 06 Nov 1994 08:49:37 GMT");
+    EXPECT_EQ(boost_format_response(rmsg), as_string(http::to_response_buffer(rmsg, true)));
+}
+
+// a benchmark, which is run with --gtest_also_run_disabled_tests
+TEST(response_header_tests, DISABLED_to_response_buffer_benchmark)
+{
+    constexpr std::size_t iterations = 100000;
+
+    http::HttpResponseHeader rmsg;
+    make_response(rmsg, 200, "OK");
+
+    report_timing("boost::format", iterations, "bytes", [&] { return boost_format_response(rmsg).size(); });
+    report_timing("to_response_buffer", iterations, "bytes", [&] { return http::to_response_buffer(rmsg).size(); });
+    report_timing("to_response_buffer with Date", iterations, "bytes", [&] { return http::to_response_buffer(rmsg, true).size(); });
+}
@@ -0,0 +1,284 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+
+#include <secr/dispatch/http/router.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace secr::dispatch;
+
+    /// a router whose handlers are never called, for matching only
+    void add(http::router& r, const std::string& method, const std::string& path_template)
+    {
+        r.add(method, path_template, [](http::dispatch_context, const http::route_parameters&) {});
+    }
+
+    std::vector<std::string> values(const http::route_parameters& parameters)
+    {
+        std::vector<std::string> result;
+        for (std::size_t i = 0 ; i < parameters.size() ; ++i)
+            result.push_back(parameters[i].to_string());
+        return result;
+    }
+
+    using status_type = http::router::match_result::status_type;
+
+    /// The matcher services write by hand: try each template in turn,
+    /// comparing segment by segment
+    struct linear_matcher
+    {
+        void add(const std::string& method, const std::string& path_template)
+        {
+            routes.push_back({ method, split(path_template) });
+        }
+
+        static std::vector<std::string> split(const std::string& path)
+        {
+            std::vector<std::string> segments;
+            std::size_t first = 1;
+            while (first <= path.size())
+            {
+                auto slash = path.find('/', first);
+                if (slash == std::string::npos)
+                    slash = path.size();
+                segments.push_back(path.substr(first, slash - first));
+                first = slash + 1;
+            }
+            return segments;
+        }
+
+        int match(const std::string& method, const std::string& path,
+                  std::vector<std::string>& captured) const
+        {
+            auto segments = split(path);
+            for (std::size_t i = 0 ; i < routes.size() ; ++i)
+            {
+                auto& r = routes[i];
+                if (r.method != method)
+                    continue;
+                captured.clear();
+                std::size_t n = 0;
+                for ( ; n < r.segments.size() ; ++n)
+                {
+                    auto& s = r.segments[n];
+                    if (not s.empty() and s[0] == '*')
+                    {
+                        std::string rest;
+                        for (auto k = n ; k < segments.size() ; ++k)
+                            rest += (k == n ? "" : "/") + segments[k];
+                        captured.push_back(rest);
+                        return int(i);
+                    }
+                    if (n >= segments.size())
+                        break;
+                    if (not s.empty() and s[0] == '{')
+                        captured.push_back(segments[n]);
+                    else if (s != segments[n])
+                        break;
+                }
+                if (n == r.segments.size() and n == segments.size())
+                    return int(i);
+            }
+            return -1;
+        }
+
+        struct route
+        {
+            std::string method;
+            std::vector<std::string> segments;
+        };
+        std::vector<route> routes;
+    };
+
+    /// a plausible api: a few hundred routes over a few dozen resources
+    std::vector<std::pair<std::string, std::string>> api_routes()
+    {
+        std::vector<std::pair<std::string, std::string>> result;
+        for (int r = 0 ; r < 50 ; ++r)
+        {
+            auto base = "/api/v1/resource" + std::to_string(r);
+            result.emplace_back("GET", base);
+            result.emplace_back("POST", base);
+            result.emplace_back("GET", base + "/{id}");
+            result.emplace_back("PUT", base + "/{id}");
+            result.emplace_back("DELETE", base + "/{id}");
+            result.emplace_back("GET", base + "/{id}/items");
+            result.emplace_back("GET", base + "/{id}/items/{item}");
+            result.emplace_back("GET", base + "/{id}/files/*path");
+        }
+        return result;
+    }
+
+    /// requests spread over the whole of api_routes, and some which match
+    /// nothing
+    std::vector<std::pair<std::string, std::string>> api_requests()
+    {
+        std::vector<std::pair<std::string, std::string>> result;
+        for (int i = 0 ; i < 50 ; i += 7)
+        {
+            auto base = "/api/v1/resource" + std::to_string(i);
+            result.emplace_back("GET", base);
+            result.emplace_back("DELETE", base + "/123");
+            result.emplace_back("GET", base + "/123/items/456");
+            result.emplace_back("GET", base + "/123/files/a/b/c.txt");
+            result.emplace_back("GET", base + "/123/unknown");
+        }
+        return result;
+    }
+}
+
+TEST(router_tests, matches_templates)
+{
+    http::router r;
+    add(r, "GET", "/");
+    add(r, "GET", "/users");
+    add(r, "GET", "/users/me");
+    add(r, "GET", "/users/{id}");
+    add(r, "POST", "/users/{id}");
+    add(r, "GET", "/users/{id}/items/{item}");
+    add(r, "GET", "/users/{id}/items/*rest");
+    add(r, "GET", "/usage");
+    add(r, "GET", "/static/*");
+    add(r, "GET", "/v{version}/status");
+    EXPECT_EQ(10, r.route_count());
+
+    // the path outlives the views of it
+    http::route_parameters parameters;
+    std::string path;
+    auto match = [&](const std::string& method, const std::string& p) {
+        path = p;
+        return r.match(method, path, parameters).status;
+    };
+
+    EXPECT_EQ(status_type::found, match("GET", "/"));
+    EXPECT_TRUE(parameters.empty());
+    EXPECT_EQ(status_type::found, match("GET", "/usage"));
+    EXPECT_EQ(status_type::not_found, match("GET", "/use"));
+    EXPECT_EQ(status_type::not_found, match("GET", "/users/"));
+
+    // literal text is preferred to a parameter
+    EXPECT_EQ(status_type::found, match("GET", "/users/me"));
+    EXPECT_TRUE(parameters.empty());
+    EXPECT_EQ(status_type::found, match("GET", "/users/meg"));
+    EXPECT_EQ(std::vector<std::string>({ "meg" }), values(parameters));
+    EXPECT_EQ("meg", parameters.get("id").to_string());
+    EXPECT_EQ("id", parameters.name(0).to_string());
+
+    // a parameter is preferred to a wildcard, which takes the rest
+    EXPECT_EQ(status_type::found, match("GET", "/users/42/items/7"));
+    EXPECT_EQ(std::vector<std::string>({ "42", "7" }), values(parameters));
+    EXPECT_EQ(status_type::found, match("GET", "/users/42/items/7/parts/9"));
+    EXPECT_EQ(std::vector<std::string>({ "42", "7/parts/9" }), values(parameters));
+    EXPECT_EQ("7/parts/9", parameters.get("rest").to_string());
+    EXPECT_EQ(status_type::found, match("GET", "/users/42/items/"));
+    EXPECT_EQ(std::vector<std::string>({ "42", "" }), values(parameters));
+
+    EXPECT_EQ(status_type::found, match("GET", "/static/css/site.css"));
+    EXPECT_EQ(std::vector<std::string>({ "css/site.css" }), values(parameters));
+
+    EXPECT_EQ(status_type::found, match("GET", "/v2/status"));
+    EXPECT_EQ("2", parameters.get("version").to_string());
+
+    // captures refer into the path
+    match("GET", "/users/99");
+    EXPECT_EQ(path.data() + 7, parameters[0].begin());
+}
+
+TEST(router_tests, methods)
+{
+    http::router r;
+    add(r, "GET", "/things/{id}");
+    add(r, "PUT", "/things/{id}");
+    add(r, "POST", "/things");
+
+    http::route_parameters parameters;
+    EXPECT_EQ(status_type::found, r.match("PUT", "/things/1", parameters).status);
+    EXPECT_EQ(status_type::found, r.match("HEAD", "/things/1", parameters).status);
+
+    auto result = r.match("DELETE", "/things/1", parameters);
+    EXPECT_EQ(status_type::method_not_allowed, result.status);
+    EXPECT_EQ("GET, HEAD, PUT", result.allow.to_string());
+
+    EXPECT_EQ(status_type::method_not_allowed, r.match("HEAD", "/things", parameters).status);
+}
+
+TEST(router_tests, rejects_bad_templates)
+{
+    http::router r;
+    add(r, "GET", "/a/{id}");
+    EXPECT_THROW(add(r, "GET", "a"), std::invalid_argument);
+    EXPECT_THROW(add(r, "GET", "/a/{id"), std::invalid_argument);
+    EXPECT_THROW(add(r, "GET", "/a/{}"), std::invalid_argument);
+    EXPECT_THROW(add(r, "GET", "/a/{id}.json"), std::invalid_argument);
+    EXPECT_THROW(add(r, "GET", "/a/*rest/more"), std::invalid_argument);
+    EXPECT_THROW(add(r, "GET", "/a/{name}/b"), std::invalid_argument);
+    EXPECT_THROW(add(r, "GET", "/a/{id}"), std::invalid_argument);
+
+    std::string many = "";
+    for (std::size_t i = 0 ; i <= http::route_parameters::max_size ; ++i)
+        many += "/{p" + std::to_string(i) + "}";
+    EXPECT_THROW(add(r, "GET", many), std::invalid_argument);
+
+    EXPECT_EQ(1, r.route_count());
+}
+
+TEST(router_tests, agrees_with_linear_matcher)
+{
+    http::router r;
+    linear_matcher linear;
+    for (auto& route : api_routes())
+    {
+        add(r, route.first, route.second);
+        linear.add(route.first, route.second);
+    }
+
+    for (auto& request : api_requests())
+    {
+        http::route_parameters parameters;
+        std::vector<std::string> captured;
+        auto found = r.match(request.first, request.second, parameters).status == status_type::found;
+        EXPECT_EQ(found, linear.match(request.first, request.second, captured) >= 0) << request.second;
+        if (found)
+        {
+            EXPECT_EQ(captured, values(parameters)) << request.second;
+        }
+    }
+}
+
+// a benchmark, which is run with --gtest_also_run_disabled_tests
+TEST(router_tests, DISABLED_match_benchmark)
+{
+    http::router r;
+    linear_matcher linear;
+    for (auto& route : api_routes())
+    {
+        add(r, route.first, route.second);
+        linear.add(route.first, route.second);
+    }
+    auto requests = api_requests();
+    std::cout << r.route_count() << " routes, " << requests.size() << " requests per call" << std::endl;
+
+    constexpr std::size_t iterations = 20000;
+    report_timing("linear", iterations, "matched", [&] {
+        std::size_t matched = 0;
+        for (auto& request : requests)
+        {
+            std::vector<std::string> captured;
+            matched += linear.match(request.first, request.second, captured) >= 0;
+        }
+        return matched;
+    });
+    report_timing("radix trie", iterations, "matched", [&] {
+        std::size_t matched = 0;
+        for (auto& request : requests)
+        {
+            http::route_parameters parameters;
+            matched += r.match(request.first, request.second, parameters).status == status_type::found;
+        }
+        return matched;
+    });
+}
@@ -0,0 +1,847 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+
+#include <secr/dispatch/http/router.hpp>
+#include <secr/dispatch/http/server.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+    namespace asio = secr::dispatch::asio;
+    namespace http = secr::dispatch::http;
+    using secr::dispatch::error_code;
+    using secr::dispatch::string_view;
+    using protocol = asio::ip::tcp;
+
+    static const std::string close_request = "GET /hello HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+    /// a GET of path which asks the server to close the connection.
+    /// extra holds any further header lines, each ending in CRLF
+    std::string get(const std::string& path, const std::string& extra = "")
+    {
+        return "GET " + path + " HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        + extra +
+        "Connection: close\r\n"
+        "\r\n";
+    }
+
+    void say_hello(http::dispatch_context context)
+    {
+        static const std::string body = "hello";
+        error_code ec;
+        context.response().flush(asio::buffer(body), ec);
+    }
+
+    http::server_options options_for(std::size_t threads)
+    {
+        http::server_options options;
+        options.threads = threads;
+        return options;
+    }
+    
+    /// a response as read from the socket, split at the end of its header
+    struct response_parts
+    {
+        std::string text;           ///< everything the server sent
+        std::string status_line;    ///< the first line, without its CRLF
+        std::string header;         ///< the header, up to and including its blank line
+        std::string body;           ///< everything after the header
+    };
+}
+
+/// Serves the handler of one test from a server on the loopback interface.
+/// A test adjusts options, calls serve() and sends requests with request().
+struct server_tests : ::testing::Test
+{
+    void serve(http::server::request_handler handler)
+    {
+        server = std::make_unique<http::server>(http::server::endpoint_type(asio::ip::address_v4::loopback(), 0),
+                                                std::move(handler),
+                                                options);
+        server->start();
+    }
+    
+    /// serve the routes added to router
+    void serve_routes()
+    {
+        serve([this](http::dispatch_context context) { router(std::move(context)); });
+    }
+    
+    /// send raw_text on a new connection and read until the server closes it
+    response_parts request(const std::string& raw_text)
+    {
+        response_parts response;
+        response.text = round_trip(client_service, server->local_endpoint(), raw_text);
+        auto header_end = response.text.find("\r\n\r\n");
+        EXPECT_NE(std::string::npos, header_end) << response.text;
+        if (header_end != std::string::npos)
+        {
+            response.status_line = response.text.substr(0, response.text.find("\r\n"));
+            response.header = response.text.substr(0, header_end + 4);
+            response.body = response.text.substr(header_end + 4);
+        }
+        return response;
+    }
+    
+    void TearDown() override
+    {
+        if (server)
+            server->stop();
+    }
+    
+    http::server_options options = options_for(1);
+    http::router router;
+    asio::io_service client_service;
+    std::unique_ptr<http::server> server;
+};
+
+TEST_F(server_tests, serves_requests_on_every_core)
+{
+    options.threads = 2;
+    serve(say_hello);
+    ASSERT_EQ(2, server->core_count());
+    ASSERT_NE(0, server->local_endpoint().port());
+
+    for (int i = 0 ; i < 8 ; ++i)
+    {
+        auto response = request(close_request);
+        EXPECT_EQ(0, response.text.find("HTTP/1.1 200 OK\r\nContent-Length: 5\r\nConnection: close\r\nDate: "));
+        EXPECT_EQ("hello", response.body);
+    }
+    EXPECT_EQ(8, server->connections_accepted());
+}
+
+// a benchmark, which is run with --gtest_also_run_disabled_tests. It runs a
+// server of its own for each number of cores.
+TEST_F(server_tests, DISABLED_connection_rate_scales_with_cores)
+{
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t connections_per_client = 250;
+    auto hardware = std::max(1u, std::thread::hardware_concurrency());
+    auto clients = std::size_t(std::max(2u, hardware));
+
+    for (std::size_t cores = 1 ; cores <= hardware ; cores *= 2)
+    {
+        http::server cores_server(http::server::endpoint_type(asio::ip::address_v4::loopback(), 0),
+                                  say_hello,
+                                  options_for(cores));
+        cores_server.start();
+
+        std::atomic<std::size_t> failures { 0 };
+        auto t0 = clock::now();
+        std::vector<std::thread> client_threads;
+        for (std::size_t c = 0 ; c < clients ; ++c)
+        {
+            client_threads.emplace_back([&] {
+                asio::io_service thread_client_service;
+                for (std::size_t i = 0 ; i < connections_per_client ; ++i)
+                {
+                    try {
+                        auto response = round_trip(thread_client_service, cores_server.local_endpoint(), close_request);
+                        if (response.compare(0, 15, "HTTP/1.1 200 OK") != 0)
+                            ++failures;
+                    }
+                    catch(...) {
+                        ++failures;
+                    }
+                }
+            });
+        }
+        for (auto& t : client_threads) {
+            t.join();
+        }
+        auto elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+        cores_server.stop();
+
+        auto total = clients * connections_per_client;
+        EXPECT_EQ(0, failures.load());
+        EXPECT_EQ(total, cores_server.connections_accepted());
+        auto rate = total / elapsed;
+        std::cout << "[ benchmark] cores: " << cores
+        << ", connections: " << total
+        << ", connections/sec: " << std::size_t(rate) << std::endl;
+        ::testing::Test::RecordProperty("connections_per_sec_" + std::to_string(cores),
+                                        std::to_string(std::size_t(rate)));
+    }
+}
+
+namespace {
+    
+    /// connect, send some data and wait for the server to close the connection
+    /// @returns the time taken for the server to close
+    std::chrono::steady_clock::duration time_to_close(asio::io_service& io_service,
+                                                      const protocol::endpoint& endpoint,
+                                                      const std::string& data)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        protocol::socket socket(io_service);
+        socket.connect(endpoint);
+        if (not data.empty()) {
+            asio::write(socket, asio::buffer(data));
+        }
+        char buf[64];
+        error_code ec;
+        while (not ec) {
+            socket.read_some(asio::buffer(buf), ec);
+        }
+        return std::chrono::steady_clock::now() - t0;
+    }
+    
+    const auto short_timeout = std::chrono::milliseconds(300);
+    
+    /// how late a timed-out connection may close: a tick of the timer wheel
+    /// plus ample room for a loaded machine
+    const auto close_slack = std::chrono::seconds(2);
+    
+    http::server_options short_timeouts()
+    {
+        auto options = options_for(1);
+        options.timeouts = http::connection_timeouts();
+        options.timeouts.idle = short_timeout;
+        options.timeouts.header = short_timeout;
+        options.timeouts.body_interval = short_timeout;
+        options.timeouts.body_min_bytes_per_sec = 1000;
+        return options;
+    }
+}
+
+TEST_F(server_tests, idle_connection_times_out)
+{
+    options = short_timeouts();
+    serve(say_hello);
+    
+    auto elapsed = time_to_close(client_service, server->local_endpoint(), "");
+    EXPECT_GE(elapsed, short_timeout);
+    EXPECT_LT(elapsed, short_timeout + close_slack);
+}
+
+TEST_F(server_tests, slow_header_times_out)
+{
+    options = short_timeouts();
+    serve(say_hello);
+    
+    auto elapsed = time_to_close(client_service, server->local_endpoint(), "GET /hello HTTP/1.1\r\nHost: loc");
+    EXPECT_GE(elapsed, short_timeout);
+    EXPECT_LT(elapsed, short_timeout + close_slack);
+}
+
+TEST_F(server_tests, keep_alive_requests_reuse_arenas)
+{
+    serve(say_hello);
+    
+    static const std::string keep_alive_request = "GET /hello HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+    
+    protocol::socket socket(client_service);
+    socket.connect(server->local_endpoint());
+    
+    auto exchange = [&] {
+        asio::write(socket, asio::buffer(keep_alive_request));
+        asio::streambuf response;
+        asio::read_until(socket, response, "hello");
+    };
+    
+    // let the pool learn the arena size
+    for (int i = 0 ; i < 16 ; ++i) {
+        exchange();
+    }
+    
+    auto allocations_before = http::request_context::arena_block_allocations();
+    for (int i = 0 ; i < 100 ; ++i) {
+        exchange();
+    }
+    EXPECT_EQ(allocations_before, http::request_context::arena_block_allocations());
+}
+
+TEST_F(server_tests, chunked_response_coalesces_small_writes)
+{
+    serve([](http::dispatch_context context)
+          {
+              static const std::string digits = "0123456789";
+              auto& response = context.response();
+              response.set_chunk_coalescing(16);
+              error_code ec;
+              for (int i = 0 ; i < 10 and not ec ; ++i)
+                  response.write_some(asio::buffer(digits), ec);
+              if (not ec)
+                  response.close(ec);
+          });
+    
+    auto response = request(close_request);
+    
+    std::string chunk = "14\r\n" "01234567890123456789" "\r\n";
+    std::string body;
+    for (int i = 0 ; i < 5 ; ++i)
+        body += chunk;
+    body += "0\r\n\r\n";
+    
+    EXPECT_NE(std::string::npos, response.header.find("Transfer-Encoding: chunked")) << response.text;
+    EXPECT_EQ(body, response.body);
+}
+
+TEST_F(server_tests, chunked_response_keeps_connection_open)
+{
+    serve([](http::dispatch_context context)
+          {
+              auto& response = context.response();
+              response.set_content_length(http::content_length_variable());
+              error_code ec;
+              response.write_some(asio::buffer(std::string("hello")), ec);
+              if (not ec)
+                  response.close(ec);
+          });
+    
+    // a Connection header which does not list "close" leaves an HTTP/1.1
+    // connection open, so the second request is answered on it
+    auto response = request("GET /hello HTTP/1.1\r\n"
+                            "Host: localhost\r\n"
+                            "TE: trailers\r\n"
+                            "Connection: TE\r\n"
+                            "\r\n"
+                            + close_request).text;
+    
+    auto second = response.find("HTTP/1.1 200", 1);
+    ASSERT_NE(std::string::npos, second) << response;
+    EXPECT_NE(std::string::npos, response.substr(0, second).find("Connection: keep-alive\r\n"));
+    EXPECT_NE(std::string::npos, response.find("Connection: close\r\n", second));
+}
+
+TEST_F(server_tests, fixed_length_response_keeps_connection_open)
+{
+    serve(say_hello);
+    
+    // an HTTP/1.1 request without a Connection header leaves the connection
+    // open, so the second request is answered on it
+    auto response = request("GET /hello HTTP/1.1\r\n"
+                            "Host: localhost\r\n"
+                            "\r\n"
+                            + close_request).text;
+    
+    auto second = response.find("HTTP/1.1 200", 1);
+    ASSERT_NE(std::string::npos, second) << response;
+    EXPECT_NE(std::string::npos, response.substr(0, second).find("Connection: keep-alive\r\n"));
+    EXPECT_NE(std::string::npos, response.find("Connection: close\r\n", second));
+}
+
+TEST_F(server_tests, head_response_has_no_body)
+{
+    router.add("GET", "/fixed", [](http::dispatch_context context, const http::route_parameters&)
+               {
+                   say_hello(std::move(context));
+               });
+    router.add("GET", "/chunked", [](http::dispatch_context context, const http::route_parameters&)
+               {
+                   auto& response = context.response();
+                   response.set_content_length(http::content_length_variable());
+                   error_code ec;
+                   response.write_some(asio::buffer(std::string("hello")), ec);
+                   if (not ec)
+                       response.close(ec);
+               });
+    serve_routes();
+    
+    // both HEAD responses leave the connection open for the GET after them
+    auto response = request("HEAD /fixed HTTP/1.1\r\n"
+                            "Host: localhost\r\n"
+                            "Connection: keep-alive\r\n"
+                            "\r\n"
+                            "HEAD /chunked HTTP/1.1\r\n"
+                            "Host: localhost\r\n"
+                            "Connection: keep-alive\r\n"
+                            "\r\n"
+                            + get("/fixed")).text;
+    
+    auto first_end = response.find("\r\n\r\n");
+    ASSERT_NE(std::string::npos, first_end) << response;
+    EXPECT_NE(std::string::npos, response.substr(0, first_end).find("Content-Length: 5\r\n"));
+    auto second = first_end + 4;
+    EXPECT_EQ(second, response.find("HTTP/1.1 200 OK\r\n", second)) << response;
+    
+    auto second_end = response.find("\r\n\r\n", second);
+    ASSERT_NE(std::string::npos, second_end) << response;
+    EXPECT_NE(std::string::npos, response.substr(second, second_end - second).find("Transfer-Encoding: chunked\r\n"));
+    auto third = second_end + 4;
+    EXPECT_EQ(third, response.find("HTTP/1.1 200 OK\r\n", third)) << response;
+    
+    auto third_end = response.find("\r\n\r\n", third);
+    ASSERT_NE(std::string::npos, third_end) << response;
+    EXPECT_EQ("hello", response.substr(third_end + 4));
+}
+
+TEST_F(server_tests, head_response_to_a_failure_has_no_body)
+{
+    serve([](http::dispatch_context) { throw std::runtime_error("broken"); });
+    
+    auto failed = request(get("/broken"));
+    EXPECT_EQ("HTTP/1.1 500 Internal Server Error", failed.status_line);
+    EXPECT_NE(std::string::npos, failed.body.find("broken"));
+    
+    // the header still describes the body a GET would have been sent
+    auto head = request("HEAD /broken HTTP/1.1\r\n"
+                        "Host: localhost\r\n"
+                        "\r\n");
+    EXPECT_EQ("HTTP/1.1 500 Internal Server Error", head.status_line);
+    EXPECT_NE(std::string::npos, head.header.find("Content-Length: " + std::to_string(failed.body.size()) + "\r\n"));
+    EXPECT_EQ("", head.body);
+}
+
+TEST_F(server_tests, async_write_sends_caller_buffers)
+{
+    constexpr std::size_t body_size = 4 * 1024 * 1024;
+    std::promise<std::size_t> written;
+    serve([&](http::dispatch_context context)
+          {
+              auto data = std::shared_ptr<std::uint8_t>(new std::uint8_t[body_size], std::default_delete<std::uint8_t[]>());
+              std::fill(data.get(), data.get() + body_size, std::uint8_t('b'));
+              
+              auto& response = context.response();
+              response.set_content_length(http::content_length_fixed(body_size));
+              response.async_write(http::shared_byte_buffer(data, body_size),
+                                   [&written](const error_code& ec, std::size_t size) {
+                                       written.set_value(ec ? 0 : size);
+                                   });
+              response.close();
+          });
+    
+    auto response = request(close_request);
+    auto result = written.get_future();
+    ASSERT_EQ(std::future_status::ready, result.wait_for(a_while()));
+    EXPECT_EQ(body_size, result.get());
+    EXPECT_EQ(std::string(body_size, 'b'), response.body);
+}
+
+TEST_F(server_tests, send_file_honours_ranges)
+{
+    std::string content;
+    for (int i = 0 ; i < 1000 ; ++i)
+        content += char('a' + i % 26);
+    char path[] = "/tmp/secr_dispatch_send_file_XXXXXX";
+    auto fd = ::mkstemp(path);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(ssize_t(content.size()), ::write(fd, content.data(), content.size()));
+    
+    serve([&path, fd](http::dispatch_context context)
+          {
+              auto& response = context.response();
+              http::add_header(response.mutable_header(), "Content-Type", "text/plain");
+              if (context.request().raw_path() == string_view("/tail"))
+                  response.send_file(fd, 990, 100);
+              else
+                  response.send_file(path);
+          });
+    
+    auto whole = request(get("/file"));
+    EXPECT_EQ("HTTP/1.1 200 OK", whole.status_line);
+    EXPECT_NE(std::string::npos, whole.header.find("Accept-Ranges: bytes\r\n"));
+    EXPECT_EQ(content, whole.body);
+    
+    auto single = request(get("/file", "Range: bytes=10-19\r\n"));
+    EXPECT_EQ("HTTP/1.1 206 Partial Content", single.status_line);
+    EXPECT_NE(std::string::npos, single.header.find("Content-Range: bytes 10-19/1000\r\n"));
+    EXPECT_EQ(content.substr(10, 10), single.body);
+    
+    auto multiple = request(get("/file", "Range: bytes=0-1, -3\r\n"));
+    EXPECT_EQ("HTTP/1.1 206 Partial Content", multiple.status_line);
+    auto boundary_pos = multiple.header.find("multipart/byteranges; boundary=");
+    ASSERT_NE(std::string::npos, boundary_pos);
+    auto boundary = multiple.header.substr(boundary_pos + 31,
+                                           multiple.header.find("\r\n", boundary_pos) - boundary_pos - 31);
+    EXPECT_EQ("--" + boundary + "\r\n"
+              "Content-Type: text/plain\r\n"
+              "Content-Range: bytes 0-1/1000\r\n"
+              "\r\n"
+              + content.substr(0, 2) +
+              "\r\n--" + boundary + "\r\n"
+              "Content-Type: text/plain\r\n"
+              "Content-Range: bytes 997-999/1000\r\n"
+              "\r\n"
+              + content.substr(997) +
+              "\r\n--" + boundary + "--\r\n", multiple.body);
+    
+    auto unsatisfiable = request(get("/file", "Range: bytes=5000-\r\n"));
+    EXPECT_EQ("HTTP/1.1 416 Range Not Satisfiable", unsatisfiable.status_line);
+    EXPECT_NE(std::string::npos, unsatisfiable.header.find("Content-Range: bytes */1000\r\n"));
+    EXPECT_EQ("", unsatisfiable.body);
+    
+    // a stale validator gets the whole file
+    auto stale = request(get("/file", "Range: bytes=10-19\r\nIf-Range: Sun, 06 Nov 1994 08:49:37 GMT\r\n"));
+    EXPECT_EQ("HTTP/1.1 200 OK", stale.status_line);
+    EXPECT_EQ(content, stale.body);
+    
+    // a region which runs past the end of the file is cut short there
+    auto tail = request(get("/tail"));
+    EXPECT_EQ("HTTP/1.1 200 OK", tail.status_line);
+    EXPECT_NE(std::string::npos, tail.header.find("Content-Length: 10\r\n"));
+    EXPECT_EQ(content.substr(990), tail.body);
+    
+    ::close(fd);
+    ::unlink(path);
+}
+
+namespace {
+    
+    std::string gunzip(const std::string& data)
+    {
+        z_stream z {};
+        inflateInit2(&z, MAX_WBITS + 32);
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        z.avail_in = uInt(data.size());
+        std::string result;
+        int status = Z_OK;
+        while (status == Z_OK)
+        {
+            char block[4096];
+            z.next_out = reinterpret_cast<Bytef*>(block);
+            z.avail_out = sizeof(block);
+            status = inflate(&z, Z_NO_FLUSH);
+            result.append(block, sizeof(block) - z.avail_out);
+        }
+        inflateEnd(&z);
+        EXPECT_EQ(Z_STREAM_END, status);
+        return result;
+    }
+    
+    std::string dechunk(const std::string& body)
+    {
+        std::string result;
+        std::size_t pos = 0;
+        while (true)
+        {
+            auto eol = body.find("\r\n", pos);
+            auto size = std::stoul(body.substr(pos, eol - pos), nullptr, 16);
+            if (size == 0)
+                return result;
+            result += body.substr(eol + 2, size);
+            pos = eol + 2 + size + 2;
+        }
+    }
+}
+
+TEST_F(server_tests, compresses_responses)
+{
+    std::string json = "[";
+    for (int i = 0 ; i < 500 ; ++i)
+        json += "{\"id\":" + std::to_string(i) + ",\"name\":\"record\",\"active\":true},";
+    json.back() = ']';
+    
+    options.compression.enabled = true;
+    options.compression.minimum_size = 100;
+    options.compression.buffer_limit = 64 * 1024;
+    serve([&json](http::dispatch_context context)
+          {
+              auto& response = context.response();
+              auto path = context.request().raw_path();
+              error_code ec;
+              if (path == string_view("/small"))
+                  response.flush(asio::buffer(json.data(), 50), ec);
+              else if (path == string_view("/stream") or path == string_view("/trickle"))
+              {
+                  std::size_t piece = path == string_view("/stream") ? 1000 : 20;
+                  for (std::size_t pos = 0 ; pos < json.size() and not ec ; pos += piece)
+                      response.write_some(asio::buffer(json.data() + pos, std::min<std::size_t>(piece, json.size() - pos)), ec);
+                  response.close();
+              }
+              else if (path == string_view("/coding"))
+              {
+                  static const http::offered_encodings offered { "gzip", "identity" };
+                  auto coding = context.request().negotiate(offered);
+                  auto body = coding ? *coding : std::string("none");
+                  response.flush(asio::buffer(body), ec);
+              }
+              else
+                  response.flush(asio::buffer(json), ec);
+          });
+    
+    // a known length is kept
+    auto whole = request(get("/", "Accept-Encoding: gzip, deflate\r\n"));
+    EXPECT_NE(std::string::npos, whole.header.find("Content-Encoding: gzip\r\n"));
+    EXPECT_NE(std::string::npos, whole.header.find("Vary: Accept-Encoding\r\n"));
+    EXPECT_NE(std::string::npos, whole.header.find("Content-Length: " + std::to_string(whole.body.size()) + "\r\n"));
+    EXPECT_LT(whole.body.size() * 4, json.size());
+    EXPECT_EQ(json, gunzip(whole.body));
+    
+    // a stream is compressed into chunks
+    auto stream = request(get("/stream", "Accept-Encoding: deflate\r\n"));
+    EXPECT_NE(std::string::npos, stream.header.find("Content-Encoding: deflate\r\n"));
+    EXPECT_NE(std::string::npos, stream.header.find("Transfer-Encoding: chunked\r\n"));
+    EXPECT_EQ(json, gunzip(dechunk(stream.body)));
+    
+    // small writes are compressed together rather than one by one
+    auto trickle = request(get("/trickle", "Accept-Encoding: gzip\r\n"));
+    auto trickled = dechunk(trickle.body);
+    EXPECT_LT(trickled.size() * 4, json.size());
+    EXPECT_EQ(json, gunzip(trickled));
+    
+    // small bodies and clients which do not ask are sent as they are, and
+    // only a body which could have been compressed varies
+    auto small = request(get("/small", "Accept-Encoding: gzip\r\n"));
+    EXPECT_EQ(std::string::npos, small.header.find("Content-Encoding"));
+    EXPECT_EQ(std::string::npos, small.header.find("Vary"));
+    EXPECT_EQ(json.substr(0, 50), small.body);
+    
+    auto plain = request(get("/"));
+    EXPECT_EQ(std::string::npos, plain.header.find("Content-Encoding"));
+    EXPECT_NE(std::string::npos, plain.header.find("Vary: Accept-Encoding\r\n"));
+    EXPECT_EQ(json, plain.body);
+    
+    auto refused = request(get("/", "Accept-Encoding: gzip;q=0\r\n"));
+    EXPECT_EQ(std::string::npos, refused.header.find("Content-Encoding"));
+    EXPECT_EQ(json, refused.body);
+    
+    // although the server compresses only for clients which ask, a handler
+    // sees a client which sends no Accept-Encoding accept any coding
+    EXPECT_EQ("gzip", request(get("/coding")).body);
+    EXPECT_EQ("identity", request(get("/coding", "Accept-Encoding: identity\r\n")).body);
+}
+
+TEST_F(server_tests, compressed_stream_delivers_each_write)
+{
+    auto piece = [](std::size_t n)
+    {
+        std::string text;
+        for (int i = 0 ; i < 20 ; ++i)
+            text += "{\"piece\":" + std::to_string(n) + ",\"id\":" + std::to_string(i) + "},";
+        return text;
+    };
+    
+    // each piece is written and flushed once the client has inflated the one
+    // before it, so a piece which is held back stalls the writer until it
+    // gives up
+    std::array<std::promise<void>, 3> received;
+    std::atomic<int> stalls { 0 };
+    std::thread writer;
+    options.compression.enabled = true;
+    options.compression.minimum_size = 100;
+    serve([&](http::dispatch_context context)
+          {
+              writer = std::thread([&, context = std::move(context)]() mutable
+              {
+                  auto& response = context.response();
+                  error_code ec;
+                  for (std::size_t i = 0 ; i < received.size() and not ec ; ++i)
+                  {
+                      response.write_some(asio::buffer(piece(i)), ec);
+                      if (not ec)
+                          response.flush_compression(ec);
+                      if (received[i].get_future().wait_for(5s) != std::future_status::ready)
+                          ++stalls;
+                  }
+                  response.close();
+              });
+          });
+    
+    protocol::socket socket(client_service);
+    socket.connect(server->local_endpoint());
+    asio::write(socket, asio::buffer(get("/stream", "Accept-Encoding: gzip\r\n")));
+    
+    asio::streambuf header;
+    auto header_size = asio::read_until(socket, header, "\r\n\r\n");
+    std::string raw(asio::buffers_begin(header.data()), asio::buffers_end(header.data()));
+    EXPECT_NE(std::string::npos, raw.substr(0, header_size).find("Content-Encoding: gzip\r\n"));
+    raw.erase(0, header_size);
+    
+    z_stream z {};
+    inflateInit2(&z, MAX_WBITS + 32);
+    std::string text, expected;
+    std::size_t next = 0;
+    error_code ec;
+    while (not ec)
+    {
+        // inflate every whole chunk which has arrived
+        for (auto eol = raw.find("\r\n") ; eol != std::string::npos ; eol = raw.find("\r\n"))
+        {
+            auto size = std::stoul(raw.substr(0, eol), nullptr, 16);
+            if (raw.size() < eol + 2 + size + 2)
+                break;
+            z.next_in = reinterpret_cast<Bytef*>(&raw[eol + 2]);
+            z.avail_in = uInt(size);
+            int status = Z_OK;
+            while (z.avail_in and status == Z_OK)
+            {
+                char block[4096];
+                z.next_out = reinterpret_cast<Bytef*>(block);
+                z.avail_out = sizeof(block);
+                status = inflate(&z, Z_SYNC_FLUSH);
+                text.append(block, sizeof(block) - z.avail_out);
+            }
+            raw.erase(0, eol + 2 + size + 2);
+        }
+        
+        while (next < received.size() and text.size() >= expected.size() + piece(next).size())
+        {
+            expected += piece(next);
+            received[next++].set_value();
+        }
+        
+        char buffer[4096];
+        auto size = socket.read_some(asio::buffer(buffer), ec);
+        raw.append(buffer, size);
+    }
+    inflateEnd(&z);
+    
+    EXPECT_EQ(asio::error::eof, ec);
+    EXPECT_EQ(0, stalls);
+    EXPECT_EQ(received.size(), next);
+    EXPECT_EQ(expected, text);
+    
+    if (writer.joinable())
+        writer.join();
+}
+
+TEST_F(server_tests, caches_responses)
+{
+    std::atomic<int> calls { 0 };
+    options.cache.enabled = true;
+    serve([&calls](http::dispatch_context context)
+          {
+              ++calls;
+              auto& response = context.response();
+              if (context.request().raw_path() == string_view("/cached"))
+              {
+                  http::add_header(response.mutable_header(), "Cache-Control", "max-age=60");
+                  http::add_header(response.mutable_header(), "ETag", http::strong_entity_tag(7));
+              }
+              error_code ec;
+              response.flush(asio::buffer(std::string("counted")), ec);
+          });
+    
+    auto first = request(get("/cached"));
+    EXPECT_EQ(std::string::npos, first.header.find("Age: "));
+    EXPECT_EQ(1, calls.load());
+    EXPECT_EQ(1, server->cache()->entry_count());
+    
+    // answered by the connection without reaching the handler
+    auto second = request(get("/cached"));
+    EXPECT_EQ(1, calls.load());
+    EXPECT_EQ("HTTP/1.1 200 OK", second.status_line);
+    EXPECT_NE(std::string::npos, second.header.find("Cache-Control: max-age=60\r\n"));
+    EXPECT_NE(std::string::npos, second.header.find("Connection: close\r\n"));
+    EXPECT_NE(std::string::npos, second.header.find("Age: "));
+    EXPECT_EQ("counted", second.body);
+    
+    // a conditional request is answered from the stored tag
+    auto unchanged = request(get("/cached", "If-None-Match: " + http::strong_entity_tag(7) + "\r\n"));
+    EXPECT_EQ(1, calls.load());
+    EXPECT_EQ("HTTP/1.1 304 Not Modified", unchanged.status_line);
+    EXPECT_NE(std::string::npos, unchanged.header.find("ETag: " + http::strong_entity_tag(7) + "\r\n"));
+    EXPECT_EQ(std::string::npos, unchanged.header.find("Content-Length"));
+    EXPECT_EQ("", unchanged.body);
+    
+    // another virtual host has its own entries
+    request("GET /cached HTTP/1.1\r\n"
+            "Host: example.com\r\n"
+            "Connection: close\r\n"
+            "\r\n");
+    EXPECT_EQ(2, calls.load());
+    EXPECT_EQ(2, server->cache()->entry_count());
+    
+    // responses without a lifetime are not stored
+    request(get("/uncached"));
+    request(get("/uncached"));
+    EXPECT_EQ(4, calls.load());
+}
+
+TEST_F(server_tests, cache_hits_keep_connection_open)
+{
+    std::atomic<int> calls { 0 };
+    options.cache.enabled = true;
+    serve([&calls](http::dispatch_context context)
+          {
+              ++calls;
+              auto& response = context.response();
+              http::add_header(response.mutable_header(), "Cache-Control", "max-age=60");
+              error_code ec;
+              response.flush(asio::buffer(std::string("counted")), ec);
+          });
+    
+    request(close_request);
+    ASSERT_EQ(1, calls.load());
+    
+    // both hits are answered on one connection, the first without closing it
+    auto response = request("GET /hello HTTP/1.1\r\n"
+                            "Host: localhost\r\n"
+                            "\r\n"
+                            + close_request).text;
+    
+    EXPECT_EQ(1, calls.load());
+    auto second = response.find("HTTP/1.1 200", 1);
+    ASSERT_NE(std::string::npos, second) << response;
+    EXPECT_NE(std::string::npos, response.substr(0, second).find("Connection: keep-alive\r\n"));
+    EXPECT_NE(std::string::npos, response.substr(0, second).find("Age: "));
+    EXPECT_NE(std::string::npos, response.find("Connection: close\r\n", second));
+}
+
+TEST_F(server_tests, answers_conditional_requests)
+{
+    std::string body(2000, 'e');
+    options.entity_tags.enabled = true;
+    serve([&body](http::dispatch_context context)
+          {
+              auto& response = context.response();
+              error_code ec;
+              if (context.request().raw_path() == string_view("/streamed"))
+              {
+                  // the handler has chosen chunked framing before it checks
+                  response.set_content_length(http::content_length_variable());
+                  if (response.check_not_modified(http::strong_entity_tag(42), ec))
+                      return;
+                  response.write_some(asio::buffer(body), ec);
+                  response.close(ec);
+                  return;
+              }
+              if (context.request().raw_path() == string_view("/versioned")
+                  and response.check_not_modified(http::strong_entity_tag(42), ec))
+              {
+                  return;
+              }
+              response.flush(asio::buffer(body), ec);
+          });
+    
+    // the body is hashed into a strong tag
+    auto first = request(get("/"));
+    auto tag_pos = first.header.find("ETag: \"");
+    ASSERT_NE(std::string::npos, tag_pos);
+    auto tag = first.header.substr(tag_pos + 6, 18);
+    EXPECT_EQ(body, first.body);
+    
+    auto unchanged = request(get("/", "If-None-Match: " + tag + "\r\n"));
+    EXPECT_EQ("HTTP/1.1 304 Not Modified", unchanged.status_line);
+    EXPECT_EQ("", unchanged.body);
+    
+    auto changed = request(get("/", "If-None-Match: \"0000000000000000\"\r\n"));
+    EXPECT_EQ(body, changed.body);
+    
+    // the handler answers from its version number
+    auto versioned = request(get("/versioned", "If-None-Match: " + http::strong_entity_tag(42) + "\r\n"));
+    EXPECT_EQ("HTTP/1.1 304 Not Modified", versioned.status_line);
+    auto stale = request(get("/versioned", "If-None-Match: " + http::strong_entity_tag(41) + "\r\n"));
+    EXPECT_NE(std::string::npos, stale.header.find("ETag: " + http::strong_entity_tag(42) + "\r\n"));
+    EXPECT_EQ(body, stale.body);
+    
+    // a 304 in place of a chunked body is not framed as chunked
+    auto streamed = request(get("/streamed", "If-None-Match: " + http::strong_entity_tag(42) + "\r\n"));
+    EXPECT_EQ("HTTP/1.1 304 Not Modified", streamed.status_line);
+    EXPECT_EQ(std::string::npos, streamed.header.find("Transfer-Encoding"));
+    EXPECT_EQ("", streamed.body);
+}
@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+
+#include <secr/dispatch/http/server.hpp>
+#include <secr/dispatch/http/service_table.hpp>
+#include <secr/dispatch/testing.pb.h>
+#if defined(SECR_DISPATCH_HAVE_TABLES)
+#include <secr/dispatch/testing.dispatch.pb.h>
+#endif
+
+#include <memory>
+#include <string>
+
+namespace {
+
+    namespace asio = secr::dispatch::asio;
+    namespace http = secr::dispatch::http;
+    namespace test_proto = ::secr::testing;
+    using protocol = asio::ip::tcp;
+
+    struct response_parts
+    {
+        std::string header;
+        std::string body;
+    };
+
+    response_parts post(asio::io_service& io_service,
+                        const protocol::endpoint& endpoint,
+                        const std::string& path,
+                        const std::string& headers,
+                        const std::string& body)
+    {
+        auto response = round_trip(io_service, endpoint,
+                                   "POST " + path + " HTTP/1.1\r\n"
+                                   "Host: localhost\r\n"
+                                   + headers +
+                                   "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                   "Connection: close\r\n"
+                                   "\r\n"
+                                   + body);
+        auto header_end = response.find("\r\n\r\n");
+        EXPECT_NE(std::string::npos, header_end);
+        return { response.substr(0, header_end + 4), response.substr(header_end + 4) };
+    }
+
+    std::string status_line(const response_parts& response)
+    {
+        return response.header.substr(0, response.header.find("\r\n"));
+    }
+
+    std::string int_pair(int x, int y)
+    {
+        test_proto::IntPair pair;
+        pair.set_x(x);
+        pair.set_y(y);
+        return pair.SerializeAsString();
+    }
+
+    /// serve the test service through a router and call each method
+    void check_service(http::router& router)
+    {
+        http::server_options options;
+        options.threads = 1;
+        http::server server(http::server::endpoint_type(asio::ip::address_v4::loopback(), 0),
+                            [&router](http::dispatch_context context) { router(std::move(context)); },
+                            options);
+        server.start();
+        asio::io_service client_service;
+        auto call = [&](const std::string& method, const std::string& headers, const std::string& body) {
+            return post(client_service, server.local_endpoint(), "/secr.testing.TestService/" + method, headers, body);
+        };
+
+        // json in, json out
+        auto json = call("complete_sync", "Content-Type: application/json\r\n", R"({"x":2,"y":3})");
+        EXPECT_EQ("HTTP/1.1 200 OK", status_line(json));
+        EXPECT_NE(std::string::npos, json.header.find("Content-Type: application/json\r\n"));
+        EXPECT_EQ(R"({"z":5})", json.body);
+
+        // binary in, binary out
+        auto binary = call("complete_sync", "Content-Type: application/x-protobuf\r\n", int_pair(20, 22));
+        EXPECT_EQ("HTTP/1.1 200 OK", status_line(binary));
+        EXPECT_NE(std::string::npos, binary.header.find("Content-Type: application/x-protobuf\r\n"));
+        test_proto::Int result;
+        ASSERT_TRUE(result.ParseFromString(binary.body));
+        EXPECT_EQ(42, result.z());
+
+        // the client's Accept decides the response encoding
+        auto mixed = call("complete_sync",
+                          "Content-Type: application/x-protobuf\r\nAccept: application/json\r\n",
+                          int_pair(1, 1));
+        EXPECT_EQ(R"({"z":2})", mixed.body);
+        auto refused = call("complete_sync", "Accept: text/html\r\n", "{}");
+        EXPECT_EQ("HTTP/1.1 406 Not Acceptable", status_line(refused));
+
+        auto async = call("complete_async_after_delay", "", R"({"x":6,"y":7})");
+        EXPECT_EQ(R"({"z":42})", async.body);
+
+        auto after = call("sync_throw_after_complete", "", R"({"x":7})");
+        EXPECT_EQ("HTTP/1.1 200 OK", status_line(after));
+        EXPECT_EQ(R"({"z":7})", after.body);
+
+        // failures
+        EXPECT_EQ("HTTP/1.1 500 Internal Server Error",
+                  status_line(call("sync_throw_nocomplete", "", "{}")));
+        EXPECT_EQ("HTTP/1.1 500 Internal Server Error",
+                  status_line(call("parameterised_test", "", "{}")));
+        EXPECT_EQ("HTTP/1.1 400 Bad Request",
+                  status_line(call("complete_sync", "", R"({"x":"two"})")));
+        EXPECT_EQ("HTTP/1.1 400 Bad Request",
+                  status_line(call("complete_sync", "Content-Type: application/x-protobuf\r\n", "\xff\xff")));
+        EXPECT_EQ("HTTP/1.1 413 Payload Too Large",
+                  status_line(call("complete_sync", "", std::string(2000, ' '))));
+        EXPECT_EQ("HTTP/1.1 404 Not Found",
+                  status_line(call("no_such_method", "", "{}")));
+
+        server.stop();
+    }
+}
+
+TEST(service_adapter_tests, calls_methods)
+{
+    auto service = std::make_shared<test_service>();
+    http::router router;
+    http::service_options options;
+    options.max_request_size = 1024;
+    http::add_service(router, service, options);
+    EXPECT_EQ(5, router.route_count());
+    check_service(router);
+}
+
+#if defined(SECR_DISPATCH_HAVE_TABLES)
+TEST(service_adapter_tests, generated_table_finds_methods)
+{
+    using table = test_proto::TestService_dispatch_table;
+    EXPECT_EQ(5, std::size_t(table::method_count));
+    auto descriptor = test_proto::TestService::descriptor();
+    for (int i = 0 ; i < descriptor->method_count() ; ++i)
+        EXPECT_EQ(i, table::find(descriptor->method(i)->name())) << descriptor->method(i)->name();
+    EXPECT_EQ(-1, table::find(""));
+    EXPECT_EQ(-1, table::find("complete"));
+    EXPECT_EQ(-1, table::find("complete_sync_"));
+    EXPECT_EQ(-1, table::find("COMPLETE_SYNC"));
+}
+
+TEST(service_adapter_tests, calls_methods_through_generated_table)
+{
+    auto service = std::make_shared<test_service>();
+    http::router router;
+    http::service_options options;
+    options.max_request_size = 1024;
+    http::add_service_table<test_proto::TestService_dispatch_table>(router, service, options);
+    EXPECT_EQ(1, router.route_count());
+    check_service(router);
+}
+#endif
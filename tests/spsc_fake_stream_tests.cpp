@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+#include <secr/dispatch/spsc_fake_stream.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace {
+
+    namespace asio = secr::dispatch::asio;
+    using secr::dispatch::error_code;
+    using secr::dispatch::spsc_fake_stream;
+}
+
+TEST(spsc_fake_stream_tests, async_reader_keeps_up_with_a_blocked_writer)
+{
+    asio::io_service r, w;
+    spsc_fake_stream fs(r, w, 10);
+    EXPECT_EQ(16, fs.capacity());
+
+    std::string data;
+    for (int i = 0 ; i < 10000 ; ++i)
+        data += std::to_string(i) + ",";
+
+    // the reader runs on its own io_service and thread
+    auto work = std::make_unique<asio::io_service::work>(r);
+    std::string received;
+    error_code read_error;
+    char buf[7];
+    std::function<void()> read_more = [&]
+    {
+        fs.async_read_some(asio::buffer(buf), [&](const error_code& ec, std::size_t size)
+                           {
+                               received.append(buf, size);
+                               if (ec)
+                               {
+                                   read_error = ec;
+                                   work.reset();
+                               }
+                               else
+                                   read_more();
+                           });
+    };
+    read_more();
+    std::thread reader([&r] { r.run(); });
+
+    // the writer fills the ring and waits for room
+    for (std::size_t pos = 0 ; pos < data.size() ; pos += 100)
+    {
+        auto buffer = asio::buffer(data.data() + pos, std::min<std::size_t>(100, data.size() - pos));
+        asio::write(fs, buffer);
+    }
+    fs.close();
+    reader.join();
+
+    EXPECT_EQ(data, received);
+    EXPECT_EQ(asio::error::misc_errors::eof, read_error);
+    EXPECT_THROW(fs.write_some(asio::buffer("x", 1)), secr::dispatch::system_error);
+}
+
+TEST(spsc_fake_stream_tests, async_writer_waits_for_room)
+{
+    asio::io_service r, w;
+    spsc_fake_stream fs(r, w, 4);
+
+    std::size_t written = 0;
+    auto write = [&](const char* data)
+    {
+        fs.async_write_some(asio::buffer(data, 4), [&](const error_code& ec, std::size_t size)
+                            {
+                                EXPECT_FALSE(ec);
+                                written += size;
+                            });
+    };
+
+    write("abcd");
+    EXPECT_TRUE(spins_once_within(w, a_while()));
+    EXPECT_EQ(4, written);
+
+    // the ring is full, so the write waits
+    write("efgh");
+    EXPECT_FALSE(spins_once_within(w, 10ms));
+
+    char buf[2];
+    EXPECT_EQ(2, fs.read_some(asio::buffer(buf)));
+    EXPECT_EQ("ab", std::string(buf, 2));
+    EXPECT_TRUE(spins_once_within(w, a_while()));
+    EXPECT_TRUE(spins_once_within(w, a_while()));
+    EXPECT_EQ(6, written);
+
+    // data written before the stream is closed is still read
+    fs.close();
+    char rest[8];
+    error_code ec;
+    auto size = asio::read(fs, asio::buffer(rest), ec);
+    EXPECT_EQ(asio::error::misc_errors::eof, ec);
+    EXPECT_EQ("cdef", std::string(rest, size));
+}
+
+TEST(spsc_fake_stream_tests, cancel_aborts_a_waiting_read)
+{
+    asio::io_service r, w;
+    spsc_fake_stream fs(r, w);
+
+    char buf[4];
+    error_code read_error;
+    fs.async_read_some(asio::buffer(buf), [&](const error_code& ec, std::size_t size)
+                       {
+                           EXPECT_EQ(0, size);
+                           read_error = ec;
+                       });
+    EXPECT_FALSE(spins_once_within(r, 10ms));
+
+    fs.cancel();
+    EXPECT_TRUE(spins_once_within(r, a_while()));
+    EXPECT_EQ(asio::error::basic_errors::operation_aborted, read_error);
+}
@@ -1,5 +1,7 @@
 #include "test_utils.hpp"
+#include <secr/dispatch/http/service_adapter.hpp>
 #include <chrono>
+#include <stdexcept>
 
 static constexpr bool debugging = true;
 
@@ -16,3 +18,66 @@ std::chrono::milliseconds a_moment()
 	return debugging ? 600000ms : 5ms;
 }
 
+
+std::string round_trip(boost::asio::io_service& io_service,
+                       const boost::asio::ip::tcp::endpoint& endpoint,
+                       const std::string& request)
+{
+    namespace asio = boost::asio;
+    asio::ip::tcp::socket socket(io_service);
+    socket.connect(endpoint);
+    asio::write(socket, asio::buffer(request));
+    asio::streambuf response;
+    boost::system::error_code ec;
+    asio::read(socket, response, ec);
+    auto data = response.data();
+    return std::string(asio::buffer_cast<const char*>(data), asio::buffer_size(data));
+}
+
+test_service::~test_service()
+{
+    for (auto& t : threads)
+        t.join();
+}
+
+void test_service::complete_sync(google::protobuf::RpcController*,
+                                 const secr::testing::IntPair* request,
+                                 secr::testing::Int* response,
+                                 google::protobuf::Closure* done)
+{
+    response->set_z(request->x() + request->y());
+    done->Run();
+}
+
+void test_service::complete_async_after_delay(google::protobuf::RpcController*,
+                                              const secr::testing::IntPair* request,
+                                              secr::testing::Int* response,
+                                              google::protobuf::Closure* done)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.emplace_back([request, response, done] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(request->x()));
+        response->set_z(request->x() * request->y());
+        done->Run();
+    });
+}
+
+void test_service::sync_throw_nocomplete(google::protobuf::RpcController*,
+                                         const secr::testing::IntPair*,
+                                         secr::testing::Int*,
+                                         google::protobuf::Closure*)
+{
+    throw std::runtime_error("no completion");
+}
+
+void test_service::sync_throw_after_complete(google::protobuf::RpcController* controller,
+                                             const secr::testing::IntPair* request,
+                                             secr::testing::Int* response,
+                                             google::protobuf::Closure* done)
+{
+    auto& context = dynamic_cast<secr::dispatch::http::rpc_controller&>(*controller).context();
+    auto path = context.request().raw_path();
+    response->set_z(path == secr::dispatch::string_view("/secr.testing.TestService/sync_throw_after_complete") ? request->x() : -1);
+    done->Run();
+    throw std::runtime_error("after completion");
+}
@@ -1,19 +1,65 @@
 #pragma once
 
 #include <chrono>
+#include <iostream>
 #include <thread>
 #include <future>
+#include <mutex>
+#include <string>
 #include <utility>
 #include <array>
 #include <vector>
 #include <valuelib/debug/unwrap.hpp>
 
+#include <secr/dispatch/testing.pb.h>
+
 #include <boost/asio.hpp>
 #include <gtest/gtest.h>
 
 std::chrono::milliseconds a_while();
 std::chrono::milliseconds a_moment();
 
+/// connect, send one request and read the response until the server closes
+std::string round_trip(boost::asio::io_service& io_service,
+                       const boost::asio::ip::tcp::endpoint& endpoint,
+                       const std::string& request);
+
+/// The implementation of secr.testing.TestService served by the service and
+/// batch tests. Asynchronous calls complete on threads of its own, which are
+/// joined on destruction.
+struct test_service : secr::testing::TestService
+{
+    ~test_service();
+
+    /// z = x + y
+    void complete_sync(google::protobuf::RpcController*,
+                       const secr::testing::IntPair* request,
+                       secr::testing::Int* response,
+                       google::protobuf::Closure* done) override;
+
+    /// z = x * y, after a delay of x milliseconds, so that calls complete
+    /// in order of x rather than in the order they were made
+    void complete_async_after_delay(google::protobuf::RpcController*,
+                                    const secr::testing::IntPair* request,
+                                    secr::testing::Int* response,
+                                    google::protobuf::Closure* done) override;
+
+    void sync_throw_nocomplete(google::protobuf::RpcController*,
+                               const secr::testing::IntPair*,
+                               secr::testing::Int*,
+                               google::protobuf::Closure*) override;
+
+    /// z = x if the request, seen through the controller, was for this
+    /// method. Throws after completing.
+    void sync_throw_after_complete(google::protobuf::RpcController* controller,
+                                   const secr::testing::IntPair* request,
+                                   secr::testing::Int* response,
+                                   google::protobuf::Closure* done) override;
+
+    std::mutex mutex;
+    std::vector<std::thread> threads;
+};
+
 
 using namespace std::literals;
 
@@ -77,6 +123,23 @@ testing::AssertionResult listen_anywhere(AcceptorType& acceptor)
     return testing::AssertionFailure() << "Cannot listen. Last error was " << err << " " << err.message();
 }
 
+/// Call f iterations times and print the mean time of a call. f returns a
+/// count, such as the number of bytes it produced, whose mean is printed
+/// with unit. Benchmarks report and do not assert, since their timings
+/// depend on the machine and its load.
+template<class F>
+void report_timing(const char* name, std::size_t iterations, const char* unit, F&& f)
+{
+    using clock_type = std::chrono::steady_clock;
+    std::size_t total = 0;
+    auto start = clock_type::now();
+    for (std::size_t i = 0 ; i < iterations ; ++i)
+        total += f();
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start);
+    std::cout << name << " : " << (elapsed.count() / iterations) << "ns per call ("
+    << (total / iterations) << " " << unit << ")" << std::endl;
+}
+
 template<class T>
 std::exception_ptr has_error(std::future<T>& future)
 {
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+
+#include <secr/dispatch/asioex/timer_wheel.hpp>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    
+    namespace asio = secr::dispatch::asio;
+    using secr::dispatch::asioex::timer_wheel_service;
+    using secr::dispatch::asioex::wheel_timer;
+    
+    /// a wheel which is only driven by the test
+    timer_wheel_service& manual_wheel(asio::io_service& io_service)
+    {
+        auto& service = asio::use_service<timer_wheel_service>(io_service);
+        service.set_tick_duration(std::chrono::hours(1));
+        return service;
+    }
+    
+}
+
+TEST(timer_wheel_tests, fires_after_duration)
+{
+    asio::io_service io_service;
+    auto& wheel = manual_wheel(io_service);
+    
+    int fired = 0;
+    wheel_timer timer(io_service);
+    EXPECT_FALSE(timer.expires_after(std::chrono::hours(3), [&] { ++fired; }));
+    EXPECT_EQ(1, wheel.size());
+    
+    EXPECT_EQ(0, wheel.advance(2));
+    io_service.poll();
+    EXPECT_EQ(0, fired);
+    
+    EXPECT_EQ(1, wheel.advance(1));
+    EXPECT_EQ(0, fired);
+    io_service.poll();
+    EXPECT_EQ(1, fired);
+    EXPECT_EQ(0, wheel.size());
+    
+    // the handler has been delivered, so cancel has nothing to cancel
+    EXPECT_FALSE(timer.cancel());
+}
+
+TEST(timer_wheel_tests, cancel_and_reschedule)
+{
+    asio::io_service io_service;
+    auto& wheel = manual_wheel(io_service);
+    
+    std::vector<int> fired;
+    wheel_timer timer(io_service);
+    timer.expires_after(std::chrono::hours(1), [&] { fired.push_back(1); });
+    EXPECT_TRUE(timer.expires_after(std::chrono::hours(2), [&] { fired.push_back(2); }));
+    EXPECT_EQ(1, wheel.size());
+    
+    wheel.advance(2);
+    io_service.poll();
+    EXPECT_EQ(std::vector<int>({ 2 }), fired);
+    
+    timer.expires_after(std::chrono::hours(1), [&] { fired.push_back(3); });
+    EXPECT_TRUE(timer.cancel());
+    EXPECT_EQ(0, wheel.size());
+    wheel.advance(10);
+    io_service.poll();
+    EXPECT_EQ(std::vector<int>({ 2 }), fired);
+    
+    {
+        // destroying a timer removes it from the wheel
+        wheel_timer transient(io_service);
+        transient.expires_after(std::chrono::hours(1), [&] { fired.push_back(4); });
+        EXPECT_EQ(1, wheel.size());
+    }
+    EXPECT_EQ(0, wheel.size());
+}
+
+TEST(timer_wheel_tests, cascades_through_levels)
+{
+    asio::io_service io_service;
+    auto& wheel = manual_wheel(io_service);
+    
+    // durations which land on every level of the wheel, including the slot
+    // boundaries
+    std::vector<std::size_t> durations = { 1, 63, 64, 65, 100, 4095, 4096, 4097, 262143, 262144, 300000 };
+    std::vector<std::unique_ptr<wheel_timer>> timers;
+    std::vector<std::size_t> fired_at(durations.size(), 0);
+    std::size_t now = 0;
+    
+    // start part-way through the lowest level
+    wheel_timer offset(io_service);
+    offset.expires_after(std::chrono::hours(1), [] {});
+    wheel.advance(17);
+    now = 17;
+    
+    for (std::size_t i = 0 ; i < durations.size() ; ++i)
+    {
+        timers.push_back(std::make_unique<wheel_timer>(io_service));
+        timers.back()->expires_after(std::chrono::hours(durations[i]),
+                                     [&, i] { fired_at[i] = now; });
+    }
+    
+    while (wheel.size())
+    {
+        wheel.advance(1);
+        ++now;
+        io_service.poll();
+        io_service.reset();
+    }
+    
+    for (std::size_t i = 0 ; i < durations.size() ; ++i) {
+        EXPECT_EQ(17 + durations[i], fired_at[i]) << "duration " << durations[i];
+    }
+}
+
+TEST(timer_wheel_tests, driven_by_real_time)
+{
+    asio::io_service io_service;
+    auto& wheel = asio::use_service<timer_wheel_service>(io_service);
+    wheel.set_tick_duration(std::chrono::milliseconds(10));
+    
+    bool fired = false;
+    wheel_timer timer(io_service);
+    timer.expires_after(std::chrono::milliseconds(30), [&] { fired = true; });
+    
+    auto t0 = std::chrono::steady_clock::now();
+    while (not fired and std::chrono::steady_clock::now() - t0 < a_while()) {
+        io_service.run_one();
+    }
+    EXPECT_TRUE(fired);
+    EXPECT_GE(std::chrono::steady_clock::now() - t0, std::chrono::milliseconds(30));
+}
+
+TEST(timer_wheel_tests, lagging_wheel_does_not_fire_early)
+{
+    asio::io_service io_service;
+    auto& wheel = asio::use_service<timer_wheel_service>(io_service);
+    wheel.set_tick_duration(std::chrono::milliseconds(10));
+    
+    // keep the wheel occupied, so that it is not brought up to date on schedule
+    wheel_timer idle(io_service);
+    idle.expires_after(std::chrono::seconds(10), [] {});
+    
+    // let the wheel fall behind real time by several ticks
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    
+    bool fired = false;
+    wheel_timer timer(io_service);
+    auto t0 = std::chrono::steady_clock::now();
+    timer.expires_after(std::chrono::milliseconds(30), [&] { fired = true; });
+    
+    while (not fired and std::chrono::steady_clock::now() - t0 < a_while()) {
+        io_service.run_one();
+    }
+    EXPECT_TRUE(fired);
+    // measured from the start of the tick in which it was scheduled
+    EXPECT_GE(std::chrono::steady_clock::now() - t0, std::chrono::milliseconds(20));
+}
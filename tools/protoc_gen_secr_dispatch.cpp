@@ -0,0 +1,209 @@
+/// @file protoc plugin which generates, for each service of a .proto file,
+/// a dispatch table for secr::dispatch::http::add_service_table.
+///
+/// For foo.proto it writes foo.dispatch.pb.h, to be placed beside foo.pb.h.
+///
+/// usage:
+///     protoc --plugin=protoc-gen-secr_dispatch=<path to this program>
+///            --secr_dispatch_out=<dir> foo.proto
+
+#include <secr/dispatch/http/method_hash.hpp>
+
+#include <google/protobuf/compiler/plugin.pb.h>
+#include <google/protobuf/descriptor.h>
+
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+    namespace pb = google::protobuf;
+    using secr::dispatch::http::method_hash;
+
+    std::string replace_all(std::string s, const std::string& from, const std::string& to)
+    {
+        for (auto pos = s.find(from) ; pos != std::string::npos ; pos = s.find(from, pos + to.size()))
+            s.replace(pos, from.size(), to);
+        return s;
+    }
+
+    std::string cpp_namespace(const std::string& package)
+    {
+        return package.empty() ? std::string() : "::" + replace_all(package, ".", "::");
+    }
+
+    /// The C++ name of a message: nested types are joined with underscores
+    std::string cpp_type(const pb::Descriptor* message)
+    {
+        auto& package = message->file()->package();
+        auto local = message->full_name().substr(package.empty() ? 0 : package.size() + 1);
+        return cpp_namespace(package) + "::" + replace_all(local, ".", "_");
+    }
+
+    std::string file_base(const std::string& proto_name)
+    {
+        auto dot = proto_name.rfind(".proto");
+        return dot == std::string::npos ? proto_name : proto_name.substr(0, dot);
+    }
+
+    /// A seed and table size which give every name a slot of its own
+    struct perfect_hash
+    {
+        std::uint32_t seed = 0;
+        std::size_t slot_count = 1;
+        std::vector<int> slots;
+    };
+
+    perfect_hash find_perfect_hash(const std::vector<std::string>& names)
+    {
+        perfect_hash result;
+        while (result.slot_count < names.size())
+            result.slot_count *= 2;
+
+        for ( ; ; result.slot_count *= 2)
+        {
+            for (std::uint32_t seed = 0 ; seed < 100000 ; ++seed)
+            {
+                std::vector<int> slots(result.slot_count, -1);
+                bool collision = false;
+                for (std::size_t i = 0 ; i < names.size() and not collision ; ++i)
+                {
+                    auto& slot = slots[method_hash(names[i], seed) & (result.slot_count - 1)];
+                    collision = slot >= 0;
+                    slot = int(i);
+                }
+                if (not collision)
+                {
+                    result.seed = seed;
+                    result.slots = std::move(slots);
+                    return result;
+                }
+            }
+        }
+    }
+
+    void generate_table(std::ostream& out, const pb::ServiceDescriptor* service)
+    {
+        std::vector<std::string> names;
+        for (int i = 0 ; i < service->method_count() ; ++i)
+            names.push_back(service->method(i)->name());
+        auto hash = find_perfect_hash(names);
+
+        out << "/// Reflection-free dispatch table of " << service->full_name() << "\n";
+        out << "struct " << service->name() << "_dispatch_table\n";
+        out << "{\n";
+        out << "    using service_type = " << service->name() << ";\n";
+        out << "    static constexpr const char* service_name = \"" << service->full_name() << "\";\n";
+        out << "    static constexpr std::size_t method_count = " << names.size() << ";\n";
+        out << "\n";
+        out << "    static int find(::secr::dispatch::string_view name)\n";
+        out << "    {\n";
+        out << "        static const int slots[" << hash.slot_count << "] = {";
+        for (std::size_t i = 0 ; i < hash.slots.size() ; ++i)
+            out << (i ? ", " : " ") << hash.slots[i];
+        out << " };\n";
+        out << "        static const char* const names[" << names.size() << "] = {\n";
+        for (auto& name : names)
+            out << "            \"" << name << "\",\n";
+        out << "        };\n";
+        out << "        auto i = slots[::secr::dispatch::http::method_hash(name, " << hash.seed << "u) & "
+            << (hash.slot_count - 1) << "];\n";
+        out << "        return i >= 0 and name == ::secr::dispatch::string_view(names[i]) ? i : -1;\n";
+        out << "    }\n";
+        out << "\n";
+        out << "    static std::shared_ptr<const ::secr::dispatch::http::method_binding>\n";
+        out << "    bind(const std::shared_ptr<service_type>& service, int index)\n";
+        out << "    {\n";
+        out << "        switch (index)\n";
+        out << "        {\n";
+        for (int i = 0 ; i < service->method_count() ; ++i)
+        {
+            auto method = service->method(i);
+            out << "            case " << i << ":\n";
+            out << "                return ::secr::dispatch::http::bind_method<service_type, "
+                << cpp_type(method->input_type()) << ", " << cpp_type(method->output_type()) << ">\n";
+            out << "                (service, \"" << method->full_name() << "\", &service_type::" << method->name() << ");\n";
+        }
+        out << "        }\n";
+        out << "        return nullptr;\n";
+        out << "    }\n";
+        out << "};\n";
+    }
+
+    std::string generate_file(const pb::FileDescriptor* file)
+    {
+        std::ostringstream out;
+        out << "// Generated by protoc-gen-secr_dispatch from " << file->name() << ". Do not edit.\n";
+        out << "#pragma once\n\n";
+        out << "#include \"" << file_base(file->name()) << ".pb.h\"\n";
+        out << "#include <secr/dispatch/http/service_table.hpp>\n\n";
+
+        // one namespace per component of the package
+        std::vector<std::string> namespaces;
+        std::istringstream package(file->package());
+        for (std::string component ; std::getline(package, component, '.') ; )
+            namespaces.push_back(component);
+        for (std::size_t i = 0 ; i < namespaces.size() ; ++i)
+            out << (i ? " " : "") << "namespace " << namespaces[i] << " {";
+        if (not namespaces.empty())
+            out << "\n\n";
+        bool first = true;
+        for (int i = 0 ; i < file->service_count() ; ++i)
+        {
+            // a service without methods has nothing to dispatch
+            if (file->service(i)->method_count() == 0)
+                continue;
+            if (not first)
+                out << "\n";
+            first = false;
+            generate_table(out, file->service(i));
+        }
+        if (not namespaces.empty())
+            out << "\n" << std::string(namespaces.size(), '}') << "\n";
+        return out.str();
+    }
+}
+
+int main()
+{
+    pb::compiler::CodeGeneratorRequest request;
+    if (not request.ParseFromFileDescriptor(STDIN_FILENO))
+    {
+        std::cerr << "protoc-gen-secr_dispatch: cannot read the request" << std::endl;
+        return 1;
+    }
+
+    // the files arrive in dependency order
+    pb::DescriptorPool pool;
+    for (auto& proto : request.proto_file())
+        pool.BuildFile(proto);
+
+    pb::compiler::CodeGeneratorResponse response;
+    response.set_supported_features(pb::compiler::CodeGeneratorResponse::FEATURE_PROTO3_OPTIONAL);
+    for (auto& name : request.file_to_generate())
+    {
+        auto file = pool.FindFileByName(name);
+        if (not file)
+        {
+            response.set_error("cannot build " + name);
+            break;
+        }
+        // a file without services still has a header, so that the build can
+        // rely on one being written for every .proto file
+        auto generated = response.add_file();
+        generated->set_name(file_base(name) + ".dispatch.pb.h");
+        generated->set_content(generate_file(file));
+    }
+
+    if (not response.SerializeToFileDescriptor(STDOUT_FILENO))
+    {
+        std::cerr << "protoc-gen-secr_dispatch: cannot write the response" << std::endl;
+        return 1;
+    }
+    return 0;
+}